@@ -83,6 +83,12 @@ struct FrameInfo
     SkyAtmosphere sky;
 };
 
+// WARNING: must match Std430ChunkDrawData in Renderer.hpp
+struct ChunkDrawData
+{
+    float3 origin;
+};
+
 const float2 Screen_Space_Position[6] = float2[](
     float2(0,0), float2(1,0), float2(1,1),
     float2(0,0), float2(1,1), float2(0,1)
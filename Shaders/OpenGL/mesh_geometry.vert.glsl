@@ -13,6 +13,12 @@ layout(std140) uniform frame_info_buffer
     FrameInfo frame_info;
 };
 
+// Indexed by the base instance of the draw command
+layout(std430) readonly buffer chunk_draw_buffer
+{
+    ChunkDrawData chunk_draws[];
+};
+
 out gl_PerVertex
 {
     float4 gl_Position;
@@ -38,13 +44,15 @@ void main()
     tex_coords_start += frame_info.texture_border_size / frame_info.texture_atlas_size;
     tex_coords_end -= frame_info.texture_border_size / frame_info.texture_atlas_size;
 
+    float3 world_position = v_position + chunk_draws[gl_BaseInstance].origin;
+
     block = v_block;
     block_face = v_block_face;
-    position = v_position;
+    position = world_position;
     normal = Block_Normals[v_block_face];
     tex_coords = mix(tex_coords_start, tex_coords_end, Block_Tex_Coords[v_block_corner]);
     face_coords = Block_Tex_Coords[v_block_corner];
     occlusion = float(v_occlusion > 0);
 
-    gl_Position = frame_info.camera.projection * frame_info.camera.view * float4(v_position,1);
+    gl_Position = frame_info.camera.projection * frame_info.camera.view * float4(world_position,1);
 }
@@ -22,6 +22,12 @@ layout(std140) uniform frame_info_buffer
     FrameInfo frame_info;
 };
 
+// Indexed by the base instance of the draw command
+layout(std430) readonly buffer chunk_draw_buffer
+{
+    ChunkDrawData chunk_draws[];
+};
+
 out gl_PerVertex
 {
     float4 gl_Position;
@@ -30,7 +36,9 @@ out gl_PerVertex
 
 void main()
 {
+    float3 world_position = v_position + chunk_draws[gl_BaseInstance].origin;
+
     int cascade_index = gl_InstanceID % 4;
-    gl_Position = frame_info.shadow_map.cascade_matrices[cascade_index] * float4(v_position, 1);
+    gl_Position = frame_info.shadow_map.cascade_matrices[cascade_index] * float4(world_position, 1);
     gl_Layer = cascade_index;
 }
@@ -10,6 +10,10 @@
 #include <pthread.h>
 #include <semaphore.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #if defined(_WIN32)
 #define VOX_PLATFORM_WINDOWS
 #elif defined(__linux__)
@@ -81,6 +85,42 @@ enum AllocatorOp
 
 typedef void *(*AllocatorFunc)(AllocatorOp op, s64 size, void *ptr, void *data);
 
+// Heap allocations are tagged with the subsystem they belong to, so we know where the memory goes.
+// The tag is stored in the data of the allocator, heap is untagged. Every heap allocation has
+// a small header with its size and tag, so it can be accounted for when it is freed
+enum MemoryTag
+{
+    MemoryTag_Untagged,
+    MemoryTag_World,
+    MemoryTag_Chunks,
+    MemoryTag_Meshes,
+    MemoryTag_Uploads,
+    MemoryTag_Graphics,
+    MemoryTag_UI,
+    MemoryTag_HashMaps,
+    MemoryTag_Jobs,
+    MemoryTag_Profiler,
+    MemoryTag_Count,
+};
+
+struct MemoryTagStats
+{
+    s64 live_bytes = 0;
+    s64 peak_bytes = 0;
+    s64 num_allocations = 0;      // Since the start
+    s64 num_live_allocations = 0;
+};
+
+const char *GetMemoryTagName(MemoryTag tag);
+MemoryTagStats GetMemoryTagStats(MemoryTag tag);
+
+// For memory that does not come from the heap (e.g. mapped with mmap)
+void RecordTaggedAllocation(MemoryTag tag, s64 size);
+void RecordTaggedFree(MemoryTag tag, s64 size);
+
+// Logs the tags that still have live allocations, returns false if there are any
+bool ReportMemoryLeaks();
+
 void *HeapAllocator(AllocatorOp op, s64 size, void *ptr, void *data);
 
 struct Allocator
@@ -92,6 +132,11 @@ struct Allocator
 extern Allocator heap;
 extern Allocator temp;
 
+static inline Allocator TaggedHeap(MemoryTag tag)
+{
+    return Allocator{(void *)(uintptr_t)tag, HeapAllocator};
+}
+
 void *Alloc(s64 size, Allocator allocator);
 void Free(void *ptr, Allocator allocator);
 
@@ -129,15 +174,61 @@ struct MemoryArenaPage
 struct MemoryArena
 {
     MemoryArenaPage *last_page = null;
+    MemoryArenaPage *free_pages = null; // Pages given back by RestoreMemoryArena, reused before allocating new ones
     s64 used = 0;
     s64 total_size = 0;
 };
 
+struct MemoryArenaMark
+{
+    MemoryArenaPage *page = null;
+    s64 page_used = 0;
+    s64 used = 0;
+};
+
+// Frees all the pages, including the free ones
 void ResetMemoryArena(MemoryArena *arena);
 void *AllocFromArena(MemoryArena *arena, s64 size);
 
+MemoryArenaMark GetMemoryArenaMark(MemoryArena *arena);
+// Frees everything allocated since the mark. The pages are kept for the next allocations
+void RestoreMemoryArena(MemoryArena *arena, MemoryArenaMark mark);
+
 void *MemoryArenaAllocator(AllocatorOp op, s64 size, void *ptr, void *data);
 
+// Every thread has its own scratch arena, so unlike temp it can be used by jobs.
+// Job workers restore it to empty between jobs, other threads have to use ScratchScope,
+// anything allocated with scratch must not outlive the job or the scope
+extern Allocator scratch;
+
+struct ScratchArenaStats
+{
+    s64 num_allocations = 0; // Since the last reset
+    s64 used = 0;
+    s64 peak_used = 0;       // Since the last reset
+    s64 reserved = 0;
+};
+
+void *ScratchAllocator(AllocatorOp op, s64 size, void *ptr, void *data);
+
+MemoryArenaMark GetScratchMark();
+void RestoreScratch(MemoryArenaMark mark);
+// Restores the scratch arena of the calling thread to empty and resets its stats
+void ResetScratchArena();
+// Gives the pages back to the OS, call before a thread that used scratch exits
+void FreeScratchArena();
+ScratchArenaStats GetScratchArenaStats();
+
+struct ScratchArenaScope
+{
+    MemoryArenaMark mark;
+
+    ScratchArenaScope() { mark = GetScratchMark(); }
+    ~ScratchArenaScope() { RestoreScratch(mark); }
+};
+
+#define ScratchScope() ScratchArenaScope _defer3(_scratch_scope_)
+
 struct String
 {
     s64 length = 0;
@@ -228,7 +319,15 @@ static const char *Log_Graphics = "Graphics";
 static const char *Log_Vulkan   = "Graphics/Vulkan";
 static const char *Log_OpenGL   = "Graphics/OpenGL";
 static const char *Log_Metal    = "Graphics/Metal";
+static const char *Log_Null     = "Graphics/Null";
 static const char *Log_Shaders  = "Graphics/Shaders";
+static const char *Log_Bench    = "Bench";
+static const char *Log_Profiler = "Profiler";
+static const char *Log_Metrics  = "Metrics";
+static const char *Log_World    = "World";
+static const char *Log_Jobs     = "Jobs";
+static const char *Log_Memory   = "Memory";
+static const char *Log_Main     = "Main";
 
 void LogMessage(const char *section, const char *str, ...);
 void LogWarning(const char *section, const char *str, ...);
@@ -426,139 +525,273 @@ static inline u64 Fnv1aHash(void *data, s64 size, u64 h = Fnv_64_Offset_Basis)
     return h;
 }
 
-#define Hash_Map_Never_Occupied 0
-#define Hash_Map_Removed 1
-#define Hash_Map_First_Occupied 2
+// Finalizer of MurmurHash3, every bit of the input affects every bit of the output
+static inline u64 HashMix(u64 x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccd;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53;
+    x ^= x >> 33;
+
+    return x;
+}
+
+// Hashes 8 bytes at a time, much faster than Fnv1aHash on small keys
+static inline u64 HashBytes(const void *data, s64 size, u64 seed = 0)
+{
+    const u8 *bytes = (const u8 *)data;
+    u64 h = seed ^ ((u64)size * 0x9e3779b97f4a7c15);
+
+    s64 i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        u64 word;
+        memcpy(&word, bytes + i, 8);
+        h = HashMix(h ^ word);
+    }
+
+    if (i < size)
+    {
+        u64 word = 0;
+        memcpy(&word, bytes + i, size - i);
+        h = HashMix(h ^ word);
+    }
+
+    return h;
+}
+
+// Hash and comparison of the keys of a HashMap, resolved at compile time. The default compares
+// and hashes the bytes of the key, so keys must not have padding. Use your own policy otherwise:
+//     struct MyKeyPolicy
+//     {
+//         static u64 Hash(const MyKey &key);
+//         static bool Equals(const MyKey &a, const MyKey &b);
+//     };
+template<typename TKey>
+struct HashMapDefaultPolicy
+{
+    static inline u64 Hash(const TKey &key)
+    {
+        return HashBytes(&key, sizeof(TKey));
+    }
+
+    static inline bool Equals(const TKey &a, const TKey &b)
+    {
+        return memcmp(&a, &b, sizeof(TKey)) == 0;
+    }
+};
+
+// Swiss table (see Abseil's flat_hash_map): every slot has a control byte that is either empty,
+// removed, or the top 7 bits of the hash of the key. Lookups compare the control bytes of a group
+// of 16 slots at once, and only compare the keys whose 7 bits match
+#define Hash_Map_Group_Size 16
+#define Hash_Map_Empty ((s8)-128)
+#define Hash_Map_Removed ((s8)-2)
 #define Hash_Map_Min_Capacity 32
-#define Hash_Map_Load_Limit 70
+#define Hash_Map_Load_Limit 87
 
-template<typename TKey, typename TValue>
+template<typename TKey, typename TValue, typename TPolicy = HashMapDefaultPolicy<TKey>>
 struct HashMap
 {
     struct Entry
     {
-        u64 hash = 0;
         TKey key;
         TValue value;
     };
 
-    typedef bool (*CompareFunc)(TKey a, TKey b);
-    typedef u64 (*HashFunc)(TKey key);
-
-    CompareFunc Compare = null;
-    HashFunc Hash = null;
-
-    Slice<Entry> entries = {};
+    // capacity + Hash_Map_Group_Size control bytes, the first group is repeated at the
+    // end so a group can be loaded from any slot without wrapping around
+    s8 *control = null;
+    Entry *entries = null;
+    s64 capacity = 0;
     Allocator allocator = {};
-    s64 occupied = 0;
     s64 count = 0;
+    s64 num_removed = 0;
 };
 
-template<typename TKey, typename TValue>
-void HashMapFree(HashMap<TKey, TValue> *map)
+// Bit i is set if control byte i of the group matches
+typedef u32 HashMapGroupMask;
+
+static inline HashMapGroupMask HashMapMatchGroup(const s8 *group, s8 value)
+{
+    #if defined(__SSE2__)
+        __m128i bytes = _mm_loadu_si128((const __m128i *)group);
+
+        return (HashMapGroupMask)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(value)));
+    #else
+        HashMapGroupMask mask = 0;
+        for (int i = 0; i < Hash_Map_Group_Size; i += 1)
+            mask |= (HashMapGroupMask)(group[i] == value) << i;
+
+        return mask;
+    #endif
+}
+
+// Empty and removed slots are the only ones with the high bit set
+static inline HashMapGroupMask HashMapMatchGroupFree(const s8 *group)
+{
+    #if defined(__SSE2__)
+        return (HashMapGroupMask)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+    #else
+        HashMapGroupMask mask = 0;
+        for (int i = 0; i < Hash_Map_Group_Size; i += 1)
+            mask |= (HashMapGroupMask)(group[i] < 0) << i;
+
+        return mask;
+    #endif
+}
+
+template<typename TKey, typename TValue, typename TPolicy>
+void HashMapSetControl(HashMap<TKey, TValue, TPolicy> *map, s64 index, s8 value)
+{
+    map->control[index] = value;
+    if (index < Hash_Map_Group_Size)
+        map->control[map->capacity + index] = value;
+}
+
+template<typename TKey, typename TValue, typename TPolicy>
+void HashMapFree(HashMap<TKey, TValue, TPolicy> *map)
 {
-    Free(map->entries.data, map->allocator);
-    map->entries = {};
-    map->occupied = 0;
+    Free(map->control, map->allocator);
+    Free(map->entries, map->allocator);
+    map->control = null;
+    map->entries = null;
+    map->capacity = 0;
     map->count = 0;
+    map->num_removed = 0;
 }
 
-template<typename TKey, typename TValue>
-void HashMapGrow(HashMap<TKey, TValue> *map)
+template<typename TKey, typename TValue, typename TPolicy>
+void HashMapRehash(HashMap<TKey, TValue, TPolicy> *map, s64 new_capacity)
 {
-    typedef typename HashMap<TKey, TValue>::Entry Entry;
+    typedef typename HashMap<TKey, TValue, TPolicy>::Entry Entry;
+
+    Assert(new_capacity >= Hash_Map_Min_Capacity && (new_capacity & (new_capacity - 1)) == 0);
 
     if (!map->allocator.func)
-        map->allocator = heap;
+        map->allocator = TaggedHeap(MemoryTag_HashMaps);
 
-    Slice<Entry> old_entries = map->entries;
-    defer(Free(old_entries.data, map->allocator));
+    s8 *old_control = map->control;
+    Entry *old_entries = map->entries;
+    s64 old_capacity = map->capacity;
 
-    s64 new_capacity = (map->entries.count * 2 > Hash_Map_Min_Capacity ? map->entries.count * 2 : Hash_Map_Min_Capacity);
-    map->entries = {};
-    map->entries.data = Alloc<Entry>(new_capacity, map->allocator);
-    map->entries.count = new_capacity;
+    map->control = Alloc<s8>(new_capacity + Hash_Map_Group_Size, map->allocator);
+    map->entries = Alloc<Entry>(new_capacity, map->allocator);
+    map->capacity = new_capacity;
     map->count = 0;
-    map->occupied = 0;
+    map->num_removed = 0;
 
-    for (s64 i = 0; i < new_capacity; i += 1)
-        map->entries[i].hash = Hash_Map_Never_Occupied;
+    memset(map->control, Hash_Map_Empty, new_capacity + Hash_Map_Group_Size);
 
-    for (s64 i = 0; i < old_entries.count; i += 1)
+    for (s64 i = 0; i < old_capacity; i += 1)
     {
-        Entry entry = old_entries[i];
-        if (entry.hash >= Hash_Map_First_Occupied)
-            HashMapInsert(map, entry.key, entry.value);
+        if (old_control[i] >= 0)
+            HashMapInsert(map, old_entries[i].key, old_entries[i].value);
     }
+
+    Free(old_control, map->allocator);
+    Free(old_entries, map->allocator);
+}
+
+template<typename TKey, typename TValue, typename TPolicy>
+void HashMapGrow(HashMap<TKey, TValue, TPolicy> *map)
+{
+    s64 new_capacity = map->capacity * 2 > Hash_Map_Min_Capacity ? map->capacity * 2 : Hash_Map_Min_Capacity;
+    HashMapRehash(map, new_capacity);
 }
 
 struct HashMapProbeResult
 {
     u64 hash = 0;
-    s64 index = -1;
+    s64 index = -1; // Where the key is, or the first free slot it can be inserted at
     bool is_present = false;
 };
 
-template<typename TKey, typename TValue>
-HashMapProbeResult HashMapProbe(HashMap<TKey, TValue> *map, TKey key)
+template<typename TKey, typename TValue, typename TPolicy>
+HashMapProbeResult HashMapProbe(HashMap<TKey, TValue, TPolicy> *map, TKey key)
 {
-    Assert(map->entries.count > 0);
-    Assert(map->Compare != null);
-    Assert(map->Hash != null);
+    Assert(map->capacity > 0);
 
-    u64 mask = (u64)(map->entries.count - 1);
-    u64 hash = map->Hash(key);
-    if (hash < Hash_Map_First_Occupied)
-        hash += Hash_Map_First_Occupied;
+    u64 mask = (u64)(map->capacity - 1);
+    u64 hash = TPolicy::Hash(key);
+    s8 hash_bits = (s8)(hash >> 57);
 
-    u64 index = hash & mask;
-    u64 increment = 1 + (hash >> 27);
-    while (map->entries[index].hash != Hash_Map_Never_Occupied)
+    s64 first_free = -1;
+    u64 position = hash & mask;
+    u64 stride = 0;
+    while (true)
     {
-        auto entry = &map->entries[index];
+        const s8 *group = map->control + position;
 
-        if (entry->hash == hash && map->Compare(entry->key, key))
-            return {.hash=hash, .index=(s64)index, .is_present=true};
+        HashMapGroupMask matches = HashMapMatchGroup(group, hash_bits);
+        while (matches)
+        {
+            s64 index = (s64)((position + __builtin_ctz(matches)) & mask);
+            if (TPolicy::Equals(map->entries[index].key, key))
+                return {.hash=hash, .index=index, .is_present=true};
 
-        index += increment;
-        index &= mask;
-        increment += 1;
-    }
+            matches &= matches - 1;
+        }
+
+        HashMapGroupMask free_slots = HashMapMatchGroupFree(group);
+        if (free_slots && first_free < 0)
+            first_free = (s64)((position + __builtin_ctz(free_slots)) & mask);
+
+        // The key would have been put in this group if it was in the map
+        if (HashMapMatchGroup(group, Hash_Map_Empty))
+            return {.hash=hash, .index=first_free, .is_present=false};
 
-    return {.hash=hash, .index=(s64)index, .is_present=false};
+        stride += Hash_Map_Group_Size;
+        position = (position + stride) & mask;
+    }
 }
 
-template<typename TKey, typename TValue>
-TValue *HashMapFindOrAdd(HashMap<TKey, TValue> *map, TKey key, bool *was_present = null)
+template<typename TKey, typename TValue, typename TPolicy>
+TValue *HashMapFindOrAdd(HashMap<TKey, TValue, TPolicy> *map, TKey key, bool *was_present = null)
 {
-    if ((map->occupied + 1) * 100 >= map->entries.count * Hash_Map_Load_Limit)
+    if (map->capacity <= 0)
         HashMapGrow(map);
 
     auto probe = HashMapProbe(map, key);
-    auto entry = &map->entries[probe.index];
     if (was_present)
         *was_present = probe.is_present;
 
     if (probe.is_present)
-        return &entry->value;
+        return &map->entries[probe.index].value;
+
+    // Removed slots can be reused, so only filling an empty slot brings us closer to the limit
+    if (map->control[probe.index] == Hash_Map_Empty && (map->count + map->num_removed + 1) * 100 > map->capacity * Hash_Map_Load_Limit)
+    {
+        // Mostly removed slots, rehashing them away is enough
+        if (map->num_removed * 2 >= map->count)
+            HashMapRehash(map, map->capacity);
+        else
+            HashMapGrow(map);
+
+        probe = HashMapProbe(map, key);
+    }
 
-    entry->hash = probe.hash;
-    entry->key = key;
-    map->occupied += 1;
+    if (map->control[probe.index] == Hash_Map_Removed)
+        map->num_removed -= 1;
+
+    HashMapSetControl(map, probe.index, (s8)(probe.hash >> 57));
+    map->entries[probe.index].key = key;
+    map->entries[probe.index].value = TValue{};
     map->count += 1;
 
-    return &entry->value;
+    return &map->entries[probe.index].value;
 }
 
-template<typename TKey, typename TValue>
-void HashMapInsert(HashMap<TKey, TValue> *map, TKey key, TValue value)
+template<typename TKey, typename TValue, typename TPolicy>
+void HashMapInsert(HashMap<TKey, TValue, TPolicy> *map, TKey key, TValue value)
 {
     auto ptr = HashMapFindOrAdd(map, key);
     *ptr = value;
 }
 
-template<typename TKey, typename TValue>
-TValue *HashMapFindPtr(HashMap<TKey, TValue> *map, TKey key)
+template<typename TKey, typename TValue, typename TPolicy>
+TValue *HashMapFindPtr(HashMap<TKey, TValue, TPolicy> *map, TKey key)
 {
     if (map->count <= 0)
         return null;
@@ -570,8 +803,8 @@ TValue *HashMapFindPtr(HashMap<TKey, TValue> *map, TKey key)
     return null;
 }
 
-template<typename TKey, typename TValue>
-TValue HashMapFind(HashMap<TKey, TValue> *map, TKey key, TValue fallback = {})
+template<typename TKey, typename TValue, typename TPolicy>
+TValue HashMapFind(HashMap<TKey, TValue, TPolicy> *map, TKey key, TValue fallback = {})
 {
     auto ptr = HashMapFindPtr(map, key);
     if (!ptr)
@@ -580,8 +813,43 @@ TValue HashMapFind(HashMap<TKey, TValue> *map, TKey key, TValue fallback = {})
     return *ptr;
 }
 
-template<typename TKey, typename TValue>
-bool HashMapRemove(HashMap<TKey, TValue> *map, TKey key, TValue *removed_value = null)
+// For iterating over the slots, from 0 to capacity
+template<typename TKey, typename TValue, typename TPolicy>
+bool HashMapIsOccupied(HashMap<TKey, TValue, TPolicy> *map, s64 index)
+{
+    return map->control[index] >= 0;
+}
+
+// The slot can be removed while iterating, entries are never moved
+template<typename TKey, typename TValue, typename TPolicy>
+void HashMapRemoveAt(HashMap<TKey, TValue, TPolicy> *map, s64 index)
+{
+    Assert(HashMapIsOccupied(map, index));
+
+    u64 mask = (u64)(map->capacity - 1);
+
+    // If there is an empty slot in every group of 16 slots that contains this one, no lookup ever went
+    // past this slot because the group was full, so it can go back to being empty instead of removed
+    HashMapGroupMask empty_before = HashMapMatchGroup(map->control + ((index - Hash_Map_Group_Size) & mask), Hash_Map_Empty);
+    HashMapGroupMask empty_after = HashMapMatchGroup(map->control + index, Hash_Map_Empty);
+    bool was_never_full = empty_before && empty_after
+        && __builtin_ctz(empty_after) + (__builtin_clz(empty_before) - (32 - Hash_Map_Group_Size)) < Hash_Map_Group_Size;
+
+    if (was_never_full)
+    {
+        HashMapSetControl(map, index, Hash_Map_Empty);
+    }
+    else
+    {
+        HashMapSetControl(map, index, Hash_Map_Removed);
+        map->num_removed += 1;
+    }
+
+    map->count -= 1;
+}
+
+template<typename TKey, typename TValue, typename TPolicy>
+bool HashMapRemove(HashMap<TKey, TValue, TPolicy> *map, TKey key, TValue *removed_value = null)
 {
     if (map->count <= 0)
     {
@@ -600,12 +868,146 @@ bool HashMapRemove(HashMap<TKey, TValue> *map, TKey key, TValue *removed_value =
         return false;
     }
 
-    auto entry = &map->entries[probe.index];
-    entry->hash = Hash_Map_Removed;
-    map->count -= 1;
-
     if (removed_value)
-        *removed_value = entry->value;
+        *removed_value = map->entries[probe.index].value;
+
+    HashMapRemoveAt(map, probe.index);
+
+    return true;
+}
+
+// Dense array of items that can be removed in O(1), referenced by 32 bit handles.
+// A handle is the index of a slot in the low bits and the generation of the slot in the
+// high bits. The generation is incremented when the item is removed, so the handles
+// that still point to the slot are stale and SlotMapGet returns null for them.
+// Generations wrap around, so a handle that was kept through 4095 reuses of its slot can
+// point to the wrong item. The items are kept packed, removing one moves the last one in its place
+
+#define Slot_Map_Index_Bits 20
+#define Slot_Map_Max_Count (1 << Slot_Map_Index_Bits)
+#define Slot_Map_Generation_Mask ((1u << (32 - Slot_Map_Index_Bits)) - 1)
+#define Slot_Map_No_Free_Slot 0xffffffff
+
+struct SlotMapHandle
+{
+    u32 value = 0; // 0 is never a valid handle, since generations start at 1
+};
+
+static inline bool IsNull(SlotMapHandle handle)
+{
+    return handle.value == 0;
+}
+
+static inline bool operator ==(SlotMapHandle a, SlotMapHandle b)
+{
+    return a.value == b.value;
+}
+
+static inline bool operator !=(SlotMapHandle a, SlotMapHandle b)
+{
+    return a.value != b.value;
+}
+
+struct SlotMapSlot
+{
+    u32 generation = 1;
+    u32 index = 0; // Index of the item if the slot is used, next free slot otherwise
+};
+
+template<typename T>
+struct SlotMap
+{
+    Array<T> items = {};
+    Array<u32> item_slots = {}; // Slot of each item
+    Array<SlotMapSlot> slots = {};
+    u32 first_free_slot = Slot_Map_No_Free_Slot; // Free slots are linked through their index
+
+    inline T &operator [](s64 index)
+    {
+        return items[index];
+    }
+};
+
+template<typename T>
+void SlotMapSetAllocator(SlotMap<T> *map, Allocator allocator)
+{
+    map->items.allocator = allocator;
+    map->item_slots.allocator = allocator;
+    map->slots.allocator = allocator;
+}
+
+template<typename T>
+void SlotMapFree(SlotMap<T> *map)
+{
+    ArrayFree(&map->items);
+    ArrayFree(&map->item_slots);
+    ArrayFree(&map->slots);
+    map->first_free_slot = Slot_Map_No_Free_Slot;
+}
+
+template<typename T>
+SlotMapHandle SlotMapAdd(SlotMap<T> *map, T item)
+{
+    u32 slot_index = map->first_free_slot;
+    if (slot_index == Slot_Map_No_Free_Slot)
+    {
+        Assert(map->slots.count < Slot_Map_Max_Count, "Too many items in slot map, increase Slot_Map_Index_Bits");
+
+        slot_index = (u32)map->slots.count;
+        ArrayPush(&map->slots);
+    }
+    else
+    {
+        map->first_free_slot = map->slots[slot_index].index;
+    }
+
+    SlotMapSlot *slot = &map->slots[slot_index];
+    slot->index = (u32)map->items.count;
+
+    ArrayPush(&map->items, item);
+    ArrayPush(&map->item_slots, slot_index);
+
+    return SlotMapHandle{(slot->generation << Slot_Map_Index_Bits) | slot_index};
+}
+
+template<typename T>
+T *SlotMapGet(SlotMap<T> *map, SlotMapHandle handle)
+{
+    u32 slot_index = handle.value & (Slot_Map_Max_Count - 1);
+    u32 generation = handle.value >> Slot_Map_Index_Bits;
+    if (slot_index >= (u32)map->slots.count || map->slots.data[slot_index].generation != generation)
+        return null;
+
+    return &map->items.data[map->slots.data[slot_index].index];
+}
+
+// Returns false if the handle is stale
+template<typename T>
+bool SlotMapRemove(SlotMap<T> *map, SlotMapHandle handle)
+{
+    if (!SlotMapGet(map, handle))
+        return false;
+
+    u32 slot_index = handle.value & (Slot_Map_Max_Count - 1);
+    SlotMapSlot *slot = &map->slots[slot_index];
+
+    s64 last = map->items.count - 1;
+    if (slot->index != last)
+    {
+        map->items[slot->index] = map->items[last];
+        map->item_slots[slot->index] = map->item_slots[last];
+        map->slots[map->item_slots[slot->index]].index = slot->index;
+    }
+
+    ArrayPop(&map->items);
+    ArrayPop(&map->item_slots);
+
+    slot->generation = (slot->generation + 1) & Slot_Map_Generation_Mask;
+    if (slot->generation == 0)
+        slot->generation = 1;
+
+    slot->index = map->first_free_slot;
+    map->first_free_slot = slot_index;
 
     return true;
 }
@@ -614,54 +1016,151 @@ bool HashMapRemove(HashMap<TKey, TValue> *map, TKey key, TValue *removed_value =
 
 typedef void (*ThreadGroupFunc)(struct ThreadGroup *, void *work);
 
-struct ThreadWorkEntry
+#define Cache_Line_Size 64
+#define Work_Deque_Initial_Capacity 256
+#define Work_Queue_Capacity (1 << 14)
+
+struct MPMCQueueCell
+{
+    u64 sequence = 0;
+    void *data = null;
+};
+
+// Bounded lock free multiple producers multiple consumers queue (Dmitry Vyukov's, see core.cpp).
+// Entries are pointers, null cannot be pushed
+struct MPMCQueue
 {
-    ThreadWorkEntry *next = null;
-    void *work = null;
-    int worker_thread_index = -1;
+    s64 capacity = 0; // Power of two
+    MPMCQueueCell *cells = null;
+    u8 cells_padding[Cache_Line_Size - sizeof(s64) - sizeof(MPMCQueueCell *)] = {};
+    u64 push_position = 0;
+    u8 push_padding[Cache_Line_Size - sizeof(u64)] = {};
+    u64 pop_position = 0;
+    u8 pop_padding[Cache_Line_Size - sizeof(u64)] = {};
 };
 
-struct ThreadWorkList
+void InitMPMCQueue(MPMCQueue *queue, s64 capacity);
+void DestroyMPMCQueue(MPMCQueue *queue);
+// Returns false if the queue is full
+bool MPMCQueuePush(MPMCQueue *queue, void *data);
+// Yields until there is room in the queue
+void MPMCQueuePushWait(MPMCQueue *queue, void *data);
+// Returns null if the queue is empty
+void *MPMCQueuePop(MPMCQueue *queue);
+// Only a snapshot when other threads use the queue
+s64 GetMPMCQueueCount(MPMCQueue *queue);
+
+struct WorkDequeBuffer
 {
-    pthread_mutex_t mutex = {};
-    sem_t semaphore = {}; // When signaled, this means "hey something was added!"
-    ThreadWorkEntry *first = null;
-    ThreadWorkEntry *last = null;
-    int count = 0;
+    s64 capacity = 0; // Power of two
+    void **entries = null;
+
+    // Thieves might still be reading from older buffers after the deque grew,
+    // so they are only freed when the deque is destroyed
+    WorkDequeBuffer *previous = null;
+};
+
+// Chase-Lev work stealing deque (see core.cpp). A single thread owns the deque and
+// pushes and pops at the bottom, any thread can steal from the top
+struct WorkDeque
+{
+    s64 top = 0;
+    u8 top_padding[Cache_Line_Size - sizeof(s64)] = {};
+    s64 bottom = 0;
+    u8 bottom_padding[Cache_Line_Size - sizeof(s64)] = {};
+    WorkDequeBuffer *buffer = null;
+};
+
+void InitWorkDeque(WorkDeque *deque);
+void DestroyWorkDeque(WorkDeque *deque);
+s64 GetWorkDequeCount(WorkDeque *deque);
+
+// Owner only
+void PushWorkDeque(WorkDeque *deque, void *entry);
+// Owner only, takes the most recently pushed entry
+void *PopWorkDeque(WorkDeque *deque);
+// Any thread, takes the oldest entry. Sets lost_race if the deque was not
+// empty but another thread took the entry first, in which case it is worth retrying
+void *StealWorkDeque(WorkDeque *deque, bool *lost_race);
+
+// Sleeps until woken up, unless *addr is no longer equal to expected
+void FutexWait(u32 *addr, u32 expected);
+void FutexWake(u32 *addr, int count);
+
+enum ThreadGroupScheduling
+{
+    // Idle workers take work from the other workers
+    ThreadGroupScheduling_WorkStealing,
+    // Work is assigned to a worker when it is added, so a slow job delays
+    // everything queued behind it. Kept around to compare against
+    ThreadGroupScheduling_RoundRobin,
 };
 
 struct WorkerThread
 {
     struct ThreadGroup *group = null;
     pthread_t thread = 0;
-    ThreadWorkList available_work = {};
-    ThreadWorkList completed_work = {};
+    WorkDeque work_deque = {}; // Work added by this worker while running a job
+    u64 steal_rng_state = 0;
+
+    // Round robin scheduling only
+    MPMCQueue available_work = {};
+    sem_t available_work_semaphore = {}; // When signaled, this means "hey something was added!"
 };
 
 struct ThreadGroup
 {
     String name = "";
     ThreadGroupFunc func = null;
+    ThreadGroupScheduling scheduling = ThreadGroupScheduling_WorkStealing;
     Slice<WorkerThread> worker_threads = {};
     int worker_thread_assign_index = 0;
 
+    // Work added from outside of the group, owned by the thread that started the group
+    WorkDeque submitted_work = {};
+    pthread_t owner_thread = {};
+
+    MPMCQueue completed_work = {};
+
+    // Idle workers sleep on this futex, it is incremented every time work is added
+    u32 wake_counter = 0;
+    s32 num_sleeping_workers = 0;
+
     bool initialized = false;
     bool started = false;
     bool should_stop = false;
 };
 
+// The scheduling can be changed between InitThreadGroup and Start
 void InitThreadGroup(ThreadGroup *group, String name, ThreadGroupFunc func, int num_threads);
 void DestroyThreadGroup(ThreadGroup *group);
 void Start(ThreadGroup *group);
 void Stop(ThreadGroup *group);
+// Must be called from the thread that started the group, or from one of its workers
 void AddWork(ThreadGroup *group, void *work);
 Slice<void *> GetCompletedWork(ThreadGroup *group);
+// Returns null when there is no more completed work
+void *PopCompletedWork(ThreadGroup *group);
+
+// Work that was added and has not been picked up by a worker thread yet
+int GetNumQueuedWork(ThreadGroup *group);
+// Work that was completed and has not been returned by GetCompletedWork yet
+int GetNumCompletedWork(ThreadGroup *group);
+
+int GetNumHardwareThreads();
 
 float GetTimeInSeconds();
 
+// Use this when measuring short durations, GetTimeInSeconds loses precision after a while
+s64 GetTimeInNanoseconds();
+
 struct Settings
 {
     int render_distance = 25;
+    bool connectivity_culling = true;
+    int chunk_upload_budget_in_mb = 16;
+    float chunk_upload_budget_in_ms = 2;
+    int chunk_pool_free_budget_in_mb = 64;
 };
 
 extern Settings g_settings;
\ No newline at end of file
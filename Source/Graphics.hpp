@@ -15,6 +15,7 @@ struct GfxCommandBuffer;
 struct GfxTexture;
 struct GfxSamplerState;
 struct GfxBuffer;
+struct GfxFence;
 struct GfxShader;
 struct GfxPipelineState;
 struct GfxRenderPass;
@@ -26,6 +27,7 @@ enum GfxBackend
     GfxBackend_OpenGL,
     GfxBackend_Vulkan,
     GfxBackend_Metal,
+    GfxBackend_Null,
 };
 
 enum GfxPixelFormat
@@ -64,20 +66,62 @@ GfxPixelFormat GfxGetSwapchainPixelFormat();
 
 GfxCommandBuffer GfxCreateCommandBuffer(String name);
 void GfxExecuteCommandBuffer(GfxCommandBuffer *cmd_buffer);
+
+// Debug groups are also timed on the GPU, see GfxGetFrameTimings
 void GfxBeginDebugGroup(GfxCommandBuffer *cmd_buffer, String name);
 void GfxEndDebugGroup(GfxCommandBuffer *cmd_buffer);
 
+// GPU timings of the whole frame and of every debug group (so every render and copy
+// pass) are measured with timestamps, and read back a few frames later when they
+// are available, without waiting for the GPU. Frames are skipped if the GPU is too
+// far behind for the results to be read back in time
+
+#define Gfx_Max_Timing_Scopes 32
+#define Gfx_Timing_Scope_Name_Capacity 32
+#define Gfx_Timing_History_Length 128
+
+struct GfxTimingScope
+{
+    char name[Gfx_Timing_Scope_Name_Capacity] = {};
+    int name_length = 0;
+    int depth = 0;
+    float time = 0;
+};
+
+struct GfxFrameTimings
+{
+    u64 frame_number = 0;
+    float gpu_time = 0;
+    int num_scopes = 0;
+    GfxTimingScope scopes[Gfx_Max_Timing_Scopes] = {};
+};
+
+// frames_ago = 0 is the most recent frame we have results for. Returns null if there is no such frame
+GfxFrameTimings *GfxGetFrameTimings(int frames_ago);
+int GfxGetNumFrameTimings();
+
+struct GfxStateStats
+{
+    s64 num_issued = 0;
+    s64 num_skipped = 0;
+};
+
+// Number of state changes and resource bindings sent to the driver during the last
+// frame, and number of redundant ones that were filtered out by the backend
+GfxStateStats GfxGetLastFrameStateStats();
+
 typedef uint32_t GfxCpuAccessFlags;
 #define GfxCpuAccess_None  0x0
 #define GfxCpuAccess_Read  0x1
 #define GfxCpuAccess_Write 0x2
 
 typedef uint32_t GfxBufferUsage;
-#define GfxBufferUsage_None          0x0
-#define GfxBufferUsage_UniformBuffer 0x1
-#define GfxBufferUsage_StorageBuffer 0x2
-#define GfxBufferUsage_VertexBuffer  0x4
-#define GfxBufferUsage_IndexBuffer   0x8
+#define GfxBufferUsage_None           0x0
+#define GfxBufferUsage_UniformBuffer  0x1
+#define GfxBufferUsage_StorageBuffer  0x2
+#define GfxBufferUsage_VertexBuffer   0x4
+#define GfxBufferUsage_IndexBuffer    0x8
+#define GfxBufferUsage_IndirectBuffer 0x10
 
 struct GfxBufferDesc
 {
@@ -100,6 +144,14 @@ void *GfxMapBuffer(GfxBuffer *buffer, s64 offset, s64 size, GfxMapAccessFlags ac
 void GfxUnmapBuffer(GfxBuffer *buffer);
 void GfxFlushMappedBuffer(GfxBuffer *buffer, s64 offset, s64 size);
 
+// A fence is signaled once the GPU has executed all the commands that
+// were issued before it was created. Checking a fence never blocks
+bool IsNull(GfxFence *fence);
+
+GfxFence GfxCreateFence();
+void GfxDestroyFence(GfxFence *fence);
+bool GfxIsFenceSignaled(GfxFence *fence);
+
 enum GfxTextureType
 {
     GfxTextureType_Invalid,
@@ -379,6 +431,9 @@ void GfxDestroyPipelineState(GfxPipelineState *state);
 Slice<GfxPipelineBinding> GfxGetVertexStageBindings(GfxPipelineState *state);
 Slice<GfxPipelineBinding> GfxGetFragmentStageBindings(GfxPipelineState *state);
 
+// These do a linear search by name, so bindings should be resolved once after creating
+// the pipeline rather than every frame. The returned binding stays valid until the
+// pipeline is destroyed, and has an index of -1 if the shader does not use it
 static inline GfxPipelineBinding GfxGetVertexStageBinding(GfxPipelineState *state, String name)
 {
     auto bindings = GfxGetVertexStageBindings(state);
@@ -497,6 +552,20 @@ void GfxSetSamplerState(GfxRenderPass *pass, GfxPipelineBinding binding, GfxSamp
 void GfxDrawPrimitives(GfxRenderPass *pass, u32 vertex_count, u32 instance_count, u32 base_vertex = 0, u32 base_instance = 0);
 void GfxDrawIndexedPrimitives(GfxRenderPass *pass, GfxBuffer *index_buffer, u32 index_count, GfxIndexType index_type, u32 instance_count, u32 base_vertex = 0, u32 base_index = 0, u32 base_instance = 0);
 
+// Layout matches what OpenGL, Vulkan and Metal expect in an indirect buffer
+struct GfxDrawIndexedIndirectCommand
+{
+    u32 index_count;
+    u32 instance_count;
+    u32 base_index;
+    s32 base_vertex;
+    u32 base_instance;
+};
+
+// Issues draw_count indexed draws whose parameters are read from an array
+// of GfxDrawIndexedIndirectCommand in indirect_buffer starting at indirect_offset
+void GfxDrawIndexedIndirect(GfxRenderPass *pass, GfxBuffer *index_buffer, GfxIndexType index_type, GfxBuffer *indirect_buffer, s64 indirect_offset, u32 draw_count);
+
 // Copy Pass
 
 GfxCopyPass GfxBeginCopyPass(String name, GfxCommandBuffer *cmd_buffer);
@@ -543,6 +612,8 @@ void GfxCopyBufferToBuffer(
 #include "Graphics/OpenGL/OpenGL.hpp"
 #elif defined(VOX_BACKEND_METAL)
 #include "Graphics/Metal/Metal.hpp"
+#elif defined(VOX_BACKEND_NULL)
+#include "Graphics/Null/Null.hpp"
 #else
 #error "No graphics backend"
 #endif
@@ -12,6 +12,12 @@ struct GfxBuffer
     GfxBufferDesc desc = {};
 };
 
+struct GfxFence
+{
+    MTL::SharedEvent *handle = null;
+    u64 value = 0;
+};
+
 struct GfxTexture
 {
     MTL::Texture *handle = null;
@@ -32,6 +32,9 @@ void GfxSubmitFrame() {}
 s64 GfxGetBufferAlignment() { return 16; }
 int GfxGetBackbufferIndex() { return 0; }
 float GfxGetLastFrameGPUTime() { return 0; }
+GfxFrameTimings *GfxGetFrameTimings(int frames_ago) { return null; }
+int GfxGetNumFrameTimings() { return 0; }
+GfxStateStats GfxGetLastFrameStateStats() { return {}; }
 
 GfxTexture *GfxGetSwapchainTexture() { return null; }
 GfxPixelFormat GfxGetSwapchainPixelFormat() { return GfxPixelFormat_Invalid; }
@@ -15,3 +15,4 @@ void GfxSetSamplerState(GfxRenderPass *pass, GfxPipelineBinding binding, GfxSamp
 
 void GfxDrawPrimitives(GfxRenderPass *pass, u32 vertex_count, u32 instance_count, u32 base_vertex, u32 base_instance) {}
 void GfxDrawIndexedPrimitives(GfxRenderPass *pass, GfxBuffer *index_buffer, u32 index_count, GfxIndexType index_type, u32 instance_count, u32 base_vertex, u32 base_index, u32 base_instance) {}
+void GfxDrawIndexedIndirect(GfxRenderPass *pass, GfxBuffer *index_buffer, GfxIndexType index_type, GfxBuffer *indirect_buffer, s64 indirect_offset, u32 draw_count) {}
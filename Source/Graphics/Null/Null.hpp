@@ -0,0 +1,99 @@
+#pragma once
+
+// Backend that does not talk to any GPU, so the rest of the program can run
+// headless. Buffers live in host memory so that the CPU side of uploads behaves
+// the same as with a real backend, everything else only records what was asked
+
+#define Gfx_Backend GfxBackend_Null
+
+struct GfxBuffer
+{
+    u8 *data = null;
+    GfxBufferDesc desc = {};
+};
+
+struct GfxFence
+{
+    u64 handle = 0;
+};
+
+struct GfxTexture
+{
+    u64 handle = 0;
+    GfxTextureDesc desc = {};
+};
+
+struct GfxSamplerState
+{
+    u64 handle = 0;
+    GfxSamplerStateDesc desc = {};
+};
+
+struct NullCommandCounts
+{
+    s64 num_command_buffers = 0;
+    s64 num_render_passes = 0;
+    s64 num_copy_passes = 0;
+    s64 num_pipeline_changes = 0;
+    s64 num_bindings = 0;
+    s64 num_draws = 0;
+    s64 num_indirect_draws = 0; // Number of draws issued through indirect commands
+    s64 num_copies = 0;
+    s64 num_bytes_copied = 0;
+};
+
+struct GfxContext
+{
+    SDL_Window *window = null;
+
+    GfxTexture dummy_swapchain_texture = {};
+
+    u64 next_handle = 1;
+
+    int backbuffer_index = 0;
+    u64 frame_number = 0;
+
+    s64 num_buffers = 0;
+    s64 buffer_memory = 0;
+
+    NullCommandCounts counts = {};
+    NullCommandCounts last_frame_counts = {};
+};
+
+struct GfxCommandBuffer
+{
+};
+
+struct GfxShader
+{
+    u64 handle = 0;
+    GfxPipelineStage stage = GfxPipelineStage_Invalid;
+    Slice<GfxPipelineBinding> bindings = {};
+};
+
+struct GfxPipelineState
+{
+    u64 handle = 0;
+    GfxPipelineStateDesc desc = {};
+
+    Slice<GfxPipelineBinding> vertex_stage_bindings = {};
+    Slice<GfxPipelineBinding> fragment_stage_bindings = {};
+};
+
+struct GfxRenderPass
+{
+    String name = "";
+    GfxRenderPassDesc desc = {};
+    GfxCommandBuffer *cmd_buffer = null;
+
+    GfxPipelineState *current_pipeline_state = null;
+};
+
+struct GfxCopyPass
+{
+    String name = "";
+    GfxCommandBuffer *cmd_buffer = null;
+};
+
+// Commands recorded during the last submitted frame
+NullCommandCounts NullGetLastFrameCommandCounts();
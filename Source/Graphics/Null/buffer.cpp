@@ -0,0 +1,80 @@
+#include "Graphics.hpp"
+
+bool IsNull(GfxBuffer *buffer)
+{
+    return buffer == null || buffer->data == null;
+}
+
+GfxBufferDesc GetDesc(GfxBuffer *buffer)
+{
+    return buffer->desc;
+}
+
+GfxBuffer GfxCreateBuffer(String name, GfxBufferDesc desc)
+{
+    Assert(desc.size > 0);
+
+    // Zeroed so that reading back a buffer the CPU never wrote to is deterministic
+    u8 *data = (u8 *)calloc(1, desc.size);
+    Assert(data != null, "Could not allocate %lld bytes for buffer '%.*s'", desc.size, FSTR(name));
+
+    g_gfx_context.num_buffers += 1;
+    g_gfx_context.buffer_memory += desc.size;
+
+    return {
+        .data=data,
+        .desc=desc,
+    };
+}
+
+void GfxDestroyBuffer(GfxBuffer *buffer)
+{
+    if (IsNull(buffer))
+        return;
+
+    g_gfx_context.num_buffers -= 1;
+    g_gfx_context.buffer_memory -= buffer->desc.size;
+
+    free(buffer->data);
+    *buffer = {};
+}
+
+void *GfxMapBuffer(GfxBuffer *buffer, s64 offset, s64 size, GfxMapAccessFlags access)
+{
+    Assert(offset >= 0 && size >= 0);
+    Assert(offset + size <= buffer->desc.size, "Mapped range is out of bounds");
+
+    return buffer->data + offset;
+}
+
+void GfxUnmapBuffer(GfxBuffer *buffer) {}
+
+void GfxFlushMappedBuffer(GfxBuffer *buffer, s64 offset, s64 size)
+{
+    Assert(offset >= 0 && size >= 0);
+    Assert(offset + size <= buffer->desc.size, "Flushed range is out of bounds");
+}
+
+bool IsNull(GfxFence *fence)
+{
+    return fence == null || fence->handle == 0;
+}
+
+GfxFence GfxCreateFence()
+{
+    GfxFence result = {.handle=g_gfx_context.next_handle};
+    g_gfx_context.next_handle += 1;
+
+    return result;
+}
+
+void GfxDestroyFence(GfxFence *fence)
+{
+    *fence = {};
+}
+
+// There is no GPU, so commands are done as soon as they are submitted
+bool GfxIsFenceSignaled(GfxFence *fence)
+{
+    return true;
+}
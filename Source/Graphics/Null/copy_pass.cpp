@@ -0,0 +1,65 @@
+#include "Graphics.hpp"
+
+GfxCopyPass GfxBeginCopyPass(String name, GfxCommandBuffer *cmd_buffer)
+{
+    g_gfx_context.counts.num_copy_passes += 1;
+
+    return {
+        .name=name,
+        .cmd_buffer=cmd_buffer,
+    };
+}
+
+void GfxEndCopyPass(GfxCopyPass *pass) {}
+
+void GfxGenerateMipmaps(GfxCopyPass *pass, GfxTexture *texture) {}
+
+void GfxCopyTextureToTexture(
+    GfxCopyPass *pass,
+    GfxTexture *src_texture,
+    Vec3u src_origin,
+    Vec3u src_size,
+    GfxTexture *dst_texture,
+    Vec3u dst_origin,
+    u32 src_slice,
+    u32 src_level,
+    u32 dst_slice,
+    u32 dst_level
+)
+{
+    g_gfx_context.counts.num_copies += 1;
+}
+
+void GfxCopyTextureToBuffer(
+    GfxCopyPass *pass,
+    GfxTexture *src_texture,
+    Vec3u src_origin,
+    Vec3u src_size,
+    GfxBuffer *dst_buffer,
+    u64 dst_offset,
+    u32 src_slice,
+    u32 src_level
+)
+{
+    g_gfx_context.counts.num_copies += 1;
+}
+
+// Buffers are in host memory, so copies are done right away. This keeps the
+// contents of the chunk mesh pools correct when they are grown or defragmented
+void GfxCopyBufferToBuffer(
+    GfxCopyPass *pass,
+    GfxBuffer *src_buffer,
+    s64 src_offset,
+    GfxBuffer *dst_buffer,
+    s64 dst_offset,
+    s64 size
+)
+{
+    Assert(src_offset >= 0 && dst_offset >= 0 && size >= 0);
+    Assert(src_offset + size <= src_buffer->desc.size && dst_offset + size <= dst_buffer->desc.size, "Copied range is out of bounds");
+
+    memmove(dst_buffer->data + dst_offset, src_buffer->data + src_offset, size);
+
+    g_gfx_context.counts.num_copies += 1;
+    g_gfx_context.counts.num_bytes_copied += size;
+}
@@ -0,0 +1,88 @@
+#include "Graphics.hpp"
+
+GfxContext g_gfx_context;
+
+void GfxCreateContext(SDL_Window *window)
+{
+    g_gfx_context.window = window;
+
+    g_gfx_context.dummy_swapchain_texture.handle = g_gfx_context.next_handle;
+    g_gfx_context.dummy_swapchain_texture.desc.type = GfxTextureType_Texture2D;
+    g_gfx_context.dummy_swapchain_texture.desc.pixel_format = GfxGetSwapchainPixelFormat();
+    g_gfx_context.dummy_swapchain_texture.desc.usage = GfxTextureUsage_RenderTarget;
+    g_gfx_context.next_handle += 1;
+
+    LogMessage(Log_Null, "Initialized null graphics backend, nothing will be rendered");
+}
+
+void GfxDestroyContext()
+{
+    g_gfx_context = {};
+}
+
+void GfxBeginFrame()
+{
+    int w = 0, h = 0;
+    if (g_gfx_context.window)
+        SDL_GetWindowSizeInPixels(g_gfx_context.window, &w, &h);
+
+    g_gfx_context.dummy_swapchain_texture.desc.width = (u32)w;
+    g_gfx_context.dummy_swapchain_texture.desc.height = (u32)h;
+
+    g_gfx_context.frame_number += 1;
+}
+
+void GfxSubmitFrame()
+{
+    g_gfx_context.last_frame_counts = g_gfx_context.counts;
+    g_gfx_context.counts = {};
+
+    g_gfx_context.backbuffer_index = (g_gfx_context.backbuffer_index + 1) % Gfx_Max_Frames_In_Flight;
+}
+
+NullCommandCounts NullGetLastFrameCommandCounts()
+{
+    return g_gfx_context.last_frame_counts;
+}
+
+// Same as the minimum uniform buffer offset alignment of most GPUs, so that
+// allocators behave like they do with the other backends
+s64 GfxGetBufferAlignment() { return 256; }
+
+int GfxGetBackbufferIndex()
+{
+    return g_gfx_context.backbuffer_index;
+}
+
+float GfxGetLastFrameGPUTime() { return 0; }
+GfxFrameTimings *GfxGetFrameTimings(int frames_ago) { return null; }
+int GfxGetNumFrameTimings() { return 0; }
+
+GfxStateStats GfxGetLastFrameStateStats()
+{
+    return {
+        .num_issued=g_gfx_context.last_frame_counts.num_pipeline_changes + g_gfx_context.last_frame_counts.num_bindings,
+    };
+}
+
+GfxTexture *GfxGetSwapchainTexture()
+{
+    return &g_gfx_context.dummy_swapchain_texture;
+}
+
+GfxPixelFormat GfxGetSwapchainPixelFormat()
+{
+    return GfxPixelFormat_RGBAUnorm8;
+}
+
+GfxCommandBuffer GfxCreateCommandBuffer(String name)
+{
+    g_gfx_context.counts.num_command_buffers += 1;
+
+    return {};
+}
+
+void GfxExecuteCommandBuffer(GfxCommandBuffer *cmd_buffer) {}
+
+void GfxBeginDebugGroup(GfxCommandBuffer *cmd_buffer, String name) {}
+void GfxEndDebugGroup(GfxCommandBuffer *cmd_buffer) {}
@@ -0,0 +1,58 @@
+#include "Graphics.hpp"
+
+bool IsNull(GfxPipelineState *state)
+{
+    return state == null || state->handle == 0;
+}
+
+GfxPipelineStateDesc GetDesc(GfxPipelineState *state)
+{
+    return state->desc;
+}
+
+GfxPipelineState GfxCreatePipelineState(String name, GfxPipelineStateDesc desc)
+{
+    if (!desc.vertex_shader)
+        return {};
+
+    GfxPipelineState result{};
+    result.handle = g_gfx_context.next_handle;
+    result.desc = desc;
+    result.vertex_stage_bindings = GfxCloneBindings(desc.vertex_shader->bindings);
+    if (desc.fragment_shader)
+        result.fragment_stage_bindings = GfxCloneBindings(desc.fragment_shader->bindings);
+
+    g_gfx_context.next_handle += 1;
+
+    return result;
+}
+
+void GfxDestroyPipelineState(GfxPipelineState *state)
+{
+    foreach (i, state->vertex_stage_bindings)
+    {
+        Free(state->vertex_stage_bindings[i].name.data, heap);
+        Free(state->vertex_stage_bindings[i].associated_texture_units.data, heap);
+    }
+
+    foreach (i, state->fragment_stage_bindings)
+    {
+        Free(state->fragment_stage_bindings[i].name.data, heap);
+        Free(state->fragment_stage_bindings[i].associated_texture_units.data, heap);
+    }
+
+    Free(state->vertex_stage_bindings.data, heap);
+    Free(state->fragment_stage_bindings.data, heap);
+
+    *state = {};
+}
+
+Slice<GfxPipelineBinding> GfxGetVertexStageBindings(GfxPipelineState *state)
+{
+    return state->vertex_stage_bindings;
+}
+
+Slice<GfxPipelineBinding> GfxGetFragmentStageBindings(GfxPipelineState *state)
+{
+    return state->fragment_stage_bindings;
+}
@@ -0,0 +1,94 @@
+#include "Graphics.hpp"
+
+GfxRenderPassDesc GetDesc(GfxRenderPass *pass)
+{
+    return pass->desc;
+}
+
+GfxRenderPass GfxBeginRenderPass(String name, GfxCommandBuffer *cmd_buffer, GfxRenderPassDesc desc)
+{
+    g_gfx_context.counts.num_render_passes += 1;
+
+    GfxRenderPass pass{};
+    pass.name = name;
+    pass.desc = desc;
+    pass.cmd_buffer = cmd_buffer;
+
+    return pass;
+}
+
+void GfxEndRenderPass(GfxRenderPass *pass) {}
+
+void GfxSetPipelineState(GfxRenderPass *pass, GfxPipelineState *state)
+{
+    Assert(!IsNull(state));
+
+    pass->current_pipeline_state = state;
+    g_gfx_context.counts.num_pipeline_changes += 1;
+}
+
+void GfxSetViewport(GfxRenderPass *pass, GfxViewport viewport) {}
+void GfxSetScissorRect(GfxRenderPass *pass, Recti rect) {}
+
+void GfxSetVertexBuffer(GfxRenderPass *Pass, int index, GfxBuffer *buffer, s64 offset, s64 size, s64 stride)
+{
+    Assert(offset >= 0 && size >= 0 && stride >= 0, "Invalid buffer offset or size or stride");
+    Assert(index >= 0, "Invalid buffer index");
+
+    g_gfx_context.counts.num_bindings += 1;
+}
+
+void GfxSetBuffer(GfxRenderPass *pass, GfxPipelineBinding binding, GfxBuffer *buffer, s64 offset, s64 size)
+{
+    Assert(offset >= 0 && size >= 0, "Invalid buffer offset or size");
+
+    if (binding.index < 0)
+        return;
+
+    Assert(!buffer || offset + size <= buffer->desc.size, "Bound range is out of bounds");
+
+    g_gfx_context.counts.num_bindings += 1;
+}
+
+void GfxSetTexture(GfxRenderPass *pass, GfxPipelineBinding binding, GfxTexture *texture)
+{
+    if (binding.index < 0 && binding.associated_texture_units.count <= 0)
+        return;
+
+    g_gfx_context.counts.num_bindings += 1;
+}
+
+void GfxSetSamplerState(GfxRenderPass *pass, GfxPipelineBinding binding, GfxSamplerState *sampler)
+{
+    if (binding.index < 0 && binding.associated_texture_units.count <= 0)
+        return;
+
+    g_gfx_context.counts.num_bindings += 1;
+}
+
+void GfxDrawPrimitives(GfxRenderPass *pass, u32 vertex_count, u32 instance_count, u32 base_vertex, u32 base_instance)
+{
+    Assert(pass->current_pipeline_state != null, "No pipeline state set");
+
+    g_gfx_context.counts.num_draws += 1;
+}
+
+void GfxDrawIndexedPrimitives(GfxRenderPass *pass, GfxBuffer *index_buffer, u32 index_count, GfxIndexType index_type, u32 instance_count, u32 base_vertex, u32 base_index, u32 base_instance)
+{
+    Assert(pass->current_pipeline_state != null, "No pipeline state set");
+
+    g_gfx_context.counts.num_draws += 1;
+}
+
+void GfxDrawIndexedIndirect(GfxRenderPass *pass, GfxBuffer *index_buffer, GfxIndexType index_type, GfxBuffer *indirect_buffer, s64 indirect_offset, u32 draw_count)
+{
+    Assert(pass->current_pipeline_state != null, "No pipeline state set");
+    Assert(indirect_offset >= 0 && indirect_offset % 4 == 0, "Invalid indirect buffer offset");
+    Assert(indirect_offset + (s64)draw_count * (s64)sizeof(GfxDrawIndexedIndirectCommand) <= indirect_buffer->desc.size, "Indirect commands are out of bounds");
+
+    if (draw_count == 0)
+        return;
+
+    g_gfx_context.counts.num_draws += 1;
+    g_gfx_context.counts.num_indirect_draws += draw_count;
+}
@@ -0,0 +1,38 @@
+#include "Graphics.hpp"
+
+// Shaders are not compiled, so they only have the bindings they were given
+
+bool IsNull(GfxShader *shader)
+{
+    return shader == null || shader->handle == 0;
+}
+
+GfxShader GfxLoadShader(String name, String source_code, GfxPipelineStage stage, Slice<GfxPipelineBinding> bindings)
+{
+    GfxShader result = {
+        .handle=g_gfx_context.next_handle,
+        .stage=stage,
+        .bindings=GfxCloneBindings(bindings),
+    };
+    g_gfx_context.next_handle += 1;
+
+    return result;
+}
+
+GfxShader GfxLoadShader(String name, String source_code, GfxPipelineStage stage)
+{
+    return GfxLoadShader(name, source_code, stage, {});
+}
+
+void GfxDestroyShader(GfxShader *shader)
+{
+    foreach (i, shader->bindings)
+    {
+        Free(shader->bindings[i].name.data, heap);
+        Free(shader->bindings[i].associated_texture_units.data, heap);
+    }
+
+    Free(shader->bindings.data, heap);
+
+    *shader = {};
+}
@@ -0,0 +1,57 @@
+#include "Graphics.hpp"
+
+// Textures are never sampled, so we do not keep their contents
+
+bool IsNull(GfxTexture *texture)
+{
+    return texture == null || texture->handle == 0;
+}
+
+GfxTextureDesc GetDesc(GfxTexture *texture)
+{
+    return texture->desc;
+}
+
+GfxTexture GfxCreateTexture(String name, GfxTextureDesc desc)
+{
+    Assert(desc.width > 0 && desc.height > 0, "Invalid size for texture '%.*s'", FSTR(name));
+
+    GfxTexture result = {.handle=g_gfx_context.next_handle, .desc=desc};
+    g_gfx_context.next_handle += 1;
+
+    return result;
+}
+
+void GfxDestroyTexture(GfxTexture *texture)
+{
+    *texture = {};
+}
+
+void GfxReplaceTextureRegion(GfxTexture *texture, Vec3u origin, Vec3u size, u32 mipmap_level, u32 array_slice, const void *bytes)
+{
+    Assert(origin.x + size.x <= texture->desc.width && origin.y + size.y <= texture->desc.height, "Texture region is out of bounds");
+    Assert(array_slice < texture->desc.array_length && mipmap_level < texture->desc.num_mipmap_levels);
+}
+
+bool IsNull(GfxSamplerState *sampler)
+{
+    return sampler == null || sampler->handle == 0;
+}
+
+GfxSamplerStateDesc GetDesc(GfxSamplerState *sampler)
+{
+    return sampler->desc;
+}
+
+GfxSamplerState GfxCreateSamplerState(String name, GfxSamplerStateDesc desc)
+{
+    GfxSamplerState result = {.handle=g_gfx_context.next_handle, .desc=desc};
+    g_gfx_context.next_handle += 1;
+
+    return result;
+}
+
+void GfxDestroySamplerState(GfxSamplerState *sampler)
+{
+    *sampler = {};
+}
@@ -10,6 +10,11 @@ struct GfxBuffer
     GfxBufferDesc desc = {};
 };
 
+struct GfxFence
+{
+    GLsync handle = null;
+};
+
 struct GfxTexture
 {
     GLuint handle = 0;
@@ -29,6 +34,66 @@ struct OpenGLFramebufferKey
     GLuint stencil_texture = 0;
 };
 
+#define GL_Num_Timing_Query_Sets (Gfx_Max_Frames_In_Flight + 2)
+#define GL_Num_Timing_Queries (2 + 2 * Gfx_Max_Timing_Scopes)
+
+// Queries 0 and 1 are the start and end of the frame, followed by the start and end of each scope
+struct OpenGLTimingQuerySet
+{
+    GLuint queries[GL_Num_Timing_Queries] = {};
+    GfxFrameTimings timings = {};
+    int scope_stack[Gfx_Max_Timing_Scopes] = {};
+    int scope_stack_count = 0;
+    bool pending = false;
+};
+
+#define GL_Max_Cached_Binding_Points 32
+
+struct OpenGLBufferRange
+{
+    GLuint handle = 0;
+    s64 offset = 0;
+    s64 size = 0; // Stride for vertex buffers
+};
+
+// Shadow copy of the GL state we set through the cached functions, used to skip
+// redundant calls. Every field is set to all ones when the state is unknown
+struct OpenGLBoundState
+{
+    GLuint program_pipeline;
+    GLuint vertex_array;
+    GLuint element_array_buffer; // Part of the vertex array state
+    GLuint array_buffer;
+    GLuint draw_indirect_buffer;
+
+    OpenGLBufferRange uniform_buffers[GL_Max_Cached_Binding_Points];
+    OpenGLBufferRange storage_buffers[GL_Max_Cached_Binding_Points];
+    OpenGLBufferRange vertex_buffers[GL_Max_Cached_Binding_Points];
+    GLuint texture_units[GL_Max_Cached_Binding_Points];
+    GLuint samplers[GL_Max_Cached_Binding_Points];
+
+    GLenum polygon_mode;
+    GLenum cull_face;
+    GLenum front_face;
+    GLenum depth_func;
+    GLboolean depth_mask;
+    GLboolean scissor_test_enabled;
+    GLboolean cull_face_enabled;
+    GLboolean depth_test_enabled;
+    GLboolean blend_enabled[Gfx_Max_Color_Attachments];
+    GLenum blend_funcs[Gfx_Max_Color_Attachments][4];
+    GLenum blend_equations[Gfx_Max_Color_Attachments][2];
+};
+
+struct OpenGLStateCache
+{
+    OpenGLBoundState state = {};
+
+    s64 num_issued = 0;
+    s64 num_skipped = 0;
+    GfxStateStats last_frame_stats = {};
+};
+
 struct GfxContext
 {
     SDL_Window *window = null;
@@ -44,8 +109,20 @@ struct GfxContext
 
     int backbuffer_index = 0;
 
+    u64 frame_number = 0;
     float last_frame_gpu_time = 0;
-    GLuint frame_time_queries[Gfx_Max_Frames_In_Flight * 2] = {};
+
+    OpenGLTimingQuerySet timing_query_sets[GL_Num_Timing_Query_Sets] = {};
+    int timing_query_set_index = 0;
+    OpenGLTimingQuerySet *current_timing_query_set = null; // Null if this frame is not timed
+    u64 num_untimed_frames = 0;
+
+    GfxFrameTimings timing_history[Gfx_Timing_History_Length] = {};
+    int timing_history_start = 0;
+    int timing_history_count = 0;
+
+    OpenGLStateCache state_cache = {};
+    u64 next_pipeline_state_id = 1;
 };
 
 struct GfxCommandBuffer
@@ -57,6 +134,10 @@ struct GfxShader
     GLuint handle = 0;
     GfxPipelineStage stage = GfxPipelineStage_Invalid;
     Slice<GfxPipelineBinding> bindings = {};
+
+    // Binding relocations live in the program object, so we only need to apply
+    // them again when a different pipeline uses this fragment shader
+    u64 relocated_pipeline_id = 0;
 };
 
 struct OpenGLBindingRelocation
@@ -69,6 +150,7 @@ struct OpenGLBindingRelocation
 
 struct GfxPipelineState
 {
+    u64 id = 0;
     GfxPipelineStateDesc desc = {};
     GLuint pso = 0;
     GLuint vao = 0;
@@ -86,7 +168,6 @@ struct GfxRenderPass
 
     GLuint fbo = 0;
     GfxPipelineState *current_pipeline_state = null;
-    GfxBuffer *current_index_buffer = null;
 };
 
 struct GfxCopyPass
@@ -149,3 +230,32 @@ GLenum GLPixelFormat(GfxPixelFormat format);
 void GLPixelFormatAndType(GfxPixelFormat pixel_format, GLenum *format, GLenum *type);
 GLenum GLTextureFilter(GfxSamplerFilter filter, GfxSamplerFilter mip_filter);
 GLenum GLTextureWrap(GfxSamplerAddressMode mode);
+
+// State cache, all state changes made during render passes should go through these
+void GLInvalidateStateCache();
+void GLEndStateCacheFrame();
+void GLForgetBuffer(GLuint handle);
+void GLForgetTexture(GLuint handle);
+void GLForgetSampler(GLuint handle);
+void GLForgetPipeline(GLuint pso, GLuint vao);
+
+// Checks that redundant state changes are skipped and that forgetting objects makes the
+// next binds go through, using fake GL functions. Does not need a context
+bool GLCheckStateCache();
+
+void GLCachedBindProgramPipeline(GLuint pso);
+void GLCachedBindVertexArray(GLuint vao);
+void GLCachedBindBuffer(GLenum target, GLuint handle);
+void GLCachedBindBufferRange(GLenum target, GLuint index, GLuint handle, s64 offset, s64 size);
+void GLCachedBindVertexBuffer(GLuint index, GLuint handle, s64 offset, s64 stride);
+void GLCachedBindTextureUnit(GLuint unit, GLuint handle);
+void GLCachedBindSampler(GLuint unit, GLuint handle);
+void GLCachedSetEnabled(GLenum cap, bool enabled);
+void GLCachedSetBlendEnabled(GLuint index, bool enabled);
+void GLCachedBlendFuncSeparate(GLuint index, GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha, GLenum dst_alpha);
+void GLCachedBlendEquationSeparate(GLuint index, GLenum rgb, GLenum alpha);
+void GLCachedPolygonMode(GLenum mode);
+void GLCachedCullFace(GLenum face);
+void GLCachedFrontFace(GLenum order);
+void GLCachedDepthFunc(GLenum func);
+void GLCachedDepthMask(bool enabled);
@@ -36,6 +36,7 @@ GfxBuffer GfxCreateBuffer(String name, GfxBufferDesc desc)
 
 void GfxDestroyBuffer(GfxBuffer *buffer)
 {
+    GLForgetBuffer(buffer->handle);
     glDeleteBuffers(1, &buffer->handle);
     *buffer = {};
 }
@@ -70,3 +71,30 @@ void GfxFlushMappedBuffer(GfxBuffer *buffer, s64 offset, s64 size)
 
     glFlushMappedNamedBufferRange(buffer->handle, offset, size);
 }
+
+bool IsNull(GfxFence *fence)
+{
+    return fence == null || fence->handle == null;
+}
+
+GfxFence GfxCreateFence()
+{
+    GLsync handle = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    Assert(handle != null);
+
+    return {.handle=handle};
+}
+
+void GfxDestroyFence(GfxFence *fence)
+{
+    glDeleteSync(fence->handle);
+    *fence = {};
+}
+
+bool GfxIsFenceSignaled(GfxFence *fence)
+{
+    GLint status = GL_UNSIGNALED;
+    glGetSynciv(fence->handle, GL_SYNC_STATUS, 1, null, &status);
+
+    return status == GL_SIGNALED;
+}
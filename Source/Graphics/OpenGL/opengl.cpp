@@ -12,9 +12,6 @@ static void GLDebugMessageCallback(
     const void *user_param
 );
 
-static bool CompareOpenGLFramebufferKeys(OpenGLFramebufferKey a, OpenGLFramebufferKey b);
-static u64 HashOpenGLFramebufferKey(OpenGLFramebufferKey key);
-
 void GfxCreateContext(SDL_Window *window)
 {
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
@@ -56,33 +53,67 @@ void GfxCreateContext(SDL_Window *window)
 
     g_gfx_context.buffer_alignment = Max(uniform_buffer_offset_alignment, storage_buffer_offset_alignment);
 
-    g_gfx_context.framebuffer_cache.Compare = CompareOpenGLFramebufferKeys;
-    g_gfx_context.framebuffer_cache.Hash = HashOpenGLFramebufferKey;
+    for (int i = 0; i < GL_Num_Timing_Query_Sets; i += 1)
+        glGenQueries(GL_Num_Timing_Queries, g_gfx_context.timing_query_sets[i].queries);
 
-    glGenQueries(StaticArraySize(g_gfx_context.frame_time_queries), g_gfx_context.frame_time_queries);
+    glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
 
-    // Make first query result not cause an error
-    for (int backbuffer_index = 0; backbuffer_index < Gfx_Max_Frames_In_Flight; backbuffer_index += 1)
-    {
-        for (int i = 0; i < 2; i += 1)
-        {
-            glQueryCounter(g_gfx_context.frame_time_queries[backbuffer_index * 2 + i], GL_TIMESTAMP);
+    GLInvalidateStateCache();
+}
 
-            char name[100];
-            sprintf(name, "Query 'Frame Time %s, Backbuffer %d'", (i == 0 ? "Start" : "End"), backbuffer_index);
+void GfxDestroyContext()
+{
+    for (int i = 0; i < GL_Num_Timing_Query_Sets; i += 1)
+        glDeleteQueries(GL_Num_Timing_Queries, g_gfx_context.timing_query_sets[i].queries);
 
-            glObjectLabel(GL_QUERY, g_gfx_context.frame_time_queries[backbuffer_index * 2 + i], -1, name);
-        }
-    }
+    SDL_GL_DeleteContext(g_gfx_context.gl_context);
+}
 
-    glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+static float GetQueryElapsedTime(GLuint start_query, GLuint end_query)
+{
+    u64 start_time, end_time;
+    glGetQueryObjectui64v(start_query, GL_QUERY_RESULT, &start_time);
+    glGetQueryObjectui64v(end_query, GL_QUERY_RESULT, &end_time);
+
+    return (float)((end_time - start_time) / 1'000'000'000.0);
 }
 
-void GfxDestroyContext()
+static void PushFrameTimings(GfxFrameTimings *timings)
 {
-    glDeleteQueries(StaticArraySize(g_gfx_context.frame_time_queries), g_gfx_context.frame_time_queries);
+    int index = (g_gfx_context.timing_history_start + g_gfx_context.timing_history_count) % Gfx_Timing_History_Length;
+    if (g_gfx_context.timing_history_count < Gfx_Timing_History_Length)
+        g_gfx_context.timing_history_count += 1;
+    else
+        g_gfx_context.timing_history_start = (g_gfx_context.timing_history_start + 1) % Gfx_Timing_History_Length;
 
-    SDL_GL_DeleteContext(g_gfx_context.gl_context);
+    g_gfx_context.timing_history[index] = *timings;
+}
+
+// Reads back the results of the timed frames the GPU is done with, oldest first
+static void ReadTimingQueryResults()
+{
+    for (int i = 0; i < GL_Num_Timing_Query_Sets; i += 1)
+    {
+        int index = (g_gfx_context.timing_query_set_index + i) % GL_Num_Timing_Query_Sets;
+        OpenGLTimingQuerySet *set = &g_gfx_context.timing_query_sets[index];
+        if (!set->pending)
+            continue;
+
+        // Timestamps are written in order, so if the end of the frame is available everything is
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(set->queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+
+        set->timings.gpu_time = GetQueryElapsedTime(set->queries[0], set->queries[1]);
+        for (int j = 0; j < set->timings.num_scopes; j += 1)
+            set->timings.scopes[j].time = GetQueryElapsedTime(set->queries[2 + j * 2], set->queries[2 + j * 2 + 1]);
+
+        g_gfx_context.last_frame_gpu_time = set->timings.gpu_time;
+        PushFrameTimings(&set->timings);
+
+        set->pending = false;
+    }
 }
 
 void GfxBeginFrame()
@@ -93,26 +124,46 @@ void GfxBeginFrame()
     g_gfx_context.dummy_swapchain_texture.desc.width = (u32)w;
     g_gfx_context.dummy_swapchain_texture.desc.height = (u32)h;
 
-    int last_query_index = g_gfx_context.backbuffer_index - (Gfx_Max_Frames_In_Flight - 1);
-    if (last_query_index < 0)
-        last_query_index += Gfx_Max_Frames_In_Flight;
+    ReadTimingQueryResults();
 
-    s64 start_time, end_time;
-    glGetQueryObjecti64v(g_gfx_context.frame_time_queries[last_query_index * 2 + 0], GL_QUERY_RESULT, &start_time);
-    glGetQueryObjecti64v(g_gfx_context.frame_time_queries[last_query_index * 2 + 1], GL_QUERY_RESULT, &end_time);
+    g_gfx_context.frame_number += 1;
 
-    s64 elapsed = end_time - start_time;
-    g_gfx_context.last_frame_gpu_time = (float)(elapsed / 1'000'000'000.0);
+    OpenGLTimingQuerySet *set = &g_gfx_context.timing_query_sets[g_gfx_context.timing_query_set_index];
+    if (set->pending)
+    {
+        // The GPU is too far behind, we do not reuse queries whose results are not available yet
+        g_gfx_context.current_timing_query_set = null;
+        g_gfx_context.num_untimed_frames += 1;
+    }
+    else
+    {
+        set->timings.frame_number = g_gfx_context.frame_number;
+        set->timings.num_scopes = 0;
+        set->scope_stack_count = 0;
+        g_gfx_context.current_timing_query_set = set;
 
-    glQueryCounter(g_gfx_context.frame_time_queries[g_gfx_context.backbuffer_index * 2 + 0], GL_TIMESTAMP);
+        glQueryCounter(set->queries[0], GL_TIMESTAMP);
+    }
 }
 
 void GfxSubmitFrame()
 {
-    glQueryCounter(g_gfx_context.frame_time_queries[g_gfx_context.backbuffer_index * 2 + 1], GL_TIMESTAMP);
+    OpenGLTimingQuerySet *set = g_gfx_context.current_timing_query_set;
+    if (set)
+    {
+        Assert(set->scope_stack_count == 0, "Unbalanced debug groups");
+
+        glQueryCounter(set->queries[1], GL_TIMESTAMP);
+        set->pending = true;
+
+        g_gfx_context.timing_query_set_index = (g_gfx_context.timing_query_set_index + 1) % GL_Num_Timing_Query_Sets;
+        g_gfx_context.current_timing_query_set = null;
+    }
 
     SDL_GL_SwapWindow(g_gfx_context.window);
 
+    GLEndStateCacheFrame();
+
     g_gfx_context.backbuffer_index = (g_gfx_context.backbuffer_index + 1) % Gfx_Max_Frames_In_Flight;
 }
 
@@ -131,6 +182,21 @@ float GfxGetLastFrameGPUTime()
     return g_gfx_context.last_frame_gpu_time;
 }
 
+GfxFrameTimings *GfxGetFrameTimings(int frames_ago)
+{
+    if (frames_ago < 0 || frames_ago >= g_gfx_context.timing_history_count)
+        return null;
+
+    int index = g_gfx_context.timing_history_start + g_gfx_context.timing_history_count - 1 - frames_ago;
+
+    return &g_gfx_context.timing_history[index % Gfx_Timing_History_Length];
+}
+
+int GfxGetNumFrameTimings()
+{
+    return g_gfx_context.timing_history_count;
+}
+
 GfxTexture *GfxGetSwapchainTexture()
 {
     return &g_gfx_context.dummy_swapchain_texture;
@@ -202,11 +268,47 @@ void GfxExecuteCommandBuffer(GfxCommandBuffer *cmd_buffer)
 void GfxBeginDebugGroup(GfxCommandBuffer *cmd_buffer, String name)
 {
     glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, name.length, name.data);
+
+    OpenGLTimingQuerySet *set = g_gfx_context.current_timing_query_set;
+    if (!set)
+        return;
+
+    Assert(set->scope_stack_count < Gfx_Max_Timing_Scopes, "Too many nested debug groups");
+
+    // Scopes past the maximum are not timed, but we still need to balance the stack
+    int scope_index = -1;
+    if (set->timings.num_scopes < Gfx_Max_Timing_Scopes)
+    {
+        scope_index = set->timings.num_scopes;
+        set->timings.num_scopes += 1;
+
+        GfxTimingScope *scope = &set->timings.scopes[scope_index];
+        scope->name_length = Min((int)name.length, Gfx_Timing_Scope_Name_Capacity);
+        memcpy(scope->name, name.data, scope->name_length);
+        scope->depth = set->scope_stack_count;
+        scope->time = 0;
+
+        glQueryCounter(set->queries[2 + scope_index * 2], GL_TIMESTAMP);
+    }
+
+    set->scope_stack[set->scope_stack_count] = scope_index;
+    set->scope_stack_count += 1;
 }
 
 void GfxEndDebugGroup(GfxCommandBuffer *cmd_buffer)
 {
     glPopDebugGroup();
+
+    OpenGLTimingQuerySet *set = g_gfx_context.current_timing_query_set;
+    if (!set)
+        return;
+
+    Assert(set->scope_stack_count > 0, "Unbalanced debug groups");
+
+    set->scope_stack_count -= 1;
+    int scope_index = set->scope_stack[set->scope_stack_count];
+    if (scope_index >= 0)
+        glQueryCounter(set->queries[2 + scope_index * 2 + 1], GL_TIMESTAMP);
 }
 
 void GLDebugMessageCallback(
@@ -258,12 +360,3 @@ void GLDebugMessageCallback(
     }
 }
 
-static bool CompareOpenGLFramebufferKeys(OpenGLFramebufferKey a, OpenGLFramebufferKey b)
-{
-    return memcmp(&a, &b, sizeof(OpenGLFramebufferKey)) == 0;
-}
-
-static u64 HashOpenGLFramebufferKey(OpenGLFramebufferKey key)
-{
-    return Fnv1aHash(&key, sizeof(OpenGLFramebufferKey));
-}
@@ -18,8 +18,11 @@ GfxPipelineState GfxCreatePipelineState(String name, GfxPipelineStateDesc desc)
         return {};
 
     GfxPipelineState result{};
+    result.id = g_gfx_context.next_pipeline_state_id;
     result.desc = desc;
 
+    g_gfx_context.next_pipeline_state_id += 1;
+
     glGenProgramPipelines(1, &result.pso);
 
     if (desc.vertex_shader)
@@ -74,6 +77,7 @@ void GfxDestroyPipelineState(GfxPipelineState *state)
     Free(state->vertex_stage_bindings.data, heap);
     Free(state->fragment_stage_bindings.data, heap);
 
+    GLForgetPipeline(state->pso, state->vao);
     glDeleteProgramPipelines(1, &state->pso);
     glDeleteVertexArrays(1, &state->vao);
     *state = {};
@@ -19,7 +19,7 @@ GfxRenderPass GfxBeginRenderPass(String name, GfxCommandBuffer *cmd_buffer, GfxR
     pass.fbo = GLGetFramebuffer(desc);
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, pass.fbo);
 
-    glDisable(GL_SCISSOR_TEST); // Prevent scissor from affecting clearing
+    GLCachedSetEnabled(GL_SCISSOR_TEST, false); // Prevent scissor from affecting clearing
 
     int color_buffer_index = 0;
     for (int i = 0; i < Gfx_Max_Color_Attachments; i += 1)
@@ -36,7 +36,7 @@ GfxRenderPass GfxBeginRenderPass(String name, GfxCommandBuffer *cmd_buffer, GfxR
 
     if (desc.depth_attachment && desc.should_clear_depth)
     {
-        glDepthMask(true);
+        GLCachedDepthMask(true);
         glClearBufferfv(GL_DEPTH, 0, &desc.clear_depth);
     }
 
@@ -62,11 +62,13 @@ void GfxSetPipelineState(GfxRenderPass *pass, GfxPipelineState *state)
 {
     pass->current_pipeline_state = state;
 
-    glBindProgramPipeline(state->pso);
+    GLCachedBindProgramPipeline(state->pso);
 
     // Relocate fragment shader bindings so they do not conflict with the vertex shader's
-    if (state->desc.fragment_shader)
+    if (state->desc.fragment_shader && state->desc.fragment_shader->relocated_pipeline_id != state->id)
     {
+        state->desc.fragment_shader->relocated_pipeline_id = state->id;
+
         GLuint fragment_program = state->desc.fragment_shader->handle;
         foreach (i, state->fragment_stage_binding_relocations)
         {
@@ -107,28 +109,27 @@ void GfxSetPipelineState(GfxRenderPass *pass, GfxPipelineState *state)
         }
     }
 
-    glDisable(GL_SCISSOR_TEST); // Enabled when calling set_scissor_rect
+    GLCachedSetEnabled(GL_SCISSOR_TEST, false); // Enabled when calling set_scissor_rect
 
-    // Vertex layout (i.e. vertex array)
-    glBindVertexArray(state->vao);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pass->current_index_buffer ? pass->current_index_buffer->handle : 0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // Vertex layout (i.e. vertex array). The index buffer is bound when drawing
+    GLCachedBindVertexArray(state->vao);
+    GLCachedBindBuffer(GL_ARRAY_BUFFER, 0);
 
     // Rasterizer state
     auto rasterizer = state->desc.rasterizer_state;
-    glPolygonMode(GL_FRONT_AND_BACK, GLFillMode(rasterizer.fill_mode));
+    GLCachedPolygonMode(GLFillMode(rasterizer.fill_mode));
 
     if (rasterizer.cull_face == GfxPolygonFace_None)
     {
-        glDisable(GL_CULL_FACE);
+        GLCachedSetEnabled(GL_CULL_FACE, false);
     }
     else
     {
-        glEnable(GL_CULL_FACE);
-        glCullFace(GLFace(rasterizer.cull_face));
+        GLCachedSetEnabled(GL_CULL_FACE, true);
+        GLCachedCullFace(GLFace(rasterizer.cull_face));
     }
 
-    glFrontFace(GLWindingOrder(rasterizer.winding_order));
+    GLCachedFrontFace(GLWindingOrder(rasterizer.winding_order));
 
     // Blend state
     for (int i = 0; i < Gfx_Max_Color_Attachments; i += 1)
@@ -136,17 +137,17 @@ void GfxSetPipelineState(GfxRenderPass *pass, GfxPipelineState *state)
         auto blend = state->desc.blend_states[i];
         if (!blend.enabled)
         {
-            glDisablei(GL_BLEND, i);
+            GLCachedSetBlendEnabled(i, false);
             continue;
         }
 
-        glEnablei(GL_BLEND, i);
-        glBlendFuncSeparatei(
+        GLCachedSetBlendEnabled(i, true);
+        GLCachedBlendFuncSeparate(
             i,
             GLBlendFactor(blend.src_RGB), GLBlendFactor(blend.dst_RGB),
             GLBlendFactor(blend.src_alpha), GLBlendFactor(blend.dst_alpha)
         );
-        glBlendEquationSeparatei(
+        GLCachedBlendEquationSeparate(
             i,
             GLBlendEquation(blend.RGB_operation),
             GLBlendEquation(blend.alpha_operation)
@@ -157,15 +158,15 @@ void GfxSetPipelineState(GfxRenderPass *pass, GfxPipelineState *state)
     auto depth = state->desc.depth_state;
     if (depth.enabled)
     {
-        glEnable(GL_DEPTH_TEST);
-        glDepthFunc(GLComparisonFunc(depth.compare_func));
+        GLCachedSetEnabled(GL_DEPTH_TEST, true);
+        GLCachedDepthFunc(GLComparisonFunc(depth.compare_func));
     }
     else
     {
-        glDisable(GL_DEPTH_TEST);
+        GLCachedSetEnabled(GL_DEPTH_TEST, false);
     }
 
-    glDepthMask(depth.write_enabled);
+    GLCachedDepthMask(depth.write_enabled);
 
     // Stencil state (@Todo)
 }
@@ -178,7 +179,7 @@ void GfxSetViewport(GfxRenderPass *pass, GfxViewport viewport)
 
 void GfxSetScissorRect(GfxRenderPass *pass, Recti rect)
 {
-    glEnable(GL_SCISSOR_TEST);
+    GLCachedSetEnabled(GL_SCISSOR_TEST, true);
     glScissor(rect.x, rect.y, rect.w, rect.h);
 }
 
@@ -187,7 +188,7 @@ void GfxSetVertexBuffer(GfxRenderPass *Pass, int index, GfxBuffer *buffer, s64 o
     Assert(offset >= 0 && size >= 0 && stride >= 0, "Invalid buffer offset or size or stride");
     Assert(index >= 0, "Invalid buffer index");
 
-    glBindVertexBuffer(index, buffer ? buffer->handle : 0, offset, stride);
+    GLCachedBindVertexBuffer(index, buffer ? buffer->handle : 0, offset, stride);
 }
 
 void GfxSetBuffer(GfxRenderPass *pass, GfxPipelineBinding binding, GfxBuffer *buffer, s64 offset, s64 size)
@@ -201,9 +202,9 @@ void GfxSetBuffer(GfxRenderPass *pass, GfxPipelineBinding binding, GfxBuffer *bu
 
     GLuint handle = buffer && size > 0 ? buffer->handle : 0;
     if (binding.type == GfxPipelineBindingType_UniformBuffer)
-        glBindBufferRange(GL_UNIFORM_BUFFER, binding.index, handle, offset, size);
+        GLCachedBindBufferRange(GL_UNIFORM_BUFFER, binding.index, handle, offset, size);
     else
-        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding.index, handle, offset, size);
+        GLCachedBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding.index, handle, offset, size);
 }
 
 void GfxSetTexture(GfxRenderPass *pass, GfxPipelineBinding binding, GfxTexture *texture)
@@ -217,11 +218,11 @@ void GfxSetTexture(GfxRenderPass *pass, GfxPipelineBinding binding, GfxTexture *
     if (binding.associated_texture_units.count > 0)
     {
         foreach (i, binding.associated_texture_units)
-            glBindTextureUnit(binding.associated_texture_units[i], handle);
+            GLCachedBindTextureUnit(binding.associated_texture_units[i], handle);
     }
     else
     {
-        glBindTextureUnit(binding.index, handle);
+        GLCachedBindTextureUnit(binding.index, handle);
     }
 }
 
@@ -236,11 +237,11 @@ void GfxSetSamplerState(GfxRenderPass *pass, GfxPipelineBinding binding, GfxSamp
     if (binding.associated_texture_units.count > 0)
     {
         foreach (i, binding.associated_texture_units)
-            glBindSampler(binding.associated_texture_units[i], handle);
+            GLCachedBindSampler(binding.associated_texture_units[i], handle);
     }
     else
     {
-        glBindSampler(binding.index, handle);
+        GLCachedBindSampler(binding.index, handle);
     }
 }
 
@@ -265,11 +266,7 @@ void GfxDrawPrimitives(GfxRenderPass *pass, u32 vertex_count, u32 instance_count
 
 void GfxDrawIndexedPrimitives(GfxRenderPass *pass, GfxBuffer *index_buffer, u32 index_count, GfxIndexType index_type, u32 instance_count, u32 base_vertex, u32 base_index, u32 base_instance)
 {
-    if (index_buffer != pass->current_index_buffer)
-    {
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer ? index_buffer->handle : 0);
-        pass->current_index_buffer = index_buffer;
-    }
+    GLCachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer ? index_buffer->handle : 0);
 
     GLenum mode = GL_TRIANGLES;
     switch (pass->current_pipeline_state->desc.rasterizer_state.primitive_type)
@@ -304,6 +301,41 @@ void GfxDrawIndexedPrimitives(GfxRenderPass *pass, GfxBuffer *index_buffer, u32
     );
 }
 
+void GfxDrawIndexedIndirect(GfxRenderPass *pass, GfxBuffer *index_buffer, GfxIndexType index_type, GfxBuffer *indirect_buffer, s64 indirect_offset, u32 draw_count)
+{
+    Assert(indirect_offset >= 0 && indirect_offset % 4 == 0, "Invalid indirect buffer offset");
+
+    if (draw_count == 0)
+        return;
+
+    GLCachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer ? index_buffer->handle : 0);
+
+    GLCachedBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer ? indirect_buffer->handle : 0);
+
+    GLenum mode = GL_TRIANGLES;
+    switch (pass->current_pipeline_state->desc.rasterizer_state.primitive_type)
+    {
+    case GfxPrimitiveType_Point:    mode = GL_POINTS;    break;
+    case GfxPrimitiveType_Line:     mode = GL_LINES;     break;
+    case GfxPrimitiveType_Triangle: mode = GL_TRIANGLES; break;
+    }
+
+    GLenum type = 0;
+    switch (index_type)
+    {
+    case GfxIndexType_Uint32: type = GL_UNSIGNED_INT;   break;
+    case GfxIndexType_Uint16: type = GL_UNSIGNED_SHORT; break;
+    }
+
+    glMultiDrawElementsIndirect(
+        mode,
+        type,
+        (void *)(ptrdiff_t)indirect_offset,
+        draw_count,
+        sizeof(GfxDrawIndexedIndirectCommand)
+    );
+}
+
 GLuint GLGetFramebuffer(GfxRenderPassDesc desc)
 {
     OpenGLFramebufferKey key{};
@@ -385,10 +417,11 @@ GLuint GLGetFramebuffer(GfxRenderPassDesc desc)
 
 void InvalidateFramebuffersUsingTexture(GLuint handle)
 {
-    foreach(i, g_gfx_context.framebuffer_cache.entries)
+    auto cache = &g_gfx_context.framebuffer_cache;
+    for (s64 i = 0; i < cache->capacity; i += 1)
     {
-        auto entry = &g_gfx_context.framebuffer_cache.entries[i];
-        if (entry->hash >= Hash_Map_First_Occupied)
+        auto entry = &cache->entries[i];
+        if (HashMapIsOccupied(cache, i))
         {
             bool should_remove = false;
             for (int i = 0; i < Gfx_Max_Color_Attachments; i += 1)
@@ -402,8 +435,7 @@ void InvalidateFramebuffersUsingTexture(GLuint handle)
 
             if (should_remove || entry->key.depth_texture == handle || entry->key.stencil_texture == handle)
             {
-                entry->hash = Hash_Map_Removed;
-                g_gfx_context.framebuffer_cache.count -= 1;
+                HashMapRemoveAt(cache, i);
             }
         }
     }
@@ -0,0 +1,463 @@
+#include "Graphics.hpp"
+
+// Every GL call that changes state goes through the driver's validation, even when
+// the value is the same as the current one. We keep a copy of what we last set and
+// skip the calls that would not change anything. The cache only knows about state
+// set through these functions, so anything else that touches the same state must
+// call GLInvalidateStateCache
+
+#define g_state (g_gfx_context.state_cache.state)
+
+static inline bool Skip(bool redundant)
+{
+    if (redundant)
+        g_gfx_context.state_cache.num_skipped += 1;
+    else
+        g_gfx_context.state_cache.num_issued += 1;
+
+    return redundant;
+}
+
+void GLInvalidateStateCache()
+{
+    memset(&g_state, 0xff, sizeof(g_state));
+}
+
+void GLEndStateCacheFrame()
+{
+    OpenGLStateCache *cache = &g_gfx_context.state_cache;
+    cache->last_frame_stats = {.num_issued=cache->num_issued, .num_skipped=cache->num_skipped};
+    cache->num_issued = 0;
+    cache->num_skipped = 0;
+}
+
+GfxStateStats GfxGetLastFrameStateStats()
+{
+    return g_gfx_context.state_cache.last_frame_stats;
+}
+
+// Deleting an object resets the bindings that refer to it, and the driver may hand
+// out the same name for the next object we create, so we cannot keep it in the cache
+
+void GLForgetBuffer(GLuint handle)
+{
+    if (g_state.element_array_buffer == handle)
+        g_state.element_array_buffer = 0;
+    if (g_state.array_buffer == handle)
+        g_state.array_buffer = 0;
+    if (g_state.draw_indirect_buffer == handle)
+        g_state.draw_indirect_buffer = 0;
+
+    for (int i = 0; i < GL_Max_Cached_Binding_Points; i += 1)
+    {
+        if (g_state.uniform_buffers[i].handle == handle)
+            g_state.uniform_buffers[i] = {};
+        if (g_state.storage_buffers[i].handle == handle)
+            g_state.storage_buffers[i] = {};
+        if (g_state.vertex_buffers[i].handle == handle)
+            g_state.vertex_buffers[i] = {};
+    }
+}
+
+void GLForgetTexture(GLuint handle)
+{
+    for (int i = 0; i < GL_Max_Cached_Binding_Points; i += 1)
+    {
+        if (g_state.texture_units[i] == handle)
+            g_state.texture_units[i] = 0;
+    }
+}
+
+void GLForgetSampler(GLuint handle)
+{
+    for (int i = 0; i < GL_Max_Cached_Binding_Points; i += 1)
+    {
+        if (g_state.samplers[i] == handle)
+            g_state.samplers[i] = 0;
+    }
+}
+
+void GLForgetPipeline(GLuint pso, GLuint vao)
+{
+    if (g_state.program_pipeline == pso)
+        g_state.program_pipeline = 0;
+
+    if (g_state.vertex_array == vao)
+    {
+        // Vertex buffer bindings are part of the vertex array state
+        g_state.vertex_array = 0;
+        g_state.element_array_buffer = 0xffffffff;
+        memset(g_state.vertex_buffers, 0xff, sizeof(g_state.vertex_buffers));
+    }
+}
+
+void GLCachedBindProgramPipeline(GLuint pso)
+{
+    if (Skip(g_state.program_pipeline == pso))
+        return;
+
+    glBindProgramPipeline(pso);
+    g_state.program_pipeline = pso;
+}
+
+void GLCachedBindVertexArray(GLuint vao)
+{
+    if (Skip(g_state.vertex_array == vao))
+        return;
+
+    glBindVertexArray(vao);
+    g_state.vertex_array = vao;
+
+    // We do not track the state of each vertex array separately
+    g_state.element_array_buffer = 0xffffffff;
+    memset(g_state.vertex_buffers, 0xff, sizeof(g_state.vertex_buffers));
+}
+
+void GLCachedBindBuffer(GLenum target, GLuint handle)
+{
+    GLuint *cached = null;
+    switch (target)
+    {
+    case GL_ELEMENT_ARRAY_BUFFER: cached = &g_state.element_array_buffer; break;
+    case GL_ARRAY_BUFFER:         cached = &g_state.array_buffer;         break;
+    case GL_DRAW_INDIRECT_BUFFER: cached = &g_state.draw_indirect_buffer; break;
+    }
+
+    if (cached && Skip(*cached == handle))
+        return;
+
+    glBindBuffer(target, handle);
+
+    if (cached)
+        *cached = handle;
+    else
+        g_gfx_context.state_cache.num_issued += 1;
+}
+
+void GLCachedBindBufferRange(GLenum target, GLuint index, GLuint handle, s64 offset, s64 size)
+{
+    OpenGLBufferRange *cached = null;
+    if (index < GL_Max_Cached_Binding_Points)
+    {
+        if (target == GL_UNIFORM_BUFFER)
+            cached = &g_state.uniform_buffers[index];
+        else if (target == GL_SHADER_STORAGE_BUFFER)
+            cached = &g_state.storage_buffers[index];
+    }
+
+    if (cached && Skip(cached->handle == handle && cached->offset == offset && cached->size == size))
+        return;
+
+    glBindBufferRange(target, index, handle, offset, size);
+
+    if (cached)
+        *cached = {.handle=handle, .offset=offset, .size=size};
+    else
+        g_gfx_context.state_cache.num_issued += 1;
+}
+
+void GLCachedBindVertexBuffer(GLuint index, GLuint handle, s64 offset, s64 stride)
+{
+    OpenGLBufferRange *cached = null;
+    if (index < GL_Max_Cached_Binding_Points)
+        cached = &g_state.vertex_buffers[index];
+
+    if (cached && Skip(cached->handle == handle && cached->offset == offset && cached->size == stride))
+        return;
+
+    glBindVertexBuffer(index, handle, offset, stride);
+
+    if (cached)
+        *cached = {.handle=handle, .offset=offset, .size=stride};
+    else
+        g_gfx_context.state_cache.num_issued += 1;
+}
+
+void GLCachedBindTextureUnit(GLuint unit, GLuint handle)
+{
+    if (unit >= GL_Max_Cached_Binding_Points)
+    {
+        glBindTextureUnit(unit, handle);
+        g_gfx_context.state_cache.num_issued += 1;
+        return;
+    }
+
+    if (Skip(g_state.texture_units[unit] == handle))
+        return;
+
+    glBindTextureUnit(unit, handle);
+    g_state.texture_units[unit] = handle;
+}
+
+void GLCachedBindSampler(GLuint unit, GLuint handle)
+{
+    if (unit >= GL_Max_Cached_Binding_Points)
+    {
+        glBindSampler(unit, handle);
+        g_gfx_context.state_cache.num_issued += 1;
+        return;
+    }
+
+    if (Skip(g_state.samplers[unit] == handle))
+        return;
+
+    glBindSampler(unit, handle);
+    g_state.samplers[unit] = handle;
+}
+
+void GLCachedSetEnabled(GLenum cap, bool enabled)
+{
+    GLboolean *cached = null;
+    switch (cap)
+    {
+    case GL_SCISSOR_TEST: cached = &g_state.scissor_test_enabled; break;
+    case GL_CULL_FACE:    cached = &g_state.cull_face_enabled;    break;
+    case GL_DEPTH_TEST:   cached = &g_state.depth_test_enabled;   break;
+    }
+
+    if (cached && Skip(*cached == (GLboolean)enabled))
+        return;
+
+    if (enabled)
+        glEnable(cap);
+    else
+        glDisable(cap);
+
+    if (cached)
+        *cached = (GLboolean)enabled;
+    else
+        g_gfx_context.state_cache.num_issued += 1;
+}
+
+void GLCachedSetBlendEnabled(GLuint index, bool enabled)
+{
+    Assert(index < Gfx_Max_Color_Attachments);
+
+    if (Skip(g_state.blend_enabled[index] == (GLboolean)enabled))
+        return;
+
+    if (enabled)
+        glEnablei(GL_BLEND, index);
+    else
+        glDisablei(GL_BLEND, index);
+
+    g_state.blend_enabled[index] = (GLboolean)enabled;
+}
+
+void GLCachedBlendFuncSeparate(GLuint index, GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha, GLenum dst_alpha)
+{
+    Assert(index < Gfx_Max_Color_Attachments);
+
+    GLenum *cached = g_state.blend_funcs[index];
+    if (Skip(cached[0] == src_rgb && cached[1] == dst_rgb && cached[2] == src_alpha && cached[3] == dst_alpha))
+        return;
+
+    glBlendFuncSeparatei(index, src_rgb, dst_rgb, src_alpha, dst_alpha);
+    cached[0] = src_rgb;
+    cached[1] = dst_rgb;
+    cached[2] = src_alpha;
+    cached[3] = dst_alpha;
+}
+
+void GLCachedBlendEquationSeparate(GLuint index, GLenum rgb, GLenum alpha)
+{
+    Assert(index < Gfx_Max_Color_Attachments);
+
+    GLenum *cached = g_state.blend_equations[index];
+    if (Skip(cached[0] == rgb && cached[1] == alpha))
+        return;
+
+    glBlendEquationSeparatei(index, rgb, alpha);
+    cached[0] = rgb;
+    cached[1] = alpha;
+}
+
+void GLCachedPolygonMode(GLenum mode)
+{
+    if (Skip(g_state.polygon_mode == mode))
+        return;
+
+    glPolygonMode(GL_FRONT_AND_BACK, mode);
+    g_state.polygon_mode = mode;
+}
+
+void GLCachedCullFace(GLenum face)
+{
+    if (Skip(g_state.cull_face == face))
+        return;
+
+    glCullFace(face);
+    g_state.cull_face = face;
+}
+
+void GLCachedFrontFace(GLenum order)
+{
+    if (Skip(g_state.front_face == order))
+        return;
+
+    glFrontFace(order);
+    g_state.front_face = order;
+}
+
+void GLCachedDepthFunc(GLenum func)
+{
+    if (Skip(g_state.depth_func == func))
+        return;
+
+    glDepthFunc(func);
+    g_state.depth_func = func;
+}
+
+void GLCachedDepthMask(bool enabled)
+{
+    if (Skip(g_state.depth_mask == (GLboolean)enabled))
+        return;
+
+    glDepthMask(enabled);
+    g_state.depth_mask = (GLboolean)enabled;
+}
+
+// Self check, runs the cache against fake GL functions that only count the calls
+// that reach the driver, so it does not need a context
+
+static s64 g_num_mock_gl_calls;
+
+static void APIENTRY MockGLBindProgramPipeline(GLuint) { g_num_mock_gl_calls += 1; }
+static void APIENTRY MockGLBindVertexArray(GLuint) { g_num_mock_gl_calls += 1; }
+static void APIENTRY MockGLBindBuffer(GLenum, GLuint) { g_num_mock_gl_calls += 1; }
+static void APIENTRY MockGLBindBufferRange(GLenum, GLuint, GLuint, GLintptr, GLsizeiptr) { g_num_mock_gl_calls += 1; }
+static void APIENTRY MockGLBindVertexBuffer(GLuint, GLuint, GLintptr, GLsizei) { g_num_mock_gl_calls += 1; }
+static void APIENTRY MockGLBindTextureUnit(GLuint, GLuint) { g_num_mock_gl_calls += 1; }
+static void APIENTRY MockGLEnable(GLenum) { g_num_mock_gl_calls += 1; }
+static void APIENTRY MockGLDisable(GLenum) { g_num_mock_gl_calls += 1; }
+
+// glad's debug wrappers check for errors after each call
+static GLenum APIENTRY MockGLGetError() { return GL_NO_ERROR; }
+
+static bool ExpectGLCalls(const char *what, s64 expected)
+{
+    s64 num_calls = g_num_mock_gl_calls;
+    g_num_mock_gl_calls = 0;
+
+    if (num_calls != expected)
+    {
+        LogError(Log_OpenGL, "State cache: %s made %lld GL calls, expected %lld", what, num_calls, expected);
+        return false;
+    }
+
+    return true;
+}
+
+bool GLCheckStateCache()
+{
+    auto bind_program_pipeline = glad_glBindProgramPipeline;
+    auto bind_vertex_array = glad_glBindVertexArray;
+    auto bind_buffer = glad_glBindBuffer;
+    auto bind_buffer_range = glad_glBindBufferRange;
+    auto bind_vertex_buffer = glad_glBindVertexBuffer;
+    auto bind_texture_unit = glad_glBindTextureUnit;
+    auto enable = glad_glEnable;
+    auto disable = glad_glDisable;
+    auto get_error = glad_glGetError;
+    OpenGLStateCache cache = g_gfx_context.state_cache;
+    defer({
+        glad_glBindProgramPipeline = bind_program_pipeline;
+        glad_glBindVertexArray = bind_vertex_array;
+        glad_glBindBuffer = bind_buffer;
+        glad_glBindBufferRange = bind_buffer_range;
+        glad_glBindVertexBuffer = bind_vertex_buffer;
+        glad_glBindTextureUnit = bind_texture_unit;
+        glad_glEnable = enable;
+        glad_glDisable = disable;
+        glad_glGetError = get_error;
+        g_gfx_context.state_cache = cache;
+    });
+
+    glad_glBindProgramPipeline = MockGLBindProgramPipeline;
+    glad_glBindVertexArray = MockGLBindVertexArray;
+    glad_glBindBuffer = MockGLBindBuffer;
+    glad_glBindBufferRange = MockGLBindBufferRange;
+    glad_glBindVertexBuffer = MockGLBindVertexBuffer;
+    glad_glBindTextureUnit = MockGLBindTextureUnit;
+    glad_glEnable = MockGLEnable;
+    glad_glDisable = MockGLDisable;
+    glad_glGetError = MockGLGetError;
+
+    GLInvalidateStateCache();
+    g_num_mock_gl_calls = 0;
+
+    bool ok = true;
+
+    // Each binding is issued once, then skipped until it changes
+    GLCachedBindProgramPipeline(1);
+    GLCachedBindVertexArray(2);
+    GLCachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 3);
+    GLCachedBindVertexBuffer(0, 3, 0, 16);
+    GLCachedBindBufferRange(GL_UNIFORM_BUFFER, 0, 4, 0, 256);
+    GLCachedBindTextureUnit(0, 5);
+    GLCachedSetEnabled(GL_DEPTH_TEST, true);
+    ok &= ExpectGLCalls("first binds", 7);
+
+    GLCachedBindProgramPipeline(1);
+    GLCachedBindVertexArray(2);
+    GLCachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 3);
+    GLCachedBindVertexBuffer(0, 3, 0, 16);
+    GLCachedBindBufferRange(GL_UNIFORM_BUFFER, 0, 4, 0, 256);
+    GLCachedBindTextureUnit(0, 5);
+    GLCachedSetEnabled(GL_DEPTH_TEST, true);
+    ok &= ExpectGLCalls("redundant binds", 0);
+
+    GLCachedBindVertexBuffer(0, 3, 64, 16);
+    GLCachedBindBufferRange(GL_UNIFORM_BUFFER, 0, 4, 256, 256);
+    GLCachedSetEnabled(GL_DEPTH_TEST, false);
+    ok &= ExpectGLCalls("binds with different offsets or values", 3);
+
+    // The name of a deleted buffer can be reused by the next one we create
+    GLForgetBuffer(3);
+    GLForgetBuffer(4);
+    GLCachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 3);
+    GLCachedBindVertexBuffer(0, 3, 64, 16);
+    GLCachedBindBufferRange(GL_UNIFORM_BUFFER, 0, 4, 256, 256);
+    ok &= ExpectGLCalls("binds after GLForgetBuffer", 3);
+
+    // The element and vertex buffers belong to the vertex array, so switching
+    // to another one and back must bind them again
+    GLCachedBindVertexArray(6);
+    GLCachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 3);
+    GLCachedBindVertexBuffer(0, 3, 64, 16);
+    ok &= ExpectGLCalls("binds after switching vertex arrays", 3);
+
+    GLCachedBindVertexArray(2);
+    GLCachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 3);
+    GLCachedBindVertexBuffer(0, 3, 64, 16);
+    ok &= ExpectGLCalls("binds after switching back to the first vertex array", 3);
+
+    GLForgetPipeline(1, 2);
+    GLCachedBindProgramPipeline(1);
+    GLCachedBindVertexArray(2);
+    GLCachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 3);
+    GLCachedBindVertexBuffer(0, 3, 64, 16);
+    ok &= ExpectGLCalls("binds after GLForgetPipeline", 4);
+
+    // Forgetting an object that is not bound does not affect what is bound
+    GLForgetBuffer(7);
+    GLForgetPipeline(8, 9);
+    GLCachedBindProgramPipeline(1);
+    GLCachedBindVertexArray(2);
+    GLCachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 3);
+    GLCachedBindVertexBuffer(0, 3, 64, 16);
+    GLCachedBindBufferRange(GL_UNIFORM_BUFFER, 0, 4, 256, 256);
+    ok &= ExpectGLCalls("binds after forgetting unbound objects", 0);
+
+    GLInvalidateStateCache();
+    GLCachedBindProgramPipeline(1);
+    GLCachedBindVertexArray(2);
+    GLCachedBindTextureUnit(0, 5);
+    GLCachedSetEnabled(GL_DEPTH_TEST, false);
+    ok &= ExpectGLCalls("binds after GLInvalidateStateCache", 4);
+
+    if (ok)
+        LogMessage(Log_OpenGL, "State cache: all checks passed");
+
+    return ok;
+}
@@ -69,6 +69,7 @@ void InvalidateFramebuffersUsingTexture(GLuint handle);
 void GfxDestroyTexture(GfxTexture *texture)
 {
     InvalidateFramebuffersUsingTexture(texture->handle);
+    GLForgetTexture(texture->handle);
     glDeleteTextures(1, &texture->handle);
     *texture = {};
 }
@@ -174,6 +175,7 @@ GfxSamplerState GfxCreateSamplerState(String name, GfxSamplerStateDesc desc)
 
 void GfxDestroySamplerState(GfxSamplerState *sampler)
 {
+    GLForgetSampler(sampler->handle);
     glDeleteSamplers(1, &sampler->handle);
     *sampler = {};
 }
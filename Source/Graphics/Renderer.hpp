@@ -3,6 +3,9 @@
 #include "Core.hpp"
 #include "Math.hpp"
 #include "Graphics.hpp"
+#include "OffsetAllocator.hpp"
+#include "Profiler.hpp"
+#include "Metrics.hpp"
 
 extern SDL_Window *g_window;
 
@@ -21,6 +24,7 @@ struct ShaderFile
 };
 
 void LoadAllShaders();
+void UnloadAllShaders();
 
 GfxShader *GetVertexShader(String name);
 GfxShader *GetFragmentShader(String name);
@@ -50,28 +54,186 @@ struct ShaderPreprocessResult
 bool InitShaderPreprocessor(ShaderPreprocessor *pp, String filename);
 void DestroyShaderPreprocessor(ShaderPreprocessor *pp);
 ShaderPreprocessResult PreprocessShader(ShaderPreprocessor *pp);
+void FreeShaderPreprocessResult(ShaderPreprocessResult *result);
+
+// Ring buffer allocator for data the GPU reads during a frame. Every allocation
+// belongs to the frame it was made in, and its memory is reused once the fence
+// of that frame is signaled. If there is not enough free space, the allocator
+// switches to a larger buffer; the previous one is kept alive until the frames
+// that used it are done, so use GetBuffer to know which buffer a pointer is in
+
+// Everything the allocator needs from the GPU, so it can run on mock buffers
+struct GfxAllocatorBackend
+{
+    // Returns the mapped pointer
+    void *(*CreateBuffer)(String name, s64 size, GfxBuffer *buffer) = null;
+    void (*DestroyBuffer)(GfxBuffer *buffer) = null;
+    void (*FlushBuffer)(GfxBuffer *buffer, s64 offset, s64 size) = null;
+    s64 (*GetBufferAlignment)() = null;
+
+    GfxFence (*CreateFence)() = null;
+    void (*DestroyFence)(GfxFence *fence) = null;
+    bool (*IsFenceSignaled)(GfxFence *fence) = null;
+};
+
+extern GfxAllocatorBackend g_default_gfx_allocator_backend;
+
+struct GfxAllocatorRetiredBuffer
+{
+    GfxBuffer *buffer = null;
+    void *mapped_ptr = null;
+    s64 capacity = 0;
+    u64 last_serial = 0;
+};
+
+struct GfxAllocatorFrame
+{
+    u64 serial = 0;
+    s64 end = 0;
+    GfxFence fence = {};
+};
 
 struct GfxAllocator
 {
-    GfxBuffer buffer = {};
+    String name = "";
+    GfxAllocatorBackend backend = {};
+    s64 alignment = 0;
+
+    // Heap allocated so pointers returned by GetBuffer stay valid when we switch buffers
+    GfxBuffer *buffer = null;
     void *mapped_ptr = null;
-    s64 top = 0;
     s64 capacity = 0;
+
+    // head and tail only ever increase, the offset in the buffer is position % capacity
+    s64 head = 0;
+    s64 tail = 0;
+    s64 frame_start = 0;
+
+    u64 current_serial = 1;
+    u64 buffer_first_serial = 1; // First frame that allocated from the current buffer
+    Array<GfxAllocatorFrame> frames = {};
+    Array<GfxAllocatorRetiredBuffer> retired_buffers = {};
+
+    s64 high_water = 0;
+    s64 frame_bytes = 0;
+    s64 last_frame_bytes = 0;
+    s64 max_frame_bytes = 0;
+    int num_grows = 0;
+};
+
+struct GfxAllocatorStats
+{
+    s64 capacity = 0;
+    s64 used = 0;
+    s64 high_water = 0;
+    s64 last_frame_bytes = 0;
+    s64 max_frame_bytes = 0;
+    int num_frames_in_flight = 0;
+    int num_retired_buffers = 0;
+    int num_grows = 0;
 };
 
 GfxAllocator *FrameDataGfxAllocator();
-GfxBuffer *FrameDataBuffer();
 Allocator FrameDataAllocator();
+GfxBuffer *FrameDataBuffer(void *ptr);
+
+void InitGfxAllocator(GfxAllocator *allocator, String name, s64 capacity, GfxAllocatorBackend *backend = &g_default_gfx_allocator_backend);
+void DestroyGfxAllocator(GfxAllocator *allocator);
+
+// Frees the memory of the frames the GPU is done with
+void ReclaimGfxAllocator(GfxAllocator *allocator);
 
-void InitGfxAllocator(GfxAllocator *allocator, String name, s64 capacity);
-void FlushGfxAllocator(GfxAllocator *allocator);
-void ResetGfxAllocator(GfxAllocator *allocator);
+// Flushes what was allocated during the frame and signals a fence after the
+// commands that were issued so far. Call once all the frame's commands are issued
+void EndGfxAllocatorFrame(GfxAllocator *allocator);
 
+GfxBuffer *GetBuffer(GfxAllocator *allocator, void *ptr);
 s64 GetBufferOffset(GfxAllocator *allocator, void *ptr);
+GfxAllocatorStats GetGfxAllocatorStats(GfxAllocator *allocator);
 
 Allocator MakeAllocator(GfxAllocator *allocator);
 void *GfxAllocatorFunc(AllocatorOp op, s64 size, void *ptr, void *data);
 
+// Persistently mapped upload buffer that worker threads can write into directly.
+// Ranges are reserved in order from any thread, and are released by the main
+// thread once it has recorded the copies that read them. Released ranges are
+// reused after the fence of the frame they were released in is signaled, and
+// only once all the ranges reserved before them can be reused too
+
+#define Staging_Ring_Alignment 64
+
+struct StagingRingRange
+{
+    s64 offset = -1; // In the buffer
+    s64 size = 0;
+    u64 id = 0;
+};
+
+static inline bool IsNull(StagingRingRange range)
+{
+    return range.offset < 0;
+}
+
+struct StagingRingRecord
+{
+    s64 end = 0;
+    u64 release_serial = 0; // 0 if the range was not used by the GPU
+    bool released = false;
+};
+
+struct StagingRingFence
+{
+    GfxFence fence = {};
+    u64 serial = 0;
+};
+
+struct StagingRing
+{
+    GfxBuffer buffer = {};
+    void *mapped_ptr = null;
+    s64 capacity = 0;
+
+    // head and tail only ever increase, the offset in the buffer is position % capacity
+    pthread_mutex_t mutex = {};
+    s64 head = 0;
+    s64 tail = 0;
+    Array<StagingRingRecord> records = {};
+    s64 first_record = 0;
+    u64 first_record_id = 0;
+
+    u64 current_serial = 1;
+    u64 completed_serial = 0;
+    Array<StagingRingFence> fences = {};
+
+    s64 high_water = 0;
+    s64 num_failed_reservations = 0;
+};
+
+struct StagingRingStats
+{
+    s64 capacity = 0;
+    s64 used = 0;
+    s64 high_water = 0;
+    s64 num_failed_reservations = 0;
+};
+
+void InitStagingRing(StagingRing *ring, String name, s64 capacity);
+void DestroyStagingRing(StagingRing *ring);
+
+// Thread safe, returns a null range if there is not enough space
+StagingRingRange ReserveStagingRing(StagingRing *ring, s64 size);
+void *GetStagingRingPointer(StagingRing *ring, StagingRingRange range);
+
+// Main thread only
+void FlushStagingRing(StagingRing *ring, StagingRingRange range);
+void ReleaseStagingRing(StagingRing *ring, StagingRingRange range, bool used_by_gpu);
+void SignalStagingRing(StagingRing *ring);
+void ReclaimStagingRing(StagingRing *ring);
+// Thread safe, workers keep reserving while we read
+StagingRingStats GetStagingRingStats(StagingRing *ring);
+
+extern StagingRing g_chunk_staging_ring;
+
 enum BlockFace : uint
 {
     BlockFace_East,
@@ -181,10 +343,65 @@ enum ChunkMeshType : s8
     ChunkMeshType_Count,
 };
 
+struct ChunkMeshPoolAllocation
+{
+    s64 offset = -1; // In bytes
+    s64 size = 0;
+    OffsetAllocation range = {};
+};
+
+struct ChunkMeshPool;
+
+// Called for every live allocation moved by DefragmentChunkMeshPool
+typedef void (*ChunkMeshPoolRelocateFunc)(ChunkMeshPool *pool, void *user_data, OffsetAllocation new_range);
+
+struct ChunkMeshPool
+{
+    String name = "";
+    GfxBufferUsage usage = GfxBufferUsage_None;
+    GfxBuffer buffer = {};
+    s64 capacity = 0;
+    OffsetAllocator allocator = {};
+    ChunkMeshPoolRelocateFunc Relocate = null;
+
+    int num_grows = 0;
+    int num_defragmentations = 0;
+};
+
+struct ChunkMeshPoolStats
+{
+    s64 capacity = 0;
+    s64 used = 0;
+    s64 largest_free_block = 0;
+    u32 num_allocations = 0;
+    u32 num_free_blocks = 0;
+    float fragmentation = 0;
+    int num_grows = 0;
+    int num_defragmentations = 0;
+};
+
+void InitChunkMeshPool(ChunkMeshPool *pool, String name, GfxBufferUsage usage, s64 capacity, ChunkMeshPoolRelocateFunc Relocate);
+void DestroyChunkMeshPool(ChunkMeshPool *pool);
+
+// The pool buffer may be recreated if it needs to be grown or defragmented,
+// in which case the old contents are copied using pass
+ChunkMeshPoolAllocation AllocFromChunkMeshPool(ChunkMeshPool *pool, s64 size, void *user_data, GfxCopyPass *pass);
+void FreeToChunkMeshPool(ChunkMeshPool *pool, ChunkMeshPoolAllocation *allocation);
+void DefragmentChunkMeshPool(ChunkMeshPool *pool, GfxCopyPass *pass);
+ChunkMeshPoolAllocation GetRelocatedAllocation(ChunkMeshPoolAllocation allocation, OffsetAllocation new_range);
+ChunkMeshPoolStats GetChunkMeshPoolStats(ChunkMeshPool *pool);
+
+extern ChunkMeshPool g_chunk_vertex_pool;
+extern ChunkMeshPool g_chunk_index_pool;
+
+// Set to defragment the pools during the next upload pass
+extern bool g_defragment_chunk_mesh_pools;
+
 struct Mesh
 {
-    GfxBuffer vertex_buffer = {};
-    GfxBuffer index_buffer = {};
+    ChunkMeshPoolAllocation vertex_allocation = {};
+    ChunkMeshPoolAllocation index_allocation = {};
+
     u32 vertex_count = 0;
     u32 index_count = 0;
 
@@ -192,20 +409,129 @@ struct Mesh
     u32 mesh_type_index_offsets[ChunkMeshType_Count] = {};
     u32 mesh_type_index_counts[ChunkMeshType_Count] = {};
 
+    s64 upload_index = -1; // Index in the pending uploads, or -1
     bool uploaded = false;
 };
 
-void GenerateChunkMeshWorker(ThreadGroup *group, void *data);
+struct ChunkUploadStats
+{
+    s64 num_pending = 0;
+    s64 pending_bytes = 0;
+
+    // Last frame
+    int num_uploaded = 0;
+    s64 uploaded_bytes = 0;
+    s64 upload_time_ns = 0;
+
+    // Current backlog, i.e. since the pending list was last empty
+    s64 backlog_start_ns = -1;
+    int backlog_num_frames = 0;
+    s64 backlog_num_chunks = 0;
+
+    // How long it took to upload everything the last time the backlog was drained
+    s64 last_drain_ns = 0;
+    int last_drain_num_frames = 0;
+    s64 last_drain_num_chunks = 0;
+};
+
+extern ChunkUploadStats g_chunk_upload_stats;
+
+void GenerateChunkMeshWorker(void *data);
 void CancelChunkMeshUpload(Chunk *chunk);
+void FreeChunkMesh(Mesh *mesh);
+
+// Offsets are in vertices and indices inside the chunk mesh pools
+struct ChunkDrawRange
+{
+    u32 vertex_offset = 0;
+    u32 index_offset = 0;
+    u32 index_count = 0;
+};
+
+typedef u8 ChunkRenderFlags;
+#define ChunkRenderFlag_Visible 0x01
+
+// Dense copy of what we need to cull and draw the uploaded chunks, so we
+// do not have to touch the (very large) Chunk structs every frame.
+// Records are added by the upload path and removed when a chunk is remeshed
+// or destroyed. All arrays are indexed by Chunk::render_index
+struct ChunkRenderTable
+{
+    s64 count = 0;
+
+    Array<Chunk *> chunks = {};
+    Array<Vec2f> positions = {};
+    Array<ChunkDrawRange> draw_ranges[ChunkMeshType_Count] = {};
+    Array<ChunkRenderFlags> flags = {};
+};
+
+extern ChunkRenderTable g_chunk_render_table;
+
+void InitChunkRenderTable(ChunkRenderTable *table);
+void DestroyChunkRenderTable(ChunkRenderTable *table);
+void AddOrUpdateChunkRenderRecord(ChunkRenderTable *table, Chunk *chunk);
+void RemoveChunkRenderRecord(ChunkRenderTable *table, Chunk *chunk);
+void ClearChunkRenderFlags(ChunkRenderTable *table, ChunkRenderFlags flags);
+
+// Fills draw_list with the indices of the records that have something to draw
+// for the given mesh type and are within max_distance of the camera
+void BuildChunkDrawList(ChunkRenderTable *table, ChunkMeshType type, Vec2f camera_position, float max_distance, bool visible_only, Array<s64> *draw_list);
+
+// WARNING: must match the struct in common.glsl
+struct Std430ChunkDrawData
+{
+    Vec3f origin;
+    u32 _padding0 = 0;
+};
+
+struct ChunkDrawCommands
+{
+    GfxBuffer *commands_buffer = null;
+    s64 commands_offset = 0;
+    GfxBuffer *draw_data_buffer = null;
+    s64 draw_data_offset = 0;
+    s64 draw_data_size = 0;
+    u32 command_counts[ChunkMeshType_Count] = {};
+    s64 total_vertex_count = 0; // Indices drawn, times the number of instances
+};
+
+// Writes one indirect draw command per draw list entry (draw_lists[type] can be empty),
+// and the per draw data indexed by the commands' base instance, in the frame data buffer
+ChunkDrawCommands BuildChunkDrawCommands(ChunkRenderTable *table, Slice<s64> draw_lists[ChunkMeshType_Count], u32 instance_count);
+void DrawChunks(GfxRenderPass *pass, ChunkDrawCommands *commands, ChunkMeshType type);
 
 extern bool g_show_debug_atlas;
 
 struct Std140FrameInfo;
 
+struct RendererMetrics
+{
+    Metric *chunk_pass_draws = null;
+    Metric *chunk_pass_vertices = null;
+    Metric *shadow_map_pass_draws = null;
+    Metric *shadow_map_pass_vertices = null;
+
+    Metric *pending_uploads = null;
+    Metric *pending_upload_bytes = null;
+    Metric *uploaded_chunks = null;
+    Metric *uploaded_bytes = null;
+
+    Metric *frame_data_high_water = null;
+    Metric *staging_ring_high_water = null;
+    Metric *staging_ring_failed_reservations = null;
+    Metric *vertex_pool_used = null;
+    Metric *vertex_pool_capacity = null;
+    Metric *index_pool_used = null;
+    Metric *index_pool_capacity = null;
+};
+
+extern RendererMetrics g_renderer_metrics;
+
 struct FrameRenderContext
 {
     GfxCommandBuffer *cmd_buffer = null;
     Std140FrameInfo *frame_info = null;
+    GfxBuffer *frame_info_buffer = null;
     s64 frame_info_offset = -1;
     World *world = null;
 };
@@ -216,6 +542,7 @@ extern GfxSamplerState g_linear_sampler;
 extern GfxSamplerState g_block_sampler;
 
 void InitRenderer();
+void DestroyRenderer();
 void RenderGraphics(World *world);
 
 #define Block_Texture_Size_No_Border 16
@@ -228,6 +555,7 @@ extern GfxTexture g_block_atlas;
 extern GfxTexture g_debug_block_face_atlas;
 
 void LoadAllTextures();
+void DestroyAllTextures();
 void QueueGenerateMipmaps(GfxTexture *texture);
 void GeneratePendingMipmaps(GfxCommandBuffer *cmd_buffer);
 
@@ -253,6 +581,7 @@ extern float g_shadow_map_filter_radius;
 Mat4f GetShadowMapCascadeMatrix(Vec3f light_direction, Mat4f camera_transform, int level);
 
 void InitShadowMap();
+void DestroyShadowMap();
 void RecreateShadowMapTexture(u32 resolution);
 void ShadowMapPass(FrameRenderContext *ctx);
 
@@ -300,6 +629,7 @@ extern SkyAtmosphere g_sky;
 extern GfxSamplerState g_sky_LUT_sampler;
 extern GfxSamplerState g_sky_color_LUT_sampler;
 
+void DestroySky();
 void RenderSkyLUTs(FrameRenderContext *ctx);
 void SkyAtmospherePass(FrameRenderContext *ctx);
 
@@ -0,0 +1,192 @@
+#include "Graphics/Renderer.hpp"
+
+// All the chunk meshes live in one vertex buffer and one index buffer so that
+// they can be drawn with a single indirect draw call. Ranges are handed out by
+// an OffsetAllocator working in units of Chunk_Mesh_Pool_Alignment bytes.
+// When no free block is large enough, we first try to compact the pool if
+// enough space is lost to fragmentation, otherwise the buffer is grown.
+// Both operations copy the buffer on the GPU
+
+#define Chunk_Mesh_Pool_Alignment 64
+#define Chunk_Mesh_Pool_Defragment_Threshold 0.5f
+
+static inline u32 BytesToUnits(s64 size)
+{
+    s64 units = AlignForward(size, Chunk_Mesh_Pool_Alignment) / Chunk_Mesh_Pool_Alignment;
+    Assert(units <= 0xffffffff, "Chunk mesh pool allocation is too large");
+
+    return (u32)units;
+}
+
+static inline ChunkMeshPoolAllocation MakePoolAllocation(OffsetAllocation range, s64 size)
+{
+    return {
+        .offset=(s64)range.offset * Chunk_Mesh_Pool_Alignment,
+        .size=size,
+        .range=range,
+    };
+}
+
+void InitChunkMeshPool(ChunkMeshPool *pool, String name, GfxBufferUsage usage, s64 capacity, ChunkMeshPoolRelocateFunc Relocate)
+{
+    pool->name = name;
+    pool->usage = usage;
+    pool->capacity = AlignForward(capacity, Chunk_Mesh_Pool_Alignment);
+    pool->Relocate = Relocate;
+
+    GfxBufferDesc desc{};
+    desc.usage = usage;
+    desc.size = pool->capacity;
+    pool->buffer = GfxCreateBuffer(name, desc);
+    Assert(!IsNull(&pool->buffer));
+
+    InitOffsetAllocator(&pool->allocator, BytesToUnits(pool->capacity));
+}
+
+void DestroyChunkMeshPool(ChunkMeshPool *pool)
+{
+    GfxDestroyBuffer(&pool->buffer);
+    DestroyOffsetAllocator(&pool->allocator);
+    *pool = {};
+}
+
+static void GrowChunkMeshPool(ChunkMeshPool *pool, s64 min_capacity, GfxCopyPass *pass)
+{
+    s64 new_capacity = pool->capacity;
+    while (new_capacity < min_capacity)
+        new_capacity *= 2;
+
+    GfxBufferDesc desc{};
+    desc.usage = pool->usage;
+    desc.size = new_capacity;
+    GfxBuffer new_buffer = GfxCreateBuffer(pool->name, desc);
+    Assert(!IsNull(&new_buffer));
+
+    GfxCopyBufferToBuffer(pass, &pool->buffer, 0, &new_buffer, 0, pool->capacity);
+    GfxDestroyBuffer(&pool->buffer);
+    pool->buffer = new_buffer;
+
+    GrowOffsetAllocator(&pool->allocator, BytesToUnits(new_capacity));
+
+    LogMessage(Log_Graphics, "Grew %.*s from %lld to %lld bytes", FSTR(pool->name), pool->capacity, new_capacity);
+
+    pool->capacity = new_capacity;
+    pool->num_grows += 1;
+}
+
+void DefragmentChunkMeshPool(ChunkMeshPool *pool, GfxCopyPass *pass)
+{
+    ProfileFunction();
+
+    float time_start = GetTimeInSeconds();
+
+    auto blocks = GetOffsetAllocatorBlocks(&pool->allocator, temp);
+
+    GfxBufferDesc desc{};
+    desc.usage = pool->usage;
+    desc.size = pool->capacity;
+    GfxBuffer new_buffer = GfxCreateBuffer(pool->name, desc);
+    Assert(!IsNull(&new_buffer));
+
+    OffsetAllocator new_allocator{};
+    InitOffsetAllocator(&new_allocator, pool->allocator.size);
+
+    // Blocks are packed in order, so consecutive blocks that were already
+    // next to each other are copied with a single command
+    s64 run_src = 0;
+    s64 run_dst = 0;
+    s64 run_size = 0;
+    foreach (i, blocks)
+    {
+        OffsetAllocation old_range = blocks[i].allocation;
+        OffsetAllocation new_range = AllocOffset(&new_allocator, old_range.size, blocks[i].user_data);
+        Assert(!IsNull(new_range));
+
+        s64 src = (s64)old_range.offset * Chunk_Mesh_Pool_Alignment;
+        s64 dst = (s64)new_range.offset * Chunk_Mesh_Pool_Alignment;
+        s64 size = (s64)old_range.size * Chunk_Mesh_Pool_Alignment;
+        if (run_size > 0 && run_src + run_size == src && run_dst + run_size == dst)
+        {
+            run_size += size;
+        }
+        else
+        {
+            if (run_size > 0)
+                GfxCopyBufferToBuffer(pass, &pool->buffer, run_src, &new_buffer, run_dst, run_size);
+
+            run_src = src;
+            run_dst = dst;
+            run_size = size;
+        }
+
+        if (pool->Relocate)
+            pool->Relocate(pool, blocks[i].user_data, new_range);
+    }
+
+    if (run_size > 0)
+        GfxCopyBufferToBuffer(pass, &pool->buffer, run_src, &new_buffer, run_dst, run_size);
+
+    GfxDestroyBuffer(&pool->buffer);
+    DestroyOffsetAllocator(&pool->allocator);
+
+    pool->buffer = new_buffer;
+    pool->allocator = new_allocator;
+    pool->num_defragmentations += 1;
+
+    float time_end = GetTimeInSeconds();
+    LogMessage(Log_Graphics, "Defragmented %.*s (%lld blocks) in %f s", FSTR(pool->name), blocks.count, time_end - time_start);
+}
+
+ChunkMeshPoolAllocation AllocFromChunkMeshPool(ChunkMeshPool *pool, s64 size, void *user_data, GfxCopyPass *pass)
+{
+    if (size <= 0)
+        return {};
+
+    u32 units = BytesToUnits(size);
+    OffsetAllocation range = AllocOffset(&pool->allocator, units, user_data);
+    if (IsNull(range))
+    {
+        OffsetAllocatorStats stats = GetOffsetAllocatorStats(&pool->allocator);
+        if (stats.free_size >= units && stats.fragmentation > Chunk_Mesh_Pool_Defragment_Threshold)
+        {
+            DefragmentChunkMeshPool(pool, pass);
+            range = AllocOffset(&pool->allocator, units, user_data);
+        }
+    }
+
+    if (IsNull(range))
+    {
+        GrowChunkMeshPool(pool, pool->capacity + (s64)units * Chunk_Mesh_Pool_Alignment, pass);
+        range = AllocOffset(&pool->allocator, units, user_data);
+        Assert(!IsNull(range));
+    }
+
+    return MakePoolAllocation(range, size);
+}
+
+void FreeToChunkMeshPool(ChunkMeshPool *pool, ChunkMeshPoolAllocation *allocation)
+{
+    FreeOffset(&pool->allocator, allocation->range);
+    *allocation = {};
+}
+
+ChunkMeshPoolAllocation GetRelocatedAllocation(ChunkMeshPoolAllocation allocation, OffsetAllocation new_range)
+{
+    return MakePoolAllocation(new_range, allocation.size);
+}
+
+ChunkMeshPoolStats GetChunkMeshPoolStats(ChunkMeshPool *pool)
+{
+    OffsetAllocatorStats stats = GetOffsetAllocatorStats(&pool->allocator);
+
+    return {
+        .capacity=pool->capacity,
+        .used=(s64)stats.used_size * Chunk_Mesh_Pool_Alignment,
+        .largest_free_block=(s64)stats.largest_free_block * Chunk_Mesh_Pool_Alignment,
+        .num_allocations=stats.num_allocations,
+        .num_free_blocks=stats.num_free_blocks,
+        .fragmentation=stats.fragmentation,
+        .num_grows=pool->num_grows,
+        .num_defragmentations=pool->num_defragmentations,
+    };
+}
@@ -0,0 +1,184 @@
+#include "Graphics/Renderer.hpp"
+#include "World.hpp"
+
+ChunkRenderTable g_chunk_render_table;
+
+template<typename T>
+static void SwapRemoveAt(Array<T> *arr, s64 index)
+{
+    Assert(index >= 0 && index < arr->count);
+
+    (*arr)[index] = (*arr)[arr->count - 1];
+    arr->count -= 1;
+}
+
+void InitChunkRenderTable(ChunkRenderTable *table)
+{
+    table->chunks.allocator = TaggedHeap(MemoryTag_Graphics);
+    table->positions.allocator = TaggedHeap(MemoryTag_Graphics);
+    for (int i = 0; i < ChunkMeshType_Count; i += 1)
+        table->draw_ranges[i].allocator = TaggedHeap(MemoryTag_Graphics);
+    table->flags.allocator = TaggedHeap(MemoryTag_Graphics);
+}
+
+void DestroyChunkRenderTable(ChunkRenderTable *table)
+{
+    ArrayFree(&table->chunks);
+    ArrayFree(&table->positions);
+    for (int i = 0; i < ChunkMeshType_Count; i += 1)
+        ArrayFree(&table->draw_ranges[i]);
+    ArrayFree(&table->flags);
+    table->count = 0;
+}
+
+void AddOrUpdateChunkRenderRecord(ChunkRenderTable *table, Chunk *chunk)
+{
+    s64 index = chunk->render_index;
+    if (index < 0)
+    {
+        index = table->count;
+
+        ArrayPush(&table->chunks);
+        ArrayPush(&table->positions);
+        for (int i = 0; i < ChunkMeshType_Count; i += 1)
+            ArrayPush(&table->draw_ranges[i]);
+        ArrayPush(&table->flags, (ChunkRenderFlags)0);
+
+        table->count += 1;
+        chunk->render_index = index;
+    }
+
+    Assert(table->chunks.count == table->count);
+
+    table->chunks[index] = chunk;
+    table->positions[index] = Vec2f{(float)chunk->x * Chunk_Size, (float)chunk->z * Chunk_Size};
+
+    u32 base_vertex = (u32)(Max(chunk->mesh.vertex_allocation.offset, (s64)0) / sizeof(BlockVertex));
+    u32 base_index = (u32)(Max(chunk->mesh.index_allocation.offset, (s64)0) / sizeof(u32));
+    for (int i = 0; i < ChunkMeshType_Count; i += 1)
+    {
+        table->draw_ranges[i][index] = {
+            .vertex_offset=base_vertex + chunk->mesh.mesh_type_vertex_offsets[i],
+            .index_offset=base_index + chunk->mesh.mesh_type_index_offsets[i],
+            .index_count=chunk->mesh.mesh_type_index_counts[i],
+        };
+    }
+}
+
+void RemoveChunkRenderRecord(ChunkRenderTable *table, Chunk *chunk)
+{
+    s64 index = chunk->render_index;
+    if (index < 0)
+        return;
+
+    Assert(index < table->count && table->chunks[index] == chunk);
+
+    s64 last = table->count - 1;
+
+    SwapRemoveAt(&table->chunks, index);
+    SwapRemoveAt(&table->positions, index);
+    for (int i = 0; i < ChunkMeshType_Count; i += 1)
+        SwapRemoveAt(&table->draw_ranges[i], index);
+    SwapRemoveAt(&table->flags, index);
+
+    table->count -= 1;
+    chunk->render_index = -1;
+
+    if (index != last)
+        table->chunks[index]->render_index = index;
+}
+
+void ClearChunkRenderFlags(ChunkRenderTable *table, ChunkRenderFlags flags)
+{
+    for (s64 i = 0; i < table->count; i += 1)
+        table->flags[i] &= ~flags;
+}
+
+void BuildChunkDrawList(ChunkRenderTable *table, ChunkMeshType type, Vec2f camera_position, float max_distance, bool visible_only, Array<s64> *draw_list)
+{
+    ProfileFunction();
+
+    ArrayClear(draw_list);
+    ArrayReserve(draw_list, table->count);
+
+    float max_distance_sqrd = max_distance * max_distance;
+    for (s64 i = 0; i < table->count; i += 1)
+    {
+        if (table->draw_ranges[type][i].index_count == 0)
+            continue;
+
+        if (visible_only && !(table->flags[i] & ChunkRenderFlag_Visible))
+            continue;
+
+        Vec2f diff = table->positions[i] - camera_position;
+        if (diff.x * diff.x + diff.y * diff.y > max_distance_sqrd)
+            continue;
+
+        ArrayPush(draw_list, i);
+    }
+}
+
+ChunkDrawCommands BuildChunkDrawCommands(ChunkRenderTable *table, Slice<s64> draw_lists[ChunkMeshType_Count], u32 instance_count)
+{
+    ProfileFunction();
+
+    ChunkDrawCommands result{};
+
+    s64 total_count = 0;
+    for (int type = 0; type < ChunkMeshType_Count; type += 1)
+    {
+        result.command_counts[type] = (u32)draw_lists[type].count;
+        total_count += draw_lists[type].count;
+    }
+
+    if (total_count <= 0)
+        return result;
+
+    auto commands = Alloc<GfxDrawIndexedIndirectCommand>(total_count, FrameDataAllocator());
+    auto draw_data = Alloc<Std430ChunkDrawData>(total_count, FrameDataAllocator());
+    Assert(commands != null && draw_data != null, "Frame data allocator is full");
+
+    result.commands_buffer = FrameDataBuffer(commands);
+    result.commands_offset = GetBufferOffset(FrameDataGfxAllocator(), commands);
+    result.draw_data_buffer = FrameDataBuffer(draw_data);
+    result.draw_data_offset = GetBufferOffset(FrameDataGfxAllocator(), draw_data);
+    result.draw_data_size = total_count * sizeof(Std430ChunkDrawData);
+
+    s64 draw_index = 0;
+    for (int type = 0; type < ChunkMeshType_Count; type += 1)
+    {
+        foreach (i, draw_lists[type])
+        {
+            s64 index = draw_lists[type][i];
+            ChunkDrawRange range = table->draw_ranges[type][index];
+            Vec2f position = table->positions[index];
+
+            commands[draw_index] = {
+                .index_count=range.index_count,
+                .instance_count=instance_count,
+                .base_index=range.index_offset,
+                .base_vertex=(s32)range.vertex_offset,
+                .base_instance=(u32)draw_index,
+            };
+            result.total_vertex_count += (s64)range.index_count * instance_count;
+            draw_data[draw_index] = {.origin={position.x, 0, position.y}};
+
+            draw_index += 1;
+        }
+    }
+
+    return result;
+}
+
+void DrawChunks(GfxRenderPass *pass, ChunkDrawCommands *commands, ChunkMeshType type)
+{
+    if (commands->command_counts[type] == 0)
+        return;
+
+    s64 offset = commands->commands_offset;
+    for (int i = 0; i < type; i += 1)
+        offset += commands->command_counts[i] * sizeof(GfxDrawIndexedIndirectCommand);
+
+    GfxSetVertexBuffer(pass, Default_Vertex_Buffer_Index, &g_chunk_vertex_pool.buffer, 0, g_chunk_vertex_pool.capacity, sizeof(BlockVertex));
+    GfxDrawIndexedIndirect(pass, &g_chunk_index_pool.buffer, GfxIndexType_Uint32, commands->commands_buffer, offset, commands->command_counts[type]);
+}
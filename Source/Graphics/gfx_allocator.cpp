@@ -0,0 +1,277 @@
+#include "Graphics/Renderer.hpp"
+
+static void *GfxAllocatorCreateBuffer(String name, s64 size, GfxBuffer *buffer)
+{
+    GfxBufferDesc desc{};
+    desc.cpu_access = GfxCpuAccess_Write;
+    desc.size = size;
+    *buffer = GfxCreateBuffer(name, desc);
+    if (IsNull(buffer))
+        return null;
+
+    return GfxMapBuffer(buffer, 0, size, GfxMapAccess_Write);
+}
+
+static void GfxAllocatorDestroyBuffer(GfxBuffer *buffer)
+{
+    GfxUnmapBuffer(buffer);
+    GfxDestroyBuffer(buffer);
+}
+
+GfxAllocatorBackend g_default_gfx_allocator_backend = {
+    .CreateBuffer=GfxAllocatorCreateBuffer,
+    .DestroyBuffer=GfxAllocatorDestroyBuffer,
+    .FlushBuffer=GfxFlushMappedBuffer,
+    .GetBufferAlignment=GfxGetBufferAlignment,
+    .CreateFence=GfxCreateFence,
+    .DestroyFence=GfxDestroyFence,
+    .IsFenceSignaled=GfxIsFenceSignaled,
+};
+
+Allocator MakeAllocator(GfxAllocator *allocator)
+{
+    return {
+        .data=allocator,
+        .func=GfxAllocatorFunc,
+    };
+}
+
+static void CreateAllocatorBuffer(GfxAllocator *allocator, s64 capacity)
+{
+    allocator->capacity = AlignForward(capacity, allocator->alignment);
+    allocator->buffer = Alloc<GfxBuffer>(TaggedHeap(MemoryTag_Graphics));
+    allocator->mapped_ptr = allocator->backend.CreateBuffer(allocator->name, allocator->capacity, allocator->buffer);
+    Assert(allocator->mapped_ptr != null, "Could not create buffer for %.*s (%lld bytes)", FSTR(allocator->name), allocator->capacity);
+
+    allocator->head = 0;
+    allocator->tail = 0;
+    allocator->frame_start = 0;
+    allocator->buffer_first_serial = allocator->current_serial;
+}
+
+static void DestroyAllocatorBuffer(GfxAllocator *allocator, GfxBuffer *buffer)
+{
+    allocator->backend.DestroyBuffer(buffer);
+    Free(buffer, TaggedHeap(MemoryTag_Graphics));
+}
+
+void InitGfxAllocator(GfxAllocator *allocator, String name, s64 capacity, GfxAllocatorBackend *backend)
+{
+    allocator->name = CloneString(name, TaggedHeap(MemoryTag_Graphics));
+    allocator->backend = *backend;
+    allocator->alignment = allocator->backend.GetBufferAlignment();
+    Assert(allocator->alignment > 0);
+
+    allocator->frames.allocator = TaggedHeap(MemoryTag_Graphics);
+    allocator->retired_buffers.allocator = TaggedHeap(MemoryTag_Graphics);
+
+    CreateAllocatorBuffer(allocator, capacity);
+}
+
+void DestroyGfxAllocator(GfxAllocator *allocator)
+{
+    foreach (i, allocator->frames)
+        allocator->backend.DestroyFence(&allocator->frames[i].fence);
+
+    foreach (i, allocator->retired_buffers)
+        DestroyAllocatorBuffer(allocator, allocator->retired_buffers[i].buffer);
+
+    DestroyAllocatorBuffer(allocator, allocator->buffer);
+
+    ArrayFree(&allocator->frames);
+    ArrayFree(&allocator->retired_buffers);
+    Free(allocator->name.data, TaggedHeap(MemoryTag_Graphics));
+
+    *allocator = {};
+}
+
+static void FlushFrame(GfxAllocator *allocator)
+{
+    s64 size = allocator->head - allocator->frame_start;
+    if (size <= 0)
+        return;
+
+    // The frame's allocations may wrap around the end of the buffer
+    s64 offset = allocator->frame_start % allocator->capacity;
+    s64 size_before_end = Min(size, allocator->capacity - offset);
+    allocator->backend.FlushBuffer(allocator->buffer, offset, size_before_end);
+
+    if (size > size_before_end)
+        allocator->backend.FlushBuffer(allocator->buffer, 0, size - size_before_end);
+}
+
+void ReclaimGfxAllocator(GfxAllocator *allocator)
+{
+    // Fences are signaled in the order they were created
+    u64 completed_serial = 0;
+    s64 num_signaled = 0;
+    while (num_signaled < allocator->frames.count && allocator->backend.IsFenceSignaled(&allocator->frames[num_signaled].fence))
+    {
+        GfxAllocatorFrame *frame = &allocator->frames[num_signaled];
+
+        // Frames from before we switched buffers did not allocate in the current one
+        if (frame->serial >= allocator->buffer_first_serial)
+            allocator->tail = frame->end;
+
+        completed_serial = frame->serial;
+        allocator->backend.DestroyFence(&frame->fence);
+        num_signaled += 1;
+    }
+
+    for (s64 i = 0; i < num_signaled; i += 1)
+        ArrayOrderedRemoveAt(&allocator->frames, 0);
+
+    for (s64 i = 0; i < allocator->retired_buffers.count; i += 1)
+    {
+        if (allocator->retired_buffers[i].last_serial > completed_serial)
+            continue;
+
+        DestroyAllocatorBuffer(allocator, allocator->retired_buffers[i].buffer);
+        ArrayOrderedRemoveAt(&allocator->retired_buffers, i);
+        i -= 1;
+    }
+}
+
+void EndGfxAllocatorFrame(GfxAllocator *allocator)
+{
+    FlushFrame(allocator);
+
+    ArrayPush(&allocator->frames, {
+        .serial=allocator->current_serial,
+        .end=allocator->head,
+        .fence=allocator->backend.CreateFence(),
+    });
+
+    allocator->current_serial += 1;
+    allocator->frame_start = allocator->head;
+
+    allocator->last_frame_bytes = allocator->frame_bytes;
+    allocator->max_frame_bytes = Max(allocator->max_frame_bytes, allocator->frame_bytes);
+    allocator->frame_bytes = 0;
+}
+
+static void GrowGfxAllocator(GfxAllocator *allocator, s64 min_size)
+{
+    // The allocations made so far this frame stay in the old buffer, which we
+    // keep alive until the GPU is done with this frame
+    FlushFrame(allocator);
+
+    ArrayPush(&allocator->retired_buffers, {
+        .buffer=allocator->buffer,
+        .mapped_ptr=allocator->mapped_ptr,
+        .capacity=allocator->capacity,
+        .last_serial=allocator->current_serial,
+    });
+
+    s64 old_capacity = allocator->capacity;
+    s64 new_capacity = old_capacity * 2;
+    while (new_capacity < min_size)
+        new_capacity *= 2;
+
+    CreateAllocatorBuffer(allocator, new_capacity);
+    allocator->num_grows += 1;
+
+    LogMessage(Log_Graphics, "Grew %.*s from %lld to %lld bytes", FSTR(allocator->name), old_capacity, new_capacity);
+}
+
+static void *AllocFromRing(GfxAllocator *allocator, s64 size)
+{
+    // Allocations are contiguous in the buffer, so we skip what is left at the end if it is too small
+    s64 offset = allocator->head % allocator->capacity;
+    s64 padding = 0;
+    if (offset + size > allocator->capacity)
+        padding = allocator->capacity - offset;
+
+    s64 end = allocator->head + padding + size;
+    if (end - allocator->tail > allocator->capacity)
+        return null;
+
+    void *ptr = (u8 *)allocator->mapped_ptr + (allocator->head + padding) % allocator->capacity;
+
+    allocator->head = end;
+    allocator->high_water = Max(allocator->high_water, allocator->head - allocator->tail);
+
+    return ptr;
+}
+
+void *GfxAllocatorFunc(AllocatorOp op, s64 size, void *ptr, void *data)
+{
+    GfxAllocator *alloc = (GfxAllocator *)data;
+
+    size = AlignForward(size, alloc->alignment);
+
+    switch (op)
+    {
+    case AllocatorOp_Alloc: {
+        void *ptr = AllocFromRing(alloc, size);
+        if (!ptr)
+        {
+            ReclaimGfxAllocator(alloc);
+            ptr = AllocFromRing(alloc, size);
+        }
+
+        if (!ptr)
+        {
+            GrowGfxAllocator(alloc, size);
+            ptr = AllocFromRing(alloc, size);
+            Assert(ptr != null);
+        }
+
+        alloc->frame_bytes += size;
+
+        return ptr;
+    } break;
+
+    case AllocatorOp_Free: break;
+    }
+
+    return null;
+}
+
+GfxBuffer *GetBuffer(GfxAllocator *allocator, void *ptr)
+{
+    intptr_t diff = (intptr_t)ptr - (intptr_t)allocator->mapped_ptr;
+    if (diff >= 0 && diff < allocator->capacity)
+        return allocator->buffer;
+
+    foreach (i, allocator->retired_buffers)
+    {
+        auto retired = allocator->retired_buffers[i];
+        diff = (intptr_t)ptr - (intptr_t)retired.mapped_ptr;
+        if (diff >= 0 && diff < retired.capacity)
+            return retired.buffer;
+    }
+
+    return null;
+}
+
+s64 GetBufferOffset(GfxAllocator *allocator, void *ptr)
+{
+    intptr_t diff = (intptr_t)ptr - (intptr_t)allocator->mapped_ptr;
+    if (diff >= 0 && diff < allocator->capacity)
+        return (s64)diff;
+
+    foreach (i, allocator->retired_buffers)
+    {
+        auto retired = allocator->retired_buffers[i];
+        diff = (intptr_t)ptr - (intptr_t)retired.mapped_ptr;
+        if (diff >= 0 && diff < retired.capacity)
+            return (s64)diff;
+    }
+
+    return -1;
+}
+
+GfxAllocatorStats GetGfxAllocatorStats(GfxAllocator *allocator)
+{
+    return {
+        .capacity=allocator->capacity,
+        .used=allocator->head - allocator->tail,
+        .high_water=allocator->high_water,
+        .last_frame_bytes=allocator->last_frame_bytes,
+        .max_frame_bytes=allocator->max_frame_bytes,
+        .num_frames_in_flight=(int)allocator->frames.count,
+        .num_retired_buffers=(int)allocator->retired_buffers.count,
+        .num_grows=allocator->num_grows,
+    };
+}
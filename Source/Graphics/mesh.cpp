@@ -5,19 +5,34 @@ struct ChunkMeshUpload
 {
     Array<BlockVertex> vertices[ChunkMeshType_Count] = {};
     Array<u32> indices[ChunkMeshType_Count] = {};
+    Chunk *chunk = null;
     Mesh *mesh = null;
+    s64 size = 0;
+
+    // If not null, the vertices and indices point into the staging ring
+    StagingRingRange staging = {};
 };
 
-// Enough for the maximum needed for two chunks
-#define Chunk_Mesh_Allocator_Capacity (2 * 4 * 6 * (Chunk_Size * Chunk_Size * Chunk_Height * (sizeof(BlockVertex) + sizeof(u32))))
+// Upper bound on the size of one chunk mesh: every face of every block is visible,
+// and each face is 4 vertices and 6 indices (152 bytes, about 57 MiB per chunk)
+#define Chunk_Max_Mesh_Size (6 * Chunk_Size * Chunk_Size * Chunk_Height * (4 * sizeof(BlockVertex) + 6 * sizeof(u32)))
 
-Array<ChunkMeshUpload> g_pending_chunk_mesh_uploads;
-GfxAllocator g_chunk_upload_allocators[Gfx_Max_Frames_In_Flight];
+// Room for two of the largest possible meshes (about 114 MiB). Mesh workers write straight
+// into the ring, and a mesh that does not fit goes through the heap and an extra copy instead.
+// With this size the largest mesh always fits once the ring has drained, and a lot of regular
+// meshes fit at the same time. The buffer is persistently mapped, so this memory is kept for
+// the whole run whether or not chunks are being meshed
+#define Chunk_Staging_Ring_Capacity (2 * Chunk_Max_Mesh_Size)
 
-GfxAllocator *CurrentChunkMeshGfxAllocator()
-{
-    return &g_chunk_upload_allocators[GfxGetBackbufferIndex()];
-}
+#define Chunk_Vertex_Pool_Initial_Capacity (64 * 1024 * 1024)
+#define Chunk_Index_Pool_Initial_Capacity (16 * 1024 * 1024)
+
+Array<ChunkMeshUpload> g_pending_chunk_mesh_uploads;
+StagingRing g_chunk_staging_ring;
+ChunkMeshPool g_chunk_vertex_pool;
+ChunkMeshPool g_chunk_index_pool;
+bool g_defragment_chunk_mesh_pools;
+ChunkUploadStats g_chunk_upload_stats;
 
 union SurroundingBlocks
 {
@@ -178,16 +193,11 @@ static void PushBlockFace(
     }
 }
 
-static void PushBlockVertices(
-    Array<BlockVertex> *vertices, Array<u32> *indices,
-    Block block,
-    Vec3f position,
-    SurroundingBlocks *surroundings
-)
+static BlockFaceFlags GetVisibleBlockFaces(Block block, SurroundingBlocks *surroundings)
 {
     BlockInfo info = Block_Infos[block];
     if (info.mesh_type == ChunkMeshType_Air)
-        return;
+        return 0;
 
     float block_height = GetBlockHeight(surroundings, 0, 0, 0);
 
@@ -205,9 +215,22 @@ static void PushBlockVertices(
     if (Block_Infos[surroundings->bottom].mesh_type != info.mesh_type || GetBlockHeight(surroundings, 0, -1, 0) != 1)
         visible_faces |= BlockFaceFlag_Bottom;
 
+    return visible_faces;
+}
+
+static void PushBlockVertices(
+    Array<BlockVertex> *vertices, Array<u32> *indices,
+    Block block,
+    Vec3f position,
+    SurroundingBlocks *surroundings,
+    BlockFaceFlags visible_faces
+)
+{
     if (!visible_faces || block == Block_Air)
         return;
 
+    float block_height = GetBlockHeight(surroundings, 0, 0, 0);
+
     if (visible_faces & BlockFaceFlag_East)
     {
         int o00 = GetOcclusionFactor(surroundings, BlockFace_East, 0, 0);
@@ -269,261 +292,585 @@ static void PushBlockVertices(
     }
 }
 
-static void AppendChunkMeshUpload(Chunk *chunk, Array<BlockVertex> vertices[ChunkMeshType_Count], Array<u32> indices[ChunkMeshType_Count]);
+static void AppendChunkMeshUpload(Chunk *chunk, Array<BlockVertex> vertices[ChunkMeshType_Count], Array<u32> indices[ChunkMeshType_Count], StagingRingRange staging);
 
-void GenerateChunkMeshWorker(ThreadGroup *group, void *data)
+static void GatherSurroundingBlocks(ChunkNeighborhood *neighborhood, int x, int y, int z, SurroundingBlocks *surroundings)
 {
+    for (int yy = -1; yy <= 1; yy += 1)
+    {
+        for (int zz = -1; zz <= 1; zz += 1)
+        {
+            for (int xx = -1; xx <= 1; xx += 1)
+            {
+                Block block = GetBlockInNeighbors(neighborhood, x + xx, y + yy, z + zz);
+                SetBlock(surroundings, xx, yy, zz, block);
+            }
+        }
+    }
+}
+
+static int CountBlockFaces(BlockFaceFlags faces)
+{
+    int count = 0;
+    for (; faces; faces &= faces - 1)
+        count += 1;
+
+    return count;
+}
+
+void GenerateChunkMeshWorker(void *data)
+{
+    ProfileFunction();
+
     auto work = (ChunkMeshWork *)data;
-    auto chunk = work->chunk;
+    auto neighborhood = &work->neighborhood;
+    auto chunk = neighborhood->chunk;
+
+    // The mesh would be dropped anyway
+    if (__atomic_load_n(&chunk->is_destroyed, __ATOMIC_RELAXED))
+        return;
+
+    // First we find the visible faces of every block, so we know exactly how
+    // much memory the mesh needs before writing any vertex
+    ScratchScope();
+    auto visible_faces = Alloc<BlockFaceFlags>(Chunk_Size * Chunk_Size * Chunk_Height, scratch);
+
+    s64 num_faces[ChunkMeshType_Count] = {};
+
+    for (int y = 0; y < Chunk_Height; y += 1)
+    {
+        for (int z = 0; z < Chunk_Size; z += 1)
+        {
+            for (int x = 0; x < Chunk_Size; x += 1)
+            {
+                int index = y * Chunk_Size * Chunk_Size + z * Chunk_Size + x;
+                visible_faces[index] = 0;
+
+                Block block = GetBlock(chunk, x, y, z);
+                BlockInfo info = Block_Infos[block];
+                if (info.mesh_type == ChunkMeshType_Air)
+                    continue;
+
+                SurroundingBlocks surroundings;
+                GatherSurroundingBlocks(neighborhood, x, y, z, &surroundings);
+
+                BlockFaceFlags faces = GetVisibleBlockFaces(block, &surroundings);
+                if (!faces)
+                    continue;
+
+                visible_faces[index] = faces;
+                num_faces[info.mesh_type] += CountBlockFaces(faces);
+            }
+        }
+    }
 
+    s64 vertices_size = 0;
+    s64 indices_size = 0;
     for (int i = 0; i < ChunkMeshType_Count; i += 1)
     {
-        work->vertices[i].allocator = heap;
-        ArrayReserve(&work->vertices[i], chunk->mesh.vertex_count);
+        vertices_size += num_faces[i] * 4 * sizeof(BlockVertex);
+        indices_size += num_faces[i] * 6 * sizeof(u32);
+    }
+
+    // The mesh is written straight into the staging ring, laid out the way it is
+    // copied to the pools, so the main thread only has to record the copy commands.
+    // The arrays have no allocator so writing more than we counted asserts.
+    // If the ring is full we use the heap and the main thread copies it later
+    work->staging = ReserveStagingRing(&g_chunk_staging_ring, vertices_size + indices_size);
+    if (!IsNull(work->staging))
+    {
+        u8 *ptr = (u8 *)GetStagingRingPointer(&g_chunk_staging_ring, work->staging);
+        for (int i = 0; i < ChunkMeshType_Count; i += 1)
+        {
+            work->vertices[i] = {.data=(BlockVertex *)ptr, .allocated=num_faces[i] * 4};
+            ptr += num_faces[i] * 4 * sizeof(BlockVertex);
+        }
 
-        work->indices[i].allocator = heap;
-        ArrayReserve(&work->indices[i], chunk->mesh.index_count);
+        for (int i = 0; i < ChunkMeshType_Count; i += 1)
+        {
+            work->indices[i] = {.data=(u32 *)ptr, .allocated=num_faces[i] * 6};
+            ptr += num_faces[i] * 6 * sizeof(u32);
+        }
+    }
+    else
+    {
+        for (int i = 0; i < ChunkMeshType_Count; i += 1)
+        {
+            work->vertices[i].allocator = TaggedHeap(MemoryTag_Meshes);
+            ArrayReserve(&work->vertices[i], num_faces[i] * 4);
+
+            work->indices[i].allocator = TaggedHeap(MemoryTag_Meshes);
+            ArrayReserve(&work->indices[i], num_faces[i] * 6);
+        }
     }
 
-    Vec3f chunk_position = Vec3f{(float)chunk->x * Chunk_Size, 0, (float)chunk->z * Chunk_Size};
+    // Vertex positions are relative to the chunk, the origin of the chunk is added in the vertex shader
     for (int y = 0; y < Chunk_Height; y += 1)
     {
         for (int z = 0; z < Chunk_Size; z += 1)
         {
             for (int x = 0; x < Chunk_Size; x += 1)
             {
+                BlockFaceFlags faces = visible_faces[y * Chunk_Size * Chunk_Size + z * Chunk_Size + x];
+                if (!faces)
+                    continue;
+
                 Block block = GetBlock(chunk, x, y, z);
                 BlockInfo info = Block_Infos[block];
-                if (info.mesh_type == ChunkMeshType_Air)
-                    continue;
 
                 SurroundingBlocks surroundings;
-                for (int yy = -1; yy <= 1; yy += 1)
-                {
-                    for (int zz = -1; zz <= 1; zz += 1)
-                    {
-                        for (int xx = -1; xx <= 1; xx += 1)
-                        {
-                            Block block = GetBlockInNeighbors(chunk, x + xx, y + yy, z + zz);
-                            SetBlock(&surroundings, xx, yy, zz, block);
-                        }
-                    }
-                }
-
-                PushBlockVertices(&work->vertices[info.mesh_type], &work->indices[info.mesh_type], block, chunk_position + Vec3f{(float)x, (float)y, (float)z}, &surroundings);
+                GatherSurroundingBlocks(neighborhood, x, y, z, &surroundings);
+
+                PushBlockVertices(&work->vertices[info.mesh_type], &work->indices[info.mesh_type], block, Vec3f{(float)x, (float)y, (float)z}, &surroundings, faces);
             }
         }
     }
+
+    ComputeChunkConnectivity(chunk, work->section_connectivity);
 }
 
-void HandleChunkMeshGeneration(World *world)
+void DropChunkMeshWork(World *world, ChunkMeshWork *work)
 {
-    foreach (i, world->dirty_chunks)
+    // If the worker saw that the chunk was destroyed in time, or the job was dropped
+    // without running, the worker did not allocate anything
+    if (!IsNull(work->staging))
     {
-        auto chunk = world->dirty_chunks[i];
-        if (!chunk->is_generated)
-            continue;
-        if (chunk->east && !chunk->east->is_generated)
-            continue;
-        if (chunk->west && !chunk->west->is_generated)
-            continue;
-        if (chunk->north && !chunk->north->is_generated)
-            continue;
-        if (chunk->south && !chunk->south->is_generated)
-            continue;
+        ReleaseStagingRing(&g_chunk_staging_ring, work->staging, false);
+    }
+    else
+    {
+        for (int j = 0; j < ChunkMeshType_Count; j += 1)
+        {
+            if (work->vertices[j].allocator.func)
+                ArrayFree(&work->vertices[j]);
+            if (work->indices[j].allocator.func)
+                ArrayFree(&work->indices[j]);
+        }
+    }
 
-        auto work = Alloc<ChunkMeshWork>(heap);
-        work->chunk = chunk;
-        AddWork(&world->chunk_mesh_generation_thread_group, work);
+    UnpinChunkNeighborhood(world, &work->neighborhood);
+    Free(work, TaggedHeap(MemoryTag_Meshes));
+}
 
-        ArrayOrderedRemoveAt(&world->dirty_chunks, i);
-        i -= 1;
-    }
+void HandleChunkMeshGeneration(World *world)
+{
+    ProfileFunction();
 
-    auto generated_chunk_meshes = GetCompletedWork(&world->chunk_mesh_generation_thread_group);
-    foreach (i, generated_chunk_meshes)
+    while (auto job = PopCompletedJob(&world->generated_chunk_meshes))
     {
-        auto work = (ChunkMeshWork *)generated_chunk_meshes[i];
+        auto work = (ChunkMeshWork *)job->data;
+
+        world->num_meshing_chunks -= 1;
+
+        Chunk *chunk = GetChunk(world, work->handle);
+        if (!chunk)
+        {
+            // The chunk was destroyed while it was being meshed
+            DropChunkMeshWork(world, work);
+            continue;
+        }
+
+        chunk->mesh.vertex_count = 0;
+        chunk->mesh.index_count = 0;
 
-        work->chunk->mesh.vertex_count = 0;
-        work->chunk->mesh.index_count = 0;
+        memcpy(chunk->section_connectivity, work->section_connectivity, sizeof(work->section_connectivity));
 
         s64 total_vertex_count = 0;
         s64 total_index_count = 0;
         for (int j = 0; j < ChunkMeshType_Count; j += 1)
         {
-            work->chunk->mesh.vertex_count += work->vertices[j].count;
-            work->chunk->mesh.index_count += work->indices[j].count;
+            chunk->mesh.vertex_count += work->vertices[j].count;
+            chunk->mesh.index_count += work->indices[j].count;
         }
 
-        // Recreate buffers if they are too small
-        if (work->chunk->mesh.vertex_count * sizeof(BlockVertex) > (u64)GetDesc(&work->chunk->mesh.vertex_buffer).size)
+        AppendChunkMeshUpload(chunk, work->vertices, work->indices, work->staging);
+
+        chunk->trace.mesh_requested_ns = work->dirty_ns;
+        chunk->trace.mesh_released_ns = job->released_ns;
+        chunk->trace.mesh_start_ns = job->start_ns;
+        chunk->trace.mesh_end_ns = job->end_ns;
+        TraceChunkMeshStaged(chunk);
+
+        // Only one mesh job per chunk is in flight, so meshes cannot be staged out of order
+        if (chunk->mesh_state == ChunkMeshState_MeshingDirty)
         {
-            if (!IsNull(&work->chunk->mesh.vertex_buffer))
-                GfxDestroyBuffer(&work->chunk->mesh.vertex_buffer);
-
-            GfxBufferDesc desc{};
-            desc.size = work->chunk->mesh.vertex_count * sizeof(BlockVertex);
-            desc.usage = GfxBufferUsage_VertexBuffer;
-            work->chunk->mesh.vertex_buffer = GfxCreateBuffer(TPrintf("Chunk %d %d Vertices", work->chunk->x, work->chunk->z), desc);
-            Assert(!IsNull(&work->chunk->mesh.vertex_buffer));
+            chunk->mesh_state = ChunkMeshState_Dirty;
+            ArrayPush(&world->dirty_chunks, chunk->handle);
         }
-
-        if (work->chunk->mesh.index_count * sizeof(u32) > (u64)GetDesc(&work->chunk->mesh.index_buffer).size)
+        else
         {
-            if (!IsNull(&work->chunk->mesh.index_buffer))
-                GfxDestroyBuffer(&work->chunk->mesh.index_buffer);
-
-            GfxBufferDesc desc{};
-            desc.size = work->chunk->mesh.index_count * sizeof(u32);
-            desc.usage = GfxBufferUsage_IndexBuffer;
-            work->chunk->mesh.index_buffer = GfxCreateBuffer(TPrintf("Chunk %d %d Indices", work->chunk->x, work->chunk->z), desc);
-            Assert(!IsNull(&work->chunk->mesh.index_buffer));
+            chunk->mesh_state = ChunkMeshState_UpToDate;
         }
 
-        AppendChunkMeshUpload(work->chunk, work->vertices, work->indices);
+        UnpinChunkNeighborhood(world, &work->neighborhood);
+        Free(work, TaggedHeap(MemoryTag_Meshes));
+    }
+
+    // The mesh job runs once the chunk and the neighbors it has are generated, chunks
+    // queued later mark it dirty again so it gets remeshed with them
+    foreach (i, world->dirty_chunks)
+    {
+        // Destroyed since it was marked dirty
+        auto chunk = GetChunk(world, world->dirty_chunks[i]);
+        if (!chunk)
+            continue;
+
+        Assert(chunk->mesh_state == ChunkMeshState_Dirty);
+
+        chunk->mesh_state = ChunkMeshState_Meshing;
+        world->num_meshing_chunks += 1;
+
+        auto work = Alloc<ChunkMeshWork>(TaggedHeap(MemoryTag_Meshes));
+        work->neighborhood = GetChunkNeighborhood(world, chunk);
+        work->handle = chunk->handle;
+        work->dirty_ns = chunk->trace.dirty_ns;
+        PinChunkNeighborhood(&work->neighborhood);
 
-        Free(work, heap);
+        auto job = &work->job;
+        InitJob(job, GenerateChunkMeshWorker, work, JobPriority_High, &world->generated_chunk_meshes);
+
+        ChunkNeighborhood *neighborhood = &work->neighborhood;
+        Chunk *dependencies[] = {neighborhood->chunk, neighborhood->east, neighborhood->west, neighborhood->north, neighborhood->south};
+        for (int j = 0; j < (int)StaticArraySize(dependencies); j += 1)
+        {
+            if (dependencies[j] && dependencies[j]->generation_job)
+                AddJobDependency(job, dependencies[j]->generation_job);
+        }
+
+        SubmitJob(&world->jobs, job);
     }
+
+    ArrayClear(&world->dirty_chunks);
 }
 
-void CancelChunkMeshUpload(Chunk *chunk)
+static void FreeChunkMeshUpload(ChunkMeshUpload *upload, bool staging_used_by_gpu)
 {
-    foreach (i, g_pending_chunk_mesh_uploads)
+    if (!IsNull(upload->staging))
     {
-        auto upload = g_pending_chunk_mesh_uploads[i];
-        if (upload.mesh == &chunk->mesh)
-        {
-            for (int j = 0; j < ChunkMeshType_Count; i += 1)
-            {
-                ArrayFree(&upload.vertices[j]);
-                ArrayFree(&upload.indices[j]);
-            }
+        ReleaseStagingRing(&g_chunk_staging_ring, upload->staging, staging_used_by_gpu);
+        upload->staging = {};
 
-            ArrayOrderedRemoveAt(&g_pending_chunk_mesh_uploads, i);
-            break;
+        for (int i = 0; i < ChunkMeshType_Count; i += 1)
+        {
+            upload->vertices[i] = {};
+            upload->indices[i] = {};
         }
+
+        return;
+    }
+
+    for (int i = 0; i < ChunkMeshType_Count; i += 1)
+    {
+        ArrayFree(&upload->vertices[i]);
+        ArrayFree(&upload->indices[i]);
     }
 }
 
-void AppendChunkMeshUpload(Chunk *chunk, Array<BlockVertex> vertices[ChunkMeshType_Count], Array<u32> indices[ChunkMeshType_Count])
+static void RemovePendingChunkMeshUpload(s64 index)
 {
-    foreach (i, g_pending_chunk_mesh_uploads)
+    Mesh *mesh = g_pending_chunk_mesh_uploads[index].mesh;
+    mesh->upload_index = -1;
+
+    g_chunk_upload_stats.pending_bytes -= g_pending_chunk_mesh_uploads[index].size;
+
+    s64 last = g_pending_chunk_mesh_uploads.count - 1;
+    if (index != last)
     {
-        auto upload = &g_pending_chunk_mesh_uploads[i];
-        if (upload->mesh == &chunk->mesh)
-        {
-            for (int j = 0; j < ChunkMeshType_Count; j += 1)
-            {
-                ArrayFree(&upload->vertices[j]);
-                ArrayFree(&upload->indices[j]);
+        g_pending_chunk_mesh_uploads[index] = g_pending_chunk_mesh_uploads[last];
+        g_pending_chunk_mesh_uploads[index].mesh->upload_index = index;
+    }
 
-                upload->vertices[j] = vertices[j];
-                upload->indices[j] = indices[j];
-            }
+    ArrayPop(&g_pending_chunk_mesh_uploads);
+    g_chunk_upload_stats.num_pending = g_pending_chunk_mesh_uploads.count;
+}
 
-            upload->mesh->uploaded = false;
+void CancelChunkMeshUpload(Chunk *chunk)
+{
+    s64 index = chunk->mesh.upload_index;
+    if (index < 0)
+        return;
 
-            return;
-        }
+    Assert(g_pending_chunk_mesh_uploads[index].mesh == &chunk->mesh);
+
+    FreeChunkMeshUpload(&g_pending_chunk_mesh_uploads[index], false);
+    RemovePendingChunkMeshUpload(index);
+}
+
+void AppendChunkMeshUpload(Chunk *chunk, Array<BlockVertex> vertices[ChunkMeshType_Count], Array<u32> indices[ChunkMeshType_Count], StagingRingRange staging)
+{
+    s64 size = 0;
+    for (int i = 0; i < ChunkMeshType_Count; i += 1)
+    {
+        size += vertices[i].count * sizeof(BlockVertex);
+        size += indices[i].count * sizeof(u32);
+    }
+
+    ChunkMeshUpload *upload = null;
+    if (chunk->mesh.upload_index >= 0)
+    {
+        // Replace the pending upload, the old mesh is outdated
+        upload = &g_pending_chunk_mesh_uploads[chunk->mesh.upload_index];
+        Assert(upload->mesh == &chunk->mesh);
+
+        FreeChunkMeshUpload(upload, false);
+        g_chunk_upload_stats.pending_bytes -= upload->size;
+    }
+    else
+    {
+        chunk->mesh.upload_index = g_pending_chunk_mesh_uploads.count;
+        upload = ArrayPush(&g_pending_chunk_mesh_uploads);
     }
 
-    ChunkMeshUpload upload{};
     for (int i = 0; i < ChunkMeshType_Count; i += 1)
     {
-        upload.vertices[i] = vertices[i];
-        upload.indices[i] = indices[i];
+        upload->vertices[i] = vertices[i];
+        upload->indices[i] = indices[i];
     }
 
-    upload.mesh = &chunk->mesh;
-    upload.mesh->uploaded = false;
+    upload->chunk = chunk;
+    upload->mesh = &chunk->mesh;
+    upload->size = size;
+    upload->staging = staging;
+    upload->mesh->uploaded = false;
+    RemoveChunkRenderRecord(&g_chunk_render_table, chunk);
 
-    ArrayPush(&g_pending_chunk_mesh_uploads, upload);
+    g_chunk_upload_stats.pending_bytes += size;
+    g_chunk_upload_stats.num_pending = g_pending_chunk_mesh_uploads.count;
 }
 
-void UploadPendingChunkMeshes(GfxCopyPass *pass, int max_uploads)
+struct PendingUploadOrder
 {
-    float time_start = GetTimeInSeconds();
+    float distance_sqrd;
+    s64 index;
+};
 
-    ResetGfxAllocator(CurrentChunkMeshGfxAllocator());
+static int ComparePendingUploadOrder(const void *a, const void *b)
+{
+    float da = ((const PendingUploadOrder *)a)->distance_sqrd;
+    float db = ((const PendingUploadOrder *)b)->distance_sqrd;
 
-    if (g_pending_chunk_mesh_uploads.count <= 0)
-        return;
+    return (da > db) - (da < db);
+}
 
-    int num_uploaded = 0;
-    GfxAllocator *gfx_allocator = CurrentChunkMeshGfxAllocator();
-    Allocator allocator = MakeAllocator(gfx_allocator);
+static int CompareIndicesDecreasing(const void *a, const void *b)
+{
+    s64 ia = *(const s64 *)a;
+    s64 ib = *(const s64 *)b;
 
-    foreach (i, g_pending_chunk_mesh_uploads)
+    return (ia < ib) - (ia > ib);
+}
+
+// Returns false if the mesh was not written by the worker and there is no room
+// in the staging ring to copy it, in which case we try again next frame
+static bool UploadChunkMesh(GfxCopyPass *pass, ChunkMeshUpload *upload)
+{
+    s64 vertices_size = 0;
+    s64 indices_size = 0;
+    for (int j = 0; j < ChunkMeshType_Count; j += 1)
+    {
+        vertices_size += upload->vertices[j].count * sizeof(BlockVertex);
+        indices_size += upload->indices[j].count * sizeof(u32);
+    }
+
+    StagingRingRange staging = upload->staging;
+    if (IsNull(staging) && upload->size > 0)
     {
-        if (num_uploaded >= max_uploads)
-            break;
+        Assert(upload->size <= g_chunk_staging_ring.capacity, "Chunk mesh upload (%lld bytes) does not fit in the staging ring", upload->size);
 
-        auto upload = g_pending_chunk_mesh_uploads[i];
+        staging = ReserveStagingRing(&g_chunk_staging_ring, upload->size);
+        if (IsNull(staging))
+            return false;
 
-        s64 vertices_size = 0;
-        s64 indices_size = 0;
+        u8 *ptr = (u8 *)GetStagingRingPointer(&g_chunk_staging_ring, staging);
         for (int j = 0; j < ChunkMeshType_Count; j += 1)
         {
-            vertices_size += upload.vertices[j].count * sizeof(BlockVertex);
-            indices_size += upload.indices[j].count * sizeof(u32);
+            if (upload->vertices[j].count > 0)
+                memcpy(ptr, upload->vertices[j].data, upload->vertices[j].count * sizeof(BlockVertex));
+            ptr += upload->vertices[j].count * sizeof(BlockVertex);
         }
 
-        s64 total_size = vertices_size + indices_size;
+        for (int j = 0; j < ChunkMeshType_Count; j += 1)
+        {
+            if (upload->indices[j].count > 0)
+                memcpy(ptr, upload->indices[j].data, upload->indices[j].count * sizeof(u32));
+            ptr += upload->indices[j].count * sizeof(u32);
+        }
+    }
 
-        void *ptr = Alloc(total_size, allocator);
-        if (!ptr)
-            continue;
+    FreeChunkMesh(upload->mesh);
 
-        s64 vertices_offset = GetBufferOffset(gfx_allocator, ptr);
-        s64 indices_offset = vertices_offset + vertices_size;
+    upload->mesh->vertex_allocation = AllocFromChunkMeshPool(&g_chunk_vertex_pool, vertices_size, upload->chunk, pass);
+    upload->mesh->index_allocation = AllocFromChunkMeshPool(&g_chunk_index_pool, indices_size, upload->chunk, pass);
 
-        s64 vertices_memcpy_offset = 0;
-        for (int j = 0; j < ChunkMeshType_Count; j += 1)
-        {
-            upload.mesh->mesh_type_vertex_offsets[j] = vertices_memcpy_offset / sizeof(BlockVertex);
+    u32 vertex_offset = 0;
+    u32 index_offset = 0;
+    for (int j = 0; j < ChunkMeshType_Count; j += 1)
+    {
+        upload->mesh->mesh_type_vertex_offsets[j] = vertex_offset;
+        upload->mesh->mesh_type_index_offsets[j] = index_offset;
+        upload->mesh->mesh_type_index_counts[j] = upload->indices[j].count;
 
-            memcpy((u8 *)ptr + vertices_memcpy_offset, upload.vertices[j].data, upload.vertices[j].count * sizeof(BlockVertex));
-            vertices_memcpy_offset += upload.vertices[j].count * sizeof(BlockVertex);
-        }
+        vertex_offset += upload->vertices[j].count;
+        index_offset += upload->indices[j].count;
+    }
 
-        ptr = (u8 *)ptr + vertices_size;
-        s64 indices_memcpy_offset = 0;
-        for (int j = 0; j < ChunkMeshType_Count; j += 1)
-        {
-            upload.mesh->mesh_type_index_offsets[j] = indices_memcpy_offset / sizeof(u32);
-            upload.mesh->mesh_type_index_counts[j] = upload.indices[j].count;
+    if (!IsNull(staging))
+    {
+        FlushStagingRing(&g_chunk_staging_ring, staging);
 
-            memcpy((u8 *)ptr + indices_memcpy_offset, upload.indices[j].data, upload.indices[j].count * sizeof(u32));
-            indices_memcpy_offset += upload.indices[j].count * sizeof(u32);
-        }
+        if (vertices_size > 0)
+            GfxCopyBufferToBuffer(pass, &g_chunk_staging_ring.buffer, staging.offset, &g_chunk_vertex_pool.buffer, upload->mesh->vertex_allocation.offset, vertices_size);
+        if (indices_size > 0)
+            GfxCopyBufferToBuffer(pass, &g_chunk_staging_ring.buffer, staging.offset + vertices_size, &g_chunk_index_pool.buffer, upload->mesh->index_allocation.offset, indices_size);
 
-        for (int j = 0; j < ChunkMeshType_Count; j += 1)
+        // Ranges written by the workers are released with the upload
+        if (IsNull(upload->staging))
+            ReleaseStagingRing(&g_chunk_staging_ring, staging, true);
+    }
+
+    FreeChunkMeshUpload(upload, true);
+
+    upload->mesh->uploaded = true;
+    AddOrUpdateChunkRenderRecord(&g_chunk_render_table, upload->chunk);
+    TraceChunkUploaded(upload->chunk);
+
+    return true;
+}
+
+void UploadPendingChunkMeshes(GfxCopyPass *pass, Vec3f camera_position)
+{
+    ProfileFunction();
+
+    s64 time_start = GetTimeInNanoseconds();
+
+    ReclaimStagingRing(&g_chunk_staging_ring);
+
+    if (g_defragment_chunk_mesh_pools)
+    {
+        DefragmentChunkMeshPool(&g_chunk_vertex_pool, pass);
+        DefragmentChunkMeshPool(&g_chunk_index_pool, pass);
+        g_defragment_chunk_mesh_pools = false;
+    }
+
+    ChunkUploadStats *stats = &g_chunk_upload_stats;
+    stats->num_uploaded = 0;
+    stats->uploaded_bytes = 0;
+    stats->upload_time_ns = 0;
+
+    if (g_pending_chunk_mesh_uploads.count <= 0)
+        return;
+
+    if (stats->backlog_start_ns < 0)
+    {
+        stats->backlog_start_ns = time_start;
+        stats->backlog_num_frames = 0;
+        stats->backlog_num_chunks = 0;
+    }
+
+    stats->backlog_num_frames += 1;
+
+    // Upload the closest chunks first
+    Vec2f camera_xz = {camera_position.x, camera_position.z};
+    auto order = AllocSlice<PendingUploadOrder>(g_pending_chunk_mesh_uploads.count, temp);
+    foreach (i, g_pending_chunk_mesh_uploads)
+    {
+        Chunk *chunk = g_pending_chunk_mesh_uploads[i].chunk;
+        Vec2f center = {(chunk->x + 0.5f) * Chunk_Size, (chunk->z + 0.5f) * Chunk_Size};
+        Vec2f diff = center - camera_xz;
+
+        order[i] = {.distance_sqrd=diff.x * diff.x + diff.y * diff.y, .index=i};
+    }
+
+    qsort(order.data, order.count, sizeof(PendingUploadOrder), ComparePendingUploadOrder);
+
+    s64 byte_budget = (s64)g_settings.chunk_upload_budget_in_mb * 1024 * 1024;
+    s64 time_budget = (s64)(g_settings.chunk_upload_budget_in_ms * 1000000.0);
+
+    // Uploading swap-removes from the pending list, so we collect the
+    // uploads first and remove them from the highest index to the lowest
+    Array<s64> uploaded = {.allocator=temp};
+    foreach (i, order)
+    {
+        ChunkMeshUpload *upload = &g_pending_chunk_mesh_uploads[order[i].index];
+
+        // We always upload at least one mesh so the queue makes progress
+        if (stats->num_uploaded > 0)
         {
-            ArrayFree(&upload.vertices[j]);
-            ArrayFree(&upload.indices[j]);
+            if (stats->uploaded_bytes + upload->size > byte_budget)
+                break;
+            if (GetTimeInNanoseconds() - time_start > time_budget)
+                break;
         }
 
-        GfxCopyBufferToBuffer(pass, &gfx_allocator->buffer, vertices_offset, &upload.mesh->vertex_buffer, 0, vertices_size);
-        GfxCopyBufferToBuffer(pass, &gfx_allocator->buffer, indices_offset, &upload.mesh->index_buffer, 0, indices_size);
+        if (!UploadChunkMesh(pass, upload))
+            continue;
 
-        upload.mesh->uploaded = true;
+        ArrayPush(&uploaded, order[i].index);
 
-        ArrayOrderedRemoveAt(&g_pending_chunk_mesh_uploads, i);
-        i -= 1;
-        num_uploaded += 1;
+        stats->num_uploaded += 1;
+        stats->uploaded_bytes += upload->size;
     }
 
-    FlushGfxAllocator(gfx_allocator);
+    // Sorting the indices in decreasing order makes it safe to swap-remove
+    qsort(uploaded.data, uploaded.count, sizeof(s64), CompareIndicesDecreasing);
+
+    foreach (i, uploaded)
+        RemovePendingChunkMeshUpload(uploaded[i]);
+
+    s64 time_end = GetTimeInNanoseconds();
+    stats->upload_time_ns = time_end - time_start;
+    stats->backlog_num_chunks += stats->num_uploaded;
 
-    float time_end = GetTimeInSeconds();
-    LogMessage(Log_Graphics, "Uploaded %d chunks (%lld pending) in %f s", num_uploaded, g_pending_chunk_mesh_uploads.count, time_end - time_start);
+    if (g_pending_chunk_mesh_uploads.count == 0)
+    {
+        stats->last_drain_ns = time_end - stats->backlog_start_ns;
+        stats->last_drain_num_frames = stats->backlog_num_frames;
+        stats->last_drain_num_chunks = stats->backlog_num_chunks;
+        stats->backlog_start_ns = -1;
+
+        // Most frames upload everything that was queued, only a backlog that took several frames is worth logging
+        if (stats->last_drain_num_frames > 1)
+            LogMessage(Log_Graphics, "Chunk upload backlog drained: %lld chunks in %d frames, %.3f s", stats->last_drain_num_chunks, stats->last_drain_num_frames, stats->last_drain_ns / 1000000000.0);
+    }
+}
+
+static void RelocateChunkMesh(ChunkMeshPool *pool, void *user_data, OffsetAllocation new_range)
+{
+    Chunk *chunk = (Chunk *)user_data;
+    if (pool == &g_chunk_vertex_pool)
+        chunk->mesh.vertex_allocation = GetRelocatedAllocation(chunk->mesh.vertex_allocation, new_range);
+    else
+        chunk->mesh.index_allocation = GetRelocatedAllocation(chunk->mesh.index_allocation, new_range);
+
+    if (chunk->render_index >= 0)
+        AddOrUpdateChunkRenderRecord(&g_chunk_render_table, chunk);
 }
 
 void InitChunkMeshUploader()
 {
-    g_pending_chunk_mesh_uploads.allocator = heap;
+    g_pending_chunk_mesh_uploads.allocator = TaggedHeap(MemoryTag_Uploads);
+
+    InitStagingRing(&g_chunk_staging_ring, "Chunk Staging Ring", Chunk_Staging_Ring_Capacity);
+
+    InitChunkMeshPool(&g_chunk_vertex_pool, "Chunk Vertex Pool", GfxBufferUsage_VertexBuffer, Chunk_Vertex_Pool_Initial_Capacity, RelocateChunkMesh);
+    InitChunkMeshPool(&g_chunk_index_pool, "Chunk Index Pool", GfxBufferUsage_IndexBuffer, Chunk_Index_Pool_Initial_Capacity, RelocateChunkMesh);
+}
+
+// The world has to be destroyed first, it cancels the pending uploads and frees the meshes
+void DestroyChunkMeshUploader()
+{
+    Assert(g_pending_chunk_mesh_uploads.count == 0, "Chunk mesh uploads are still pending");
+
+    ArrayFree(&g_pending_chunk_mesh_uploads);
+
+    DestroyStagingRing(&g_chunk_staging_ring);
 
-    for (int i = 0; i < Gfx_Max_Frames_In_Flight; i += 1)
-        InitGfxAllocator(&g_chunk_upload_allocators[i], TPrintf("Chunk Mesh Allocator %d", i), Chunk_Mesh_Allocator_Capacity);
+    DestroyChunkMeshPool(&g_chunk_vertex_pool);
+    DestroyChunkMeshPool(&g_chunk_index_pool);
+}
+
+void FreeChunkMesh(Mesh *mesh)
+{
+    FreeToChunkMeshPool(&g_chunk_vertex_pool, &mesh->vertex_allocation);
+    FreeToChunkMeshPool(&g_chunk_index_pool, &mesh->index_allocation);
 }
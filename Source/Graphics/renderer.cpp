@@ -2,20 +2,13 @@
 #include "World.hpp"
 #include "UI.hpp"
 
-#define Max_Chunk_Upload_Per_Frame 50
-
-static GfxAllocator g_frame_data_allocators[Gfx_Max_Frames_In_Flight];
+static GfxAllocator g_frame_data_allocator;
 
 bool g_show_debug_atlas = false;
 
 GfxAllocator *FrameDataGfxAllocator()
 {
-    return &g_frame_data_allocators[GfxGetBackbufferIndex()];
-}
-
-GfxBuffer *FrameDataBuffer()
-{
-    return &FrameDataGfxAllocator()->buffer;
+    return &g_frame_data_allocator;
 }
 
 Allocator FrameDataAllocator()
@@ -23,126 +16,139 @@ Allocator FrameDataAllocator()
     return MakeAllocator(FrameDataGfxAllocator());
 }
 
-Allocator MakeAllocator(GfxAllocator *allocator)
+GfxBuffer *FrameDataBuffer(void *ptr)
 {
-    return {
-        .data=allocator,
-        .func=GfxAllocatorFunc,
-    };
+    return GetBuffer(FrameDataGfxAllocator(), ptr);
 }
 
-void InitGfxAllocator(GfxAllocator *allocator, String name, s64 capacity)
-{
-    GfxBufferDesc desc{};
-    desc.cpu_access = GfxCpuAccess_Write;
-    desc.size = capacity;
-    allocator->buffer = GfxCreateBuffer(name, desc);
-    Assert(!IsNull(&allocator->buffer));
-
-    allocator->capacity = capacity;
-    allocator->mapped_ptr = GfxMapBuffer(&allocator->buffer, 0, capacity, GfxMapAccess_Write);
-    Assert(allocator->mapped_ptr != null);
-}
+#define Frame_Data_Allocator_Capacity (4 * 1024 * 1024)
 
-void FlushGfxAllocator(GfxAllocator *allocator)
+struct PostProcessingBindings
 {
-    GfxFlushMappedBuffer(&allocator->buffer, 0, allocator->top);
-}
+    GfxPipelineBinding fragment_main_texture;
+};
 
-void ResetGfxAllocator(GfxAllocator *allocator)
+struct ChunkBindings
 {
-    allocator->top = 0;
-}
-
-s64 GetBufferOffset(GfxAllocator *allocator, void *ptr)
-{
-    ptrdiff_t diff = (intptr_t)ptr - (intptr_t)allocator->mapped_ptr;
-    if (diff < 0 || diff > allocator->capacity)
-        return -1;
-
-    return (s64)diff;
-}
-
-void *GfxAllocatorFunc(AllocatorOp op, s64 size, void *ptr, void *data)
-{
-    GfxAllocator *alloc = (GfxAllocator *)data;
-
-    size = AlignForward(size, GfxGetBufferAlignment());
-
-    switch (op)
-    {
-    case AllocatorOp_Alloc: {
-        if (alloc->top + size > alloc->capacity)
-            return null;
-
-        void *ptr = (u8 *)alloc->mapped_ptr + alloc->top;
-        alloc->top += size;
-
-        return ptr;
-    } break;
-
-    case AllocatorOp_Free: break;
-    }
-
-    return null;
-}
-
-#define Frame_Data_Allocator_Capacity (1 * 1024 * 1024)
+    GfxPipelineBinding vertex_frame_info;
+    GfxPipelineBinding vertex_chunk_draw_data;
+    GfxPipelineBinding fragment_frame_info;
+    GfxPipelineBinding fragment_block_atlas;
+    GfxPipelineBinding fragment_shadow_map;
+    GfxPipelineBinding fragment_shadow_map_noise;
+    GfxPipelineBinding fragment_sky_transmittance_LUT;
+    GfxPipelineBinding fragment_sky_color_LUT;
+};
 
 static GfxPipelineState g_post_processing_pipeline;
+static PostProcessingBindings g_post_processing_bindings;
 static GfxPipelineState g_chunk_pipeline;
+static ChunkBindings g_chunk_bindings;
 GfxTexture g_main_color_texture;
 GfxTexture g_main_depth_texture;
 GfxSamplerState g_linear_sampler;
 GfxSamplerState g_block_sampler;
 
 void InitChunkMeshUploader();
+void DestroyChunkMeshUploader();
 
-Slice<GfxVertexInputDesc> MakeBlockVertexLayout()
-{
-    Array<GfxVertexInputDesc> vertex_layout = {.allocator=heap};
-    ArrayPush(&vertex_layout, {
+// Pipelines keep a pointer to their vertex layout, so it is not allocated
+static GfxVertexInputDesc g_block_vertex_layout[] = {
+    {
         .format=GfxVertexFormat_Float3,
         .offset=offsetof(BlockVertex, position),
         .stride=sizeof(BlockVertex),
         .buffer_index=Default_Vertex_Buffer_Index
-    });
-    ArrayPush(&vertex_layout, {
+    },
+    {
         .format=GfxVertexFormat_UInt,
         .offset=offsetof(BlockVertex, block),
         .stride=sizeof(BlockVertex),
         .buffer_index=Default_Vertex_Buffer_Index
-    });
-    ArrayPush(&vertex_layout, {
+    },
+    {
         .format=GfxVertexFormat_UInt,
         .offset=offsetof(BlockVertex, block_face),
         .stride=sizeof(BlockVertex),
         .buffer_index=Default_Vertex_Buffer_Index
-    });
-    ArrayPush(&vertex_layout, {
+    },
+    {
         .format=GfxVertexFormat_UInt,
         .offset=offsetof(BlockVertex, block_corner),
         .stride=sizeof(BlockVertex),
         .buffer_index=Default_Vertex_Buffer_Index
-    });
-    ArrayPush(&vertex_layout, {
+    },
+    {
         .format=GfxVertexFormat_UInt,
         .offset=offsetof(BlockVertex, occlusion),
         .stride=sizeof(BlockVertex),
         .buffer_index=Default_Vertex_Buffer_Index
-    });
+    },
+};
 
-    return MakeSlice(vertex_layout);
+Slice<GfxVertexInputDesc> MakeBlockVertexLayout()
+{
+    return {.count=(s64)StaticArraySize(g_block_vertex_layout), .data=g_block_vertex_layout};
+}
+
+RendererMetrics g_renderer_metrics;
+
+static void InitRendererMetrics()
+{
+    RendererMetrics *m = &g_renderer_metrics;
+
+    m->chunk_pass_draws = RegisterGauge("render.chunks.draws");
+    m->chunk_pass_vertices = RegisterGauge("render.chunks.vertices");
+    m->shadow_map_pass_draws = RegisterGauge("render.shadow_map.draws");
+    m->shadow_map_pass_vertices = RegisterGauge("render.shadow_map.vertices");
+
+    m->pending_uploads = RegisterGauge("uploads.pending");
+    m->pending_upload_bytes = RegisterGauge("uploads.pending_bytes");
+    m->uploaded_chunks = RegisterCounter("uploads.chunks");
+    m->uploaded_bytes = RegisterCounter("uploads.bytes");
+
+    m->frame_data_high_water = RegisterGauge("memory.frame_data.high_water");
+    m->staging_ring_high_water = RegisterGauge("memory.staging_ring.high_water");
+    m->staging_ring_failed_reservations = RegisterGauge("memory.staging_ring.failed_reservations");
+    m->vertex_pool_used = RegisterGauge("memory.vertex_pool.used");
+    m->vertex_pool_capacity = RegisterGauge("memory.vertex_pool.capacity");
+    m->index_pool_used = RegisterGauge("memory.index_pool.used");
+    m->index_pool_capacity = RegisterGauge("memory.index_pool.capacity");
+}
+
+static void PublishRendererMetrics()
+{
+    RendererMetrics *m = &g_renderer_metrics;
+
+    MetricSet(m->pending_uploads, g_chunk_upload_stats.num_pending);
+    MetricSet(m->pending_upload_bytes, g_chunk_upload_stats.pending_bytes);
+    MetricAdd(m->uploaded_chunks, g_chunk_upload_stats.num_uploaded);
+    MetricAdd(m->uploaded_bytes, g_chunk_upload_stats.uploaded_bytes);
+
+    MetricSet(m->frame_data_high_water, GetGfxAllocatorStats(FrameDataGfxAllocator()).high_water);
+    StagingRingStats staging_ring = GetStagingRingStats(&g_chunk_staging_ring);
+    MetricSet(m->staging_ring_high_water, staging_ring.high_water);
+    MetricSet(m->staging_ring_failed_reservations, staging_ring.num_failed_reservations);
+
+    ChunkMeshPoolStats vertex_pool = GetChunkMeshPoolStats(&g_chunk_vertex_pool);
+    MetricSet(m->vertex_pool_used, vertex_pool.used);
+    MetricSet(m->vertex_pool_capacity, vertex_pool.capacity);
+
+    ChunkMeshPoolStats index_pool = GetChunkMeshPoolStats(&g_chunk_index_pool);
+    MetricSet(m->index_pool_used, index_pool.used);
+    MetricSet(m->index_pool_capacity, index_pool.capacity);
 }
 
 void InitRenderer()
 {
+    InitRendererMetrics();
+
     LoadAllTextures();
 
-    for (int i = 0; i < Gfx_Max_Frames_In_Flight; i += 1)
-        InitGfxAllocator(&g_frame_data_allocators[i], TPrintf("Frame Data Allocator %d", i), Frame_Data_Allocator_Capacity);
+    InitGfxAllocator(&g_frame_data_allocator, "Frame Data Allocator", Frame_Data_Allocator_Capacity);
 
     InitChunkMeshUploader();
+    InitChunkRenderTable(&g_chunk_render_table);
 
     InitShadowMap();
 
@@ -154,6 +160,8 @@ void InitRenderer()
 
         g_post_processing_pipeline = GfxCreatePipelineState("Post Processing", pipeline_desc);
         Assert(!IsNull(&g_post_processing_pipeline));
+
+        g_post_processing_bindings.fragment_main_texture = GfxGetFragmentStageBinding(&g_post_processing_pipeline, "main_texture");
     }
 
     {
@@ -169,6 +177,16 @@ void InitRenderer()
 
         g_chunk_pipeline = GfxCreatePipelineState("Chunk", pipeline_desc);
         Assert(!IsNull(&g_chunk_pipeline));
+
+        auto bindings = &g_chunk_bindings;
+        bindings->vertex_frame_info = GfxGetVertexStageBinding(&g_chunk_pipeline, "frame_info_buffer");
+        bindings->vertex_chunk_draw_data = GfxGetVertexStageBinding(&g_chunk_pipeline, "chunk_draw_buffer");
+        bindings->fragment_frame_info = GfxGetFragmentStageBinding(&g_chunk_pipeline, "frame_info_buffer");
+        bindings->fragment_block_atlas = GfxGetFragmentStageBinding(&g_chunk_pipeline, "block_atlas");
+        bindings->fragment_shadow_map = GfxGetFragmentStageBinding(&g_chunk_pipeline, "shadow_map");
+        bindings->fragment_shadow_map_noise = GfxGetFragmentStageBinding(&g_chunk_pipeline, "shadow_map_noise");
+        bindings->fragment_sky_transmittance_LUT = GfxGetFragmentStageBinding(&g_chunk_pipeline, "sky_transmittance_LUT");
+        bindings->fragment_sky_color_LUT = GfxGetFragmentStageBinding(&g_chunk_pipeline, "sky_color_LUT");
     }
 
     {
@@ -191,6 +209,30 @@ void InitRenderer()
     }
 }
 
+// The world has to be destroyed first, its chunks hold meshes in the chunk mesh pools
+void DestroyRenderer()
+{
+    GfxDestroyPipelineState(&g_post_processing_pipeline);
+    GfxDestroyPipelineState(&g_chunk_pipeline);
+    GfxDestroySamplerState(&g_linear_sampler);
+    GfxDestroySamplerState(&g_block_sampler);
+
+    if (!IsNull(&g_main_color_texture))
+        GfxDestroyTexture(&g_main_color_texture);
+    if (!IsNull(&g_main_depth_texture))
+        GfxDestroyTexture(&g_main_depth_texture);
+
+    DestroySky();
+    DestroyShadowMap();
+
+    DestroyChunkRenderTable(&g_chunk_render_table);
+    DestroyChunkMeshUploader();
+
+    DestroyGfxAllocator(&g_frame_data_allocator);
+
+    DestroyAllTextures();
+}
+
 static void RecreateRenderTargets()
 {
     int width, height;
@@ -233,10 +275,12 @@ static void RecreateRenderTargets()
 }
 
 void HandleChunkMeshGeneration(World *world);
-void UploadPendingChunkMeshes(GfxCopyPass *pass, int max_uploads);
+void UploadPendingChunkMeshes(GfxCopyPass *pass, Vec3f camera_position);
 
 void RenderGraphics(World *world)
 {
+    ProfileFunction();
+
     FrameRenderContext ctx = {};
     ctx.world = world;
 
@@ -249,7 +293,7 @@ void RenderGraphics(World *world)
     GfxCommandBuffer cmd_buffer = GfxCreateCommandBuffer("Frame");
     ctx.cmd_buffer = &cmd_buffer;
 
-    ResetGfxAllocator(FrameDataGfxAllocator());
+    ReclaimGfxAllocator(FrameDataGfxAllocator());
 
     HandleChunkMeshGeneration(world);
 
@@ -257,10 +301,17 @@ void RenderGraphics(World *world)
 
     GfxCopyPass upload_pass = GfxBeginCopyPass("Upload", ctx.cmd_buffer);
     {
-        UploadPendingChunkMeshes(&upload_pass, Max_Chunk_Upload_Per_Frame);
+        UploadPendingChunkMeshes(&upload_pass, world->camera.position);
     }
     GfxEndCopyPass(&upload_pass);
 
+    // Staging ranges released during the uploads can be reused once this is signaled
+    SignalStagingRing(&g_chunk_staging_ring);
+
+    // Done after the uploads so chunks that were just uploaded are visible this frame
+    if (g_settings.connectivity_culling)
+        UpdateChunkVisibility(world, world->camera.position, g_settings.render_distance * Chunk_Size);
+
     Vec3f sun_direction = -SphericalToCartesian(world->sun_azimuth, world->sun_polar);
     ctx.frame_info = Alloc<Std140FrameInfo>(FrameDataAllocator());
     *ctx.frame_info = {
@@ -324,6 +375,7 @@ void RenderGraphics(World *world)
         },
     };
     Assert(ctx.frame_info != null);
+    ctx.frame_info_buffer = FrameDataBuffer(ctx.frame_info);
     ctx.frame_info_offset = GetBufferOffset(FrameDataGfxAllocator(), ctx.frame_info);
 
     ShadowMapPass(&ctx);
@@ -337,62 +389,60 @@ void RenderGraphics(World *world)
         GfxClearColor(&pass_desc, 0, {0.106, 0.478, 0.82,1});
         GfxClearDepth(&pass_desc, 1);
 
+        ProfileZone("Chunks");
+
         auto pass = GfxBeginRenderPass("Chunks", ctx.cmd_buffer, pass_desc);
         {
             GfxSetViewport(&pass, {.width=(float)window_w, .height=(float)window_h});
             GfxSetPipelineState(&pass, &g_chunk_pipeline);
 
-            auto vertex_frame_info = GfxGetVertexStageBinding(&g_chunk_pipeline, "frame_info_buffer");
-            auto fragment_frame_info = GfxGetFragmentStageBinding(&g_chunk_pipeline, "frame_info_buffer");
-            auto fragment_block_atlas = GfxGetFragmentStageBinding(&g_chunk_pipeline, "block_atlas");
-            auto fragment_shadow_map = GfxGetFragmentStageBinding(&g_chunk_pipeline, "shadow_map");
-            auto fragment_shadow_map_noise = GfxGetFragmentStageBinding(&g_chunk_pipeline, "shadow_map_noise");
-            auto fragment_sky_transmittance_LUT = GfxGetFragmentStageBinding(&g_chunk_pipeline, "sky_transmittance_LUT");
-            auto fragment_sky_color_LUT = GfxGetFragmentStageBinding(&g_chunk_pipeline, "sky_color_LUT");
+            auto bindings = &g_chunk_bindings;
 
-            GfxSetBuffer(&pass, vertex_frame_info, FrameDataBuffer(), ctx.frame_info_offset, sizeof(Std140FrameInfo));
-            GfxSetBuffer(&pass, fragment_frame_info, FrameDataBuffer(), ctx.frame_info_offset, sizeof(Std140FrameInfo));
+            GfxSetBuffer(&pass, bindings->vertex_frame_info, ctx.frame_info_buffer, ctx.frame_info_offset, sizeof(Std140FrameInfo));
+            GfxSetBuffer(&pass, bindings->fragment_frame_info, ctx.frame_info_buffer, ctx.frame_info_offset, sizeof(Std140FrameInfo));
 
             if (g_show_debug_atlas)
-                GfxSetTexture(&pass, fragment_block_atlas, &g_debug_block_face_atlas);
+                GfxSetTexture(&pass, bindings->fragment_block_atlas, &g_debug_block_face_atlas);
             else
-                GfxSetTexture(&pass, fragment_block_atlas, &g_block_atlas);
+                GfxSetTexture(&pass, bindings->fragment_block_atlas, &g_block_atlas);
 
-            GfxSetSamplerState(&pass, fragment_block_atlas, &g_block_sampler);
+            GfxSetSamplerState(&pass, bindings->fragment_block_atlas, &g_block_sampler);
 
-            GfxSetTexture(&pass, fragment_shadow_map, &g_shadow_map_texture);
-            GfxSetSamplerState(&pass, fragment_shadow_map, &g_shadow_map_sampler);
+            GfxSetTexture(&pass, bindings->fragment_shadow_map, &g_shadow_map_texture);
+            GfxSetSamplerState(&pass, bindings->fragment_shadow_map, &g_shadow_map_sampler);
 
-            GfxSetTexture(&pass, fragment_shadow_map_noise, &g_shadow_map_noise_texture);
-            GfxSetSamplerState(&pass, fragment_shadow_map_noise, &g_shadow_map_noise_sampler);
+            GfxSetTexture(&pass, bindings->fragment_shadow_map_noise, &g_shadow_map_noise_texture);
+            GfxSetSamplerState(&pass, bindings->fragment_shadow_map_noise, &g_shadow_map_noise_sampler);
 
-            GfxSetTexture(&pass, fragment_sky_transmittance_LUT, &g_sky.transmittance_LUT);
-            GfxSetSamplerState(&pass, fragment_sky_transmittance_LUT, &g_sky_LUT_sampler);
+            GfxSetTexture(&pass, bindings->fragment_sky_transmittance_LUT, &g_sky.transmittance_LUT);
+            GfxSetSamplerState(&pass, bindings->fragment_sky_transmittance_LUT, &g_sky_LUT_sampler);
+
+            GfxSetTexture(&pass, bindings->fragment_sky_color_LUT, &g_sky.color_LUT);
+            GfxSetSamplerState(&pass, bindings->fragment_sky_color_LUT, &g_sky_color_LUT_sampler);
+
+            ChunkRenderTable *table = &g_chunk_render_table;
+            Vec2f camera_position = Vec2f{world->camera.position.x, world->camera.position.z};
+
+            Slice<s64> draw_lists[ChunkMeshType_Count] = {};
+            for (int type = 0; type < ChunkMeshType_Count; type += 1)
+            {
+                Array<s64> draw_list = {.allocator=temp};
+                BuildChunkDrawList(table, (ChunkMeshType)type, camera_position, g_settings.render_distance * Chunk_Size, g_settings.connectivity_culling, &draw_list);
+                draw_lists[type] = MakeSlice(draw_list);
+            }
 
-            GfxSetTexture(&pass, fragment_sky_color_LUT, &g_sky.color_LUT);
-            GfxSetSamplerState(&pass, fragment_sky_color_LUT, &g_sky_color_LUT_sampler);
+            ChunkDrawCommands commands = BuildChunkDrawCommands(table, draw_lists, 1);
+            GfxSetBuffer(&pass, bindings->vertex_chunk_draw_data, commands.draw_data_buffer, commands.draw_data_offset, commands.draw_data_size);
 
+            s64 num_draws = 0;
             for (int type = 0; type < ChunkMeshType_Count; type += 1)
             {
-                foreach (i, world->all_chunks)
-                {
-                    auto chunk = world->all_chunks[i];
-                    if (!chunk->mesh.uploaded)
-                        continue;
-
-                    Vec2f chunk_position = Vec2f{(float)chunk->x * Chunk_Size, (float)chunk->z * Chunk_Size};
-                    Vec2f camera_position = Vec2f{world->camera.position.x, world->camera.position.z};
-                    if (Length(camera_position - chunk_position) > g_settings.render_distance * Chunk_Size)
-                        continue;
-
-                    GfxSetVertexBuffer(&pass, Default_Vertex_Buffer_Index, &chunk->mesh.vertex_buffer, 0, sizeof(BlockVertex) * chunk->mesh.vertex_count, sizeof(BlockVertex));
-
-                    u32 vertex_offset = chunk->mesh.mesh_type_vertex_offsets[type];
-                    u32 index_offset = chunk->mesh.mesh_type_index_offsets[type];
-                    u32 index_count = chunk->mesh.mesh_type_index_counts[type];
-                    GfxDrawIndexedPrimitives(&pass, &chunk->mesh.index_buffer, index_count, GfxIndexType_Uint32, 1, vertex_offset, index_offset, (u32)i);
-                }
+                DrawChunks(&pass, &commands, (ChunkMeshType)type);
+                num_draws += commands.command_counts[type];
             }
+
+            MetricSet(g_renderer_metrics.chunk_pass_draws, num_draws);
+            MetricSet(g_renderer_metrics.chunk_pass_vertices, commands.total_vertex_count);
         }
         GfxEndRenderPass(&pass);
     }
@@ -403,14 +453,15 @@ void RenderGraphics(World *world)
         GfxRenderPassDesc pass_desc{};
         GfxSetColorAttachment(&pass_desc, 0, GfxGetSwapchainTexture());
 
+        ProfileZone("Post Processing");
+
         auto pass = GfxBeginRenderPass("Post Processing", ctx.cmd_buffer, pass_desc);
         {
             GfxSetViewport(&pass, {.width=(float)window_w, .height=(float)window_h});
             GfxSetPipelineState(&pass, &g_post_processing_pipeline);
 
-            auto fragment_main_texture = GfxGetFragmentStageBinding(&g_post_processing_pipeline, "main_texture");
-            GfxSetTexture(&pass, fragment_main_texture, &g_main_color_texture);
-            GfxSetSamplerState(&pass, fragment_main_texture, &g_linear_sampler);
+            GfxSetTexture(&pass, g_post_processing_bindings.fragment_main_texture, &g_main_color_texture);
+            GfxSetSamplerState(&pass, g_post_processing_bindings.fragment_main_texture, &g_linear_sampler);
 
             GfxDrawPrimitives(&pass, 6, 1);
         }
@@ -419,7 +470,15 @@ void RenderGraphics(World *world)
 
     UIRenderPass(&ctx);
 
-    GfxExecuteCommandBuffer(ctx.cmd_buffer);
+    {
+        ProfileZone("Submit");
+
+        GfxExecuteCommandBuffer(ctx.cmd_buffer);
+
+        EndGfxAllocatorFrame(FrameDataGfxAllocator());
+
+        GfxSubmitFrame();
+    }
 
-    GfxSubmitFrame();
+    PublishRendererMetrics();
 }
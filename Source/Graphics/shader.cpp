@@ -16,7 +16,9 @@ static bool LoadShader(ShaderFile *file)
 {
     file->stages = 0;
 
-    if (Gfx_Backend == GfxBackend_OpenGL)
+    // The null backend does not compile anything, but loads the OpenGL shaders
+    // so that every shader file has the same stages as with a real backend
+    if (Gfx_Backend == GfxBackend_OpenGL || Gfx_Backend == GfxBackend_Null)
     {
         bool has_vertex = false;
         String vert_filename = TPrintf("Shaders/OpenGL/%.*s.vert.glsl", file->name.length, file->name.data);
@@ -25,13 +27,17 @@ static bool LoadShader(ShaderFile *file)
             has_vertex = true;
 
             ShaderPreprocessor pp{};
-            if (!InitShaderPreprocessor(&pp, vert_filename))
+            bool pp_ok = InitShaderPreprocessor(&pp, vert_filename);
+            defer(DestroyShaderPreprocessor(&pp));
+            if (!pp_ok)
                 return false;
 
             auto pp_result = PreprocessShader(&pp);
             if (!pp_result.ok)
                 return false;
 
+            defer(FreeShaderPreprocessResult(&pp_result));
+
             GfxShader shader = GfxLoadShader(file->name, pp_result.source_code, GfxPipelineStage_Vertex);
             if (IsNull(&shader))
                 return false;
@@ -52,13 +58,17 @@ static bool LoadShader(ShaderFile *file)
             has_fragment = true;
 
             ShaderPreprocessor pp{};
-            if (!InitShaderPreprocessor(&pp, frag_filename))
+            bool pp_ok = InitShaderPreprocessor(&pp, frag_filename);
+            defer(DestroyShaderPreprocessor(&pp));
+            if (!pp_ok)
                 return false;
 
             auto pp_result = PreprocessShader(&pp);
             if (!pp_result.ok)
                 return false;
 
+            defer(FreeShaderPreprocessResult(&pp_result));
+
             GfxShader shader = GfxLoadShader(file->name, pp_result.source_code, GfxPipelineStage_Fragment);
             if (IsNull(&shader))
                 return false;
@@ -101,6 +111,16 @@ void LoadAllShaders()
     }
 }
 
+void UnloadAllShaders()
+{
+    for (int i = 0; i < (int)StaticArraySize(g_shader_files); i += 1)
+    {
+        GfxDestroyShader(&g_shader_files[i].vertex_shader);
+        GfxDestroyShader(&g_shader_files[i].fragment_shader);
+        g_shader_files[i].stages = 0;
+    }
+}
+
 GfxShader *GetVertexShader(String name)
 {
     for (int i = 0; i < (int)StaticArraySize(g_shader_files); i += 1)
@@ -94,8 +94,9 @@ static Result<String> ParseStringLiteral(Lexer *lexer)
     if (!MatchString(lexer, "\""))
         return Result<String>::Bad(false);
 
+    // Only AddFile reads the result, and it clones the filename it keeps
     Array<char> result = {};
-    result.allocator = heap;
+    result.allocator = temp;
 
     while (!IsAtEnd(lexer))
     {
@@ -248,3 +249,13 @@ ShaderPreprocessResult PreprocessShader(ShaderPreprocessor *pp)
 
     return result;
 }
+
+void FreeShaderPreprocessResult(ShaderPreprocessResult *result)
+{
+    foreach (i, result->all_loaded_files)
+        Free(result->all_loaded_files[i].data, heap);
+
+    Free(result->all_loaded_files.data, heap);
+    Free(result->source_code.data, heap);
+    *result = {};
+}
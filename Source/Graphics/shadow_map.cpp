@@ -45,7 +45,8 @@ void InitShadowMap()
     RNG rng = {};
     RandomSeed(&rng, 348967956);
 
-    Vec4f *noise_pixels = Alloc<Vec4f>(Shadow_Map_Noise_Size * Shadow_Map_Noise_Size * Shadow_Map_Num_Filtering_Samples, heap);
+    Vec4f *noise_pixels = Alloc<Vec4f>(Shadow_Map_Noise_Size * Shadow_Map_Noise_Size * Shadow_Map_Num_Filtering_Samples, TaggedHeap(MemoryTag_Graphics));
+    defer(Free(noise_pixels, TaggedHeap(MemoryTag_Graphics)));
     for (int i = 0; i < Shadow_Map_Num_Filtering_Samples; i += 1)
     {
         for (int y = 0; y < Shadow_Map_Noise_Size; y += 1)
@@ -109,7 +110,14 @@ void RecreateShadowMapTexture(u32 resolution)
     g_shadow_map_texture = GfxCreateTexture("Shadow Map", desc);
 }
 
+struct ShadowMapBindings
+{
+    GfxPipelineBinding vertex_frame_info;
+    GfxPipelineBinding vertex_chunk_draw_data;
+};
+
 static GfxPipelineState g_shadow_map_pipeline;
+static ShadowMapBindings g_shadow_map_bindings;
 
 static void InitShadowMapPipeline()
 {
@@ -119,10 +127,26 @@ static void InitShadowMapPipeline()
     desc.vertex_shader = GetVertexShader("shadow_map_geometry");
     desc.vertex_layout = MakeBlockVertexLayout();
     g_shadow_map_pipeline = GfxCreatePipelineState("Shadow Map", desc);
+
+    g_shadow_map_bindings.vertex_frame_info = GfxGetVertexStageBinding(&g_shadow_map_pipeline, "frame_info_buffer");
+    g_shadow_map_bindings.vertex_chunk_draw_data = GfxGetVertexStageBinding(&g_shadow_map_pipeline, "chunk_draw_buffer");
+}
+
+void DestroyShadowMap()
+{
+    if (!IsNull(&g_shadow_map_pipeline))
+        GfxDestroyPipelineState(&g_shadow_map_pipeline);
+
+    GfxDestroyTexture(&g_shadow_map_texture);
+    GfxDestroyTexture(&g_shadow_map_noise_texture);
+    GfxDestroySamplerState(&g_shadow_map_sampler);
+    GfxDestroySamplerState(&g_shadow_map_noise_sampler);
 }
 
 void ShadowMapPass(FrameRenderContext *ctx)
 {
+    ProfileFunction();
+
     if (IsNull(&g_shadow_map_pipeline))
     {
         InitShadowMapPipeline();
@@ -140,23 +164,24 @@ void ShadowMapPass(FrameRenderContext *ctx)
         GfxSetPipelineState(&pass, &g_shadow_map_pipeline);
         GfxSetViewport(&pass, {.width=(float)resolution, .height=(float)resolution});
 
-        auto vertex_frame_info = GfxGetVertexStageBinding(&g_shadow_map_pipeline, "frame_info_buffer");
+        GfxSetBuffer(&pass, g_shadow_map_bindings.vertex_frame_info, ctx->frame_info_buffer, ctx->frame_info_offset, sizeof(Std140FrameInfo));
 
-        GfxSetBuffer(&pass, vertex_frame_info, FrameDataBuffer(), ctx->frame_info_offset, sizeof(Std140FrameInfo));
+        ChunkRenderTable *table = &g_chunk_render_table;
 
-        foreach (i, ctx->world->all_chunks)
-        {
-            auto chunk = ctx->world->all_chunks[i];
-            if (!chunk->mesh.uploaded)
-                continue;
+        // Shadows are not culled, chunks behind the camera or hidden by terrain can still cast visible shadows
+        Array<s64> solid_draw_list = {.allocator=temp};
+        BuildChunkDrawList(table, ChunkMeshType_Solid, {}, INFINITY, false, &solid_draw_list);
 
-            GfxSetVertexBuffer(&pass, Default_Vertex_Buffer_Index, &chunk->mesh.vertex_buffer, 0, sizeof(BlockVertex) * chunk->mesh.vertex_count, sizeof(BlockVertex));
+        Slice<s64> draw_lists[ChunkMeshType_Count] = {};
+        draw_lists[ChunkMeshType_Solid] = MakeSlice(solid_draw_list);
 
-            u32 vertex_offset = chunk->mesh.mesh_type_vertex_offsets[ChunkMeshType_Solid];
-            u32 index_offset = chunk->mesh.mesh_type_index_offsets[ChunkMeshType_Solid];
-            u32 index_count = chunk->mesh.mesh_type_index_counts[ChunkMeshType_Solid];
-            GfxDrawIndexedPrimitives(&pass, &chunk->mesh.index_buffer, index_count, GfxIndexType_Uint32, Shadow_Map_Num_Cascades, vertex_offset, index_offset);
-        }
+        ChunkDrawCommands commands = BuildChunkDrawCommands(table, draw_lists, Shadow_Map_Num_Cascades);
+        GfxSetBuffer(&pass, g_shadow_map_bindings.vertex_chunk_draw_data, commands.draw_data_buffer, commands.draw_data_offset, commands.draw_data_size);
+
+        DrawChunks(&pass, &commands, ChunkMeshType_Solid);
+
+        MetricSet(g_renderer_metrics.shadow_map_pass_draws, commands.command_counts[ChunkMeshType_Solid]);
+        MetricSet(g_renderer_metrics.shadow_map_pass_vertices, commands.total_vertex_count);
     }
     GfxEndRenderPass(&pass);
 }
@@ -9,6 +9,24 @@ GfxPipelineState g_sky_atmosphere_pipeline;
 GfxSamplerState g_sky_LUT_sampler;
 GfxSamplerState g_sky_color_LUT_sampler;
 
+struct SkyBindings
+{
+    GfxPipelineBinding transmittance_LUT_sky_buffer;
+
+    GfxPipelineBinding multi_scatter_LUT_sky_buffer;
+    GfxPipelineBinding multi_scatter_LUT_transmittance_LUT;
+
+    GfxPipelineBinding color_LUT_frame_info;
+    GfxPipelineBinding color_LUT_transmittance_LUT;
+    GfxPipelineBinding color_LUT_multi_scatter_LUT;
+
+    GfxPipelineBinding atmosphere_frame_info;
+    GfxPipelineBinding atmosphere_transmittance_LUT;
+    GfxPipelineBinding atmosphere_color_LUT;
+};
+
+static SkyBindings g_sky_bindings;
+
 static void InitSkyPipelines()
 {
     GfxPipelineStateDesc desc = {};
@@ -33,6 +51,22 @@ static void InitSkyPipelines()
         g_sky_atmosphere_pipeline = GfxCreatePipelineState("Sky Atmosphere", desc);
     }
 
+    {
+        auto bindings = &g_sky_bindings;
+        bindings->transmittance_LUT_sky_buffer = GfxGetFragmentStageBinding(&g_sky_transmittance_LUT_pipeline, "sky_buffer");
+
+        bindings->multi_scatter_LUT_sky_buffer = GfxGetFragmentStageBinding(&g_sky_multi_scatter_LUT_pipeline, "sky_buffer");
+        bindings->multi_scatter_LUT_transmittance_LUT = GfxGetFragmentStageBinding(&g_sky_multi_scatter_LUT_pipeline, "transmittance_LUT");
+
+        bindings->color_LUT_frame_info = GfxGetFragmentStageBinding(&g_sky_color_LUT_pipeline, "frame_info_buffer");
+        bindings->color_LUT_transmittance_LUT = GfxGetFragmentStageBinding(&g_sky_color_LUT_pipeline, "transmittance_LUT");
+        bindings->color_LUT_multi_scatter_LUT = GfxGetFragmentStageBinding(&g_sky_color_LUT_pipeline, "multi_scatter_LUT");
+
+        bindings->atmosphere_frame_info = GfxGetFragmentStageBinding(&g_sky_atmosphere_pipeline, "frame_info_buffer");
+        bindings->atmosphere_transmittance_LUT = GfxGetFragmentStageBinding(&g_sky_atmosphere_pipeline, "transmittance_LUT");
+        bindings->atmosphere_color_LUT = GfxGetFragmentStageBinding(&g_sky_atmosphere_pipeline, "color_LUT");
+    }
+
     {
         GfxSamplerStateDesc sampler_desc = {};
         sampler_desc.min_filter = GfxSamplerFilter_Linear;
@@ -51,7 +85,28 @@ static void InitSkyPipelines()
     }
 }
 
-static void SkyTransmittanceLUTPass(GfxCommandBuffer *cmd_buffer, s64 sky_offset)
+void DestroySky()
+{
+    // Everything is created on first use
+    if (!IsNull(&g_sky_transmittance_LUT_pipeline))
+    {
+        GfxDestroyPipelineState(&g_sky_transmittance_LUT_pipeline);
+        GfxDestroyPipelineState(&g_sky_multi_scatter_LUT_pipeline);
+        GfxDestroyPipelineState(&g_sky_color_LUT_pipeline);
+        GfxDestroyPipelineState(&g_sky_atmosphere_pipeline);
+        GfxDestroySamplerState(&g_sky_LUT_sampler);
+        GfxDestroySamplerState(&g_sky_color_LUT_sampler);
+    }
+
+    if (!IsNull(&g_sky.transmittance_LUT))
+        GfxDestroyTexture(&g_sky.transmittance_LUT);
+    if (!IsNull(&g_sky.multi_scatter_LUT))
+        GfxDestroyTexture(&g_sky.multi_scatter_LUT);
+    if (!IsNull(&g_sky.color_LUT))
+        GfxDestroyTexture(&g_sky.color_LUT);
+}
+
+static void SkyTransmittanceLUTPass(GfxCommandBuffer *cmd_buffer, GfxBuffer *sky_buffer, s64 sky_offset)
 {
     if (IsNull(&g_sky.transmittance_LUT))
     {
@@ -72,15 +127,14 @@ static void SkyTransmittanceLUTPass(GfxCommandBuffer *cmd_buffer, s64 sky_offset
         GfxSetPipelineState(&pass, &g_sky_transmittance_LUT_pipeline);
         GfxSetViewport(&pass, {.width=(float)g_sky.transmittance_LUT_resolution.x, .height=(float)g_sky.transmittance_LUT_resolution.y});
 
-        auto fragment_sky_buffer = GfxGetFragmentStageBinding(&g_sky_transmittance_LUT_pipeline, "sky_buffer");
-        GfxSetBuffer(&pass, fragment_sky_buffer, FrameDataBuffer(), sky_offset, sizeof(Std140SkyAtmosphere));
+        GfxSetBuffer(&pass, g_sky_bindings.transmittance_LUT_sky_buffer, sky_buffer, sky_offset, sizeof(Std140SkyAtmosphere));
 
         GfxDrawPrimitives(&pass, 6, 1);
     }
     GfxEndRenderPass(&pass);
 }
 
-static void SkyMultiScatterLUTPass(GfxCommandBuffer *cmd_buffer, s64 sky_offset)
+static void SkyMultiScatterLUTPass(GfxCommandBuffer *cmd_buffer, GfxBuffer *sky_buffer, s64 sky_offset)
 {
     if (IsNull(&g_sky.multi_scatter_LUT))
     {
@@ -101,12 +155,11 @@ static void SkyMultiScatterLUTPass(GfxCommandBuffer *cmd_buffer, s64 sky_offset)
         GfxSetPipelineState(&pass, &g_sky_multi_scatter_LUT_pipeline);
         GfxSetViewport(&pass, {.width=(float)g_sky.multi_scatter_LUT_resolution.x, .height=(float)g_sky.multi_scatter_LUT_resolution.y});
 
-        auto fragment_sky_buffer = GfxGetFragmentStageBinding(&g_sky_multi_scatter_LUT_pipeline, "sky_buffer");
-        auto fragment_transmittance_LUT = GfxGetFragmentStageBinding(&g_sky_multi_scatter_LUT_pipeline, "transmittance_LUT");
+        auto bindings = &g_sky_bindings;
 
-        GfxSetBuffer(&pass, fragment_sky_buffer, FrameDataBuffer(), sky_offset, sizeof(Std140SkyAtmosphere));
-        GfxSetTexture(&pass, fragment_transmittance_LUT, &g_sky.transmittance_LUT);
-        GfxSetSamplerState(&pass, fragment_transmittance_LUT, &g_sky_LUT_sampler);
+        GfxSetBuffer(&pass, bindings->multi_scatter_LUT_sky_buffer, sky_buffer, sky_offset, sizeof(Std140SkyAtmosphere));
+        GfxSetTexture(&pass, bindings->multi_scatter_LUT_transmittance_LUT, &g_sky.transmittance_LUT);
+        GfxSetSamplerState(&pass, bindings->multi_scatter_LUT_transmittance_LUT, &g_sky_LUT_sampler);
 
         GfxDrawPrimitives(&pass, 6, 1);
     }
@@ -134,15 +187,13 @@ static void SkyColorLUTPass(FrameRenderContext *ctx)
         GfxSetPipelineState(&pass, &g_sky_color_LUT_pipeline);
         GfxSetViewport(&pass, {.width=(float)g_sky.color_LUT_resolution.x, .height=(float)g_sky.color_LUT_resolution.y});
 
-        auto fragment_frame_info_buffer = GfxGetFragmentStageBinding(&g_sky_color_LUT_pipeline, "frame_info_buffer");
-        auto fragment_transmittance_LUT = GfxGetFragmentStageBinding(&g_sky_color_LUT_pipeline, "transmittance_LUT");
-        auto fragment_multi_scatter_LUT = GfxGetFragmentStageBinding(&g_sky_color_LUT_pipeline, "multi_scatter_LUT");
+        auto bindings = &g_sky_bindings;
 
-        GfxSetBuffer(&pass, fragment_frame_info_buffer, FrameDataBuffer(), ctx->frame_info_offset, sizeof(Std140FrameInfo));
-        GfxSetTexture(&pass, fragment_transmittance_LUT, &g_sky.transmittance_LUT);
-        GfxSetSamplerState(&pass, fragment_transmittance_LUT, &g_sky_LUT_sampler);
-        GfxSetTexture(&pass, fragment_multi_scatter_LUT, &g_sky.multi_scatter_LUT);
-        GfxSetSamplerState(&pass, fragment_multi_scatter_LUT, &g_sky_LUT_sampler);
+        GfxSetBuffer(&pass, bindings->color_LUT_frame_info, ctx->frame_info_buffer, ctx->frame_info_offset, sizeof(Std140FrameInfo));
+        GfxSetTexture(&pass, bindings->color_LUT_transmittance_LUT, &g_sky.transmittance_LUT);
+        GfxSetSamplerState(&pass, bindings->color_LUT_transmittance_LUT, &g_sky_LUT_sampler);
+        GfxSetTexture(&pass, bindings->color_LUT_multi_scatter_LUT, &g_sky.multi_scatter_LUT);
+        GfxSetSamplerState(&pass, bindings->color_LUT_multi_scatter_LUT, &g_sky_LUT_sampler);
 
         GfxDrawPrimitives(&pass, 6, 1);
     }
@@ -151,6 +202,8 @@ static void SkyColorLUTPass(FrameRenderContext *ctx)
 
 void RenderSkyLUTs(FrameRenderContext *ctx)
 {
+    ProfileFunction();
+
     if (IsNull(&g_sky_transmittance_LUT_pipeline))
         InitSkyPipelines();
 
@@ -173,15 +226,18 @@ void RenderSkyLUTs(FrameRenderContext *ctx)
         .ground_radius=g_sky.ground_radius,
         .atmosphere_radius=g_sky.atmosphere_radius,
     };
+    GfxBuffer *sky_buffer = FrameDataBuffer(sky);
     s64 sky_offset = GetBufferOffset(FrameDataGfxAllocator(), sky);
 
-    SkyTransmittanceLUTPass(ctx->cmd_buffer, sky_offset);
-    SkyMultiScatterLUTPass(ctx->cmd_buffer, sky_offset);
+    SkyTransmittanceLUTPass(ctx->cmd_buffer, sky_buffer, sky_offset);
+    SkyMultiScatterLUTPass(ctx->cmd_buffer, sky_buffer, sky_offset);
     SkyColorLUTPass(ctx);
 }
 
 void SkyAtmospherePass(FrameRenderContext *ctx)
 {
+    ProfileFunction();
+
     if (IsNull(&g_sky_atmosphere_pipeline))
         InitSkyPipelines();
 
@@ -197,15 +253,13 @@ void SkyAtmospherePass(FrameRenderContext *ctx)
         GfxSetPipelineState(&pass, &g_sky_atmosphere_pipeline);
         GfxSetViewport(&pass, {.width=(float)window_w, .height=(float)window_h});
 
-        auto fragment_frame_info_buffer = GfxGetFragmentStageBinding(&g_sky_atmosphere_pipeline, "frame_info_buffer");
-        auto fragment_transmittance_LUT = GfxGetFragmentStageBinding(&g_sky_atmosphere_pipeline, "transmittance_LUT");
-        auto fragment_color_LUT = GfxGetFragmentStageBinding(&g_sky_atmosphere_pipeline, "color_LUT");
+        auto bindings = &g_sky_bindings;
 
-        GfxSetBuffer(&pass, fragment_frame_info_buffer, FrameDataBuffer(), ctx->frame_info_offset, sizeof(Std140FrameInfo));
-        GfxSetTexture(&pass, fragment_transmittance_LUT, &g_sky.transmittance_LUT);
-        GfxSetSamplerState(&pass, fragment_transmittance_LUT, &g_sky_LUT_sampler);
-        GfxSetTexture(&pass, fragment_color_LUT, &g_sky.color_LUT);
-        GfxSetSamplerState(&pass, fragment_color_LUT, &g_sky_color_LUT_sampler);
+        GfxSetBuffer(&pass, bindings->atmosphere_frame_info, ctx->frame_info_buffer, ctx->frame_info_offset, sizeof(Std140FrameInfo));
+        GfxSetTexture(&pass, bindings->atmosphere_transmittance_LUT, &g_sky.transmittance_LUT);
+        GfxSetSamplerState(&pass, bindings->atmosphere_transmittance_LUT, &g_sky_LUT_sampler);
+        GfxSetTexture(&pass, bindings->atmosphere_color_LUT, &g_sky.color_LUT);
+        GfxSetSamplerState(&pass, bindings->atmosphere_color_LUT, &g_sky_color_LUT_sampler);
 
         GfxDrawPrimitives(&pass, 6, 1);
     }
@@ -0,0 +1,167 @@
+#include "Graphics/Renderer.hpp"
+
+// Compact the record list once this many records at the front were reclaimed
+#define Staging_Ring_Compact_Threshold 256
+
+void InitStagingRing(StagingRing *ring, String name, s64 capacity)
+{
+    ring->capacity = AlignForward(capacity, Staging_Ring_Alignment);
+
+    GfxBufferDesc desc{};
+    desc.cpu_access = GfxCpuAccess_Write;
+    desc.size = ring->capacity;
+    ring->buffer = GfxCreateBuffer(name, desc);
+    Assert(!IsNull(&ring->buffer));
+
+    ring->mapped_ptr = GfxMapBuffer(&ring->buffer, 0, ring->capacity, GfxMapAccess_Write);
+    Assert(ring->mapped_ptr != null);
+
+    pthread_mutex_init(&ring->mutex, null);
+
+    ring->records.allocator = TaggedHeap(MemoryTag_Uploads);
+    ring->fences.allocator = TaggedHeap(MemoryTag_Uploads);
+}
+
+void DestroyStagingRing(StagingRing *ring)
+{
+    foreach (i, ring->fences)
+        GfxDestroyFence(&ring->fences[i].fence);
+
+    ArrayFree(&ring->fences);
+    ArrayFree(&ring->records);
+
+    pthread_mutex_destroy(&ring->mutex);
+
+    GfxUnmapBuffer(&ring->buffer);
+    GfxDestroyBuffer(&ring->buffer);
+
+    *ring = {};
+}
+
+StagingRingRange ReserveStagingRing(StagingRing *ring, s64 size)
+{
+    size = AlignForward(size, Staging_Ring_Alignment);
+    if (size <= 0 || size > ring->capacity)
+        return {};
+
+    pthread_mutex_lock(&ring->mutex);
+    defer(pthread_mutex_unlock(&ring->mutex));
+
+    // Ranges are contiguous in the buffer, so we skip what is left at the end if it is too small
+    s64 offset = ring->head % ring->capacity;
+    s64 padding = 0;
+    if (offset + size > ring->capacity)
+        padding = ring->capacity - offset;
+
+    s64 end = ring->head + padding + size;
+    if (end - ring->tail > ring->capacity)
+    {
+        ring->num_failed_reservations += 1;
+        return {};
+    }
+
+    ArrayPush(&ring->records, {.end=end});
+
+    StagingRingRange result = {
+        .offset=(ring->head + padding) % ring->capacity,
+        .size=size,
+        .id=ring->first_record_id + (u64)(ring->records.count - 1),
+    };
+
+    ring->head = end;
+    if (ring->head - ring->tail > ring->high_water)
+        ring->high_water = ring->head - ring->tail;
+
+    return result;
+}
+
+void *GetStagingRingPointer(StagingRing *ring, StagingRingRange range)
+{
+    Assert(!IsNull(range));
+
+    return (u8 *)ring->mapped_ptr + range.offset;
+}
+
+void FlushStagingRing(StagingRing *ring, StagingRingRange range)
+{
+    Assert(!IsNull(range));
+
+    GfxFlushMappedBuffer(&ring->buffer, range.offset, range.size);
+}
+
+void ReleaseStagingRing(StagingRing *ring, StagingRingRange range, bool used_by_gpu)
+{
+    if (IsNull(range))
+        return;
+
+    pthread_mutex_lock(&ring->mutex);
+    defer(pthread_mutex_unlock(&ring->mutex));
+
+    Assert(range.id >= ring->first_record_id);
+
+    s64 index = (s64)(range.id - ring->first_record_id);
+    Assert(index >= ring->first_record && index < ring->records.count);
+
+    auto record = &ring->records[index];
+    Assert(!record->released, "Staging ring range was released twice");
+
+    record->released = true;
+    record->release_serial = used_by_gpu ? ring->current_serial : 0;
+}
+
+void SignalStagingRing(StagingRing *ring)
+{
+    ArrayPush(&ring->fences, {.fence=GfxCreateFence(), .serial=ring->current_serial});
+    ring->current_serial += 1;
+}
+
+void ReclaimStagingRing(StagingRing *ring)
+{
+    // Fences are signaled in the order they were created
+    s64 num_signaled = 0;
+    while (num_signaled < ring->fences.count && GfxIsFenceSignaled(&ring->fences[num_signaled].fence))
+    {
+        ring->completed_serial = ring->fences[num_signaled].serial;
+        GfxDestroyFence(&ring->fences[num_signaled].fence);
+        num_signaled += 1;
+    }
+
+    for (s64 i = 0; i < num_signaled; i += 1)
+        ArrayOrderedRemoveAt(&ring->fences, 0);
+
+    pthread_mutex_lock(&ring->mutex);
+    defer(pthread_mutex_unlock(&ring->mutex));
+
+    while (ring->first_record < ring->records.count)
+    {
+        StagingRingRecord record = ring->records[ring->first_record];
+        if (!record.released || record.release_serial > ring->completed_serial)
+            break;
+
+        ring->tail = record.end;
+        ring->first_record += 1;
+    }
+
+    if (ring->first_record > 0 && (ring->first_record >= Staging_Ring_Compact_Threshold || ring->first_record == ring->records.count))
+    {
+        s64 num_live = ring->records.count - ring->first_record;
+        memmove(ring->records.data, ring->records.data + ring->first_record, num_live * sizeof(StagingRingRecord));
+
+        ring->records.count = num_live;
+        ring->first_record_id += (u64)ring->first_record;
+        ring->first_record = 0;
+    }
+}
+
+StagingRingStats GetStagingRingStats(StagingRing *ring)
+{
+    pthread_mutex_lock(&ring->mutex);
+    defer(pthread_mutex_unlock(&ring->mutex));
+
+    return {
+        .capacity=ring->capacity,
+        .used=ring->head - ring->tail,
+        .high_water=ring->high_water,
+        .num_failed_reservations=ring->num_failed_reservations,
+    };
+}
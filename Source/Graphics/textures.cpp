@@ -59,6 +59,12 @@ static void BlitPixels(u32 *dest, Vec3u dest_size, Vec3u dest_origin, LoadedImag
     }
 }
 
+static void FreeImage(LoadedImage *image)
+{
+    stbi_image_free(image->pixels);
+    *image = {};
+}
+
 static Result<LoadedImage> LoadImage(String filename)
 {
     int width, height;
@@ -73,6 +79,7 @@ static Result<LoadedImage> LoadImage(String filename)
     if (result.width != Block_Texture_Size_No_Border || result.height != Block_Texture_Size_No_Border)
     {
         LogError(Log_Graphics, "Block texture '%.*s' has size %dx%d but we expected %dx%d", FSTR(filename), width, height, Block_Texture_Size_No_Border, Block_Texture_Size_No_Border);
+        FreeImage(&result);
 
         return Result<LoadedImage>::Bad(false);
     }
@@ -82,7 +89,8 @@ static Result<LoadedImage> LoadImage(String filename)
 
 static void LoadBlockAtlasTexture()
 {
-    u32 *pixels = Alloc<u32>(Block_Atlas_Size * Block_Atlas_Size * 6, heap);
+    u32 *pixels = Alloc<u32>(Block_Atlas_Size * Block_Atlas_Size * 6, TaggedHeap(MemoryTag_Graphics));
+    defer(Free(pixels, TaggedHeap(MemoryTag_Graphics)));
     memset(pixels, 0, Block_Atlas_Size * Block_Atlas_Size * 6 * sizeof(u32));
 
     for (int i = 1; i < Block_Count; i += 1)
@@ -103,6 +111,16 @@ static void LoadBlockAtlasTexture()
         auto image_west = LoadImage(filename_west);
         auto image_north = LoadImage(filename_north);
         auto image_south = LoadImage(filename_south);
+        defer({
+            FreeImage(&image.value);
+            FreeImage(&image_top.value);
+            FreeImage(&image_bottom.value);
+            FreeImage(&image_east.value);
+            FreeImage(&image_west.value);
+            FreeImage(&image_north.value);
+            FreeImage(&image_south.value);
+        });
+
         if (!image_top.ok || !image_bottom.ok || !image_east.ok || !image_west.ok || !image_north.ok || !image_south.ok)
         {
             Assert(image.ok, "Could not load base image for block '%.*s'", FSTR(name));
@@ -153,7 +171,8 @@ static void LoadBlockAtlasTexture()
 
 static void LoadDebugBlockFaceAtlasTexture()
 {
-    u32 *pixels = Alloc<u32>(Block_Atlas_Size * Block_Atlas_Size * 6, heap);
+    u32 *pixels = Alloc<u32>(Block_Atlas_Size * Block_Atlas_Size * 6, TaggedHeap(MemoryTag_Graphics));
+    defer(Free(pixels, TaggedHeap(MemoryTag_Graphics)));
     memset(pixels, 0, Block_Atlas_Size * Block_Atlas_Size * 6 * sizeof(u32));
 
     for (int i = 1; i < Block_Count; i += 1)
@@ -164,6 +183,14 @@ static void LoadDebugBlockFaceAtlasTexture()
         auto image_west = LoadImage("Data/Blocks/block_face_west.png");
         auto image_north = LoadImage("Data/Blocks/block_face_north.png");
         auto image_south = LoadImage("Data/Blocks/block_face_south.png");
+        defer({
+            FreeImage(&image_top.value);
+            FreeImage(&image_bottom.value);
+            FreeImage(&image_east.value);
+            FreeImage(&image_west.value);
+            FreeImage(&image_north.value);
+            FreeImage(&image_south.value);
+        });
 
         uint block_x = ((i - 1) % Block_Atlas_Num_Blocks) * Block_Texture_Size;
         uint block_y = ((i - 1) / Block_Atlas_Num_Blocks) * Block_Texture_Size;
@@ -198,16 +225,26 @@ void LoadAllTextures()
 
 static Array<GfxTexture *> g_mipmaps_to_generate;
 
+void DestroyAllTextures()
+{
+    GfxDestroyTexture(&g_block_atlas);
+    GfxDestroyTexture(&g_debug_block_face_atlas);
+
+    ArrayFree(&g_mipmaps_to_generate);
+}
+
 void QueueGenerateMipmaps(GfxTexture *texture)
 {
     if (!g_mipmaps_to_generate.allocator.func)
-        g_mipmaps_to_generate.allocator = heap;
+        g_mipmaps_to_generate.allocator = TaggedHeap(MemoryTag_Graphics);
 
     ArrayPush(&g_mipmaps_to_generate, texture);
 }
 
 void GeneratePendingMipmaps(GfxCommandBuffer *cmd_buffer)
 {
+    ProfileFunction();
+
     auto pass = GfxBeginCopyPass("Generate Mipmaps", cmd_buffer);
     {
         foreach (i, g_mipmaps_to_generate)
@@ -35,49 +35,72 @@ static void PushRect(Array<UIVertex> *vertices, UIRectElement elem, int window_w
     v->color = elem.color;
 }
 
+struct UIBindings
+{
+    GfxPipelineBinding vertex_frame_info;
+    GfxPipelineBinding fragment_texture;
+};
+
 static GfxPipelineState g_ui_pipeline;
+static UIBindings g_ui_bindings;
 static GfxSamplerState g_ui_texture_sampler;
 
-static void InitPipeline()
-{
-    GfxPipelineStateDesc desc{};
-    desc.rasterizer_state.cull_face = GfxPolygonFace_None;
-    desc.color_formats[0] = GfxGetSwapchainPixelFormat();
-    desc.blend_states[0] = {.enabled=true};
-    desc.vertex_shader = GetVertexShader("ui");
-    desc.fragment_shader = GetFragmentShader("ui");
-
-    Array<GfxVertexInputDesc> vertex_layout = {.allocator=heap};
-    ArrayPush(&vertex_layout, {
+// Pipelines keep a pointer to their vertex layout, so it is not allocated
+static GfxVertexInputDesc g_ui_vertex_layout[] = {
+    {
         .format=GfxVertexFormat_Float2,
         .offset=offsetof(UIVertex, position),
         .stride=sizeof(UIVertex),
         .buffer_index=Default_Vertex_Buffer_Index
-    });
-    ArrayPush(&vertex_layout, {
+    },
+    {
         .format=GfxVertexFormat_Float2,
         .offset=offsetof(UIVertex, tex_coords),
         .stride=sizeof(UIVertex),
         .buffer_index=Default_Vertex_Buffer_Index
-    });
-    ArrayPush(&vertex_layout, {
+    },
+    {
         .format=GfxVertexFormat_Float4,
         .offset=offsetof(UIVertex, color),
         .stride=sizeof(UIVertex),
         .buffer_index=Default_Vertex_Buffer_Index
-    });
-    desc.vertex_layout = MakeSlice(vertex_layout);
+    },
+};
+
+static void InitPipeline()
+{
+    GfxPipelineStateDesc desc{};
+    desc.rasterizer_state.cull_face = GfxPolygonFace_None;
+    desc.color_formats[0] = GfxGetSwapchainPixelFormat();
+    desc.blend_states[0] = {.enabled=true};
+    desc.vertex_shader = GetVertexShader("ui");
+    desc.fragment_shader = GetFragmentShader("ui");
+    desc.vertex_layout = {.count=(s64)StaticArraySize(g_ui_vertex_layout), .data=g_ui_vertex_layout};
 
     g_ui_pipeline = GfxCreatePipelineState("UI", desc);
 
+    g_ui_bindings.vertex_frame_info = GfxGetVertexStageBinding(&g_ui_pipeline, "frame_info_buffer");
+    g_ui_bindings.fragment_texture = GfxGetFragmentStageBinding(&g_ui_pipeline, "ui_texture");
+
     GfxSamplerStateDesc sampler_desc{};
     sampler_desc.min_filter = GfxSamplerFilter_Nearest;
     sampler_desc.mag_filter = GfxSamplerFilter_Nearest;
     g_ui_texture_sampler = GfxCreateSamplerState("UI", sampler_desc);
 }
 
+void DestroyUIPipeline()
+{
+    if (IsNull(&g_ui_pipeline))
+        return;
+
+    GfxDestroyPipelineState(&g_ui_pipeline);
+    GfxDestroySamplerState(&g_ui_texture_sampler);
+}
+
 void UIRenderPass(FrameRenderContext *ctx)
 {
+    ProfileFunction();
+
     if (IsNull(&g_ui_pipeline))
     {
         InitPipeline();
@@ -107,12 +130,11 @@ void UIRenderPass(FrameRenderContext *ctx)
         GfxSetViewport(&pass, {.width=(float)window_w, .height=(float)window_h});
         GfxSetPipelineState(&pass, &g_ui_pipeline);
 
-        GfxSetVertexBuffer(&pass, Default_Vertex_Buffer_Index, FrameDataBuffer(), vertices_offset, vertices.count * sizeof(UIVertex), sizeof(UIVertex));
+        GfxSetVertexBuffer(&pass, Default_Vertex_Buffer_Index, FrameDataBuffer(vertices.data), vertices_offset, vertices.count * sizeof(UIVertex), sizeof(UIVertex));
 
-        auto vertex_frame_info = GfxGetVertexStageBinding(&g_ui_pipeline, "frame_info_buffer");
-        auto fragment_texture = GfxGetFragmentStageBinding(&g_ui_pipeline, "ui_texture");
+        auto fragment_texture = g_ui_bindings.fragment_texture;
 
-        GfxSetBuffer(&pass, vertex_frame_info, FrameDataBuffer(), ctx->frame_info_offset, sizeof(Std140FrameInfo));
+        GfxSetBuffer(&pass, g_ui_bindings.vertex_frame_info, ctx->frame_info_buffer, ctx->frame_info_offset, sizeof(Std140FrameInfo));
         GfxSetSamplerState(&pass, fragment_texture, &g_ui_texture_sampler);
 
         // @Todo @Speed: batch draw calls
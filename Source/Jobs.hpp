@@ -0,0 +1,143 @@
+#pragma once
+
+#include "Core.hpp"
+
+// Job system shared by the whole game, with one worker per core by default.
+// Jobs have a priority, and can depend on other jobs: a job is only released to the
+// workers once all of its dependencies are done, so nobody has to poll for it.
+// Jobs are intrusive: the memory of a job is owned by whoever submits it (usually embedded
+// in the data the job works on), and the system never allocates anything for it.
+// Jobs can be submitted from any thread. A job that has a completion queue is handed back
+// through it once done, and can still be used as a dependency until its memory is reused.
+// Jobs released by workers go to work stealing deques, the same way as in ThreadGroup (see core.cpp),
+// jobs submitted from other threads and completed jobs go through bounded MPMC queues.
+// Completed jobs that do not fit in their queue go to an intrusive overflow list, so a worker
+// never waits for the owner of the queue, which might itself be waiting to submit a job.
+// Jobs can allocate their temporaries with scratch, it is reset once the job is done
+
+enum JobPriority
+{
+    JobPriority_High,
+    JobPriority_Normal,
+    JobPriority_Low,
+    JobPriority_Count,
+};
+
+typedef void (*JobFunc)(void *data);
+
+#define Job_Max_Dependencies 8
+#define Job_Completion_Queue_Capacity (1 << 14)
+
+struct Job;
+struct JobSystem;
+struct JobCompletionQueue;
+
+// Links a job in the list of jobs to release when one of its dependencies is done.
+// The nodes live in the waiting job, since it cannot go away before all its dependencies are done
+struct JobContinuation
+{
+    Job *job = null;
+    JobContinuation *next = null;
+};
+
+struct Job
+{
+    JobFunc func = null;
+    void *data = null;
+    JobPriority priority = JobPriority_Normal;
+    JobSystem *system = null;
+    JobCompletionQueue *completion_queue = null;
+
+    // One more than the number of dependencies that are not done until the job is submitted
+    s32 num_pending_dependencies = 1;
+    // Jobs to release when this one is done, set to Job_Continuations_Closed once done
+    JobContinuation *continuations = null;
+    JobContinuation dependency_nodes[Job_Max_Dependencies] = {};
+    int num_dependencies = 0;
+
+    s64 submitted_ns = 0;
+    s64 released_ns = 0;
+    s64 start_ns = 0;
+    s64 end_ns = 0; // 0 if the job was dropped without running, see DestroyJobSystem
+
+    Job *next_completed = null; // In the overflow list of the completion queue
+};
+
+#define Job_Continuations_Closed ((JobContinuation *)1)
+
+struct JobCompletionQueue
+{
+    MPMCQueue jobs = {};
+
+    // Pushed to by any thread when the queue is full, taken all at once by the owner
+    Job *overflow = null;
+    s32 num_overflow = 0;
+    Job *overflow_popped = null; // Only used by the owner
+};
+
+struct JobWorker
+{
+    JobSystem *system = null;
+    pthread_t thread = 0;
+    WorkDeque deques[JobPriority_Count] = {}; // Jobs released by this worker
+    u64 steal_rng_state = 0;
+
+    s64 num_jobs = 0;
+    s64 busy_ns = 0;      // Time spent in jobs that are done
+    s64 job_start_ns = 0; // Start of the current job, 0 when idle
+
+    // The scratch arena of the worker is reset after every job, see RunJob
+    s64 num_scratch_allocations = 0;
+    s64 scratch_peak_used = 0; // Most scratch memory used by a single job
+    s64 scratch_reserved = 0;
+
+    // Only used by the thread that owns the job system, see UpdateJobSystemStats
+    s64 last_busy_ns = 0;
+    float utilization = 0;
+};
+
+struct JobSystem
+{
+    String name = "";
+    Slice<JobWorker> workers = {};
+
+    // Jobs submitted or released outside of the workers
+    MPMCQueue submitted_jobs[JobPriority_Count] = {};
+
+    // Idle workers sleep on this futex, it is incremented every time a job is released
+    u32 wake_counter = 0;
+    s32 num_sleeping_workers = 0;
+    bool should_stop = false;
+
+    s32 num_waiting_jobs = 0; // Submitted, but some of their dependencies are not done
+
+    s64 last_stats_ns = 0;
+};
+
+// num_threads <= 0 means one worker per core, minus one for the main thread
+void InitJobSystem(JobSystem *system, String name, int num_threads = 0);
+// Jobs that did not run yet are handed back through their completion queue without running,
+// so the queues have to be drained after this to free what the jobs were working on
+void DestroyJobSystem(JobSystem *system);
+
+void InitJobCompletionQueue(JobCompletionQueue *queue, s64 capacity = Job_Completion_Queue_Capacity);
+void DestroyJobCompletionQueue(JobCompletionQueue *queue);
+
+// The job must not be queued or waiting for its dependencies
+void InitJob(Job *job, JobFunc func, void *data, JobPriority priority, JobCompletionQueue *completion_queue = null);
+// Must be called before job is submitted. The dependency must have been submitted and its memory
+// not reused yet. Nothing happens if it is already done
+void AddJobDependency(Job *job, Job *dependency);
+void SubmitJob(JobSystem *system, Job *job);
+
+// Returns null when there are no more completed jobs. Only the thread that owns the queue can pop
+Job *PopCompletedJob(JobCompletionQueue *queue);
+int GetNumCompletedJobs(JobCompletionQueue *queue);
+
+// Jobs that are released and have not been picked up by a worker yet
+int GetNumQueuedJobs(JobSystem *system);
+int GetNumWaitingJobs(JobSystem *system);
+
+// Updates the utilization of the workers since the last call, call once per frame
+void UpdateJobSystemStats(JobSystem *system);
+float GetAverageJobWorkerUtilization(JobSystem *system);
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Core.hpp"
+
+// Registry of named counters, gauges and histograms that any subsystem can publish to.
+// Metrics are registered once (registering an existing name returns the same metric)
+// and never unregistered, so the pointers can be kept around. Updating a metric is a
+// few atomic operations, so worker threads can update them too.
+// The values are shown in the debug UI and can be written to a CSV or JSONL file
+// every few frames, see StartMetricsDump
+
+#define Metrics_Max_Count 128
+#define Metric_Histogram_Num_Buckets 64
+#define Default_Metrics_Dump_Interval 60
+
+enum MetricType
+{
+    MetricType_Counter,   // Only goes up
+    MetricType_Gauge,     // Set to the current value
+    MetricType_Histogram, // Distribution of recorded values
+};
+
+struct Metric
+{
+    const char *name = null;
+    MetricType type = MetricType_Counter;
+
+    s64 value = 0;
+
+    // Histograms. Bucket 0 holds values <= 0, bucket i holds values in [2^(i-1), 2^i)
+    s64 count = 0;
+    s64 sum = 0;
+    s64 min = 0;
+    s64 max = 0;
+    s64 buckets[Metric_Histogram_Num_Buckets] = {};
+};
+
+Metric *RegisterCounter(const char *name);
+Metric *RegisterGauge(const char *name);
+Metric *RegisterHistogram(const char *name);
+
+void MetricAdd(Metric *metric, s64 amount = 1);
+void MetricSet(Metric *metric, s64 value);
+void MetricRecord(Metric *metric, s64 value);
+
+s64 GetMetricValue(Metric *metric);
+
+// Estimated from the buckets, so this is only precise up to a power of two
+s64 GetMetricPercentile(Metric *metric, f64 percentile);
+
+Slice<Metric> GetAllMetrics();
+
+// The format is chosen from the extension of the file, .csv or .jsonl.
+// A CSV header is written again whenever new metrics were registered
+bool StartMetricsDump(String filename, int interval_in_frames);
+void StopMetricsDump();
+bool IsDumpingMetrics();
+
+// Call once per frame, writes a line every interval_in_frames frames
+void UpdateMetricsDump();
+
+// Publishes the live bytes, peak bytes and number of live allocations of every memory tag
+// as memory.tag.<name>.* gauges, call once per frame
+void PublishMemoryMetrics();
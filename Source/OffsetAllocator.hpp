@@ -0,0 +1,93 @@
+#pragma once
+
+// Two-level segregated fit (TLSF) allocator for ranges of an external resource,
+// e.g. a GPU buffer. It only hands out offsets and never touches the memory
+// itself. Allocating and freeing are O(1), adjacent free blocks are merged
+
+#include "Core.hpp"
+
+#define Offset_Allocator_Num_Second_Level_Bins_Log2 4
+#define Offset_Allocator_Num_Second_Level_Bins (1 << Offset_Allocator_Num_Second_Level_Bins_Log2)
+#define Offset_Allocator_Num_First_Level_Bins (32 - Offset_Allocator_Num_Second_Level_Bins_Log2 + 1)
+#define Offset_Allocator_Num_Bins (Offset_Allocator_Num_First_Level_Bins * Offset_Allocator_Num_Second_Level_Bins)
+
+#define Offset_Allocator_Invalid_Node 0xffffffff
+
+struct OffsetAllocation
+{
+    u32 offset = 0;
+    u32 size = 0;
+    u32 node = Offset_Allocator_Invalid_Node;
+};
+
+static inline bool IsNull(OffsetAllocation allocation)
+{
+    return allocation.node == Offset_Allocator_Invalid_Node;
+}
+
+struct OffsetAllocatorNode
+{
+    u32 offset = 0;
+    u32 size = 0;
+    bool used = false;
+    void *user_data = null;
+
+    // Neighbors in memory
+    u32 prev_physical = Offset_Allocator_Invalid_Node;
+    u32 next_physical = Offset_Allocator_Invalid_Node;
+
+    // Neighbors in the free list of the bin this node is in
+    u32 prev_free = Offset_Allocator_Invalid_Node;
+    u32 next_free = Offset_Allocator_Invalid_Node;
+};
+
+struct OffsetAllocator
+{
+    u32 size = 0;
+    u32 used_size = 0;
+    u32 num_allocations = 0;
+    u32 num_free_blocks = 0;
+
+    u32 first_level_bitmap = 0;
+    u16 second_level_bitmaps[Offset_Allocator_Num_First_Level_Bins] = {};
+    u32 bin_heads[Offset_Allocator_Num_Bins] = {};
+
+    u32 last_physical = Offset_Allocator_Invalid_Node;
+
+    Array<OffsetAllocatorNode> nodes = {};
+    Array<u32> unused_nodes = {};
+};
+
+struct OffsetAllocatorStats
+{
+    u32 size = 0;
+    u32 used_size = 0;
+    u32 free_size = 0;
+    u32 largest_free_block = 0;
+    u32 num_allocations = 0;
+    u32 num_free_blocks = 0;
+
+    // 0 when all the free space is contiguous, approaches 1 when it is scattered in small blocks
+    float fragmentation = 0;
+};
+
+struct OffsetAllocatorBlock
+{
+    OffsetAllocation allocation = {};
+    void *user_data = null;
+};
+
+void InitOffsetAllocator(OffsetAllocator *allocator, u32 size, Allocator node_allocator = heap);
+void DestroyOffsetAllocator(OffsetAllocator *allocator);
+
+// Returns a null allocation if there is no free block large enough
+OffsetAllocation AllocOffset(OffsetAllocator *allocator, u32 size, void *user_data = null);
+void FreeOffset(OffsetAllocator *allocator, OffsetAllocation allocation);
+
+// Adds free space at the end of the managed range
+void GrowOffsetAllocator(OffsetAllocator *allocator, u32 new_size);
+
+OffsetAllocatorStats GetOffsetAllocatorStats(OffsetAllocator *allocator);
+
+// Returns all the live allocations sorted by offset
+Array<OffsetAllocatorBlock> GetOffsetAllocatorBlocks(OffsetAllocator *allocator, Allocator allocator_for_result);
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Core.hpp"
+
+// CPU profiler. Zones are recorded per thread into fixed size ring buffers that
+// only the owning thread writes to, so recording never takes a lock. Readers (the
+// frame summary and the trace export) read the rings on the main thread and skip
+// the events that were overwritten while reading.
+// Zone names must outlive the profiler (use string literals).
+// Define VOX_DISABLE_PROFILER to compile the zones out
+
+#define Profiler_Max_Threads 64
+#define Profiler_Thread_Name_Capacity 48
+#define Profiler_Events_Per_Thread (1 << 14) // Must be a power of two
+#define Profiler_Max_Zone_Depth 32
+#define Profiler_Max_Zone_Summaries 64
+
+struct ProfileEvent
+{
+    const char *name = null;
+    s64 start_ns = 0;
+    s64 end_ns = 0;
+    int depth = 0;
+};
+
+struct ProfileOpenZone
+{
+    const char *name = null;
+    s64 start_ns = 0;
+};
+
+struct ProfilerThread
+{
+    char name[Profiler_Thread_Name_Capacity] = {};
+    bool active = false;
+
+    int depth = 0;
+    ProfileOpenZone open_zones[Profiler_Max_Zone_Depth] = {};
+
+    // Events are written at head, which only the owning thread increments.
+    // Readers use head to know which events are complete
+    u64 head = 0;
+    ProfileEvent *events = null;
+
+    u64 summary_cursor = 0; // Only used by the main thread
+};
+
+struct ProfileZoneSummary
+{
+    const char *name = null;
+    int count = 0;
+    s64 total_ns = 0;
+    s64 max_ns = 0;
+};
+
+struct ProfileFrameSummary
+{
+    s64 frame_ns = 0;
+    int num_zones = 0;
+    ProfileZoneSummary zones[Profiler_Max_Zone_Summaries] = {};
+};
+
+// Threads are registered by name so a thread that is recreated with the same
+// name (e.g. when the world is regenerated) shows up as the same track
+void ProfilerRegisterThread(const char *name);
+void ProfilerUnregisterThread();
+// Frees the events of every thread, nothing is recorded after this.
+// Only call it once the other threads have exited
+void ProfilerShutdown();
+
+void ProfilerBeginZone(const char *name);
+void ProfilerEndZone();
+
+// Summarizes the zones that ended since the last call, call once per frame on the main thread
+void ProfilerNewFrame();
+ProfileFrameSummary *ProfilerGetLastFrameSummary();
+
+// Writes the events still in the ring buffers in the Chrome trace event format,
+// which can be opened with chrome://tracing or https://ui.perfetto.dev
+bool ProfilerWriteChromeTrace(String filename);
+
+struct ProfileZoneScope
+{
+    ProfileZoneScope(const char *name) { ProfilerBeginZone(name); }
+    ~ProfileZoneScope() { ProfilerEndZone(); }
+};
+
+#if defined(VOX_DISABLE_PROFILER)
+    #define ProfileZone(name)
+#else
+    #define ProfileZone(name) ProfileZoneScope _defer3(_profile_zone_)(name)
+#endif
+
+#define ProfileFunction() ProfileZone(__func__)
@@ -26,13 +26,16 @@ extern Array<UIRectElement> g_ui_elements;
 extern GfxTexture g_ui_font;
 extern GfxTexture g_ui_white_texture;
 
+void DestroyUI();
 void UIBeginFrame();
 void UIRenderPass(FrameRenderContext *ctx);
+void DestroyUIPipeline();
 
 void UISetMouse(bool has_mouse);
 void UISetCursorStart(float x, float y);
 void UISameLine();
 void UIImage(GfxTexture *texture, Vec2f size, Vec2f uv0 = {0,0}, Vec2f uv1 = {1,1});
+void UIGraph(Slice<float> values, Vec2f size, float max_value);
 void UITextAt(Vec2f position, String text);
 void UIText(String text);
 bool UIButton(String id);
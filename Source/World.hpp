@@ -1,17 +1,23 @@
 #pragma once
 
 #include "Core.hpp"
+#include "Jobs.hpp"
 #include "Blocks.hpp"
 #include "Graphics.hpp"
 #include "Graphics/Renderer.hpp"
 
 #define Chunk_Height 256
 #define Chunk_Size 16
+#define Chunk_Section_Height Chunk_Size
+#define Chunk_Num_Sections (Chunk_Height / Chunk_Section_Height)
 
 extern float squashing_factor;
 
 struct Chunk;
 
+// Safe to keep after the chunk is destroyed: GetChunk returns null for the handle of a chunk that is gone
+typedef SlotMapHandle ChunkHandle;
+
 struct ChunkKey
 {
     s16 x, z;
@@ -44,6 +50,65 @@ struct Camera
 
 void UpdateCamera(Camera *camera);
 
+// Power of two, must be larger than twice the maximum render distance
+#define Chunk_Grid_Size 128
+
+// Chunks around the camera are stored in a grid that wraps around on world coordinates
+// (see chunk_grid.cpp), so finding a chunk is an array access, and moving the grid only
+// touches the columns and rows that enter or leave it. Chunks that are outside of the
+// grid are kept in a hash map
+struct ChunkGrid
+{
+    s32 min_x = 0;
+    s32 min_z = 0;
+    Chunk **slots = null; // Chunk_Grid_Size * Chunk_Grid_Size
+    HashMap<ChunkKey, Chunk *> outside = {};
+};
+
+void InitChunkGrid(ChunkGrid *grid, s32 center_x, s32 center_z);
+void DestroyChunkGrid(ChunkGrid *grid);
+Chunk *FindChunk(ChunkGrid *grid, s16 x, s16 z);
+// There must not be a chunk at the same position in the grid already
+void AddChunkToGrid(ChunkGrid *grid, Chunk *chunk);
+void RemoveChunkFromGrid(ChunkGrid *grid, Chunk *chunk);
+void RecenterChunkGrid(ChunkGrid *grid, s32 center_x, s32 center_z);
+
+// Chunks are allocated from large regions of virtual memory that are backed by huge pages when
+// the OS allows it (see chunk_pool.cpp). Freed slots are kept for the next chunks, and the memory
+// of those over g_settings.chunk_pool_free_budget_in_mb is given back to the OS.
+// Only used from the main thread
+#define Chunk_Pool_Region_Size (64 * 1024 * 1024)
+
+struct ChunkPool
+{
+    s64 slot_size = 0;
+    s64 slots_per_region = 0;
+    Array<u8 *> regions = {};
+    s64 next_fresh_slot = 0; // In the last region
+
+    s64 num_used_slots = 0;
+    Array<void *> free_slots = {};     // Still resident, the oldest are first
+    Array<void *> released_slots = {}; // Given back to the OS
+};
+
+struct ChunkPoolStats
+{
+    s64 slot_size = 0;
+    s64 reserved = 0;
+    s64 resident = 0;
+    s64 num_used_slots = 0;
+    s64 num_free_slots = 0;
+    s64 num_released_slots = 0;
+    int num_regions = 0;
+};
+
+void InitChunkPool(ChunkPool *pool);
+// All the chunks must have been freed
+void DestroyChunkPool(ChunkPool *pool);
+Chunk *AllocChunk(ChunkPool *pool);
+void FreeChunk(ChunkPool *pool, Chunk *chunk);
+ChunkPoolStats GetChunkPoolStats(ChunkPool *pool);
+
 #define Water_Level (Chunk_Height - 100)
 #define Dirt_Layer_Size 4
 #define Underwater_Gravel_Layer_Size 3
@@ -55,13 +120,18 @@ struct World
     float sun_polar = Pi * 0.4;
     float sun_azimuth = 0;
     Camera camera {};
-    HashMap<ChunkKey, Chunk *> chunks_by_position = {};
-    Array<Chunk *> all_chunks = {};
-    Array<Chunk *> dirty_chunks = {};
+    ChunkGrid chunk_grid = {};
+    ChunkPool chunk_pool = {};
+    SlotMap<Chunk *> chunks = {};
+    Array<ChunkHandle> dirty_chunks = {}; // Chunks in ChunkMeshState_Dirty, or destroyed since they were marked dirty
     int num_generated_chunks = 0;
+    int num_visible_chunks = 0;
+    int num_generating_chunks = 0; // Generation job in flight
+    int num_meshing_chunks = 0;    // Mesh job in flight
 
-    ThreadGroup chunk_generation_thread_group = {};
-    ThreadGroup chunk_mesh_generation_thread_group = {};
+    JobSystem jobs = {};
+    JobCompletionQueue generated_chunks = {};
+    JobCompletionQueue generated_chunk_meshes = {};
 
     NoiseParams density_params = {};
     NoiseParams continentalness_params = {};
@@ -76,51 +146,180 @@ struct World
     Slice<Vec2f> peaks_and_valleys_offsets = {};
 };
 
+static inline Chunk *GetChunk(World *world, ChunkHandle handle)
+{
+    Chunk **chunk = SlotMapGet(&world->chunks, handle);
+
+    return chunk ? *chunk : null;
+}
+
 static inline Slice<NoiseParams> GetAllNoiseParams(World *world)
 {
     return {.count=4, .data=&world->density_params};
 }
 
+// Bit (a * 6 + b) is set when faces a and b of a chunk section can see each other
+// through non opaque blocks (see visibility.cpp)
+typedef u64 SectionConnectivity;
+#define Section_Connectivity_All ((1ull << 36) - 1)
+
+// Timestamps of the steps a chunk goes through until it is on screen (see chunk_trace.cpp).
+// Only written by the main thread, the workers report their timestamps through their work
+struct ChunkTrace
+{
+    s64 queued_ns = 0;
+    s64 generation_start_ns = 0;
+    s64 generation_end_ns = 0;
+    s64 generated_ns = 0;
+    s64 dirty_ns = 0;          // Last time the chunk was marked dirty
+    s64 mesh_requested_ns = 0; // When the chunk was marked dirty for the last mesh that was staged
+    s64 mesh_released_ns = 0;
+    s64 mesh_start_ns = 0;
+    s64 mesh_end_ns = 0;
+    s64 upload_staged_ns = 0;
+    s64 uploaded_ns = 0;
+    s64 visible_ns = 0; // When the first mesh was uploaded
+};
+
+// Only the main thread changes the mesh state of a chunk, waiting for the chunk and its neighbors
+// to be generated is left to the dependencies of the mesh job (see HandleChunkMeshGeneration)
+enum ChunkMeshState : u8
+{
+    ChunkMeshState_UpToDate,     // No mesh job in flight, and nothing changed since the last one
+    ChunkMeshState_Dirty,        // In world->dirty_chunks, a mesh job is submitted next frame
+    ChunkMeshState_Meshing,      // A mesh job is in flight
+    ChunkMeshState_MeshingDirty, // Changed while a mesh job was in flight, goes back to dirty once it is done
+};
+
 struct Chunk
 {
     s16 x, z;
+    ChunkHandle handle = {}; // Null once the chunk is destroyed
 
     bool is_generated = false;
+    ChunkMeshState mesh_state = ChunkMeshState_UpToDate;
     Mesh mesh = {};
 
+    ChunkHandle east = {};
+    ChunkHandle west = {};
+    ChunkHandle north = {};
+    ChunkHandle south = {};
+
+    // Number of jobs in flight that read the chunk, see PinChunk
+    s32 num_pins = 0;
+    // Set by DestroyChunk, jobs check it so they do not work on a chunk nobody wants anymore
+    bool is_destroyed = false;
+
+    s64 render_index = -1;
+
+    // Until the main thread handles the generated chunk, mesh jobs use it as a dependency
+    Job *generation_job = null;
+
+    ChunkTrace trace = {};
+
+    u64 visibility_frame = 0;
+    u16 visited_sections = 0;
+    SectionConnectivity section_connectivity[Chunk_Num_Sections] = {};
+
+    Block blocks[Chunk_Height * Chunk_Size * Chunk_Size];
+
+    u8 terrain_height_values[Chunk_Size * Chunk_Size];
+};
+
+// A chunk and its neighbors, resolved from their handles on the main thread for a job that reads them.
+// The chunks are pinned until the job is handled, so they cannot be freed under the job
+struct ChunkNeighborhood
+{
+    Chunk *chunk = null;
     Chunk *east = null;
     Chunk *west = null;
     Chunk *north = null;
     Chunk *south = null;
+};
 
-    Block blocks[Chunk_Height * Chunk_Size * Chunk_Size];
+ChunkNeighborhood GetChunkNeighborhood(World *world, Chunk *chunk);
 
-    float continentalness_values[Chunk_Size * Chunk_Size];
-    float erosion_values[Chunk_Size * Chunk_Size];
-    float peaks_and_valleys_values[Chunk_Size * Chunk_Size];
-    u8 terrain_height_values[Chunk_Size * Chunk_Size];
-    float density_values[Chunk_Height * Chunk_Size * Chunk_Size];
-};
+// A chunk that is destroyed while pinned is only freed once it is unpinned as many times.
+// Only called from the main thread
+void PinChunk(Chunk *chunk);
+void UnpinChunk(World *world, Chunk *chunk);
+void PinChunkNeighborhood(ChunkNeighborhood *neighborhood);
+void UnpinChunkNeighborhood(World *world, ChunkNeighborhood *neighborhood);
 
 Block GetBlock(Chunk *chunk, int x, int y, int z);
-Block GetBlockInNeighbors(Chunk *chunk, int x, int y, int z);
-float GetBlockHeight(Chunk *chunk, Block block, int x, int y, int z);
+Block GetBlockInNeighbors(ChunkNeighborhood *neighborhood, int x, int y, int z);
+float GetBlockHeight(ChunkNeighborhood *neighborhood, Block block, int x, int y, int z);
 
 void SetDefaultNoiseParams(World *world);
-void InitWorld(World *world, u32 seed);
+// num_threads <= 0 means one worker per core, see InitJobSystem
+void InitWorld(World *world, u32 seed, int num_threads = 0);
 void DestroyWorld(World *world);
+// Handles to the chunk become stale right away. If jobs still use the chunk their
+// results are dropped when they are handled, and the chunk is freed after that
 void DestroyChunk(World *world, Chunk *chunk);
 
+// Also recenters the chunk grid on point
 void GenerateChunksAroundPoint(World *world, Vec3f point, float radius);
 
+// Updates the world gauges of the metrics registry, call once per frame
+void PublishWorldMetrics(World *world);
+
 void QueueChunkGeneration(World *world, s16 x, s16 z);
 void HandleNewlyGeneratedChunks(World *world);
 
+// The chunk gets remeshed, once if it is marked dirty several times before that
 void MarkChunkDirty(World *world, Chunk *chunk);
 
+enum ChunkLatencyStage
+{
+    ChunkLatencyStage_GenerationQueue,   // Queued until a worker starts generating it
+    ChunkLatencyStage_Generation,
+    ChunkLatencyStage_GenerationHandoff, // Generated until the main thread picks it up
+    ChunkLatencyStage_NeighborWait,      // Dirty until the mesh job is released, waiting for the chunk and its neighbors to be generated
+    ChunkLatencyStage_MeshQueue,         // Released until a worker starts meshing it
+    ChunkLatencyStage_Meshing,
+    ChunkLatencyStage_MeshHandoff,       // Meshed until the main thread stages it for upload
+    ChunkLatencyStage_Upload,            // Staged until uploaded, throttled by the upload budget
+    ChunkLatencyStage_QueueToVisible,    // Queued until the first mesh is uploaded
+    ChunkLatencyStage_Count,
+};
+
+#define Chunk_Trace_Max_Outliers 32
+
+// Record the latency of the stages that just ended in the metrics registry,
+// called on the main thread when the chunk reaches the corresponding step
+void TraceChunkGenerated(Chunk *chunk);
+void TraceChunkMeshStaged(Chunk *chunk);
+void TraceChunkUploaded(Chunk *chunk);
+
+Metric *GetChunkLatencyMetric(ChunkLatencyStage stage);
+
+// The traces of the chunks that took the longest to get on screen are kept
+// so they can be written to a JSON file and inspected
+bool WriteChunkTraceOutliers(String filename);
+void ClearChunkTraceOutliers();
+
+bool AreSectionFacesConnected(SectionConnectivity connectivity, BlockFace a, BlockFace b);
+SectionConnectivity ComputeSectionConnectivity(Chunk *chunk, int section_index);
+void ComputeChunkConnectivity(Chunk *chunk, SectionConnectivity connectivity[Chunk_Num_Sections]);
+
+// Marks the chunks that can be seen from the camera by walking through connected chunk sections
+void UpdateChunkVisibility(World *world, Vec3f camera_position, float max_distance);
+bool IsChunkVisible(Chunk *chunk);
+
 struct ChunkMeshWork
 {
     Array<BlockVertex> vertices[ChunkMeshType_Count] = {};
     Array<u32> indices[ChunkMeshType_Count] = {};
-    Chunk *chunk = null;
+    StagingRingRange staging = {};
+    SectionConnectivity section_connectivity[Chunk_Num_Sections] = {};
+    ChunkNeighborhood neighborhood = {}; // Pinned until the job is handled
+    ChunkHandle handle = {};             // Stale once the chunk is destroyed, in which case the mesh is dropped
+
+    s64 dirty_ns = 0;
+
+    Job job = {};
 };
+
+// Frees the mesh of a job whose result is not used, unpins its chunks and frees the work
+void DropChunkMeshWork(World *world, ChunkMeshWork *work);
@@ -0,0 +1,2245 @@
+#include "Core.hpp"
+#include "Graphics.hpp"
+#include "Graphics/Renderer.hpp"
+#include "World.hpp"
+
+#include <SDL.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <sched.h>
+#include <new>
+
+// Headless benchmarks, built with the null graphics backend as vox-bench.
+// Every scenario uses a fixed seed so runs can be compared with each other.
+// Shaders and textures are loaded from the working directory, so run it from
+// the root of the repository:
+//     ./vox-bench [--seed N] [--chunks N] [--frames N] [--threads N]
+//                 [--render-distance N] [--scenario name] [--output file.json]
+//                 [--trace file.json]
+// Results are written as JSON to the output file (vox-bench.json by default),
+// the logs go to stdout as usual. The trace option writes the profiler zones
+// that are still in the ring buffers once every scenario has run
+
+Settings g_settings;
+
+u64 g_frame_index = 0;
+
+static MemoryArena g_frame_arena;
+
+Allocator heap = Allocator{null, HeapAllocator};
+Allocator temp = Allocator{&g_frame_arena, MemoryArenaAllocator};
+
+SDL_Window *g_window;
+World g_world;
+
+#define Bench_Default_Seed 1337
+#define Bench_Default_Chunk_Grid_Size 16
+#define Bench_Default_Num_Frames 300
+#define Bench_Default_Render_Distance 12
+#define Bench_Default_Output_Filename "vox-bench.json"
+
+// The determinism check generates a smaller grid once per thread count
+#define Bench_Determinism_Grid_Size 8
+
+#define Bench_Fly_Through_Speed 2.0f
+// Fast enough that chunks leave the render distance before their jobs are done
+#define Bench_Chunk_Streaming_Speed 24.0f
+
+#define Bench_Poll_Interval_In_Us 1000
+
+#define Bench_Batch_Size 4096
+#define Bench_Hash_Map_Count (1 << 20)
+#define Bench_Hash_Map_Small_Count 64
+#define Bench_Noise_Count (1 << 20)
+#define Bench_Draw_List_Iterations 200
+#define Bench_Chunk_Lookup_Grid_Size 64
+#define Bench_Chunk_Lookup_Count (1 << 22)
+#define Bench_Chunk_Lookup_Num_Recenters 256
+#define Bench_Chunk_Lookup_Recenter_Step 8
+#define Bench_Chunk_Lookup_Jump_Interval 8 // Every few recenters the grid jumps somewhere else instead of stepping
+#define Bench_Chunk_Alloc_Batch_Size 256
+#define Bench_Chunk_Alloc_Num_Batches 64
+#define Bench_Gfx_Allocator_Initial_Capacity (32 * 1024)
+#define Bench_Gfx_Allocator_Alignment 16
+#define Bench_Gfx_Allocator_Num_Frames 4096
+#define Bench_Gfx_Allocator_Frames_In_Flight 3
+#define Bench_Gfx_Allocator_Max_Allocs_Per_Frame 24
+#define Bench_Gfx_Allocator_Max_Alloc_Size 2048
+#define Bench_Gfx_Allocator_Spike_Interval 97 // Frames that allocate more than the buffer can hold
+#define Bench_Gfx_Allocator_Spike_Alloc_Size 4096
+#define Bench_Gfx_Allocator_Spike_Num_Allocs 16
+#define Bench_Connectivity_Iterations 1024
+#define Bench_Offset_Allocator_Initial_Size (1 << 12)
+#define Bench_Offset_Allocator_Max_Size (1 << 19)
+#define Bench_Offset_Allocator_Max_Alloc_Size 512
+#define Bench_Offset_Allocator_Max_Live 1024
+#define Bench_Offset_Allocator_Num_Ops (1 << 18)
+#define Bench_Offset_Allocator_Check_Interval 1024
+
+// Every Bench_Slow_Job_Interval job is Bench_Slow_Job_Factor times slower than the others,
+// like a mountain chunk among plains
+#define Bench_Thread_Group_Num_Jobs 2048
+#define Bench_Fast_Job_Iterations 20000
+#define Bench_Slow_Job_Interval 16
+#define Bench_Slow_Job_Factor 40
+
+// Every producer pushes its own range of items, the consumers check that each of them comes out exactly once.
+// The queue is small so producers and consumers keep running into a full or empty queue
+#define Bench_MPMC_Queue_Capacity 256
+#define Bench_MPMC_Queue_Num_Producers 4
+#define Bench_MPMC_Queue_Num_Consumers 4
+#define Bench_MPMC_Queue_Items_Per_Producer (1 << 18)
+
+#define Bench_Job_Round_Trip_Count (1 << 18)
+#define Bench_Job_Round_Trip_Batch_Size 1024
+#define Bench_Job_Overflow_Count (4 * Job_Completion_Queue_Capacity)
+
+struct BenchOptions
+{
+    u32 seed = Bench_Default_Seed;
+    int chunk_grid_size = Bench_Default_Chunk_Grid_Size;
+    int num_frames = Bench_Default_Num_Frames;
+    int num_threads = 0; // One per core
+    int render_distance = Bench_Default_Render_Distance;
+    const char *scenario = null;
+    const char *output_filename = Bench_Default_Output_Filename;
+    const char *trace_filename = null;
+};
+
+struct BenchResult
+{
+    String name = "";
+    String unit = "";
+    s64 num_items = 0;
+    f64 total_seconds = 0;
+    f64 p50_ms = 0;
+    f64 p99_ms = 0;
+    s64 peak_memory_bytes = 0;
+};
+
+static BenchOptions g_options;
+static Array<BenchResult> g_results;
+
+static f64 SecondsSince(s64 start)
+{
+    return (GetTimeInNanoseconds() - start) * 1e-9;
+}
+
+static s64 GetPeakMemoryBytes()
+{
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+
+    #if defined(__APPLE__)
+        return (s64)usage.ru_maxrss;
+    #else
+        return (s64)usage.ru_maxrss * 1024;
+    #endif
+}
+
+static int CompareF64(const void *a, const void *b)
+{
+    f64 x = *(f64 *)a;
+    f64 y = *(f64 *)b;
+
+    return (x > y) - (x < y);
+}
+
+static f64 Percentile(Array<f64> sorted, f64 p)
+{
+    if (sorted.count <= 0)
+        return 0;
+
+    s64 index = (s64)(p * (sorted.count - 1) + 0.5);
+
+    return sorted[Clamp(index, (s64)0, sorted.count - 1)];
+}
+
+static bool ShouldRun(const char *name)
+{
+    return !g_options.scenario || strcmp(g_options.scenario, name) == 0;
+}
+
+// Samples are the time in seconds it took to process one item
+static void AddResult(String name, String unit, s64 num_items, f64 total_seconds, Array<f64> *samples)
+{
+    qsort(samples->data, samples->count, sizeof(f64), CompareF64);
+
+    ArrayPush(&g_results, {
+        .name=name,
+        .unit=unit,
+        .num_items=num_items,
+        .total_seconds=total_seconds,
+        .p50_ms=Percentile(*samples, 0.50) * 1000,
+        .p99_ms=Percentile(*samples, 0.99) * 1000,
+        .peak_memory_bytes=GetPeakMemoryBytes(),
+    });
+
+    LogMessage(Log_Bench, "%.*s: %lld %.*s in %.3f s, p50 %.4f ms, p99 %.4f ms", FSTR(name), num_items, FSTR(unit), total_seconds, g_results[g_results.count - 1].p50_ms, g_results[g_results.count - 1].p99_ms);
+
+    ArrayClear(samples);
+}
+
+static void InitBenchWorld(World *world, int num_threads)
+{
+    *world = {};
+    SetDefaultNoiseParams(world);
+    InitWorld(world, g_options.seed, num_threads);
+}
+
+// Queues a square grid of chunks centered on the origin and waits until they are all generated.
+// The time between queuing a chunk and seeing it generated is added to samples
+static void GenerateChunkGrid(World *world, int grid_size, Array<f64> *samples)
+{
+    Array<Chunk *> pending = {.allocator=heap};
+    defer(ArrayFree(&pending));
+
+    s64 queue_time = GetTimeInNanoseconds();
+    for (int z = 0; z < grid_size; z += 1)
+    {
+        for (int x = 0; x < grid_size; x += 1)
+        {
+            s16 chunk_x = (s16)(x - grid_size / 2);
+            s16 chunk_z = (s16)(z - grid_size / 2);
+            QueueChunkGeneration(world, chunk_x, chunk_z);
+            ArrayPush(&pending, FindChunk(&world->chunk_grid, chunk_x, chunk_z));
+        }
+    }
+
+    while (pending.count > 0)
+    {
+        // Leave the cores to the workers, this only costs us a bit of latency precision
+        usleep(Bench_Poll_Interval_In_Us);
+
+        HandleNewlyGeneratedChunks(world);
+
+        for (s64 i = 0; i < pending.count; i += 1)
+        {
+            if (!pending[i]->is_generated)
+                continue;
+
+            if (samples)
+                ArrayPush(samples, SecondsSince(queue_time));
+
+            pending[i] = pending[pending.count - 1];
+            pending.count -= 1;
+            i -= 1;
+        }
+    }
+}
+
+static u64 HashChunkGrid(World *world, int grid_size)
+{
+    u64 hash = Fnv_64_Offset_Basis;
+    for (int z = 0; z < grid_size; z += 1)
+    {
+        for (int x = 0; x < grid_size; x += 1)
+        {
+            ChunkKey key = {(s16)(x - grid_size / 2), (s16)(z - grid_size / 2)};
+            Chunk *chunk = FindChunk(&world->chunk_grid, key.x, key.z);
+            Assert(chunk != null && chunk->is_generated);
+
+            hash = Fnv1aHash(chunk->blocks, sizeof(chunk->blocks), hash);
+        }
+    }
+
+    return hash;
+}
+
+static void BenchGenerateAndMeshChunks()
+{
+    bool generate = ShouldRun("generate_chunks");
+    bool mesh = ShouldRun("mesh_chunks");
+    if (!generate && !mesh)
+        return;
+
+    Array<f64> samples = {.allocator=heap};
+    defer(ArrayFree(&samples));
+
+    World world{};
+    InitBenchWorld(&world, g_options.num_threads);
+    defer(DestroyWorld(&world));
+
+    int grid_size = g_options.chunk_grid_size;
+
+    s64 start = GetTimeInNanoseconds();
+    GenerateChunkGrid(&world, grid_size, &samples);
+    f64 total = SecondsSince(start);
+
+    if (generate)
+        AddResult("generate_chunks", "chunks", grid_size * grid_size, total, &samples);
+
+    if (!mesh)
+        return;
+
+    // Meshing is measured on the main thread, one chunk at a time, and only for
+    // chunks that have all their neighbors so we do the same work as in game
+    s64 num_meshed = 0;
+    start = GetTimeInNanoseconds();
+    foreach (i, world.chunks.items)
+    {
+        ChunkNeighborhood neighborhood = GetChunkNeighborhood(&world, world.chunks[i]);
+        if (!neighborhood.east || !neighborhood.west || !neighborhood.north || !neighborhood.south)
+            continue;
+
+        s64 chunk_start = GetTimeInNanoseconds();
+
+        ChunkMeshWork work{};
+        work.neighborhood = neighborhood;
+        GenerateChunkMeshWorker(&work);
+
+        ArrayPush(&samples, SecondsSince(chunk_start));
+        num_meshed += 1;
+
+        if (!IsNull(work.staging))
+        {
+            ReleaseStagingRing(&g_chunk_staging_ring, work.staging, false);
+            ReclaimStagingRing(&g_chunk_staging_ring);
+        }
+        else
+        {
+            for (int j = 0; j < ChunkMeshType_Count; j += 1)
+            {
+                ArrayFree(&work.vertices[j]);
+                ArrayFree(&work.indices[j]);
+            }
+        }
+    }
+    total = SecondsSince(start);
+
+    AddResult("mesh_chunks", "chunks", num_meshed, total, &samples);
+}
+
+static void BenchFlyThrough()
+{
+    if (!ShouldRun("fly_through"))
+        return;
+
+    Array<f64> samples = {.allocator=heap};
+    defer(ArrayFree(&samples));
+
+    World world{};
+    InitBenchWorld(&world, g_options.num_threads);
+    defer(DestroyWorld(&world));
+
+    g_settings.render_distance = g_options.render_distance;
+    world.camera.position = Vec3f{0, Water_Level + 40, 0};
+
+    s64 start = GetTimeInNanoseconds();
+    for (int i = 0; i < g_options.num_frames; i += 1)
+    {
+        s64 frame_start = GetTimeInNanoseconds();
+
+        g_frame_index += 1;
+        ResetMemoryArena(&g_frame_arena);
+
+        ProfilerNewFrame();
+        ProfileZone("Frame");
+
+        HandleNewlyGeneratedChunks(&world);
+
+        world.camera.position.x += Bench_Fly_Through_Speed;
+        UpdateCamera(&world.camera);
+
+        GenerateChunksAroundPoint(&world, world.camera.position, g_settings.render_distance * Chunk_Size);
+
+        RenderGraphics(&world);
+
+        ArrayPush(&samples, SecondsSince(frame_start));
+    }
+    f64 total = SecondsSince(start);
+
+    LogMessage(Log_Bench, "fly_through: %d chunks generated, %lld chunks loaded", world.num_generated_chunks, world.chunks.items.count);
+
+    AddResult("fly_through", "frames", g_options.num_frames, total, &samples);
+}
+
+// Same as fly_through, but the chunks that are out of the render distance are destroyed,
+// most of them while they are still being generated or meshed
+static void BenchChunkStreaming()
+{
+    if (!ShouldRun("chunk_streaming"))
+        return;
+
+    Array<f64> samples = {.allocator=heap};
+    defer(ArrayFree(&samples));
+
+    World world{};
+    InitBenchWorld(&world, g_options.num_threads);
+    defer(DestroyWorld(&world));
+
+    g_settings.render_distance = g_options.render_distance;
+    world.camera.position = Vec3f{0, Water_Level + 40, 0};
+
+    s64 num_destroyed = 0;
+
+    s64 start = GetTimeInNanoseconds();
+    for (int i = 0; i < g_options.num_frames; i += 1)
+    {
+        s64 frame_start = GetTimeInNanoseconds();
+
+        g_frame_index += 1;
+        ResetMemoryArena(&g_frame_arena);
+
+        ProfilerNewFrame();
+        ProfileZone("Frame");
+
+        HandleNewlyGeneratedChunks(&world);
+
+        world.camera.position.x += Bench_Chunk_Streaming_Speed;
+        UpdateCamera(&world.camera);
+
+        float radius = g_settings.render_distance * Chunk_Size;
+        GenerateChunksAroundPoint(&world, world.camera.position, radius);
+
+        // Keep one more chunk than GenerateChunksAroundPoint on each side, so we do not destroy what it just queued
+        int min_x = (int)((world.camera.position.x - radius) / Chunk_Size) - 1;
+        int max_x = (int)((world.camera.position.x + radius) / Chunk_Size) + 1;
+
+        // Destroying a chunk moves the last one in its place
+        for (s64 j = world.chunks.items.count - 1; j >= 0; j -= 1)
+        {
+            Chunk *chunk = world.chunks[j];
+            if (chunk->x < min_x || chunk->x > max_x)
+            {
+                DestroyChunk(&world, chunk);
+                num_destroyed += 1;
+            }
+        }
+
+        RenderGraphics(&world);
+
+        ArrayPush(&samples, SecondsSince(frame_start));
+    }
+    f64 total = SecondsSince(start);
+
+    LogMessage(Log_Bench, "chunk_streaming: %d chunks generated, %lld chunks destroyed, %lld chunks loaded", world.num_generated_chunks, num_destroyed, world.chunks.items.count);
+
+    AddResult("chunk_streaming", "frames", g_options.num_frames, total, &samples);
+}
+
+// This is what HashMap looked like before it became a Swiss table: linear probing on a
+// 64 bit hash stored per entry, with the hash and comparison called through function pointers
+#define Legacy_Hash_Map_Never_Occupied 0
+#define Legacy_Hash_Map_Removed 1
+#define Legacy_Hash_Map_First_Occupied 2
+
+template<typename TKey, typename TValue>
+struct LegacyHashMap
+{
+    struct Entry
+    {
+        u64 hash = 0;
+        TKey key;
+        TValue value;
+    };
+
+    bool (*Compare)(TKey a, TKey b) = null;
+    u64 (*Hash)(TKey key) = null;
+
+    Slice<Entry> entries = {};
+    s64 occupied = 0;
+    s64 count = 0;
+};
+
+template<typename TKey, typename TValue>
+static void HashMapFree(LegacyHashMap<TKey, TValue> *map)
+{
+    Free(map->entries.data, heap);
+    map->entries = {};
+    map->occupied = 0;
+    map->count = 0;
+}
+
+template<typename TKey, typename TValue>
+static HashMapProbeResult HashMapProbe(LegacyHashMap<TKey, TValue> *map, TKey key)
+{
+    u64 mask = (u64)(map->entries.count - 1);
+    u64 hash = map->Hash(key);
+    if (hash < Legacy_Hash_Map_First_Occupied)
+        hash += Legacy_Hash_Map_First_Occupied;
+
+    u64 index = hash & mask;
+    u64 increment = 1 + (hash >> 27);
+    while (map->entries[index].hash != Legacy_Hash_Map_Never_Occupied)
+    {
+        auto entry = &map->entries[index];
+        if (entry->hash == hash && map->Compare(entry->key, key))
+            return {.hash=hash, .index=(s64)index, .is_present=true};
+
+        index += increment;
+        index &= mask;
+        increment += 1;
+    }
+
+    return {.hash=hash, .index=(s64)index, .is_present=false};
+}
+
+template<typename TKey, typename TValue>
+static void HashMapInsert(LegacyHashMap<TKey, TValue> *map, TKey key, TValue value)
+{
+    typedef typename LegacyHashMap<TKey, TValue>::Entry Entry;
+
+    if ((map->occupied + 1) * 100 >= map->entries.count * 70)
+    {
+        Slice<Entry> old_entries = map->entries;
+
+        s64 new_capacity = Max(map->entries.count * 2, (s64)32);
+        map->entries = AllocSlice<Entry>(new_capacity, heap, true);
+        map->count = 0;
+        map->occupied = 0;
+
+        foreach (i, old_entries)
+        {
+            if (old_entries[i].hash >= Legacy_Hash_Map_First_Occupied)
+                HashMapInsert(map, old_entries[i].key, old_entries[i].value);
+        }
+
+        Free(old_entries.data, heap);
+    }
+
+    auto probe = HashMapProbe(map, key);
+    auto entry = &map->entries[probe.index];
+    if (!probe.is_present)
+    {
+        entry->hash = probe.hash;
+        entry->key = key;
+        map->occupied += 1;
+        map->count += 1;
+    }
+
+    entry->value = value;
+}
+
+template<typename TKey, typename TValue>
+static TValue HashMapFind(LegacyHashMap<TKey, TValue> *map, TKey key)
+{
+    if (map->count <= 0)
+        return {};
+
+    auto probe = HashMapProbe(map, key);
+
+    return probe.is_present ? map->entries[probe.index].value : TValue{};
+}
+
+template<typename TKey, typename TValue>
+static bool HashMapRemove(LegacyHashMap<TKey, TValue> *map, TKey key)
+{
+    if (map->count <= 0)
+        return false;
+
+    auto probe = HashMapProbe(map, key);
+    if (!probe.is_present)
+        return false;
+
+    map->entries[probe.index].hash = Legacy_Hash_Map_Removed;
+    map->count -= 1;
+
+    return true;
+}
+
+static bool CompareU64(u64 a, u64 b)
+{
+    return a == b;
+}
+
+static u64 HashU64(u64 key)
+{
+    return Fnv1aHash(key);
+}
+
+static u64 MakeHashMapKey(s64 i)
+{
+    return (u64)(i + 1) * 0x9e3779b97f4a7c15;
+}
+
+static bool CompareChunkKeys(ChunkKey a, ChunkKey b)
+{
+    return a.x == b.x && a.z == b.z;
+}
+
+static u64 HashChunkKey(ChunkKey key)
+{
+    return Fnv1aHash(&key, sizeof(ChunkKey));
+}
+
+// Chunks are loaded in a square around the camera
+static ChunkKey MakeChunkKey(s64 i)
+{
+    return ChunkKey{.x=(s16)(i % 1024 - 512), .z=(s16)(i / 1024 - 512)};
+}
+
+// Same layout as the key of the framebuffer cache of the OpenGL backend
+struct BenchFramebufferKey
+{
+    u32 color_textures[Gfx_Max_Color_Attachments] = {};
+    u32 depth_texture = 0;
+    u32 stencil_texture = 0;
+};
+
+static bool CompareFramebufferKeys(BenchFramebufferKey a, BenchFramebufferKey b)
+{
+    return memcmp(&a, &b, sizeof(BenchFramebufferKey)) == 0;
+}
+
+static u64 HashFramebufferKey(BenchFramebufferKey key)
+{
+    return Fnv1aHash(&key, sizeof(BenchFramebufferKey));
+}
+
+// A color texture, sometimes a second one, and a depth texture shared between render passes
+static BenchFramebufferKey MakeFramebufferKey(s64 i)
+{
+    BenchFramebufferKey key{};
+    key.color_textures[0] = (u32)(i + 1);
+    if (i % 4 == 0)
+        key.color_textures[1] = (u32)(i + 2);
+    key.depth_texture = (u32)(i % 16 + 1);
+
+    return key;
+}
+
+// Misses are looked up with keys made from [count, 2 * count)
+template<typename TMap, typename TKey>
+static void BenchHashMapOps(String name, TMap *map, TKey (*MakeKey)(s64 i), s64 count)
+{
+    Array<f64> samples = {.allocator=heap};
+    defer(ArrayFree(&samples));
+
+    String ops[] = {"insert", "find_hit", "find_miss", "remove"};
+
+    volatile u64 sink = 0;
+    for (int op = 0; op < (int)StaticArraySize(ops); op += 1)
+    {
+        s64 batch_size = Min(count, (s64)Bench_Batch_Size);
+
+        s64 start = GetTimeInNanoseconds();
+        for (s64 batch = 0; batch < count; batch += batch_size)
+        {
+            s64 batch_start = GetTimeInNanoseconds();
+            for (s64 i = batch; i < batch + batch_size; i += 1)
+            {
+                switch (op)
+                {
+                case 0: HashMapInsert(map, MakeKey(i), (u64)i); break;
+                case 1: sink += HashMapFind(map, MakeKey(i)); break;
+                case 2: sink += HashMapFind(map, MakeKey(i + count)); break;
+                case 3: sink += HashMapRemove(map, MakeKey(i)); break;
+                }
+            }
+
+            ArrayPush(&samples, SecondsSince(batch_start) / batch_size);
+        }
+        f64 total = SecondsSince(start);
+
+        AddResult(TPrintf("%.*s_%.*s", FSTR(name), FSTR(ops[op])), "ops", count, total, &samples);
+    }
+
+    HashMapFree(map);
+}
+
+// Looks up the same count keys over and over, misses use keys made from [count, 2 * count)
+template<typename TMap, typename TKey>
+static void BenchHashMapLookups(String name, TMap *map, TKey (*MakeKey)(s64 i), s64 count, s64 num_lookups)
+{
+    Array<f64> samples = {.allocator=heap};
+    defer(ArrayFree(&samples));
+
+    for (s64 i = 0; i < count; i += 1)
+        HashMapInsert(map, MakeKey(i), (u64)i);
+
+    volatile u64 sink = 0;
+    for (int miss = 0; miss < 2; miss += 1)
+    {
+        s64 start = GetTimeInNanoseconds();
+        for (s64 batch = 0; batch < num_lookups; batch += Bench_Batch_Size)
+        {
+            s64 batch_start = GetTimeInNanoseconds();
+            for (s64 i = batch; i < batch + Bench_Batch_Size; i += 1)
+                sink += HashMapFind(map, MakeKey(i % count + miss * count));
+
+            ArrayPush(&samples, SecondsSince(batch_start) / Bench_Batch_Size);
+        }
+        f64 total = SecondsSince(start);
+
+        AddResult(TPrintf("%.*s_%s", FSTR(name), miss ? "find_miss" : "find_hit"), "ops", num_lookups, total, &samples);
+    }
+
+    HashMapFree(map);
+}
+
+static void BenchHashMap()
+{
+    if (!ShouldRun("hash_map"))
+        return;
+
+    {
+        HashMap<u64, u64> map{};
+        BenchHashMapOps("hash_map", &map, MakeHashMapKey, Bench_Hash_Map_Count);
+
+        LegacyHashMap<u64, u64> legacy{.Compare=CompareU64, .Hash=HashU64};
+        BenchHashMapOps("legacy_hash_map", &legacy, MakeHashMapKey, Bench_Hash_Map_Count);
+    }
+
+    {
+        HashMap<ChunkKey, u64> map{};
+        BenchHashMapOps("hash_map_chunk_key", &map, MakeChunkKey, Bench_Hash_Map_Count);
+
+        LegacyHashMap<ChunkKey, u64> legacy{.Compare=CompareChunkKeys, .Hash=HashChunkKey};
+        BenchHashMapOps("legacy_hash_map_chunk_key", &legacy, MakeChunkKey, Bench_Hash_Map_Count);
+    }
+
+    // The framebuffer cache only holds a few dozen entries, and is mostly looked up
+    {
+        HashMap<BenchFramebufferKey, u64> map{};
+        BenchHashMapLookups("hash_map_framebuffer_key", &map, MakeFramebufferKey, Bench_Hash_Map_Small_Count, Bench_Hash_Map_Count);
+
+        LegacyHashMap<BenchFramebufferKey, u64> legacy{.Compare=CompareFramebufferKeys, .Hash=HashFramebufferKey};
+        BenchHashMapLookups("legacy_hash_map_framebuffer_key", &legacy, MakeFramebufferKey, Bench_Hash_Map_Small_Count, Bench_Hash_Map_Count);
+    }
+}
+
+static void BenchNoise()
+{
+    if (!ShouldRun("noise"))
+        return;
+
+    Array<f64> samples = {.allocator=heap};
+    defer(ArrayFree(&samples));
+
+    // Only the noise parameters of the world are used, no chunk is generated
+    World world{};
+    SetDefaultNoiseParams(&world);
+
+    RNG rng{};
+    RandomSeed(&rng, g_options.seed);
+
+    world.density_params.max_amplitude = PerlinFractalMax(world.density_params.octaves, world.density_params.persistance);
+    world.density_offsets = AllocSlice<Vec3f>(world.density_params.octaves, heap);
+    defer(Free(world.density_offsets.data, heap));
+    PerlinGenerateOffsets(&rng, &world.density_offsets);
+
+    world.continentalness_params.max_amplitude = PerlinFractalMax(world.continentalness_params.octaves, world.continentalness_params.persistance);
+    world.continentalness_offsets = AllocSlice<Vec2f>(world.continentalness_params.octaves, heap);
+    defer(Free(world.continentalness_offsets.data, heap));
+    PerlinGenerateOffsets(&rng, &world.continentalness_offsets);
+
+    String names[] = {"perlin_2d", "perlin_3d", "perlin_fractal_2d", "perlin_fractal_3d"};
+
+    volatile float sink = 0;
+    for (int kernel = 0; kernel < (int)StaticArraySize(names); kernel += 1)
+    {
+        s64 start = GetTimeInNanoseconds();
+        for (s64 batch = 0; batch < Bench_Noise_Count; batch += Bench_Batch_Size)
+        {
+            s64 batch_start = GetTimeInNanoseconds();
+            for (s64 i = batch; i < batch + Bench_Batch_Size; i += 1)
+            {
+                // Walk a 64x64x256 block of samples like chunk generation does
+                float x = (float)(i % 64) * 0.37f;
+                float z = (float)((i / 64) % 64) * 0.37f;
+                float y = (float)(i / (64 * 64)) * 0.37f;
+
+                switch (kernel)
+                {
+                case 0: sink += PerlinNoise(x, z); break;
+                case 1: sink += PerlinNoise(x, y, z); break;
+                case 2: sink += PerlinFractalNoise(world.continentalness_params, world.continentalness_offsets, x, z); break;
+                case 3: sink += PerlinFractalNoise(world.density_params, world.density_offsets, x, y, z); break;
+                }
+            }
+
+            ArrayPush(&samples, SecondsSince(batch_start) / Bench_Batch_Size);
+        }
+        f64 total = SecondsSince(start);
+
+        AddResult(names[kernel], "samples", Bench_Noise_Count, total, &samples);
+    }
+}
+
+struct BenchJob
+{
+    s64 iterations = 0;
+    s64 queued_ns = 0;
+    s64 end_ns = 0;
+    u64 result = 0;
+
+    Job job = {};
+};
+
+static void RunBenchJob(void *data)
+{
+    auto job = (BenchJob *)data;
+
+    // Burn a fixed amount of CPU rather than sleeping or spinning on the clock,
+    // so the cost of a job does not depend on how the threads get scheduled
+    u64 x = (u64)job->iterations;
+    for (s64 i = 0; i < job->iterations; i += 1)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+    }
+
+    job->result = x;
+    job->end_ns = GetTimeInNanoseconds();
+}
+
+static void BenchJobWorker(ThreadGroup *group, void *data)
+{
+    RunBenchJob(data);
+}
+
+static void InitSkewedBenchJobs(BenchJob *jobs)
+{
+    for (int i = 0; i < Bench_Thread_Group_Num_Jobs; i += 1)
+    {
+        jobs[i].iterations = Bench_Fast_Job_Iterations;
+        if (i % Bench_Slow_Job_Interval == 0)
+            jobs[i].iterations *= Bench_Slow_Job_Factor;
+    }
+}
+
+// Samples are the latency of each job, from being added to being done
+static void AddBenchJobResult(String name, BenchJob *jobs, f64 total, Array<f64> *samples)
+{
+    for (int i = 0; i < Bench_Thread_Group_Num_Jobs; i += 1)
+        ArrayPush(samples, (jobs[i].end_ns - jobs[i].queued_ns) * 1e-9);
+
+    AddResult(name, "jobs", Bench_Thread_Group_Num_Jobs, total, samples);
+}
+
+static void BenchThreadGroupScheduling(String name, ThreadGroupScheduling scheduling)
+{
+    Array<f64> samples = {.allocator=heap};
+    defer(ArrayFree(&samples));
+
+    auto jobs = Alloc<BenchJob>(Bench_Thread_Group_Num_Jobs, heap, true);
+    defer(Free(jobs, heap));
+
+    ThreadGroup group{};
+    InitThreadGroup(&group, "Bench Jobs", BenchJobWorker, g_options.num_threads);
+    group.scheduling = scheduling;
+    Start(&group);
+    defer(DestroyThreadGroup(&group));
+
+    InitSkewedBenchJobs(jobs);
+
+    s64 start = GetTimeInNanoseconds();
+    for (int i = 0; i < Bench_Thread_Group_Num_Jobs; i += 1)
+    {
+        jobs[i].queued_ns = GetTimeInNanoseconds();
+        AddWork(&group, &jobs[i]);
+    }
+
+    int num_completed = 0;
+    while (num_completed < Bench_Thread_Group_Num_Jobs)
+    {
+        usleep(Bench_Poll_Interval_In_Us);
+        num_completed += (int)GetCompletedWork(&group).count;
+    }
+    f64 total = SecondsSince(start);
+
+    AddBenchJobResult(name, jobs, total, &samples);
+}
+
+static void BenchJobSystem()
+{
+    Array<f64> samples = {.allocator=heap};
+    defer(ArrayFree(&samples));
+
+    auto jobs = Alloc<BenchJob>(Bench_Thread_Group_Num_Jobs, heap, true);
+    defer(Free(jobs, heap));
+
+    JobSystem system{};
+    InitJobSystem(&system, "Bench Jobs", g_options.num_threads);
+    defer(DestroyJobSystem(&system));
+
+    JobCompletionQueue completed{};
+    InitJobCompletionQueue(&completed);
+    defer(DestroyJobCompletionQueue(&completed));
+
+    InitSkewedBenchJobs(jobs);
+
+    s64 start = GetTimeInNanoseconds();
+    for (int i = 0; i < Bench_Thread_Group_Num_Jobs; i += 1)
+    {
+        jobs[i].queued_ns = GetTimeInNanoseconds();
+        InitJob(&jobs[i].job, RunBenchJob, &jobs[i], JobPriority_Normal, &completed);
+        SubmitJob(&system, &jobs[i].job);
+    }
+
+    int num_completed = 0;
+    while (num_completed < Bench_Thread_Group_Num_Jobs)
+    {
+        usleep(Bench_Poll_Interval_In_Us);
+
+        while (PopCompletedJob(&completed))
+            num_completed += 1;
+    }
+    f64 total = SecondsSince(start);
+
+    AddBenchJobResult("thread_group_skewed_job_system", jobs, total, &samples);
+}
+
+static void BenchThreadGroup()
+{
+    if (!ShouldRun("thread_group"))
+        return;
+
+    BenchThreadGroupScheduling("thread_group_skewed_round_robin", ThreadGroupScheduling_RoundRobin);
+    BenchThreadGroupScheduling("thread_group_skewed_work_stealing", ThreadGroupScheduling_WorkStealing);
+    BenchJobSystem();
+}
+
+struct BenchMPMCQueue
+{
+    MPMCQueue queue = {};
+    u8 *times_popped = null; // Per item
+    s64 num_popped = 0;
+};
+
+struct BenchMPMCQueueThread
+{
+    BenchMPMCQueue *bench = null;
+    pthread_t thread = 0;
+    int index = 0;
+};
+
+static void *BenchMPMCQueueProducer(void *data)
+{
+    auto producer = (BenchMPMCQueueThread *)data;
+
+    // Items start at 1 since null cannot be pushed
+    u64 first_item = (u64)producer->index * Bench_MPMC_Queue_Items_Per_Producer + 1;
+    for (u64 i = 0; i < Bench_MPMC_Queue_Items_Per_Producer; i += 1)
+        MPMCQueuePushWait(&producer->bench->queue, (void *)(first_item + i));
+
+    return null;
+}
+
+static void *BenchMPMCQueueConsumer(void *data)
+{
+    auto consumer = (BenchMPMCQueueThread *)data;
+    BenchMPMCQueue *bench = consumer->bench;
+
+    s64 num_items = (s64)Bench_MPMC_Queue_Num_Producers * Bench_MPMC_Queue_Items_Per_Producer;
+    while (__atomic_load_n(&bench->num_popped, __ATOMIC_RELAXED) < num_items)
+    {
+        void *item = MPMCQueuePop(&bench->queue);
+        if (!item)
+        {
+            sched_yield();
+            continue;
+        }
+
+        __atomic_fetch_add(&bench->times_popped[(u64)item - 1], 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&bench->num_popped, 1, __ATOMIC_RELAXED);
+    }
+
+    return null;
+}
+
+// Returns false if an item was lost or popped more than once. Build with SANITIZE=thread
+// to also have the queue checked for data races
+static bool BenchMPMCQueueStress()
+{
+    if (!ShouldRun("mpmc_queue"))
+        return true;
+
+    Array<f64> samples = {.allocator=heap};
+    defer(ArrayFree(&samples));
+
+    s64 num_items = (s64)Bench_MPMC_Queue_Num_Producers * Bench_MPMC_Queue_Items_Per_Producer;
+
+    BenchMPMCQueue bench{};
+    InitMPMCQueue(&bench.queue, Bench_MPMC_Queue_Capacity);
+    defer(DestroyMPMCQueue(&bench.queue));
+
+    bench.times_popped = Alloc<u8>(num_items, heap, true);
+    defer(Free(bench.times_popped, heap));
+
+    BenchMPMCQueueThread producers[Bench_MPMC_Queue_Num_Producers] = {};
+    BenchMPMCQueueThread consumers[Bench_MPMC_Queue_Num_Consumers] = {};
+
+    s64 start = GetTimeInNanoseconds();
+    for (int i = 0; i < Bench_MPMC_Queue_Num_Consumers; i += 1)
+    {
+        consumers[i] = {.bench=&bench, .index=i};
+        pthread_create(&consumers[i].thread, null, BenchMPMCQueueConsumer, &consumers[i]);
+    }
+    for (int i = 0; i < Bench_MPMC_Queue_Num_Producers; i += 1)
+    {
+        producers[i] = {.bench=&bench, .index=i};
+        pthread_create(&producers[i].thread, null, BenchMPMCQueueProducer, &producers[i]);
+    }
+
+    for (int i = 0; i < Bench_MPMC_Queue_Num_Producers; i += 1)
+        pthread_join(producers[i].thread, null);
+    for (int i = 0; i < Bench_MPMC_Queue_Num_Consumers; i += 1)
+        pthread_join(consumers[i].thread, null);
+    f64 total = SecondsSince(start);
+
+    s64 num_lost = 0;
+    s64 num_duplicated = 0;
+    for (s64 i = 0; i < num_items; i += 1)
+    {
+        if (bench.times_popped[i] == 0)
+            num_lost += 1;
+        else if (bench.times_popped[i] > 1)
+            num_duplicated += 1;
+    }
+
+    if (num_lost > 0 || num_duplicated > 0 || GetMPMCQueueCount(&bench.queue) != 0)
+    {
+        LogError(Log_Bench, "MPMC queue lost %lld items and popped %lld items more than once", num_lost, num_duplicated);
+        return false;
+    }
+
+    AddResult("mpmc_queue_stress", "items", num_items, total, &samples);
+
+    return true;
+}
+
+static void RunEmptyBenchJob(void *data)
+{
+}
+
+// Measures the overhead of the job system itself: submitting, running and handing back jobs that do nothing
+static void BenchJobRoundTrip()
+{
+    if (!ShouldRun("job_round_trip"))
+        return;
+
+    Array<f64> samples = {.allocator=heap};
+    defer(ArrayFree(&samples));
+
+    auto jobs = Alloc<Job>(Bench_Job_Round_Trip_Batch_Size, heap, true);
+    defer(Free(jobs, heap));
+
+    JobSystem system{};
+    InitJobSystem(&system, "Bench Jobs", g_options.num_threads);
+    defer(DestroyJobSystem(&system));
+
+    JobCompletionQueue completed{};
+    InitJobCompletionQueue(&completed);
+    defer(DestroyJobCompletionQueue(&completed));
+
+    s64 start = GetTimeInNanoseconds();
+    for (int batch = 0; batch < Bench_Job_Round_Trip_Count / Bench_Job_Round_Trip_Batch_Size; batch += 1)
+    {
+        s64 batch_start = GetTimeInNanoseconds();
+        for (int i = 0; i < Bench_Job_Round_Trip_Batch_Size; i += 1)
+        {
+            InitJob(&jobs[i], RunEmptyBenchJob, null, JobPriority_Normal, &completed);
+            SubmitJob(&system, &jobs[i]);
+        }
+
+        int num_completed = 0;
+        while (num_completed < Bench_Job_Round_Trip_Batch_Size)
+        {
+            if (PopCompletedJob(&completed))
+                num_completed += 1;
+            else
+                sched_yield();
+        }
+
+        ArrayPush(&samples, SecondsSince(batch_start) / Bench_Job_Round_Trip_Batch_Size);
+    }
+    f64 total = SecondsSince(start);
+
+    AddResult("job_round_trip", "jobs", Bench_Job_Round_Trip_Count, total, &samples);
+}
+
+static void CountBenchJob(void *data)
+{
+    __atomic_fetch_add((u8 *)data, 1, __ATOMIC_RELAXED);
+}
+
+// Submits more jobs than the submission and completion queues can hold before handing back any of
+// them, like the world does when it queues a big grid of chunks at once. Returns false if a job did
+// not run exactly once or was not handed back. If workers waited for room in the completion queue
+// this would never return, since we only drain it once everything is submitted
+static bool BenchJobOverflow()
+{
+    if (!ShouldRun("job_overflow"))
+        return true;
+
+    Array<f64> samples = {.allocator=heap};
+    defer(ArrayFree(&samples));
+
+    auto jobs = Alloc<Job>(Bench_Job_Overflow_Count, heap, true);
+    defer(Free(jobs, heap));
+
+    auto times_run = Alloc<u8>(Bench_Job_Overflow_Count, heap, true);
+    defer(Free(times_run, heap));
+
+    auto times_completed = Alloc<u8>(Bench_Job_Overflow_Count, heap, true);
+    defer(Free(times_completed, heap));
+
+    JobSystem system{};
+    InitJobSystem(&system, "Bench Jobs", g_options.num_threads);
+    defer(DestroyJobSystem(&system));
+
+    JobCompletionQueue completed{};
+    InitJobCompletionQueue(&completed);
+    defer(DestroyJobCompletionQueue(&completed));
+
+    s64 start = GetTimeInNanoseconds();
+    for (s64 i = 0; i < Bench_Job_Overflow_Count; i += 1)
+    {
+        InitJob(&jobs[i], CountBenchJob, &times_run[i], JobPriority_Normal, &completed);
+        SubmitJob(&system, &jobs[i]);
+    }
+
+    s64 num_completed = 0;
+    while (num_completed < Bench_Job_Overflow_Count)
+    {
+        Job *job = PopCompletedJob(&completed);
+        if (!job)
+        {
+            sched_yield();
+            continue;
+        }
+
+        times_completed[job - jobs] += 1;
+        num_completed += 1;
+    }
+    f64 total = SecondsSince(start);
+
+    s64 num_bad = 0;
+    for (s64 i = 0; i < Bench_Job_Overflow_Count; i += 1)
+    {
+        if (__atomic_load_n(&times_run[i], __ATOMIC_RELAXED) != 1 || times_completed[i] != 1)
+            num_bad += 1;
+    }
+
+    if (num_bad > 0 || GetNumCompletedJobs(&completed) != 0)
+    {
+        LogError(Log_Bench, "Job overflow: %lld jobs did not run or were not handed back exactly once", num_bad);
+        return false;
+    }
+
+    AddResult("job_overflow", "jobs", Bench_Job_Overflow_Count, total, &samples);
+
+    return true;
+}
+
+// Allocates chunks in batches and writes their blocks like the generation does, then frees
+// them, once with the chunk pool and once like chunks used to be allocated from the heap
+static void BenchChunkAlloc()
+{
+    if (!ShouldRun("chunk_alloc"))
+        return;
+
+    Array<f64> samples = {.allocator=heap};
+    defer(ArrayFree(&samples));
+
+    Chunk *chunks[Bench_Chunk_Alloc_Batch_Size];
+    s64 num_chunks = Bench_Chunk_Alloc_Batch_Size * Bench_Chunk_Alloc_Num_Batches;
+
+    for (int use_pool = 1; use_pool >= 0; use_pool -= 1)
+    {
+        ChunkPool pool{};
+        InitChunkPool(&pool);
+
+        s64 start = GetTimeInNanoseconds();
+        for (int batch = 0; batch < Bench_Chunk_Alloc_Num_Batches; batch += 1)
+        {
+            s64 batch_start = GetTimeInNanoseconds();
+            for (int i = 0; i < Bench_Chunk_Alloc_Batch_Size; i += 1)
+            {
+                chunks[i] = use_pool ? AllocChunk(&pool) : Alloc<Chunk>(heap);
+                memset(chunks[i]->blocks, batch + 1, sizeof(chunks[i]->blocks));
+            }
+
+            for (int i = 0; i < Bench_Chunk_Alloc_Batch_Size; i += 1)
+            {
+                if (use_pool)
+                    FreeChunk(&pool, chunks[i]);
+                else
+                    Free(chunks[i], heap);
+            }
+
+            ArrayPush(&samples, SecondsSince(batch_start) / Bench_Chunk_Alloc_Batch_Size);
+        }
+        f64 total = SecondsSince(start);
+
+        DestroyChunkPool(&pool);
+
+        AddResult(use_pool ? "chunk_alloc_pool" : "chunk_alloc_heap", "chunks", num_chunks, total, &samples);
+    }
+}
+
+struct BenchMockGpuBuffer
+{
+    GfxBuffer *buffer = null;
+    u8 *memory = null;
+    s64 size = 0;
+};
+
+struct BenchGfxAllocation
+{
+    u64 *ptr = null;
+    s64 num_words = 0;
+    u64 pattern = 0;
+    u64 serial = 0;
+    GfxBuffer *buffer = null;
+};
+
+// Stands in for the GPU in the gfx_allocator scenario. Buffers are heap memory,
+// and the fence of a frame is signaled once we say the GPU finished that frame
+struct BenchMockGpu
+{
+    Array<BenchMockGpuBuffer> buffers = {};
+    Array<BenchGfxAllocation> in_flight = {};
+    u64 last_fence = 0;
+    u64 completed_fence = 0;
+    bool failed = false;
+};
+
+static BenchMockGpu g_mock_gpu;
+
+static BenchMockGpuBuffer *FindMockGpuBuffer(GfxBuffer *buffer)
+{
+    foreach (i, g_mock_gpu.buffers)
+    {
+        if (g_mock_gpu.buffers[i].buffer == buffer)
+            return &g_mock_gpu.buffers[i];
+    }
+
+    return null;
+}
+
+static void *MockGpuCreateBuffer(String name, s64 size, GfxBuffer *buffer)
+{
+    (void)name;
+
+    u8 *memory = Alloc<u8>(size, heap);
+    ArrayPush(&g_mock_gpu.buffers, {.buffer=buffer, .memory=memory, .size=size});
+
+    return memory;
+}
+
+static void MockGpuDestroyBuffer(GfxBuffer *buffer)
+{
+    foreach (i, g_mock_gpu.in_flight)
+    {
+        if (g_mock_gpu.in_flight[i].buffer == buffer)
+        {
+            LogError(Log_Bench, "Gfx allocator: buffer destroyed while frame %llu still uses it", g_mock_gpu.in_flight[i].serial);
+            g_mock_gpu.failed = true;
+            break;
+        }
+    }
+
+    foreach (i, g_mock_gpu.buffers)
+    {
+        if (g_mock_gpu.buffers[i].buffer == buffer)
+        {
+            Free(g_mock_gpu.buffers[i].memory, heap);
+            ArrayOrderedRemoveAt(&g_mock_gpu.buffers, i);
+            return;
+        }
+    }
+
+    LogError(Log_Bench, "Gfx allocator: destroyed a buffer that does not exist");
+    g_mock_gpu.failed = true;
+}
+
+static void MockGpuFlushBuffer(GfxBuffer *buffer, s64 offset, s64 size)
+{
+    BenchMockGpuBuffer *mock = FindMockGpuBuffer(buffer);
+    if (!mock || offset < 0 || size <= 0 || offset + size > mock->size)
+    {
+        LogError(Log_Bench, "Gfx allocator: flushed [%lld, %lld) which is not inside of a live buffer", offset, offset + size);
+        g_mock_gpu.failed = true;
+    }
+}
+
+static s64 MockGpuGetBufferAlignment()
+{
+    return Bench_Gfx_Allocator_Alignment;
+}
+
+static GfxFence MockGpuCreateFence()
+{
+    g_mock_gpu.last_fence += 1;
+
+    return {.handle=g_mock_gpu.last_fence};
+}
+
+static void MockGpuDestroyFence(GfxFence *fence)
+{
+    *fence = {};
+}
+
+static bool MockGpuIsFenceSignaled(GfxFence *fence)
+{
+    return fence->handle <= g_mock_gpu.completed_fence;
+}
+
+// Finishes the frames up to fence, after checking that nothing overwrote what they allocated
+static void CompleteMockGpuFrames(u64 fence)
+{
+    for (s64 i = 0; i < g_mock_gpu.in_flight.count; i += 1)
+    {
+        BenchGfxAllocation allocation = g_mock_gpu.in_flight[i];
+        if (allocation.serial > fence)
+            continue;
+
+        for (s64 word = 0; word < allocation.num_words && !g_mock_gpu.failed; word += 1)
+        {
+            if (allocation.ptr[word] != allocation.pattern)
+            {
+                LogError(Log_Bench, "Gfx allocator: memory of frame %llu was overwritten before the GPU was done with it", allocation.serial);
+                g_mock_gpu.failed = true;
+            }
+        }
+
+        g_mock_gpu.in_flight[i] = g_mock_gpu.in_flight[g_mock_gpu.in_flight.count - 1];
+        g_mock_gpu.in_flight.count -= 1;
+        i -= 1;
+    }
+
+    g_mock_gpu.completed_fence = Max(g_mock_gpu.completed_fence, fence);
+}
+
+// Runs the frame data allocator on mock buffers, with the GPU a few frames behind and
+// frames that do not fit once in a while. Checks that the ring wraps around, that memory
+// is only reused once the fence of its frame is signaled, and that growing keeps the old
+// buffer alive until the frames that used it are done
+static bool BenchGfxAllocator()
+{
+    if (!ShouldRun("gfx_allocator"))
+        return true;
+
+    Array<f64> samples = {.allocator=heap};
+    defer(ArrayFree(&samples));
+
+    g_mock_gpu = {};
+    g_mock_gpu.buffers.allocator = heap;
+    g_mock_gpu.in_flight.allocator = heap;
+    defer({
+        ArrayFree(&g_mock_gpu.buffers);
+        ArrayFree(&g_mock_gpu.in_flight);
+    });
+
+    GfxAllocatorBackend backend = {
+        .CreateBuffer=MockGpuCreateBuffer,
+        .DestroyBuffer=MockGpuDestroyBuffer,
+        .FlushBuffer=MockGpuFlushBuffer,
+        .GetBufferAlignment=MockGpuGetBufferAlignment,
+        .CreateFence=MockGpuCreateFence,
+        .DestroyFence=MockGpuDestroyFence,
+        .IsFenceSignaled=MockGpuIsFenceSignaled,
+    };
+
+    GfxAllocator allocator{};
+    InitGfxAllocator(&allocator, "Bench Gfx Allocator", Bench_Gfx_Allocator_Initial_Capacity, &backend);
+    Allocator alloc = MakeAllocator(&allocator);
+
+    RNG rng{};
+    RandomSeed(&rng, g_options.seed);
+
+    s64 num_wraps = 0;
+    s64 num_grows_in_flight = 0;
+    GfxBuffer *last_buffer = null;
+    s64 last_offset = 0;
+
+    s64 start = GetTimeInNanoseconds();
+    for (u64 frame = 1; frame <= Bench_Gfx_Allocator_Num_Frames && !g_mock_gpu.failed; frame += 1)
+    {
+        s64 frame_start = GetTimeInNanoseconds();
+
+        if (frame > Bench_Gfx_Allocator_Frames_In_Flight)
+            CompleteMockGpuFrames(frame - Bench_Gfx_Allocator_Frames_In_Flight - 1);
+
+        ReclaimGfxAllocator(&allocator);
+
+        bool spike = frame % Bench_Gfx_Allocator_Spike_Interval == 0;
+        int num_allocs = spike ? Bench_Gfx_Allocator_Spike_Num_Allocs : 1 + RandomGetNext(&rng) % Bench_Gfx_Allocator_Max_Allocs_Per_Frame;
+        for (int i = 0; i < num_allocs; i += 1)
+        {
+            s64 size = spike ? Bench_Gfx_Allocator_Spike_Alloc_Size : 8 * (1 + RandomGetNext(&rng) % (Bench_Gfx_Allocator_Max_Alloc_Size / 8));
+
+            int num_grows = allocator.num_grows;
+            auto ptr = (u64 *)Alloc(size, alloc);
+            if (allocator.num_grows > num_grows && g_mock_gpu.in_flight.count > 0)
+                num_grows_in_flight += 1;
+
+            GfxBuffer *buffer = GetBuffer(&allocator, ptr);
+            s64 offset = GetBufferOffset(&allocator, ptr);
+            BenchMockGpuBuffer *mock = FindMockGpuBuffer(buffer);
+            if (!mock || (u8 *)ptr != mock->memory + offset || offset % Bench_Gfx_Allocator_Alignment != 0 || offset + size > mock->size)
+            {
+                LogError(Log_Bench, "Gfx allocator: allocation of %lld bytes at offset %lld is not inside of the buffer it was made in", size, offset);
+                g_mock_gpu.failed = true;
+                break;
+            }
+
+            if (buffer == last_buffer && offset < last_offset)
+                num_wraps += 1;
+            last_buffer = buffer;
+            last_offset = offset;
+
+            BenchGfxAllocation allocation = {
+                .ptr=ptr,
+                .num_words=size / 8,
+                .pattern=(frame << 32) | (u64)i,
+                .serial=frame,
+                .buffer=buffer,
+            };
+            for (s64 word = 0; word < allocation.num_words; word += 1)
+                ptr[word] = allocation.pattern;
+
+            ArrayPush(&g_mock_gpu.in_flight, allocation);
+        }
+
+        EndGfxAllocatorFrame(&allocator);
+
+        ArrayPush(&samples, SecondsSince(frame_start));
+    }
+
+    CompleteMockGpuFrames(g_mock_gpu.last_fence);
+    ReclaimGfxAllocator(&allocator);
+    f64 total = SecondsSince(start);
+
+    GfxAllocatorStats stats = GetGfxAllocatorStats(&allocator);
+    if (!g_mock_gpu.failed && (stats.used != 0 || stats.num_frames_in_flight != 0 || stats.num_retired_buffers != 0 || g_mock_gpu.buffers.count != 1))
+    {
+        LogError(Log_Bench, "Gfx allocator: %lld bytes used, %d frames in flight, %d retired buffers and %lld buffers alive once the GPU is idle",
+            stats.used, stats.num_frames_in_flight, stats.num_retired_buffers, g_mock_gpu.buffers.count);
+        g_mock_gpu.failed = true;
+    }
+
+    if (!g_mock_gpu.failed && (num_wraps == 0 || num_grows_in_flight == 0))
+    {
+        LogError(Log_Bench, "Gfx allocator: wrapped around %lld times and grew %lld times with frames in flight, both paths have to run", num_wraps, num_grows_in_flight);
+        g_mock_gpu.failed = true;
+    }
+
+    DestroyGfxAllocator(&allocator);
+
+    if (g_mock_gpu.failed)
+        return false;
+
+    LogMessage(Log_Bench, "Gfx allocator: wrapped around %lld times, grew %d times to %lld bytes", num_wraps, stats.num_grows, stats.capacity);
+
+    AddResult("gfx_allocator", "frames", Bench_Gfx_Allocator_Num_Frames, total, &samples);
+
+    return true;
+}
+
+// Walks the blocks of the allocator in memory order and checks that they cover the whole
+// range without gaps, that adjacent free blocks were merged, and that the live blocks
+// are the ones we think we allocated
+static bool CheckOffsetAllocator(OffsetAllocator *allocator, Array<OffsetAllocation> live)
+{
+    OffsetAllocatorStats stats = GetOffsetAllocatorStats(allocator);
+
+    u32 index = allocator->last_physical;
+    while (index != Offset_Allocator_Invalid_Node && allocator->nodes[index].prev_physical != Offset_Allocator_Invalid_Node)
+        index = allocator->nodes[index].prev_physical;
+
+    u32 end = 0;
+    u32 used_size = 0;
+    u32 num_used = 0;
+    u32 num_free = 0;
+    bool prev_free = false;
+    while (index != Offset_Allocator_Invalid_Node)
+    {
+        OffsetAllocatorNode *node = &allocator->nodes[index];
+        if (node->offset != end || node->size == 0)
+        {
+            LogError(Log_Bench, "Offset allocator: block [%u, %u) does not start where the previous one ended (%u)", node->offset, node->offset + node->size, end);
+            return false;
+        }
+
+        if (!node->used && prev_free)
+        {
+            LogError(Log_Bench, "Offset allocator: free block at %u was not merged with the previous one", node->offset);
+            return false;
+        }
+
+        if (node->used)
+        {
+            used_size += node->size;
+            num_used += 1;
+        }
+        else
+        {
+            num_free += 1;
+        }
+
+        end = node->offset + node->size;
+        prev_free = !node->used;
+        index = node->next_physical;
+    }
+
+    if (end != stats.size || used_size != stats.used_size || num_used != (u32)live.count || num_used != stats.num_allocations || num_free != stats.num_free_blocks)
+    {
+        LogError(Log_Bench, "Offset allocator: blocks cover %u/%u units, %u/%u used in %u/%u allocations (%lld live), %u/%u free blocks",
+            end, stats.size, used_size, stats.used_size, num_used, stats.num_allocations, live.count, num_free, stats.num_free_blocks);
+        return false;
+    }
+
+    foreach (i, live)
+    {
+        OffsetAllocatorNode *node = &allocator->nodes[live[i].node];
+        if (!node->used || node->offset != live[i].offset || node->size != live[i].size)
+        {
+            LogError(Log_Bench, "Offset allocator: allocation [%u, %u) is not live anymore", live[i].offset, live[i].offset + live[i].size);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Randomly allocates, frees and grows like the chunk mesh pools do, and checks that live
+// allocations never overlap, that the bookkeeping matches what was allocated and that
+// freeing everything merges the whole range back into a single free block
+static bool BenchOffsetAllocator()
+{
+    if (!ShouldRun("offset_allocator"))
+        return true;
+
+    Array<f64> samples = {.allocator=heap};
+    defer(ArrayFree(&samples));
+
+    Array<OffsetAllocation> live = {.allocator=heap};
+    defer(ArrayFree(&live));
+
+    // Which allocation owns each unit, to catch overlaps the allocator itself would not see
+    auto owners = Alloc<u8>(Bench_Offset_Allocator_Max_Size, heap, true);
+    defer(Free(owners, heap));
+
+    OffsetAllocator allocator{};
+    InitOffsetAllocator(&allocator, Bench_Offset_Allocator_Initial_Size);
+    defer(DestroyOffsetAllocator(&allocator));
+
+    RNG rng{};
+    RandomSeed(&rng, g_options.seed);
+
+    s64 num_grows = 0;
+    s64 num_failed = 0;
+
+    s64 start = GetTimeInNanoseconds();
+    s64 batch_start = start;
+    for (s64 i = 0; i < Bench_Offset_Allocator_Num_Ops; i += 1)
+    {
+        bool alloc = live.count == 0 || (live.count < Bench_Offset_Allocator_Max_Live && RandomGetNext(&rng) % 8 < 5);
+        if (alloc)
+        {
+            u32 size = 1 + RandomGetNext(&rng) % Bench_Offset_Allocator_Max_Alloc_Size;
+            OffsetAllocation allocation = AllocOffset(&allocator, size);
+            while (IsNull(allocation) && allocator.size < Bench_Offset_Allocator_Max_Size)
+            {
+                GrowOffsetAllocator(&allocator, allocator.size * 2);
+                num_grows += 1;
+
+                allocation = AllocOffset(&allocator, size);
+            }
+
+            if (IsNull(allocation))
+            {
+                num_failed += 1;
+                continue;
+            }
+
+            if (allocation.size != size || allocation.offset + allocation.size > allocator.size)
+            {
+                LogError(Log_Bench, "Offset allocator: asked for %u units, got [%u, %u) in a range of %u", size, allocation.offset, allocation.offset + allocation.size, allocator.size);
+                return false;
+            }
+
+            for (u32 unit = allocation.offset; unit < allocation.offset + allocation.size; unit += 1)
+            {
+                if (owners[unit])
+                {
+                    LogError(Log_Bench, "Offset allocator: allocation [%u, %u) overlaps a live allocation at %u", allocation.offset, allocation.offset + allocation.size, unit);
+                    return false;
+                }
+
+                owners[unit] = 1;
+            }
+
+            ArrayPush(&live, allocation);
+        }
+        else
+        {
+            s64 index = RandomGetNext(&rng) % live.count;
+            OffsetAllocation allocation = live[index];
+            live[index] = live[live.count - 1];
+            live.count -= 1;
+
+            memset(owners + allocation.offset, 0, allocation.size);
+            FreeOffset(&allocator, allocation);
+        }
+
+        if ((i + 1) % Bench_Offset_Allocator_Check_Interval == 0)
+        {
+            ArrayPush(&samples, SecondsSince(batch_start) / Bench_Offset_Allocator_Check_Interval);
+
+            if (!CheckOffsetAllocator(&allocator, live))
+                return false;
+
+            batch_start = GetTimeInNanoseconds();
+        }
+    }
+
+    foreach (i, live)
+        FreeOffset(&allocator, live[i]);
+    live.count = 0;
+
+    f64 total = SecondsSince(start);
+
+    if (!CheckOffsetAllocator(&allocator, live))
+        return false;
+
+    OffsetAllocatorStats stats = GetOffsetAllocatorStats(&allocator);
+    if (stats.used_size != 0 || stats.num_free_blocks != 1 || stats.largest_free_block != stats.size)
+    {
+        LogError(Log_Bench, "Offset allocator: %u units used and %u free blocks after freeing everything, largest is %u/%u", stats.used_size, stats.num_free_blocks, stats.largest_free_block, stats.size);
+        return false;
+    }
+
+    if (num_grows == 0)
+    {
+        LogError(Log_Bench, "Offset allocator: the allocator never grew, the grow path was not checked");
+        return false;
+    }
+
+    LogMessage(Log_Bench, "Offset allocator: grew %lld times to %u units, %lld allocations did not fit", num_grows, stats.size, num_failed);
+
+    AddResult("offset_allocator", "ops", Bench_Offset_Allocator_Num_Ops, total, &samples);
+
+    return true;
+}
+
+// Looks up chunks and their neighbors like QueueChunkGeneration does, once with the chunks
+// inside of the chunk grid and once with the grid moved away so they are all in the hash map
+// Checks that every chunk is found at its coordinates, and that the coordinates around them are empty
+static bool CheckChunkGridLookups(ChunkGrid *grid, Chunk **chunks, int num_chunks)
+{
+    for (int i = 0; i < num_chunks; i += 1)
+    {
+        Chunk *found = FindChunk(grid, chunks[i]->x, chunks[i]->z);
+        if (found != chunks[i])
+        {
+            LogError(Log_Bench, "Chunk lookup: chunk %d %d is not found with the grid at %d %d", chunks[i]->x, chunks[i]->z, grid->min_x, grid->min_z);
+            return false;
+        }
+    }
+
+    s16 min = -Bench_Chunk_Lookup_Grid_Size / 2 - 1;
+    s16 max = Bench_Chunk_Lookup_Grid_Size / 2;
+    for (s16 i = min; i <= max; i += 1)
+    {
+        if (FindChunk(grid, i, min) || FindChunk(grid, i, max) || FindChunk(grid, min, i) || FindChunk(grid, max, i))
+        {
+            LogError(Log_Bench, "Chunk lookup: found a chunk where there is none with the grid at %d %d", grid->min_x, grid->min_z);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool BenchChunkLookup()
+{
+    if (!ShouldRun("chunk_lookup"))
+        return true;
+
+    Array<f64> samples = {.allocator=heap};
+    defer(ArrayFree(&samples));
+
+    ChunkGrid grid{};
+    InitChunkGrid(&grid, 0, 0);
+    defer(DestroyChunkGrid(&grid));
+
+    // Only the position of the chunks is used, so the block data is never committed
+    int num_chunks = Bench_Chunk_Lookup_Grid_Size * Bench_Chunk_Lookup_Grid_Size;
+    auto chunks = Alloc<Chunk *>(num_chunks, heap);
+    defer({
+        for (int i = 0; i < num_chunks; i += 1)
+            Free(chunks[i], heap);
+        Free(chunks, heap);
+    });
+
+    for (int i = 0; i < num_chunks; i += 1)
+    {
+        chunks[i] = (Chunk *)Alloc(sizeof(Chunk), heap);
+        chunks[i]->x = (s16)(i % Bench_Chunk_Lookup_Grid_Size - Bench_Chunk_Lookup_Grid_Size / 2);
+        chunks[i]->z = (s16)(i / Bench_Chunk_Lookup_Grid_Size - Bench_Chunk_Lookup_Grid_Size / 2);
+        AddChunkToGrid(&grid, chunks[i]);
+    }
+
+    String names[] = {"chunk_lookup_grid", "chunk_lookup_hash_map"};
+    int neighbor_offsets[][2] = {{0, 0}, {1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+
+    RNG rng{};
+    volatile s64 sink = 0;
+    for (int pass = 0; pass < (int)StaticArraySize(names); pass += 1)
+    {
+        if (pass == 1)
+            RecenterChunkGrid(&grid, Chunk_Grid_Size * 4, 0);
+
+        RandomSeed(&rng, g_options.seed);
+
+        s64 start = GetTimeInNanoseconds();
+        for (s64 batch = 0; batch < Bench_Chunk_Lookup_Count; batch += Bench_Batch_Size)
+        {
+            s64 batch_start = GetTimeInNanoseconds();
+            for (s64 i = batch; i < batch + Bench_Batch_Size; i += 1)
+            {
+                Chunk *chunk = chunks[RandomGetNext(&rng) % num_chunks];
+                int neighbor = (int)(i % StaticArraySize(neighbor_offsets));
+                sink += FindChunk(&grid, (s16)(chunk->x + neighbor_offsets[neighbor][0]), (s16)(chunk->z + neighbor_offsets[neighbor][1])) != null;
+            }
+
+            ArrayPush(&samples, SecondsSince(batch_start) / Bench_Batch_Size);
+        }
+        f64 total = SecondsSince(start);
+
+        AddResult(names[pass], "lookups", Bench_Chunk_Lookup_Count, total, &samples);
+    }
+
+    // Move the grid around the chunks so they keep going in and out of it, in small steps
+    // like the camera does and in jumps that leave no slot in common with the previous grid
+    RandomSeed(&rng, g_options.seed);
+
+    s32 center_x = Chunk_Grid_Size * 4;
+    s32 center_z = 0;
+    int num_jumps_past_grid = 0;
+    for (int i = 0; i < Bench_Chunk_Lookup_Num_Recenters; i += 1)
+    {
+        s32 new_center_x, new_center_z;
+        if (i % Bench_Chunk_Lookup_Jump_Interval == 0)
+        {
+            new_center_x = (s32)(RandomGetNext(&rng) % (Chunk_Grid_Size * 2 + 1)) - Chunk_Grid_Size;
+            new_center_z = (s32)(RandomGetNext(&rng) % (Chunk_Grid_Size * 2 + 1)) - Chunk_Grid_Size;
+        }
+        else
+        {
+            new_center_x = center_x + (s32)(RandomGetNext(&rng) % (Bench_Chunk_Lookup_Recenter_Step * 2 + 1)) - Bench_Chunk_Lookup_Recenter_Step;
+            new_center_z = center_z + (s32)(RandomGetNext(&rng) % (Bench_Chunk_Lookup_Recenter_Step * 2 + 1)) - Bench_Chunk_Lookup_Recenter_Step;
+            new_center_x = Clamp(new_center_x, -Chunk_Grid_Size, Chunk_Grid_Size);
+            new_center_z = Clamp(new_center_z, -Chunk_Grid_Size, Chunk_Grid_Size);
+        }
+
+        if (Abs(new_center_x - center_x) >= Chunk_Grid_Size || Abs(new_center_z - center_z) >= Chunk_Grid_Size)
+            num_jumps_past_grid += 1;
+
+        center_x = new_center_x;
+        center_z = new_center_z;
+        RecenterChunkGrid(&grid, center_x, center_z);
+
+        if (!CheckChunkGridLookups(&grid, chunks, num_chunks))
+            return false;
+    }
+
+    if (num_jumps_past_grid == 0)
+    {
+        LogError(Log_Bench, "Chunk lookup: the grid never jumped further than its size");
+        return false;
+    }
+
+    return true;
+}
+
+static Chunk *AllocBenchChunk(s16 x, s16 z)
+{
+    Chunk *chunk = new (Alloc(sizeof(Chunk), heap)) Chunk;
+    chunk->x = x;
+    chunk->z = z;
+    memset(chunk->blocks, Block_Air, sizeof(chunk->blocks));
+
+    return chunk;
+}
+
+static void SetBlock(Chunk *chunk, int x, int y, int z, Block block)
+{
+    chunk->blocks[y * Chunk_Size * Chunk_Size + z * Chunk_Size + x] = block;
+}
+
+static bool CheckFacesConnected(const char *what, SectionConnectivity connectivity, BlockFace a, BlockFace b, bool expected)
+{
+    if (AreSectionFacesConnected(connectivity, a, b) != expected || AreSectionFacesConnected(connectivity, b, a) != expected)
+    {
+        LogError(Log_Bench, "Connectivity: %s, faces %u and %u should%s be connected", what, a, b, expected ? "" : " not");
+        return false;
+    }
+
+    return true;
+}
+
+// Walls off one chunk of a 3x3 world from the camera, which stands in the middle chunk.
+// The walled off chunk must not be visible, and all the others must be
+static bool CheckChunkVisibilityBehindWall()
+{
+    World world{};
+    SlotMapSetAllocator(&world.chunks, heap);
+    InitChunkGrid(&world.chunk_grid, 0, 0);
+
+    Chunk *chunks[3][3] = {};
+    for (int z = 0; z < 3; z += 1)
+    {
+        for (int x = 0; x < 3; x += 1)
+        {
+            Chunk *chunk = AllocBenchChunk((s16)(x - 1), (s16)(z - 1));
+            chunk->is_generated = true;
+            chunk->handle = SlotMapAdd(&world.chunks, chunk);
+            AddChunkToGrid(&world.chunk_grid, chunk);
+            chunks[z][x] = chunk;
+        }
+    }
+
+    defer({
+        for (int z = 0; z < 3; z += 1)
+        {
+            for (int x = 0; x < 3; x += 1)
+            {
+                RemoveChunkRenderRecord(&g_chunk_render_table, chunks[z][x]);
+                RemoveChunkFromGrid(&world.chunk_grid, chunks[z][x]);
+                Free(chunks[z][x], heap);
+            }
+        }
+
+        DestroyChunkGrid(&world.chunk_grid);
+        SlotMapFree(&world.chunks);
+    });
+
+    // The east side of the camera chunk is opaque from top to bottom
+    Chunk *center = chunks[1][1];
+    for (int y = 0; y < Chunk_Height; y += 1)
+    {
+        for (int z = 0; z < Chunk_Size; z += 1)
+            SetBlock(center, Chunk_Size - 1, y, z, Block_Stone);
+    }
+
+    for (int z = 0; z < 3; z += 1)
+    {
+        for (int x = 0; x < 3; x += 1)
+        {
+            Chunk *chunk = chunks[z][x];
+            chunk->east = x < 2 ? chunks[z][x + 1]->handle : ChunkHandle{};
+            chunk->west = x > 0 ? chunks[z][x - 1]->handle : ChunkHandle{};
+            chunk->north = z < 2 ? chunks[z + 1][x]->handle : ChunkHandle{};
+            chunk->south = z > 0 ? chunks[z - 1][x]->handle : ChunkHandle{};
+
+            ComputeChunkConnectivity(chunk, chunk->section_connectivity);
+            AddOrUpdateChunkRenderRecord(&g_chunk_render_table, chunk);
+        }
+    }
+
+    g_frame_index += 1;
+    Vec3f camera_position = {Chunk_Size * 0.5f, Chunk_Height * 0.5f + 0.5f, Chunk_Size * 0.5f};
+    UpdateChunkVisibility(&world, camera_position, Chunk_Size * 4);
+
+    for (int z = 0; z < 3; z += 1)
+    {
+        for (int x = 0; x < 3; x += 1)
+        {
+            Chunk *chunk = chunks[z][x];
+            bool expected = chunk != chunks[1][2];
+            bool visible = (g_chunk_render_table.flags[chunk->render_index] & ChunkRenderFlag_Visible) != 0;
+            if (visible != expected)
+            {
+                LogError(Log_Bench, "Connectivity: chunk %d %d should%s be visible from behind a wall", chunk->x, chunk->z, expected ? "" : " not");
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Checks the connectivity of a few known sections, and that culling hides a chunk behind a wall
+static bool BenchConnectivity()
+{
+    if (!ShouldRun("connectivity"))
+        return true;
+
+    Array<f64> samples = {.allocator=heap};
+    defer(ArrayFree(&samples));
+
+    Chunk *air = AllocBenchChunk(0, 0);
+    Chunk *layer = AllocBenchChunk(0, 0);
+    Chunk *pocket = AllocBenchChunk(0, 0);
+    defer({
+        Free(air, heap);
+        Free(layer, heap);
+        Free(pocket, heap);
+    });
+
+    // A full opaque layer in the middle of the section
+    for (int z = 0; z < Chunk_Size; z += 1)
+    {
+        for (int x = 0; x < Chunk_Size; x += 1)
+            SetBlock(layer, x, Chunk_Section_Height / 2, z, Block_Stone);
+    }
+
+    // An opaque section with 2x2x2 blocks of air in the middle
+    for (int y = 0; y < Chunk_Section_Height; y += 1)
+    {
+        for (int z = 0; z < Chunk_Size; z += 1)
+        {
+            for (int x = 0; x < Chunk_Size; x += 1)
+            {
+                bool inside = x >= Chunk_Size / 2 - 1 && x <= Chunk_Size / 2
+                    && y >= Chunk_Section_Height / 2 - 1 && y <= Chunk_Section_Height / 2
+                    && z >= Chunk_Size / 2 - 1 && z <= Chunk_Size / 2;
+                SetBlock(pocket, x, y, z, inside ? Block_Air : Block_Stone);
+            }
+        }
+    }
+
+    SectionConnectivity air_connectivity = 0;
+    SectionConnectivity layer_connectivity = 0;
+    SectionConnectivity pocket_connectivity = 0;
+
+    s64 start = GetTimeInNanoseconds();
+    for (int i = 0; i < Bench_Connectivity_Iterations; i += 1)
+    {
+        s64 iteration_start = GetTimeInNanoseconds();
+
+        air_connectivity = ComputeSectionConnectivity(air, 0);
+        layer_connectivity = ComputeSectionConnectivity(layer, 0);
+        pocket_connectivity = ComputeSectionConnectivity(pocket, 0);
+
+        ArrayPush(&samples, SecondsSince(iteration_start) / 3);
+    }
+    f64 total = SecondsSince(start);
+
+    if (air_connectivity != Section_Connectivity_All)
+    {
+        LogError(Log_Bench, "Connectivity: air section is 0x%llx, expected all faces to be connected", air_connectivity);
+        return false;
+    }
+
+    bool layer_ok = true;
+    layer_ok &= CheckFacesConnected("full layer", layer_connectivity, BlockFace_Top, BlockFace_Bottom, false);
+    layer_ok &= CheckFacesConnected("full layer", layer_connectivity, BlockFace_East, BlockFace_West, true);
+    layer_ok &= CheckFacesConnected("full layer", layer_connectivity, BlockFace_North, BlockFace_South, true);
+    layer_ok &= CheckFacesConnected("full layer", layer_connectivity, BlockFace_East, BlockFace_North, true);
+    layer_ok &= CheckFacesConnected("full layer", layer_connectivity, BlockFace_Top, BlockFace_East, true);
+    layer_ok &= CheckFacesConnected("full layer", layer_connectivity, BlockFace_Bottom, BlockFace_West, true);
+    if (!layer_ok)
+        return false;
+
+    if (pocket_connectivity != 0)
+    {
+        LogError(Log_Bench, "Connectivity: sealed air pocket is 0x%llx, expected no faces to be connected", pocket_connectivity);
+        return false;
+    }
+
+    if (!CheckChunkVisibilityBehindWall())
+        return false;
+
+    AddResult("connectivity", "sections", Bench_Connectivity_Iterations * 3, total, &samples);
+
+    return true;
+}
+
+// This is what building a draw list looked like before the chunk render table
+static void BuildChunkDrawListFromChunks(Array<Chunk *> chunks, ChunkMeshType type, Vec2f camera_position, float max_distance, bool visible_only, Array<s64> *draw_list)
+{
+    ArrayClear(draw_list);
+    ArrayReserve(draw_list, chunks.count);
+
+    float max_distance_sqrd = max_distance * max_distance;
+    foreach (i, chunks)
+    {
+        Chunk *chunk = chunks[i];
+        if (chunk->mesh.mesh_type_index_counts[type] == 0)
+            continue;
+
+        if (visible_only && !IsChunkVisible(chunk))
+            continue;
+
+        Vec2f diff = Vec2f{(float)chunk->x * Chunk_Size, (float)chunk->z * Chunk_Size} - camera_position;
+        if (diff.x * diff.x + diff.y * diff.y > max_distance_sqrd)
+            continue;
+
+        ArrayPush(draw_list, i);
+    }
+}
+
+static bool BenchChunkDrawList(int num_chunks)
+{
+    Array<f64> samples = {.allocator=heap};
+    defer(ArrayFree(&samples));
+
+    Array<Chunk *> chunks = {.allocator=heap};
+    defer(ArrayFree(&chunks));
+
+    Array<s64> draw_list = {.allocator=heap};
+    defer(ArrayFree(&draw_list));
+
+    ChunkRenderTable table{};
+    InitChunkRenderTable(&table);
+    defer(DestroyChunkRenderTable(&table));
+
+    RNG rng{};
+    RandomSeed(&rng, g_options.seed);
+
+    // We only touch the start of each chunk so the block data is never committed,
+    // but the chunks are spread in memory the same way as in game
+    int grid_size = (int)sqrtf((float)num_chunks);
+    for (int i = 0; i < num_chunks; i += 1)
+    {
+        Chunk *chunk = (Chunk *)Alloc(sizeof(Chunk), heap);
+        memset((void *)chunk, 0, offsetof(Chunk, blocks));
+        chunk->render_index = -1;
+        chunk->x = (s16)(i % grid_size - grid_size / 2);
+        chunk->z = (s16)(i / grid_size - grid_size / 2);
+
+        for (int type = 0; type < ChunkMeshType_Count; type += 1)
+        {
+            if (RandomGetNext(&rng) % 4 != 0)
+                chunk->mesh.mesh_type_index_counts[type] = 6 * (1 + RandomGetNext(&rng) % 1024);
+        }
+
+        bool visible = RandomGetNext(&rng) % 2 == 0;
+        if (visible)
+        {
+            chunk->visibility_frame = g_frame_index;
+            chunk->visited_sections = 1;
+        }
+
+        ArrayPush(&chunks, chunk);
+        AddOrUpdateChunkRenderRecord(&table, chunk);
+        if (visible)
+            table.flags[chunk->render_index] |= ChunkRenderFlag_Visible;
+    }
+
+    float max_distance = grid_size * 0.4f * Chunk_Size;
+
+    s64 start = GetTimeInNanoseconds();
+    for (int i = 0; i < Bench_Draw_List_Iterations; i += 1)
+    {
+        s64 iteration_start = GetTimeInNanoseconds();
+        for (int type = 0; type < ChunkMeshType_Count; type += 1)
+            BuildChunkDrawListFromChunks(chunks, (ChunkMeshType)type, {}, max_distance, true, &draw_list);
+
+        ArrayPush(&samples, SecondsSince(iteration_start));
+    }
+    f64 total = SecondsSince(start);
+
+    AddResult(TPrintf("chunk_draw_list_walk_%d", num_chunks), "iterations", Bench_Draw_List_Iterations, total, &samples);
+
+    start = GetTimeInNanoseconds();
+    for (int i = 0; i < Bench_Draw_List_Iterations; i += 1)
+    {
+        s64 iteration_start = GetTimeInNanoseconds();
+        for (int type = 0; type < ChunkMeshType_Count; type += 1)
+            BuildChunkDrawList(&table, (ChunkMeshType)type, {}, max_distance, true, &draw_list);
+
+        ArrayPush(&samples, SecondsSince(iteration_start));
+    }
+    total = SecondsSince(start);
+
+    AddResult(TPrintf("chunk_draw_list_table_%d", num_chunks), "iterations", Bench_Draw_List_Iterations, total, &samples);
+
+    // Records are updated when a chunk is uploaded again or its mesh is relocated. This must
+    // not hide the chunk until connectivity culling sets its visible flag on the next frame
+    Array<s64> expected_draw_list = {.allocator=heap};
+    defer(ArrayFree(&expected_draw_list));
+
+    BuildChunkDrawList(&table, ChunkMeshType_Solid, {}, max_distance, true, &expected_draw_list);
+
+    foreach (i, chunks)
+        AddOrUpdateChunkRenderRecord(&table, chunks[i]);
+
+    BuildChunkDrawList(&table, ChunkMeshType_Solid, {}, max_distance, true, &draw_list);
+
+    foreach (i, chunks)
+        Free(chunks[i], heap);
+
+    if (draw_list.count != expected_draw_list.count || memcmp(draw_list.data, expected_draw_list.data, draw_list.count * sizeof(s64)) != 0)
+    {
+        LogError(Log_Bench, "Chunk draw list: %lld chunks were drawn before their render records were updated, %lld after", expected_draw_list.count, draw_list.count);
+        return false;
+    }
+
+    return true;
+}
+
+struct DeterminismResult
+{
+    int num_threads = 0;
+    u64 hash = 0;
+};
+
+static bool CheckDeterminism(Array<DeterminismResult> *results)
+{
+    int thread_counts[] = {1, 2, 4, g_options.num_threads};
+
+    bool deterministic = true;
+    for (int i = 0; i < (int)StaticArraySize(thread_counts); i += 1)
+    {
+        World world{};
+        InitBenchWorld(&world, thread_counts[i]);
+
+        GenerateChunkGrid(&world, Bench_Determinism_Grid_Size, null);
+        u64 hash = HashChunkGrid(&world, Bench_Determinism_Grid_Size);
+
+        DestroyWorld(&world);
+
+        ArrayPush(results, {.num_threads=thread_counts[i], .hash=hash});
+        if (hash != (*results)[0].hash)
+        {
+            LogError(Log_Bench, "Generated blocks with %d threads (%016llx) differ from %d threads (%016llx)", thread_counts[i], hash, thread_counts[0], (*results)[0].hash);
+            deterministic = false;
+        }
+    }
+
+    return deterministic;
+}
+
+static void WriteResults(FILE *file, bool deterministic, Array<DeterminismResult> determinism)
+{
+    fprintf(file, "{\n");
+    fprintf(file, "  \"seed\": %u,\n", g_options.seed);
+    fprintf(file, "  \"threads\": %d,\n", g_options.num_threads);
+    fprintf(file, "  \"chunk_grid_size\": %d,\n", g_options.chunk_grid_size);
+    fprintf(file, "  \"frames\": %d,\n", g_options.num_frames);
+    fprintf(file, "  \"render_distance\": %d,\n", g_options.render_distance);
+    fprintf(file, "  \"peak_memory_bytes\": %lld,\n", GetPeakMemoryBytes());
+
+    fprintf(file, "  \"determinism\": {\n");
+    fprintf(file, "    \"passed\": %s,\n", deterministic ? "true" : "false");
+    fprintf(file, "    \"runs\": [");
+    foreach (i, determinism)
+        fprintf(file, "%s{\"threads\": %d, \"hash\": \"%016llx\"}", i > 0 ? ", " : "", determinism[i].num_threads, determinism[i].hash);
+    fprintf(file, "]\n");
+    fprintf(file, "  },\n");
+
+    fprintf(file, "  \"scenarios\": [\n");
+    foreach (i, g_results)
+    {
+        BenchResult r = g_results[i];
+        fprintf(file, "    {\"name\": \"%.*s\", \"unit\": \"%.*s\", \"count\": %lld, \"seconds\": %.6f, \"per_second\": %.3f, \"p50_ms\": %.6f, \"p99_ms\": %.6f, \"peak_memory_bytes\": %lld}%s\n",
+            FSTR(r.name), FSTR(r.unit), r.num_items, r.total_seconds,
+            r.total_seconds > 0 ? r.num_items / r.total_seconds : 0.0,
+            r.p50_ms, r.p99_ms, r.peak_memory_bytes,
+            i < g_results.count - 1 ? "," : "");
+    }
+    fprintf(file, "  ]\n");
+    fprintf(file, "}\n");
+}
+
+static bool ParseOptions(int argc, char **args)
+{
+    for (int i = 1; i < argc; i += 1)
+    {
+        const char *arg = args[i];
+        const char *value = i + 1 < argc ? args[i + 1] : null;
+        if (!value)
+        {
+            LogError(Log_Bench, "Missing value for %s", arg);
+            return false;
+        }
+
+        if (strcmp(arg, "--seed") == 0)
+            g_options.seed = (u32)strtoul(value, null, 10);
+        else if (strcmp(arg, "--chunks") == 0)
+            g_options.chunk_grid_size = Max((int)sqrtf((float)atoi(value)), 3);
+        else if (strcmp(arg, "--frames") == 0)
+            g_options.num_frames = Max(atoi(value), 1);
+        else if (strcmp(arg, "--threads") == 0)
+            g_options.num_threads = Max(atoi(value), 1);
+        else if (strcmp(arg, "--render-distance") == 0)
+            g_options.render_distance = Max(atoi(value), 1);
+        else if (strcmp(arg, "--scenario") == 0)
+            g_options.scenario = value;
+        else if (strcmp(arg, "--output") == 0)
+            g_options.output_filename = value;
+        else if (strcmp(arg, "--trace") == 0)
+            g_options.trace_filename = value;
+        else
+        {
+            LogError(Log_Bench, "Unknown option %s", arg);
+            return false;
+        }
+
+        i += 1;
+    }
+
+    return true;
+}
+
+int main(int argc, char **args)
+{
+    if (!ParseOptions(argc, args))
+        return 1;
+
+    if (g_options.num_threads <= 0)
+        g_options.num_threads = Max(GetNumHardwareThreads() - 1, 1);
+
+    g_results.allocator = heap;
+
+    // The dummy video driver does not need a display, the window is never shown
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", true);
+    SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS);
+
+    ProfilerRegisterThread("Main");
+
+    g_window = SDL_CreateWindow("Vox Bench", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1800, 1012, SDL_WINDOW_HIDDEN);
+    defer(SDL_DestroyWindow(g_window));
+
+    GfxCreateContext(g_window);
+    defer(GfxDestroyContext());
+
+    LoadAllShaders();
+    defer(UnloadAllShaders());
+
+    InitRenderer();
+    defer(DestroyRenderer());
+
+    Array<DeterminismResult> determinism = {.allocator=heap};
+    defer(ArrayFree(&determinism));
+
+    bool deterministic = CheckDeterminism(&determinism);
+
+    BenchGenerateAndMeshChunks();
+    BenchFlyThrough();
+    BenchChunkStreaming();
+    BenchHashMap();
+    bool chunk_lookup_passed = BenchChunkLookup();
+    bool connectivity_passed = BenchConnectivity();
+    BenchChunkAlloc();
+    bool offset_allocator_passed = BenchOffsetAllocator();
+    bool gfx_allocator_passed = BenchGfxAllocator();
+    BenchNoise();
+    BenchThreadGroup();
+    bool mpmc_queue_passed = BenchMPMCQueueStress();
+    BenchJobRoundTrip();
+    bool job_overflow_passed = BenchJobOverflow();
+
+    bool chunk_draw_list_passed = true;
+    if (ShouldRun("chunk_draw_list"))
+    {
+        chunk_draw_list_passed &= BenchChunkDrawList(2500);
+        chunk_draw_list_passed &= BenchChunkDrawList(10000);
+    }
+
+    if (g_options.trace_filename)
+        ProfilerWriteChromeTrace(g_options.trace_filename);
+
+    FILE *file = fopen(g_options.output_filename, "w");
+    if (!file)
+    {
+        LogError(Log_Bench, "Could not open %s for writing", g_options.output_filename);
+        return 1;
+    }
+
+    WriteResults(file, deterministic, determinism);
+    fclose(file);
+
+    LogMessage(Log_Bench, "Wrote results to %s", g_options.output_filename);
+
+    return deterministic && mpmc_queue_passed && job_overflow_passed && chunk_lookup_passed && connectivity_passed && offset_allocator_passed && gfx_allocator_passed && chunk_draw_list_passed ? 0 : 1;
+}
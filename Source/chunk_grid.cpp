@@ -0,0 +1,155 @@
+#include "World.hpp"
+
+static inline bool IsInChunkGrid(ChunkGrid *grid, s32 x, s32 z)
+{
+    return x >= grid->min_x && x < grid->min_x + Chunk_Grid_Size
+        && z >= grid->min_z && z < grid->min_z + Chunk_Grid_Size;
+}
+
+// Wraps around on world coordinates, so a chunk keeps its slot when the grid moves
+static inline Chunk **GetChunkGridSlot(ChunkGrid *grid, s32 x, s32 z)
+{
+    s32 mask = Chunk_Grid_Size - 1;
+
+    return &grid->slots[(z & mask) * Chunk_Grid_Size + (x & mask)];
+}
+
+void InitChunkGrid(ChunkGrid *grid, s32 center_x, s32 center_z)
+{
+    grid->min_x = center_x - Chunk_Grid_Size / 2;
+    grid->min_z = center_z - Chunk_Grid_Size / 2;
+    grid->slots = Alloc<Chunk *>(Chunk_Grid_Size * Chunk_Grid_Size, TaggedHeap(MemoryTag_Chunks), true);
+
+    grid->outside.allocator = TaggedHeap(MemoryTag_HashMaps);
+}
+
+void DestroyChunkGrid(ChunkGrid *grid)
+{
+    Free(grid->slots, TaggedHeap(MemoryTag_Chunks));
+    HashMapFree(&grid->outside);
+    *grid = {};
+}
+
+Chunk *FindChunk(ChunkGrid *grid, s16 x, s16 z)
+{
+    if (IsInChunkGrid(grid, x, z))
+    {
+        Chunk *chunk = *GetChunkGridSlot(grid, x, z);
+        if (chunk && chunk->x == x && chunk->z == z)
+            return chunk;
+
+        return null;
+    }
+
+    return HashMapFind(&grid->outside, ChunkKey{x, z});
+}
+
+void AddChunkToGrid(ChunkGrid *grid, Chunk *chunk)
+{
+    if (IsInChunkGrid(grid, chunk->x, chunk->z))
+    {
+        Chunk **slot = GetChunkGridSlot(grid, chunk->x, chunk->z);
+        Assert(*slot == null, "Chunk %d %d is already in the grid", chunk->x, chunk->z);
+
+        *slot = chunk;
+    }
+    else
+    {
+        bool exists = false;
+        *HashMapFindOrAdd(&grid->outside, ChunkKey{chunk->x, chunk->z}, &exists) = chunk;
+        Assert(!exists, "Chunk %d %d is already in the grid", chunk->x, chunk->z);
+    }
+}
+
+void RemoveChunkFromGrid(ChunkGrid *grid, Chunk *chunk)
+{
+    if (IsInChunkGrid(grid, chunk->x, chunk->z))
+    {
+        Chunk **slot = GetChunkGridSlot(grid, chunk->x, chunk->z);
+        Assert(*slot == chunk);
+
+        *slot = null;
+    }
+    else
+    {
+        HashMapRemove(&grid->outside, ChunkKey{chunk->x, chunk->z});
+    }
+}
+
+// Moves the chunk of a slot whose column or row just left the grid to the hash map
+static void EvictChunkGridSlot(ChunkGrid *grid, s32 x, s32 z)
+{
+    Chunk **slot = GetChunkGridSlot(grid, x, z);
+    if (!*slot)
+        return;
+
+    HashMapInsert(&grid->outside, ChunkKey{(*slot)->x, (*slot)->z}, *slot);
+    *slot = null;
+}
+
+// Moves the chunk at (x, z), which just entered the grid, from the hash map to its slot
+static void FillChunkGridSlot(ChunkGrid *grid, s32 x, s32 z)
+{
+    if (grid->outside.count <= 0)
+        return;
+
+    Chunk *chunk = null;
+    if (HashMapRemove(&grid->outside, ChunkKey{(s16)x, (s16)z}, &chunk))
+        *GetChunkGridSlot(grid, x, z) = chunk;
+}
+
+void RecenterChunkGrid(ChunkGrid *grid, s32 center_x, s32 center_z)
+{
+    s32 old_min_x = grid->min_x;
+    s32 old_min_z = grid->min_z;
+    s32 new_min_x = center_x - Chunk_Grid_Size / 2;
+    s32 new_min_z = center_z - Chunk_Grid_Size / 2;
+    if (new_min_x == old_min_x && new_min_z == old_min_z)
+        return;
+
+    ProfileFunction();
+
+    // Only the columns and rows that leave the grid are touched, the other chunks stay in their slot
+    for (s32 x = old_min_x; x < old_min_x + Chunk_Grid_Size; x += 1)
+    {
+        if (x >= new_min_x && x < new_min_x + Chunk_Grid_Size)
+            continue;
+
+        for (s32 z = old_min_z; z < old_min_z + Chunk_Grid_Size; z += 1)
+            EvictChunkGridSlot(grid, x, z);
+    }
+    for (s32 z = old_min_z; z < old_min_z + Chunk_Grid_Size; z += 1)
+    {
+        if (z >= new_min_z && z < new_min_z + Chunk_Grid_Size)
+            continue;
+
+        for (s32 x = old_min_x; x < old_min_x + Chunk_Grid_Size; x += 1)
+        {
+            if (x >= new_min_x && x < new_min_x + Chunk_Grid_Size)
+                EvictChunkGridSlot(grid, x, z);
+        }
+    }
+
+    grid->min_x = new_min_x;
+    grid->min_z = new_min_z;
+
+    for (s32 x = new_min_x; x < new_min_x + Chunk_Grid_Size; x += 1)
+    {
+        if (x >= old_min_x && x < old_min_x + Chunk_Grid_Size)
+            continue;
+
+        for (s32 z = new_min_z; z < new_min_z + Chunk_Grid_Size; z += 1)
+            FillChunkGridSlot(grid, x, z);
+    }
+    for (s32 z = new_min_z; z < new_min_z + Chunk_Grid_Size; z += 1)
+    {
+        if (z >= old_min_z && z < old_min_z + Chunk_Grid_Size)
+            continue;
+
+        for (s32 x = new_min_x; x < new_min_x + Chunk_Grid_Size; x += 1)
+        {
+            if (x >= old_min_x && x < old_min_x + Chunk_Grid_Size)
+                FillChunkGridSlot(grid, x, z);
+        }
+    }
+}
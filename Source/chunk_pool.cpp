@@ -0,0 +1,159 @@
+#include "World.hpp"
+
+#include <new>
+
+#if defined(VOX_PLATFORM_POSIX)
+#include <sys/mman.h>
+#endif
+
+#define Chunk_Pool_Page_Size 4096
+#define Chunk_Pool_Huge_Page_Size (2 * 1024 * 1024)
+
+static u8 *ReserveChunkPoolRegion()
+{
+#if defined(VOX_PLATFORM_POSIX)
+    // Map one more huge page than we need so we can align the region on a huge page boundary
+    s64 mapped_size = Chunk_Pool_Region_Size + Chunk_Pool_Huge_Page_Size;
+    u8 *memory = (u8 *)mmap(null, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    Assert(memory != MAP_FAILED, "Could not map %lld bytes for the chunk pool", mapped_size);
+
+    u8 *region = (u8 *)AlignForward((u64)memory, (u64)Chunk_Pool_Huge_Page_Size);
+    s64 before = region - memory;
+    s64 after = mapped_size - before - Chunk_Pool_Region_Size;
+    if (before > 0)
+        munmap(memory, before);
+    if (after > 0)
+        munmap(region + Chunk_Pool_Region_Size, after);
+
+    #if defined(VOX_PLATFORM_LINUX)
+        // Generation and meshing walk all over the chunk data, so huge pages save a lot of TLB misses.
+        // This is only a hint, transparent huge pages might be disabled
+        madvise(region, Chunk_Pool_Region_Size, MADV_HUGEPAGE);
+    #endif
+
+    // The whole region is accounted for, even the slots that were never touched or were released
+    RecordTaggedAllocation(MemoryTag_Chunks, Chunk_Pool_Region_Size);
+
+    return region;
+#else
+    return (u8 *)Alloc(Chunk_Pool_Region_Size, TaggedHeap(MemoryTag_Chunks));
+#endif
+}
+
+static void FreeChunkPoolRegion(u8 *region)
+{
+#if defined(VOX_PLATFORM_POSIX)
+    munmap(region, Chunk_Pool_Region_Size);
+    RecordTaggedFree(MemoryTag_Chunks, Chunk_Pool_Region_Size);
+#else
+    Free(region, TaggedHeap(MemoryTag_Chunks));
+#endif
+}
+
+// The slot stays mapped, its pages are zero filled again the next time they are touched
+static void ReleaseChunkPoolSlot(ChunkPool *pool, void *slot)
+{
+#if defined(VOX_PLATFORM_LINUX)
+    madvise(slot, pool->slot_size, MADV_DONTNEED);
+#elif defined(VOX_PLATFORM_POSIX)
+    madvise(slot, pool->slot_size, MADV_FREE);
+#endif
+}
+
+void InitChunkPool(ChunkPool *pool)
+{
+    *pool = {};
+
+    // Slots are page aligned so we can give them back to the OS one by one
+    pool->slot_size = AlignForward((s64)sizeof(Chunk), (s64)Chunk_Pool_Page_Size);
+    pool->slots_per_region = Chunk_Pool_Region_Size / pool->slot_size;
+    pool->next_fresh_slot = pool->slots_per_region;
+
+    pool->regions.allocator = TaggedHeap(MemoryTag_Chunks);
+    pool->free_slots.allocator = TaggedHeap(MemoryTag_Chunks);
+    pool->released_slots.allocator = TaggedHeap(MemoryTag_Chunks);
+}
+
+void DestroyChunkPool(ChunkPool *pool)
+{
+    Assert(pool->num_used_slots == 0, "Chunk pool is destroyed while %lld chunks are still allocated", pool->num_used_slots);
+
+    foreach (i, pool->regions)
+        FreeChunkPoolRegion(pool->regions[i]);
+
+    ArrayFree(&pool->regions);
+    ArrayFree(&pool->free_slots);
+    ArrayFree(&pool->released_slots);
+    *pool = {};
+}
+
+Chunk *AllocChunk(ChunkPool *pool)
+{
+    void *slot = null;
+
+    // Recently freed slots are still resident, and maybe still in the cache
+    if (pool->free_slots.count > 0)
+    {
+        slot = pool->free_slots[pool->free_slots.count - 1];
+        ArrayPop(&pool->free_slots);
+    }
+    else if (pool->released_slots.count > 0)
+    {
+        slot = pool->released_slots[pool->released_slots.count - 1];
+        ArrayPop(&pool->released_slots);
+    }
+    else
+    {
+        if (pool->next_fresh_slot >= pool->slots_per_region)
+        {
+            ArrayPush(&pool->regions, ReserveChunkPoolRegion());
+            pool->next_fresh_slot = 0;
+        }
+
+        slot = pool->regions[pool->regions.count - 1] + pool->next_fresh_slot * pool->slot_size;
+        pool->next_fresh_slot += 1;
+    }
+
+    pool->num_used_slots += 1;
+
+    // Default initialization only runs the member initializers, so the blocks and terrain
+    // heights are left as they are. They are all written by GenerateChunkWorker
+    return new (slot) Chunk;
+}
+
+void FreeChunk(ChunkPool *pool, Chunk *chunk)
+{
+    Assert(pool->num_used_slots > 0);
+
+    pool->num_used_slots -= 1;
+    ArrayPush(&pool->free_slots, (void *)chunk);
+
+    // Give the oldest free slots back to the OS, the budget might have changed since the last call
+    s64 budget = (s64)g_settings.chunk_pool_free_budget_in_mb * 1024 * 1024;
+    s64 num_to_release = pool->free_slots.count - budget / pool->slot_size;
+    if (num_to_release <= 0)
+        return;
+
+    for (s64 i = 0; i < num_to_release; i += 1)
+    {
+        ReleaseChunkPoolSlot(pool, pool->free_slots[i]);
+        ArrayPush(&pool->released_slots, pool->free_slots[i]);
+    }
+
+    memmove(pool->free_slots.data, pool->free_slots.data + num_to_release, (pool->free_slots.count - num_to_release) * sizeof(void *));
+    pool->free_slots.count -= num_to_release;
+}
+
+ChunkPoolStats GetChunkPoolStats(ChunkPool *pool)
+{
+    // Slots that were never handed out were never touched, so they are not resident
+    return {
+        .slot_size=pool->slot_size,
+        .reserved=pool->regions.count * Chunk_Pool_Region_Size,
+        .resident=(pool->num_used_slots + pool->free_slots.count) * pool->slot_size,
+        .num_used_slots=pool->num_used_slots,
+        .num_free_slots=pool->free_slots.count,
+        .num_released_slots=pool->released_slots.count,
+        .num_regions=(int)pool->regions.count,
+    };
+}
@@ -0,0 +1,177 @@
+#include "World.hpp"
+
+static const char *g_chunk_latency_metric_names[ChunkLatencyStage_Count] = {
+    "chunk.latency.generation_queue_ns",
+    "chunk.latency.generation_ns",
+    "chunk.latency.generation_handoff_ns",
+    "chunk.latency.neighbor_wait_ns",
+    "chunk.latency.mesh_queue_ns",
+    "chunk.latency.meshing_ns",
+    "chunk.latency.mesh_handoff_ns",
+    "chunk.latency.upload_ns",
+    "chunk.latency.queue_to_visible_ns",
+};
+
+static Metric *g_chunk_latency_metrics[ChunkLatencyStage_Count];
+
+struct ChunkTraceOutlier
+{
+    s16 x, z;
+    ChunkTrace trace;
+};
+
+static ChunkTraceOutlier g_chunk_trace_outliers[Chunk_Trace_Max_Outliers];
+static int g_num_chunk_trace_outliers = 0;
+
+Metric *GetChunkLatencyMetric(ChunkLatencyStage stage)
+{
+    if (!g_chunk_latency_metrics[stage])
+        g_chunk_latency_metrics[stage] = RegisterHistogram(g_chunk_latency_metric_names[stage]);
+
+    return g_chunk_latency_metrics[stage];
+}
+
+static void RecordChunkLatency(ChunkLatencyStage stage, s64 start_ns, s64 end_ns)
+{
+    // The chunk did not go through this stage (e.g. the bench meshes chunks directly)
+    if (start_ns <= 0 || end_ns <= 0)
+        return;
+
+    MetricRecord(GetChunkLatencyMetric(stage), end_ns - start_ns);
+}
+
+void TraceChunkGenerated(Chunk *chunk)
+{
+    ChunkTrace *trace = &chunk->trace;
+    trace->generated_ns = GetTimeInNanoseconds();
+
+    RecordChunkLatency(ChunkLatencyStage_GenerationQueue, trace->queued_ns, trace->generation_start_ns);
+    RecordChunkLatency(ChunkLatencyStage_Generation, trace->generation_start_ns, trace->generation_end_ns);
+    RecordChunkLatency(ChunkLatencyStage_GenerationHandoff, trace->generation_end_ns, trace->generated_ns);
+}
+
+void TraceChunkMeshStaged(Chunk *chunk)
+{
+    ChunkTrace *trace = &chunk->trace;
+    trace->upload_staged_ns = GetTimeInNanoseconds();
+
+    // A new chunk is marked dirty before it is generated, in which case the
+    // wait for the neighbors only starts once the chunk itself is generated
+    s64 ready_ns = Max(trace->mesh_requested_ns, trace->generation_end_ns);
+
+    RecordChunkLatency(ChunkLatencyStage_NeighborWait, ready_ns, trace->mesh_released_ns);
+    RecordChunkLatency(ChunkLatencyStage_MeshQueue, trace->mesh_released_ns, trace->mesh_start_ns);
+    RecordChunkLatency(ChunkLatencyStage_Meshing, trace->mesh_start_ns, trace->mesh_end_ns);
+    RecordChunkLatency(ChunkLatencyStage_MeshHandoff, trace->mesh_end_ns, trace->upload_staged_ns);
+}
+
+static void AddChunkTraceOutlier(Chunk *chunk)
+{
+    s64 duration = chunk->trace.visible_ns - chunk->trace.queued_ns;
+
+    int index = g_num_chunk_trace_outliers;
+    if (g_num_chunk_trace_outliers >= Chunk_Trace_Max_Outliers)
+    {
+        // Replace the fastest outlier, if this chunk was slower
+        index = 0;
+        for (int i = 1; i < g_num_chunk_trace_outliers; i += 1)
+        {
+            ChunkTrace *a = &g_chunk_trace_outliers[i].trace;
+            ChunkTrace *b = &g_chunk_trace_outliers[index].trace;
+            if (a->visible_ns - a->queued_ns < b->visible_ns - b->queued_ns)
+                index = i;
+        }
+
+        ChunkTrace *fastest = &g_chunk_trace_outliers[index].trace;
+        if (duration <= fastest->visible_ns - fastest->queued_ns)
+            return;
+    }
+    else
+    {
+        g_num_chunk_trace_outliers += 1;
+    }
+
+    g_chunk_trace_outliers[index] = {.x=chunk->x, .z=chunk->z, .trace=chunk->trace};
+}
+
+void TraceChunkUploaded(Chunk *chunk)
+{
+    ChunkTrace *trace = &chunk->trace;
+    trace->uploaded_ns = GetTimeInNanoseconds();
+
+    RecordChunkLatency(ChunkLatencyStage_Upload, trace->upload_staged_ns, trace->uploaded_ns);
+
+    // Later uploads are remeshes (e.g. a neighbor was loaded), only the first one makes the chunk visible
+    if (trace->visible_ns <= 0)
+    {
+        trace->visible_ns = trace->uploaded_ns;
+        RecordChunkLatency(ChunkLatencyStage_QueueToVisible, trace->queued_ns, trace->visible_ns);
+
+        if (trace->queued_ns > 0)
+            AddChunkTraceOutlier(chunk);
+    }
+}
+
+void ClearChunkTraceOutliers()
+{
+    g_num_chunk_trace_outliers = 0;
+}
+
+static int CompareChunkTraceOutliers(const void *a, const void *b)
+{
+    const ChunkTrace *x = &((const ChunkTraceOutlier *)a)->trace;
+    const ChunkTrace *y = &((const ChunkTraceOutlier *)b)->trace;
+    s64 dx = x->visible_ns - x->queued_ns;
+    s64 dy = y->visible_ns - y->queued_ns;
+
+    return (dx < dy) - (dx > dy);
+}
+
+static f64 TraceMilliseconds(s64 start_ns, s64 end_ns)
+{
+    if (start_ns <= 0 || end_ns <= 0)
+        return 0;
+
+    return (end_ns - start_ns) / 1000000.0;
+}
+
+bool WriteChunkTraceOutliers(String filename)
+{
+    FILE *file = fopen(CloneToCString(filename, temp), "w");
+    if (!file)
+    {
+        LogError(Log_World, "Could not open %.*s for writing", FSTR(filename));
+        return false;
+    }
+
+    defer(fclose(file));
+
+    qsort(g_chunk_trace_outliers, g_num_chunk_trace_outliers, sizeof(ChunkTraceOutlier), CompareChunkTraceOutliers);
+
+    // Only the last mesh of a chunk is traced, so for remeshed chunks the mesh stages
+    // can be later than the first upload (and the stage durations do not add up)
+    fprintf(file, "[\n");
+    for (int i = 0; i < g_num_chunk_trace_outliers; i += 1)
+    {
+        ChunkTraceOutlier *outlier = &g_chunk_trace_outliers[i];
+        ChunkTrace *t = &outlier->trace;
+
+        s64 ready_ns = Max(t->mesh_requested_ns, t->generation_end_ns);
+
+        fprintf(file, "  {\"x\": %d, \"z\": %d, \"queue_to_visible_ms\": %.3f, \"stages_ms\": {", outlier->x, outlier->z, TraceMilliseconds(t->queued_ns, t->visible_ns));
+        fprintf(file, "\"generation_queue\": %.3f, ", TraceMilliseconds(t->queued_ns, t->generation_start_ns));
+        fprintf(file, "\"generation\": %.3f, ", TraceMilliseconds(t->generation_start_ns, t->generation_end_ns));
+        fprintf(file, "\"generation_handoff\": %.3f, ", TraceMilliseconds(t->generation_end_ns, t->generated_ns));
+        fprintf(file, "\"neighbor_wait\": %.3f, ", TraceMilliseconds(ready_ns, t->mesh_released_ns));
+        fprintf(file, "\"mesh_queue\": %.3f, ", TraceMilliseconds(t->mesh_released_ns, t->mesh_start_ns));
+        fprintf(file, "\"meshing\": %.3f, ", TraceMilliseconds(t->mesh_start_ns, t->mesh_end_ns));
+        fprintf(file, "\"mesh_handoff\": %.3f, ", TraceMilliseconds(t->mesh_end_ns, t->upload_staged_ns));
+        fprintf(file, "\"upload\": %.3f", TraceMilliseconds(t->upload_staged_ns, t->uploaded_ns));
+        fprintf(file, "}}%s\n", i < g_num_chunk_trace_outliers - 1 ? "," : "");
+    }
+    fprintf(file, "]\n");
+
+    LogMessage(Log_World, "Wrote %d chunk traces to %.*s", g_num_chunk_trace_outliers, FSTR(filename));
+
+    return true;
+}
@@ -1,17 +1,139 @@
 #include "Core.hpp"
 #include "Math.hpp"
+#include "Profiler.hpp"
 
 #if defined(VOX_PLATFORM_POSIX)
 #include <unistd.h>
 #include <time.h>
+#include <sched.h>
 #endif
 
+#if defined(VOX_PLATFORM_LINUX)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+struct MemoryTagCounters
+{
+    s64 live_bytes = 0;
+    s64 peak_bytes = 0;
+    s64 num_allocations = 0;
+    s64 num_live_allocations = 0;
+
+    // Tags are updated from every thread, keep them on their own cache line
+    u8 padding[Cache_Line_Size - 4 * sizeof(s64)] = {};
+};
+
+static MemoryTagCounters g_memory_tags[MemoryTag_Count];
+
+static const char *g_memory_tag_names[MemoryTag_Count] = {
+    "untagged",
+    "world",
+    "chunks",
+    "meshes",
+    "uploads",
+    "graphics",
+    "ui",
+    "hash_maps",
+    "jobs",
+    "profiler",
+};
+
+const char *GetMemoryTagName(MemoryTag tag)
+{
+    Assert(tag >= 0 && tag < MemoryTag_Count);
+
+    return g_memory_tag_names[tag];
+}
+
+MemoryTagStats GetMemoryTagStats(MemoryTag tag)
+{
+    Assert(tag >= 0 && tag < MemoryTag_Count);
+
+    MemoryTagCounters *counters = &g_memory_tags[tag];
+
+    return {
+        .live_bytes=__atomic_load_n(&counters->live_bytes, __ATOMIC_RELAXED),
+        .peak_bytes=__atomic_load_n(&counters->peak_bytes, __ATOMIC_RELAXED),
+        .num_allocations=__atomic_load_n(&counters->num_allocations, __ATOMIC_RELAXED),
+        .num_live_allocations=__atomic_load_n(&counters->num_live_allocations, __ATOMIC_RELAXED),
+    };
+}
+
+void RecordTaggedAllocation(MemoryTag tag, s64 size)
+{
+    MemoryTagCounters *counters = &g_memory_tags[tag];
+
+    __atomic_fetch_add(&counters->num_allocations, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&counters->num_live_allocations, 1, __ATOMIC_RELAXED);
+
+    s64 live = __atomic_add_fetch(&counters->live_bytes, size, __ATOMIC_RELAXED);
+    s64 peak = __atomic_load_n(&counters->peak_bytes, __ATOMIC_RELAXED);
+    while (live > peak && !__atomic_compare_exchange_n(&counters->peak_bytes, &peak, live, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
+
+void RecordTaggedFree(MemoryTag tag, s64 size)
+{
+    MemoryTagCounters *counters = &g_memory_tags[tag];
+
+    __atomic_fetch_sub(&counters->num_live_allocations, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&counters->live_bytes, size, __ATOMIC_RELAXED);
+}
+
+bool ReportMemoryLeaks()
+{
+    bool ok = true;
+    for (int i = 0; i < MemoryTag_Count; i += 1)
+    {
+        MemoryTagStats stats = GetMemoryTagStats((MemoryTag)i);
+        if (stats.num_live_allocations == 0)
+            continue;
+
+        LogWarning(Log_Memory, "%s: %lld bytes in %lld allocations were not freed", GetMemoryTagName((MemoryTag)i), stats.live_bytes, stats.num_live_allocations);
+        ok = false;
+    }
+
+    if (ok)
+        LogMessage(Log_Memory, "No leaks");
+
+    return ok;
+}
+
+// 16 bytes so the memory we return keeps the alignment of malloc
+struct HeapAllocationHeader
+{
+    s64 size;
+    s64 tag;
+};
+
 void *HeapAllocator(AllocatorOp op, s64 size, void *ptr, void *data)
 {
     switch (op)
     {
-    case AllocatorOp_Alloc: return malloc(size);
-    case AllocatorOp_Free:  free(ptr); break;
+    case AllocatorOp_Alloc: {
+        MemoryTag tag = (MemoryTag)(uintptr_t)data;
+        Assert(tag >= 0 && tag < MemoryTag_Count, "Heap allocator data is not a memory tag");
+
+        auto header = (HeapAllocationHeader *)malloc(sizeof(HeapAllocationHeader) + size);
+        if (!header)
+            return null;
+
+        header->size = size;
+        header->tag = tag;
+        RecordTaggedAllocation(tag, size);
+
+        return header + 1;
+    }
+
+    case AllocatorOp_Free: {
+        // The tag of the allocation is used, not the one of the allocator it is freed with
+        auto header = (HeapAllocationHeader *)ptr - 1;
+        RecordTaggedFree((MemoryTag)header->tag, header->size);
+
+        free(header);
+    } break;
     }
 
     return null;
@@ -41,29 +163,55 @@ static void AddPage(MemoryArena *arena, s64 min_size)
 {
     min_size = Max(min_size, 4096 - (s64)sizeof(MemoryArenaPage));
 
-    MemoryArenaPage *page = (MemoryArenaPage *)malloc(min_size + sizeof(MemoryArenaPage));
-    *page = {};
+    // Reuse a page given back by RestoreMemoryArena if one is big enough
+    MemoryArenaPage *page = null;
+    for (MemoryArenaPage **link = &arena->free_pages; *link; link = &(*link)->prev)
+    {
+        if ((*link)->total_size >= min_size)
+        {
+            page = *link;
+            *link = page->prev;
+            break;
+        }
+    }
+
+    if (!page)
+    {
+        page = (MemoryArenaPage *)malloc(min_size + sizeof(MemoryArenaPage));
+        *page = {};
 
-    page->total_size = min_size;
-    arena->total_size += min_size;
+        page->total_size = min_size;
+        arena->total_size += min_size;
+    }
 
+    page->used = 0;
     page->prev = arena->last_page;
     arena->last_page = page;
 }
 
-void ResetMemoryArena(MemoryArena *arena)
+static void FreePages(MemoryArenaPage *page)
 {
-    while (arena->last_page)
+    while (page)
     {
-        MemoryArenaPage *prev = arena->last_page->prev;
-        free(arena->last_page);
+        MemoryArenaPage *prev = page->prev;
+        free(page);
 
-        arena->last_page = prev;
+        page = prev;
     }
 }
 
+void ResetMemoryArena(MemoryArena *arena)
+{
+    FreePages(arena->last_page);
+    FreePages(arena->free_pages);
+    *arena = {};
+}
+
 void *AllocFromArena(MemoryArena *arena, s64 size)
 {
+    // Keep the allocations 8 bytes aligned, scratch arenas mix strings and arrays of any type
+    size = AlignForward(size, (s64)8);
+
     MemoryArenaPage *page = arena->last_page;
 
     if (!page || page->used + size > page->total_size)
@@ -74,10 +222,38 @@ void *AllocFromArena(MemoryArena *arena, s64 size)
 
     void *ptr = (char *)(page + 1) + page->used;
     page->used += size;
+    arena->used += size;
 
     return ptr;
 }
 
+MemoryArenaMark GetMemoryArenaMark(MemoryArena *arena)
+{
+    return {
+        .page=arena->last_page,
+        .page_used=arena->last_page ? arena->last_page->used : 0,
+        .used=arena->used,
+    };
+}
+
+void RestoreMemoryArena(MemoryArena *arena, MemoryArenaMark mark)
+{
+    while (arena->last_page != mark.page)
+    {
+        MemoryArenaPage *page = arena->last_page;
+        Assert(page != null, "Memory arena mark does not belong to this arena, or was already restored");
+
+        arena->last_page = page->prev;
+        page->prev = arena->free_pages;
+        arena->free_pages = page;
+    }
+
+    if (mark.page)
+        mark.page->used = mark.page_used;
+
+    arena->used = mark.used;
+}
+
 void *MemoryArenaAllocator(AllocatorOp op, s64 size, void *ptr, void *data)
 {
     switch (op)
@@ -89,6 +265,70 @@ void *MemoryArenaAllocator(AllocatorOp op, s64 size, void *ptr, void *data)
     return null;
 }
 
+struct ScratchArena
+{
+    MemoryArena arena = {};
+    s64 num_allocations = 0;
+    s64 peak_used = 0;
+};
+
+static thread_local ScratchArena t_scratch_arena;
+
+Allocator scratch = Allocator{null, ScratchAllocator};
+
+void *ScratchAllocator(AllocatorOp op, s64 size, void *ptr, void *data)
+{
+    ScratchArena *arena = &t_scratch_arena;
+
+    switch (op)
+    {
+    case AllocatorOp_Alloc: {
+        void *result = AllocFromArena(&arena->arena, size);
+        arena->num_allocations += 1;
+        arena->peak_used = Max(arena->peak_used, arena->arena.used);
+
+        return result;
+    }
+
+    case AllocatorOp_Free: break; // No-op, use ScratchScope
+    }
+
+    return null;
+}
+
+MemoryArenaMark GetScratchMark()
+{
+    return GetMemoryArenaMark(&t_scratch_arena.arena);
+}
+
+void RestoreScratch(MemoryArenaMark mark)
+{
+    RestoreMemoryArena(&t_scratch_arena.arena, mark);
+}
+
+void ResetScratchArena()
+{
+    RestoreMemoryArena(&t_scratch_arena.arena, {});
+    t_scratch_arena.num_allocations = 0;
+    t_scratch_arena.peak_used = 0;
+}
+
+void FreeScratchArena()
+{
+    ResetMemoryArena(&t_scratch_arena.arena);
+    t_scratch_arena = {};
+}
+
+ScratchArenaStats GetScratchArenaStats()
+{
+    return {
+        .num_allocations=t_scratch_arena.num_allocations,
+        .used=t_scratch_arena.arena.used,
+        .peak_used=t_scratch_arena.peak_used,
+        .reserved=t_scratch_arena.arena.total_size,
+    };
+}
+
 void LogMessage(const char *section, const char *str, ...)
 {
     if (section)
@@ -165,7 +405,7 @@ String GetAbsoluteFilename(String filename, Allocator allocator)
     if (!result)
         return "";
 
-    return result;
+    return CloneString(result, allocator);
 }
 
 bool FileExists(String filename)
@@ -188,7 +428,8 @@ Result<String> ReadEntireFile(String filename)
     s64 size = ftell(file);
     rewind(file);
 
-    char *data =(char *)malloc(size + 1);
+    // Freed with heap by the callers
+    char *data = Alloc<char>(size + 1, heap);
     if (!data)
         return Result<String>::Bad(false);
 
@@ -285,34 +526,275 @@ String TPrintf(const char *fmt, ...)
 
 static void *WorkerThreadRoutine(void *data);
 
-static void InitWorkList(ThreadWorkList *list)
+static thread_local WorkerThread *t_worker_thread = null;
+
+#if defined(VOX_PLATFORM_LINUX)
+
+void FutexWait(u32 *addr, u32 expected)
 {
-    pthread_mutex_init(&list->mutex, null);
-    sem_init(&list->semaphore, 0, 0);
+    // Returns immediately if the value changed since we read it, so we cannot miss a wake up
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, null, null, 0);
 }
 
-static void DestroyWorkList(ThreadWorkList *list)
+void FutexWake(u32 *addr, int count)
 {
-    pthread_mutex_destroy(&list->mutex);
-    sem_destroy(&list->semaphore);
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, null, null, 0);
+}
+
+#else
+
+// No futexes here, emulate them with a single condition variable
+static pthread_mutex_t g_futex_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_futex_cond = PTHREAD_COND_INITIALIZER;
+
+void FutexWait(u32 *addr, u32 expected)
+{
+    pthread_mutex_lock(&g_futex_mutex);
+    if (__atomic_load_n(addr, __ATOMIC_SEQ_CST) == expected)
+        pthread_cond_wait(&g_futex_cond, &g_futex_mutex);
+    pthread_mutex_unlock(&g_futex_mutex);
+}
+
+void FutexWake(u32 *addr, int count)
+{
+    pthread_mutex_lock(&g_futex_mutex);
+    pthread_cond_broadcast(&g_futex_cond);
+    pthread_mutex_unlock(&g_futex_mutex);
+}
+
+#endif
+
+// Work stealing deque from "Dynamic Circular Work-Stealing Deque" (Chase, Lev),
+// with the memory orderings of "Correct and Efficient Work-Stealing for Weak
+// Memory Models" (Lê, Pop, Cohen, Zappa Nardelli)
+
+static WorkDequeBuffer *AllocWorkDequeBuffer(s64 capacity)
+{
+    auto buffer = Alloc<WorkDequeBuffer>(TaggedHeap(MemoryTag_Jobs));
+    buffer->capacity = capacity;
+    buffer->entries = Alloc<void *>(capacity, TaggedHeap(MemoryTag_Jobs), true);
+
+    return buffer;
+}
+
+void InitWorkDeque(WorkDeque *deque)
+{
+    deque->buffer = AllocWorkDequeBuffer(Work_Deque_Initial_Capacity);
+}
+
+void DestroyWorkDeque(WorkDeque *deque)
+{
+    auto buffer = deque->buffer;
+    while (buffer)
+    {
+        auto previous = buffer->previous;
+        Free(buffer->entries, TaggedHeap(MemoryTag_Jobs));
+        Free(buffer, TaggedHeap(MemoryTag_Jobs));
+        buffer = previous;
+    }
+
+    deque->buffer = null;
+}
+
+s64 GetWorkDequeCount(WorkDeque *deque)
+{
+    s64 top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    s64 bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+
+    return Max(bottom - top, (s64)0);
+}
+
+void PushWorkDeque(WorkDeque *deque, void *entry)
+{
+    s64 bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    s64 top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    WorkDequeBuffer *buffer = __atomic_load_n(&deque->buffer, __ATOMIC_RELAXED);
+
+    if (bottom - top > buffer->capacity - 1)
+    {
+        auto new_buffer = AllocWorkDequeBuffer(buffer->capacity * 2);
+        for (s64 i = top; i < bottom; i += 1)
+            new_buffer->entries[i & (new_buffer->capacity - 1)] = __atomic_load_n(&buffer->entries[i & (buffer->capacity - 1)], __ATOMIC_RELAXED);
+
+        new_buffer->previous = buffer;
+        __atomic_store_n(&deque->buffer, new_buffer, __ATOMIC_RELEASE);
+        buffer = new_buffer;
+    }
+
+    __atomic_store_n(&buffer->entries[bottom & (buffer->capacity - 1)], entry, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+}
+
+void *PopWorkDeque(WorkDeque *deque)
+{
+    s64 bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    WorkDequeBuffer *buffer = __atomic_load_n(&deque->buffer, __ATOMIC_RELAXED);
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    s64 top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+    if (top > bottom)
+    {
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return null;
+    }
+
+    void *entry = __atomic_load_n(&buffer->entries[bottom & (buffer->capacity - 1)], __ATOMIC_RELAXED);
+    if (top == bottom)
+    {
+        // Last entry, race against the thieves for it
+        if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+            entry = null;
+
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+
+    return entry;
+}
+
+void *StealWorkDeque(WorkDeque *deque, bool *lost_race)
+{
+    s64 top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    s64 bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+
+    if (top >= bottom)
+        return null;
+
+    WorkDequeBuffer *buffer = __atomic_load_n(&deque->buffer, __ATOMIC_ACQUIRE);
+    void *entry = __atomic_load_n(&buffer->entries[top & (buffer->capacity - 1)], __ATOMIC_RELAXED);
+
+    if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+    {
+        *lost_race = true;
+        return null;
+    }
+
+    return entry;
+}
+
+// Bounded queue from "Bounded MPMC queue" (Dmitry Vyukov). Each cell has a sequence number
+// that tells whether it is ready to be written to or read from for a given position, so
+// producers and consumers only contend on their own position and never allocate
+
+void InitMPMCQueue(MPMCQueue *queue, s64 capacity)
+{
+    Assert(capacity >= 2 && (capacity & (capacity - 1)) == 0, "MPMC queue capacity must be a power of two");
+
+    queue->capacity = capacity;
+    queue->cells = Alloc<MPMCQueueCell>(capacity, TaggedHeap(MemoryTag_Jobs));
+    for (s64 i = 0; i < capacity; i += 1)
+        queue->cells[i] = {.sequence=(u64)i, .data=null};
+
+    queue->push_position = 0;
+    queue->pop_position = 0;
+}
+
+void DestroyMPMCQueue(MPMCQueue *queue)
+{
+    Free(queue->cells, TaggedHeap(MemoryTag_Jobs));
+    *queue = {};
+}
+
+bool MPMCQueuePush(MPMCQueue *queue, void *data)
+{
+    Assert(data != null);
+
+    u64 mask = (u64)queue->capacity - 1;
+    u64 position = __atomic_load_n(&queue->push_position, __ATOMIC_RELAXED);
+    while (true)
+    {
+        MPMCQueueCell *cell = &queue->cells[position & mask];
+        u64 sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        s64 diff = (s64)(sequence - position);
+
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&queue->push_position, &position, position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                cell->data = data;
+                __atomic_store_n(&cell->sequence, position + 1, __ATOMIC_RELEASE);
+
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            // The consumers have not read the cell from the previous lap yet
+            return false;
+        }
+        else
+        {
+            position = __atomic_load_n(&queue->push_position, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+void MPMCQueuePushWait(MPMCQueue *queue, void *data)
+{
+    while (!MPMCQueuePush(queue, data))
+        sched_yield();
+}
+
+void *MPMCQueuePop(MPMCQueue *queue)
+{
+    u64 mask = (u64)queue->capacity - 1;
+    u64 position = __atomic_load_n(&queue->pop_position, __ATOMIC_RELAXED);
+    while (true)
+    {
+        MPMCQueueCell *cell = &queue->cells[position & mask];
+        u64 sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        s64 diff = (s64)(sequence - (position + 1));
+
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&queue->pop_position, &position, position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                void *data = cell->data;
+                __atomic_store_n(&cell->sequence, position + mask + 1, __ATOMIC_RELEASE);
+
+                return data;
+            }
+        }
+        else if (diff < 0)
+        {
+            return null;
+        }
+        else
+        {
+            position = __atomic_load_n(&queue->pop_position, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+s64 GetMPMCQueueCount(MPMCQueue *queue)
+{
+    u64 pop_position = __atomic_load_n(&queue->pop_position, __ATOMIC_RELAXED);
+    u64 push_position = __atomic_load_n(&queue->push_position, __ATOMIC_RELAXED);
+
+    return Clamp((s64)(push_position - pop_position), (s64)0, queue->capacity);
 }
 
 void InitThreadGroup(ThreadGroup *group, String name, ThreadGroupFunc func, int num_threads)
 {
-    Assert(num_threads > 1);
+    Assert(num_threads > 0);
     Assert(func != null);
 
     group->name = name;
     group->func = func;
-    group->worker_threads = AllocSlice<WorkerThread>(num_threads, heap, true);
+    group->worker_threads = AllocSlice<WorkerThread>(num_threads, TaggedHeap(MemoryTag_Jobs), true);
+
+    InitWorkDeque(&group->submitted_work);
+    InitMPMCQueue(&group->completed_work, Work_Queue_Capacity);
 
     foreach (i, group->worker_threads)
     {
         auto worker = &group->worker_threads[i];
         worker->group = group;
+        worker->steal_rng_state = Fnv1aHash((u64)i + 1);
 
-        InitWorkList(&worker->available_work);
-        InitWorkList(&worker->completed_work);
+        InitWorkDeque(&worker->work_deque);
     }
 
     group->initialized = true;
@@ -324,14 +806,12 @@ void DestroyThreadGroup(ThreadGroup *group)
         Stop(group);
 
     foreach (i, group->worker_threads)
-    {
-        auto worker = &group->worker_threads[i];
+        DestroyWorkDeque(&group->worker_threads[i].work_deque);
 
-        DestroyWorkList(&worker->available_work);
-        DestroyWorkList(&worker->completed_work);
-    }
+    DestroyWorkDeque(&group->submitted_work);
+    DestroyMPMCQueue(&group->completed_work);
 
-    Free(group->worker_threads.data, heap);
+    Free(group->worker_threads.data, TaggedHeap(MemoryTag_Jobs));
     *group = {};
 }
 
@@ -340,9 +820,18 @@ void Start(ThreadGroup *group)
     Assert(group->initialized, "Thread group is not initialized");
     Assert(!group->started, "Thread group has already been started");
 
+    group->owner_thread = pthread_self();
+
     foreach (i, group->worker_threads)
     {
         auto worker = &group->worker_threads[i];
+
+        if (group->scheduling == ThreadGroupScheduling_RoundRobin)
+        {
+            InitMPMCQueue(&worker->available_work, Work_Queue_Capacity);
+            sem_init(&worker->available_work_semaphore, 0, 0);
+        }
+
         int status = pthread_create(&worker->thread, null, WorkerThreadRoutine, worker);
         Assert(status == 0);
     }
@@ -354,140 +843,218 @@ void Stop(ThreadGroup *group)
 {
     Assert(group->started, "Thread group has not been started");
 
-    group->should_stop = true;
+    __atomic_store_n(&group->should_stop, true, __ATOMIC_SEQ_CST);
+
+    __atomic_fetch_add(&group->wake_counter, 1, __ATOMIC_SEQ_CST);
+    FutexWake(&group->wake_counter, INT32_MAX);
 
     foreach (i, group->worker_threads)
     {
         auto worker = &group->worker_threads[i];
-        sem_post(&worker->available_work.semaphore);
+        if (group->scheduling == ThreadGroupScheduling_RoundRobin)
+            sem_post(&worker->available_work_semaphore);
 
         pthread_join(worker->thread, null);
         worker->thread = 0;
+
+        if (group->scheduling == ThreadGroupScheduling_RoundRobin)
+        {
+            DestroyMPMCQueue(&worker->available_work);
+            sem_destroy(&worker->available_work_semaphore);
+        }
     }
 
     group->started = false;
 }
 
-static void AddWorkToList(ThreadWorkList *list, ThreadWorkEntry *entry)
+void AddWork(ThreadGroup *group, void *work)
 {
-    pthread_mutex_lock(&list->mutex);
-
-    if (list->last)
-        list->last->next = entry;
-    else
-        list->first = entry;
-
-    list->last = entry;
-    list->count += 1;
-
-    pthread_mutex_unlock(&list->mutex);
+    Assert(group->started, "Thread group has not been started");
+    Assert(work != null);
 
-    sem_post(&list->semaphore);
-}
+    if (__atomic_load_n(&group->should_stop, __ATOMIC_RELAXED))
+        return;
 
-static ThreadWorkEntry *GetWorkFromList(ThreadWorkList *list)
-{
-    pthread_mutex_lock(&list->mutex);
+    if (group->scheduling == ThreadGroupScheduling_RoundRobin)
+    {
+        auto worker = &group->worker_threads[group->worker_thread_assign_index];
 
-    auto result = list->first;
+        group->worker_thread_assign_index += 1;
+        if (group->worker_thread_assign_index >= group->worker_threads.count)
+            group->worker_thread_assign_index = 0;
 
-    list->first = result->next;
-    if (!list->first)
-        list->last = null;
+        MPMCQueuePushWait(&worker->available_work, work);
+        sem_post(&worker->available_work_semaphore);
 
-    list->count -= 1;
+        return;
+    }
 
-    result->next = null;
+    WorkerThread *worker = t_worker_thread;
+    if (worker && worker->group == group)
+    {
+        PushWorkDeque(&worker->work_deque, work);
+    }
+    else
+    {
+        Assert(pthread_equal(pthread_self(), group->owner_thread), "Work can only be added from the thread that started the group, or from its workers");
+        PushWorkDeque(&group->submitted_work, work);
+    }
 
-    pthread_mutex_unlock(&list->mutex);
+    // Pairs with the sleeping worker incrementing num_sleeping_workers before waiting
+    // on the counter: either the worker sees the new counter value and does not sleep,
+    // or we see that it is sleeping and wake it up
+    __atomic_fetch_add(&group->wake_counter, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&group->num_sleeping_workers, __ATOMIC_SEQ_CST) > 0)
+        FutexWake(&group->wake_counter, 1);
+}
 
-    return result;
+void *PopCompletedWork(ThreadGroup *group)
+{
+    return MPMCQueuePop(&group->completed_work);
 }
 
-void AddWork(ThreadGroup *group, void *work)
+Slice<void *> GetCompletedWork(ThreadGroup *group)
 {
-    Assert(group->started, "Thread group has not been started");
+    Array<void *> result = {.allocator=temp};
+    ArrayReserve(&result, GetMPMCQueueCount(&group->completed_work));
 
-    if (group->should_stop)
-        return;
+    while (void *work = MPMCQueuePop(&group->completed_work))
+        ArrayPush(&result, work);
 
-    auto entry = Alloc<ThreadWorkEntry>(heap);
-    entry->work = work;
+    return MakeSlice(result);
+}
 
-    entry->worker_thread_index = group->worker_thread_assign_index;
+int GetNumQueuedWork(ThreadGroup *group)
+{
+    s64 count = GetWorkDequeCount(&group->submitted_work);
+    foreach (i, group->worker_threads)
+    {
+        count += GetWorkDequeCount(&group->worker_threads[i].work_deque);
+        if (group->started && group->scheduling == ThreadGroupScheduling_RoundRobin)
+            count += GetMPMCQueueCount(&group->worker_threads[i].available_work);
+    }
 
-    group->worker_thread_assign_index += 1;
-    if (group->worker_thread_assign_index >= group->worker_threads.count)
-        group->worker_thread_assign_index = 0;
+    return (int)count;
+}
 
-    AddWorkToList(&group->worker_threads[entry->worker_thread_index].available_work, entry);
+int GetNumCompletedWork(ThreadGroup *group)
+{
+    return (int)GetMPMCQueueCount(&group->completed_work);
 }
 
-Slice<void *> GetCompletedWork(ThreadGroup *group)
+static void *FindWork(WorkerThread *worker)
 {
-    Array<void *> result = {.allocator=temp};
+    ThreadGroup *group = worker->group;
 
-    ThreadWorkEntry *completed = null;
-    int count = 0;
-    foreach (i, group->worker_threads)
+    // Work we added ourselves first, it is probably still in the cache
+    void *work = PopWorkDeque(&worker->work_deque);
+    if (work)
+        return work;
+
+    while (true)
     {
-        auto worker = &group->worker_threads[i];
+        bool lost_race = false;
 
-        pthread_mutex_lock(&worker->completed_work.mutex);
+        // Oldest submitted work first, this keeps the order in which work is added
+        work = StealWorkDeque(&group->submitted_work, &lost_race);
+        if (work)
+            return work;
 
-        count += worker->completed_work.count;
+        // Start from a random victim so the thieves do not all fight over the same worker
+        worker->steal_rng_state ^= worker->steal_rng_state << 13;
+        worker->steal_rng_state ^= worker->steal_rng_state >> 7;
+        worker->steal_rng_state ^= worker->steal_rng_state << 17;
 
-        if (worker->completed_work.last)
+        s64 num_workers = group->worker_threads.count;
+        s64 first_victim = (s64)(worker->steal_rng_state % (u64)num_workers);
+        for (s64 i = 0; i < num_workers; i += 1)
         {
-            worker->completed_work.last->next = completed;
-            completed = worker->completed_work.first;
-        }
+            WorkerThread *victim = &group->worker_threads[(first_victim + i) % num_workers];
+            if (victim == worker)
+                continue;
 
-        worker->completed_work.first = null;
-        worker->completed_work.last = null;
-        worker->completed_work.count = 0;
+            work = StealWorkDeque(&victim->work_deque, &lost_race);
+            if (work)
+                return work;
+        }
 
-        pthread_mutex_unlock(&worker->completed_work.mutex);
+        if (!lost_race)
+            return null;
     }
+}
+
+static void WorkStealingLoop(WorkerThread *worker)
+{
+    ThreadGroup *group = worker->group;
 
-    while (completed)
+    while (!__atomic_load_n(&group->should_stop, __ATOMIC_ACQUIRE))
     {
-        auto next = completed->next;
+        // Read the counter before looking for work, if work is added after we looked
+        // the counter will have changed and FutexWait will return immediately
+        u32 wake_counter = __atomic_load_n(&group->wake_counter, __ATOMIC_SEQ_CST);
 
-        ArrayPush(&result, completed->work);
+        void *work = FindWork(worker);
+        if (!work)
+        {
+            __atomic_fetch_add(&group->num_sleeping_workers, 1, __ATOMIC_SEQ_CST);
+            if (!__atomic_load_n(&group->should_stop, __ATOMIC_SEQ_CST))
+                FutexWait(&group->wake_counter, wake_counter);
+            __atomic_fetch_sub(&group->num_sleeping_workers, 1, __ATOMIC_SEQ_CST);
 
-        Free(completed, heap);
+            continue;
+        }
 
-        completed = next;
+        group->func(group, work);
+        MPMCQueuePushWait(&group->completed_work, work);
     }
-
-    Assert(result.count == count);
-
-    return MakeSlice(result);
 }
 
-void *WorkerThreadRoutine(void *data)
+static void RoundRobinLoop(WorkerThread *worker)
 {
-    auto worker = (WorkerThread *)data;
+    ThreadGroup *group = worker->group;
 
-    while (!worker->group->should_stop)
+    while (!__atomic_load_n(&group->should_stop, __ATOMIC_ACQUIRE))
     {
-        sem_wait(&worker->available_work.semaphore);
-        if (worker->group->should_stop)
+        sem_wait(&worker->available_work_semaphore);
+        if (__atomic_load_n(&group->should_stop, __ATOMIC_ACQUIRE))
             break;
 
-        auto entry = GetWorkFromList(&worker->available_work);
-
-        if (entry)
+        void *work = MPMCQueuePop(&worker->available_work);
+        if (work)
         {
-            worker->group->func(worker->group, entry->work);
-            AddWorkToList(&worker->completed_work, entry);
+            group->func(group, work);
+            MPMCQueuePushWait(&group->completed_work, work);
         }
     }
+}
+
+void *WorkerThreadRoutine(void *data)
+{
+    auto worker = (WorkerThread *)data;
+
+    t_worker_thread = worker;
+
+    char thread_name[Profiler_Thread_Name_Capacity];
+    snprintf(thread_name, sizeof(thread_name), "%.*s %d", FSTR(worker->group->name), (int)(worker - worker->group->worker_threads.data));
+    ProfilerRegisterThread(thread_name);
+    defer(ProfilerUnregisterThread());
+    defer(FreeScratchArena());
+
+    if (worker->group->scheduling == ThreadGroupScheduling_RoundRobin)
+        RoundRobinLoop(worker);
+    else
+        WorkStealingLoop(worker);
 
     return null;
 }
 
+int GetNumHardwareThreads()
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return count > 0 ? (int)count : 1;
+}
+
 float GetTimeInSeconds()
 {
     struct timespec time;
@@ -495,3 +1062,11 @@ float GetTimeInSeconds()
 
     return (float)time.tv_sec + (float)time.tv_nsec * 1e-9;
 }
+
+s64 GetTimeInNanoseconds()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (s64)time.tv_sec * 1000000000 + (s64)time.tv_nsec;
+}
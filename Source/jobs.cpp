@@ -0,0 +1,407 @@
+#include "Jobs.hpp"
+#include "Math.hpp"
+#include "Profiler.hpp"
+
+static thread_local JobWorker *t_job_worker = null;
+
+static void *JobWorkerRoutine(void *data);
+
+void InitJobSystem(JobSystem *system, String name, int num_threads)
+{
+    if (num_threads <= 0)
+        num_threads = Max(GetNumHardwareThreads() - 1, 1);
+
+    system->name = name;
+    system->workers = AllocSlice<JobWorker>(num_threads, TaggedHeap(MemoryTag_Jobs), true);
+
+    for (int i = 0; i < JobPriority_Count; i += 1)
+        InitMPMCQueue(&system->submitted_jobs[i], Work_Queue_Capacity);
+
+    foreach (i, system->workers)
+    {
+        auto worker = &system->workers[i];
+        worker->system = system;
+        worker->steal_rng_state = Fnv1aHash((u64)i + 1);
+
+        for (int j = 0; j < JobPriority_Count; j += 1)
+            InitWorkDeque(&worker->deques[j]);
+    }
+
+    foreach (i, system->workers)
+    {
+        auto worker = &system->workers[i];
+        int status = pthread_create(&worker->thread, null, JobWorkerRoutine, worker);
+        Assert(status == 0);
+    }
+
+    LogMessage(Log_Jobs, "Started %.*s with %d workers", FSTR(name), num_threads);
+}
+
+// Never waits, the owner of the queue might be waiting for one of our jobs to submit its own
+static void PushCompletedJob(JobCompletionQueue *queue, Job *job)
+{
+    if (MPMCQueuePush(&queue->jobs, job))
+        return;
+
+    // Counted before the job is in the list, so the owner never sees the count go below 0
+    __atomic_fetch_add(&queue->num_overflow, 1, __ATOMIC_RELAXED);
+
+    Job *head = __atomic_load_n(&queue->overflow, __ATOMIC_RELAXED);
+    while (true)
+    {
+        job->next_completed = head;
+        if (__atomic_compare_exchange_n(&queue->overflow, &head, job, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            return;
+    }
+}
+
+static void DropJob(Job *job)
+{
+    // A job that never ran takes down the jobs that were only waiting for it
+    JobContinuation *continuation = job->continuations;
+    job->continuations = Job_Continuations_Closed;
+    while (continuation && continuation != Job_Continuations_Closed)
+    {
+        JobContinuation *next = continuation->next;
+
+        if (__atomic_sub_fetch(&continuation->job->num_pending_dependencies, 1, __ATOMIC_ACQ_REL) == 0)
+            DropJob(continuation->job);
+
+        continuation = next;
+    }
+
+    if (job->completion_queue)
+        PushCompletedJob(job->completion_queue, job);
+}
+
+void DestroyJobSystem(JobSystem *system)
+{
+    __atomic_store_n(&system->should_stop, true, __ATOMIC_SEQ_CST);
+
+    __atomic_fetch_add(&system->wake_counter, 1, __ATOMIC_SEQ_CST);
+    FutexWake(&system->wake_counter, INT32_MAX);
+
+    foreach (i, system->workers)
+        pthread_join(system->workers[i].thread, null);
+
+    // The workers are gone, so we can take ownership of their deques
+    foreach (i, system->workers)
+    {
+        for (int j = 0; j < JobPriority_Count; j += 1)
+        {
+            WorkDeque *deque = &system->workers[i].deques[j];
+            while (auto job = (Job *)PopWorkDeque(deque))
+                DropJob(job);
+
+            DestroyWorkDeque(deque);
+        }
+    }
+
+    for (int i = 0; i < JobPriority_Count; i += 1)
+    {
+        while (auto job = (Job *)MPMCQueuePop(&system->submitted_jobs[i]))
+            DropJob(job);
+
+        DestroyMPMCQueue(&system->submitted_jobs[i]);
+    }
+
+    Free(system->workers.data, TaggedHeap(MemoryTag_Jobs));
+    *system = {};
+}
+
+void InitJobCompletionQueue(JobCompletionQueue *queue, s64 capacity)
+{
+    InitMPMCQueue(&queue->jobs, capacity);
+}
+
+void DestroyJobCompletionQueue(JobCompletionQueue *queue)
+{
+    DestroyMPMCQueue(&queue->jobs);
+    *queue = {};
+}
+
+void InitJob(Job *job, JobFunc func, void *data, JobPriority priority, JobCompletionQueue *completion_queue)
+{
+    Assert(func != null);
+
+    *job = {};
+    job->func = func;
+    job->data = data;
+    job->priority = priority;
+    job->completion_queue = completion_queue;
+}
+
+void AddJobDependency(Job *job, Job *dependency)
+{
+    Assert(job->system == null, "Dependencies must be added before the job is submitted");
+    Assert(dependency->system != null, "The dependency must be submitted first");
+
+    Assert(job->num_dependencies < Job_Max_Dependencies, "Too many dependencies, increase Job_Max_Dependencies");
+
+    auto continuation = &job->dependency_nodes[job->num_dependencies];
+    continuation->job = job;
+    job->num_dependencies += 1;
+
+    __atomic_fetch_add(&job->num_pending_dependencies, 1, __ATOMIC_RELAXED);
+
+    JobContinuation *head = __atomic_load_n(&dependency->continuations, __ATOMIC_ACQUIRE);
+    while (true)
+    {
+        if (head == Job_Continuations_Closed)
+        {
+            // Already done, nothing to wait for
+            __atomic_fetch_sub(&job->num_pending_dependencies, 1, __ATOMIC_RELAXED);
+            job->num_dependencies -= 1;
+
+            return;
+        }
+
+        continuation->next = head;
+        if (__atomic_compare_exchange_n(&dependency->continuations, &head, continuation, true, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE))
+            return;
+    }
+}
+
+static void ReleaseJob(Job *job)
+{
+    JobSystem *system = job->system;
+
+    job->released_ns = GetTimeInNanoseconds();
+
+    JobWorker *worker = t_job_worker;
+    if (worker && worker->system == system)
+    {
+        PushWorkDeque(&worker->deques[job->priority], job);
+    }
+    else
+    {
+        MPMCQueuePushWait(&system->submitted_jobs[job->priority], job);
+    }
+
+    // See WorkStealingLoop in core.cpp for why this cannot miss a sleeping worker
+    __atomic_fetch_add(&system->wake_counter, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&system->num_sleeping_workers, __ATOMIC_SEQ_CST) > 0)
+        FutexWake(&system->wake_counter, 1);
+}
+
+static void ReleaseWaitingJob(Job *job)
+{
+    __atomic_fetch_sub(&job->system->num_waiting_jobs, 1, __ATOMIC_RELAXED);
+    ReleaseJob(job);
+}
+
+void SubmitJob(JobSystem *system, Job *job)
+{
+    Assert(job->system == null, "Job has already been submitted");
+
+    job->system = system;
+    job->submitted_ns = GetTimeInNanoseconds();
+
+    __atomic_fetch_add(&system->num_waiting_jobs, 1, __ATOMIC_RELAXED);
+
+    // Drop the reference that kept the job from being released while adding dependencies
+    if (__atomic_sub_fetch(&job->num_pending_dependencies, 1, __ATOMIC_ACQ_REL) == 0)
+        ReleaseWaitingJob(job);
+}
+
+static void FinishJob(Job *job)
+{
+    // Nobody can add continuations after this, so we own the list
+    JobContinuation *continuation = __atomic_exchange_n(&job->continuations, Job_Continuations_Closed, __ATOMIC_ACQ_REL);
+    while (continuation)
+    {
+        // The node lives in the waiting job, which can be done and reused as soon as it is released
+        JobContinuation *next = continuation->next;
+
+        if (__atomic_sub_fetch(&continuation->job->num_pending_dependencies, 1, __ATOMIC_ACQ_REL) == 0)
+            ReleaseWaitingJob(continuation->job);
+
+        continuation = next;
+    }
+
+    // The owner can reuse the job as soon as it is in the queue
+    if (job->completion_queue)
+        PushCompletedJob(job->completion_queue, job);
+}
+
+Job *PopCompletedJob(JobCompletionQueue *queue)
+{
+    if (auto job = (Job *)MPMCQueuePop(&queue->jobs))
+        return job;
+
+    if (!queue->overflow_popped && __atomic_load_n(&queue->overflow, __ATOMIC_RELAXED))
+        queue->overflow_popped = __atomic_exchange_n(&queue->overflow, null, __ATOMIC_ACQUIRE);
+
+    Job *job = queue->overflow_popped;
+    if (job)
+    {
+        queue->overflow_popped = job->next_completed;
+        __atomic_fetch_sub(&queue->num_overflow, 1, __ATOMIC_RELAXED);
+    }
+
+    return job;
+}
+
+int GetNumCompletedJobs(JobCompletionQueue *queue)
+{
+    return (int)GetMPMCQueueCount(&queue->jobs) + __atomic_load_n(&queue->num_overflow, __ATOMIC_RELAXED);
+}
+
+int GetNumQueuedJobs(JobSystem *system)
+{
+    s64 count = 0;
+    for (int i = 0; i < JobPriority_Count; i += 1)
+    {
+        count += GetMPMCQueueCount(&system->submitted_jobs[i]);
+
+        foreach (j, system->workers)
+            count += GetWorkDequeCount(&system->workers[j].deques[i]);
+    }
+
+    return (int)count;
+}
+
+int GetNumWaitingJobs(JobSystem *system)
+{
+    return __atomic_load_n(&system->num_waiting_jobs, __ATOMIC_RELAXED);
+}
+
+void UpdateJobSystemStats(JobSystem *system)
+{
+    s64 now = GetTimeInNanoseconds();
+    s64 elapsed = now - system->last_stats_ns;
+
+    foreach (i, system->workers)
+    {
+        JobWorker *worker = &system->workers[i];
+
+        // Count the time spent in the current job too, or a worker running
+        // a job that takes longer than a frame would look idle
+        s64 job_start = __atomic_load_n(&worker->job_start_ns, __ATOMIC_RELAXED);
+        s64 busy = __atomic_load_n(&worker->busy_ns, __ATOMIC_RELAXED);
+        if (job_start > 0)
+            busy += now - job_start;
+
+        if (system->last_stats_ns > 0 && elapsed > 0)
+            worker->utilization = Clamp((busy - worker->last_busy_ns) / (float)elapsed, 0.0f, 1.0f);
+
+        worker->last_busy_ns = busy;
+    }
+
+    system->last_stats_ns = now;
+}
+
+float GetAverageJobWorkerUtilization(JobSystem *system)
+{
+    if (system->workers.count <= 0)
+        return 0;
+
+    float total = 0;
+    foreach (i, system->workers)
+        total += system->workers[i].utilization;
+
+    return total / system->workers.count;
+}
+
+static Job *FindJob(JobWorker *worker)
+{
+    JobSystem *system = worker->system;
+
+    while (true)
+    {
+        bool lost_race = false;
+
+        worker->steal_rng_state ^= worker->steal_rng_state << 13;
+        worker->steal_rng_state ^= worker->steal_rng_state >> 7;
+        worker->steal_rng_state ^= worker->steal_rng_state << 17;
+
+        s64 num_workers = system->workers.count;
+        s64 first_victim = (s64)(worker->steal_rng_state % (u64)num_workers);
+
+        // A job of lower priority is only taken when there is no job of higher priority anywhere
+        for (int priority = 0; priority < JobPriority_Count; priority += 1)
+        {
+            auto job = (Job *)PopWorkDeque(&worker->deques[priority]);
+            if (job)
+                return job;
+
+            job = (Job *)MPMCQueuePop(&system->submitted_jobs[priority]);
+            if (job)
+                return job;
+
+            for (s64 i = 0; i < num_workers; i += 1)
+            {
+                JobWorker *victim = &system->workers[(first_victim + i) % num_workers];
+                if (victim == worker)
+                    continue;
+
+                job = (Job *)StealWorkDeque(&victim->deques[priority], &lost_race);
+                if (job)
+                    return job;
+            }
+        }
+
+        if (!lost_race)
+            return null;
+    }
+}
+
+static void RunJob(JobWorker *worker, Job *job)
+{
+    s64 start = GetTimeInNanoseconds();
+    job->start_ns = start;
+    __atomic_store_n(&worker->job_start_ns, start, __ATOMIC_RELAXED);
+
+    job->func(job->data);
+
+    s64 end = GetTimeInNanoseconds();
+    job->end_ns = end;
+    __atomic_store_n(&worker->job_start_ns, 0, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&worker->busy_ns, end - start, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&worker->num_jobs, 1, __ATOMIC_RELAXED);
+
+    ScratchArenaStats scratch_stats = GetScratchArenaStats();
+    __atomic_fetch_add(&worker->num_scratch_allocations, scratch_stats.num_allocations, __ATOMIC_RELAXED);
+    if (scratch_stats.peak_used > __atomic_load_n(&worker->scratch_peak_used, __ATOMIC_RELAXED))
+        __atomic_store_n(&worker->scratch_peak_used, scratch_stats.peak_used, __ATOMIC_RELAXED);
+    __atomic_store_n(&worker->scratch_reserved, scratch_stats.reserved, __ATOMIC_RELAXED);
+
+    // The next job starts with an empty arena, even if this one forgot to restore what it allocated
+    ResetScratchArena();
+
+    FinishJob(job);
+}
+
+void *JobWorkerRoutine(void *data)
+{
+    auto worker = (JobWorker *)data;
+    JobSystem *system = worker->system;
+
+    t_job_worker = worker;
+
+    char thread_name[Profiler_Thread_Name_Capacity];
+    snprintf(thread_name, sizeof(thread_name), "%.*s %d", FSTR(system->name), (int)(worker - system->workers.data));
+    ProfilerRegisterThread(thread_name);
+    defer(ProfilerUnregisterThread());
+    defer(FreeScratchArena());
+
+    while (!__atomic_load_n(&system->should_stop, __ATOMIC_ACQUIRE))
+    {
+        u32 wake_counter = __atomic_load_n(&system->wake_counter, __ATOMIC_SEQ_CST);
+
+        Job *job = FindJob(worker);
+        if (!job)
+        {
+            __atomic_fetch_add(&system->num_sleeping_workers, 1, __ATOMIC_SEQ_CST);
+            if (!__atomic_load_n(&system->should_stop, __ATOMIC_SEQ_CST))
+                FutexWait(&system->wake_counter, wake_counter);
+            __atomic_fetch_sub(&system->num_sleeping_workers, 1, __ATOMIC_SEQ_CST);
+
+            continue;
+        }
+
+        RunJob(worker, job);
+    }
+
+    return null;
+}
@@ -21,7 +21,64 @@ World g_world;
 
 int main(int argc, char **args)
 {
-    SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS);
+    // Optionally run for a fixed number of frames, mostly useful for headless builds.
+    // Metrics can be written every few frames with --metrics file.csv|file.jsonl [--metrics-interval N],
+    // and the traces of the chunks that were the slowest to show up on exit with --chunk-traces file.json.
+    // --leak-report logs the memory tags that still have live allocations on exit.
+    // With OpenGL, --check-state-cache runs the state cache self check and exits
+    u64 max_frames = 0;
+    const char *metrics_filename = null;
+    const char *chunk_traces_filename = null;
+    bool leak_report = false;
+    int metrics_interval = Default_Metrics_Dump_Interval;
+    for (int i = 1; i < argc; i += 1)
+    {
+        bool takes_value = strcmp(args[i], "--metrics") == 0
+            || strcmp(args[i], "--metrics-interval") == 0
+            || strcmp(args[i], "--chunk-traces") == 0;
+        if (takes_value && i + 1 >= argc)
+        {
+            LogError(Log_Main, "Missing value for %s", args[i]);
+            return 1;
+        }
+
+        if (strcmp(args[i], "--metrics") == 0)
+        {
+            metrics_filename = args[i + 1];
+            i += 1;
+        }
+        else if (strcmp(args[i], "--metrics-interval") == 0)
+        {
+            metrics_interval = atoi(args[i + 1]);
+            i += 1;
+        }
+        else if (strcmp(args[i], "--chunk-traces") == 0)
+        {
+            chunk_traces_filename = args[i + 1];
+            i += 1;
+        }
+        else if (strcmp(args[i], "--leak-report") == 0)
+        {
+            leak_report = true;
+        }
+    #if defined(VOX_BACKEND_OPENGL)
+        else if (strcmp(args[i], "--check-state-cache") == 0)
+        {
+            return GLCheckStateCache() ? 0 : 1;
+        }
+    #endif
+        else
+        {
+            char *end = null;
+            max_frames = strtoull(args[i], &end, 10);
+            if (args[i][0] < '0' || args[i][0] > '9' || *end != 0)
+            {
+                LogError(Log_Main, "Unknown option %s", args[i]);
+                return 1;
+            }
+        }
+    }
+
     u32 sdl_flags = SDL_WINDOW_RESIZABLE;
     #if defined(VOX_BACKEND_OPENGL)
         sdl_flags |= SDL_WINDOW_OPENGL;
@@ -31,8 +88,23 @@ int main(int argc, char **args)
         SDL_SetHint(SDL_HINT_RENDER_DRIVER, "vulkan");
     #elif defined(VOX_BACKEND_METAL)
         SDL_SetHint(SDL_HINT_RENDER_DRIVER, "metal");
+    #elif defined(VOX_BACKEND_NULL)
+        // The dummy video driver does not need a display, the window is never shown
+        SDL_setenv("SDL_VIDEODRIVER", "dummy", true);
+        sdl_flags |= SDL_WINDOW_HIDDEN;
     #endif
 
+    SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS);
+
+    ProfilerRegisterThread("Main");
+
+    // Declared first so it runs after everything else is destroyed
+    defer({
+        if (leak_report)
+            ReportMemoryLeaks();
+    });
+    defer(ProfilerShutdown());
+
     g_window = SDL_CreateWindow("Vox", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1800, 1012, sdl_flags);
     defer(SDL_DestroyWindow(g_window));
 
@@ -40,23 +112,47 @@ int main(int argc, char **args)
     defer(GfxDestroyContext());
 
     LoadAllShaders();
+    defer(UnloadAllShaders());
+
     InitRenderer();
+    defer(DestroyRenderer());
+    defer(DestroyUI());
 
     SetDefaultNoiseParams(&g_world);
     InitWorld(&g_world, (u32)(GetTimeInSeconds() * 173894775));
     defer(DestroyWorld(&g_world));
 
+    if (metrics_filename)
+        StartMetricsDump(metrics_filename, metrics_interval);
+    defer(StopMetricsDump());
+
+    defer({
+        if (chunk_traces_filename)
+            WriteChunkTraceOutliers(chunk_traces_filename);
+    });
+
+    Metric *frame_time_metric = RegisterHistogram("frame.time_ns");
+    s64 last_frame_start = 0;
+
     GfxTexture noise_texture = {};
     GfxTexture terrain_texture = {};
 
     int current_params = 1;
     bool quit = false;
-    while(!quit)
+    while(!quit && (max_frames == 0 || g_frame_index < max_frames))
     {
         g_frame_index += 1;
 
         ResetMemoryArena(&g_frame_arena);
 
+        ProfilerNewFrame();
+        ProfileZone("Frame");
+
+        s64 frame_start = GetTimeInNanoseconds();
+        if (last_frame_start > 0)
+            MetricRecord(frame_time_metric, frame_start - last_frame_start);
+        last_frame_start = frame_start;
+
         UpdateInput();
 
         SDL_Event event = {};
@@ -74,10 +170,18 @@ int main(int argc, char **args)
         SDL_GetWindowSizeInPixels(g_window, &window_w, &window_h);
 
         UpdateCamera(&g_world.camera);
-        UpdateUI(&g_world);
+
+        {
+            ProfileZone("UpdateUI");
+            UpdateUI(&g_world);
+        }
 
         GenerateChunksAroundPoint(&g_world, g_world.camera.position, g_settings.render_distance * Chunk_Size);
 
         RenderGraphics(&g_world);
+
+        PublishWorldMetrics(&g_world);
+        PublishMemoryMetrics();
+        UpdateMetricsDump();
     }
 }
@@ -0,0 +1,285 @@
+#include "Metrics.hpp"
+#include "Math.hpp"
+
+static Metric g_metrics[Metrics_Max_Count];
+static int g_num_metrics = 0;
+static pthread_mutex_t g_metrics_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+struct MetricsDump
+{
+    FILE *file = null;
+    bool csv = false;
+    int interval_in_frames = 1;
+    int num_metrics_in_header = 0;
+    s64 start_time_ns = 0;
+};
+
+static MetricsDump g_metrics_dump;
+
+static Metric *RegisterMetric(const char *name, MetricType type)
+{
+    pthread_mutex_lock(&g_metrics_mutex);
+    defer(pthread_mutex_unlock(&g_metrics_mutex));
+
+    for (int i = 0; i < g_num_metrics; i += 1)
+    {
+        if (strcmp(g_metrics[i].name, name) == 0)
+        {
+            Assert(g_metrics[i].type == type, "Metric %s was registered with a different type", name);
+            return &g_metrics[i];
+        }
+    }
+
+    Assert(g_num_metrics < Metrics_Max_Count, "Too many metrics, increase Metrics_Max_Count");
+
+    Metric *metric = &g_metrics[g_num_metrics];
+    *metric = {.name=name, .type=type, .min=INT64_MAX, .max=INT64_MIN};
+
+    // Readers do not take the mutex, so the metric is published after it is initialized
+    __atomic_store_n(&g_num_metrics, g_num_metrics + 1, __ATOMIC_RELEASE);
+
+    return metric;
+}
+
+Metric *RegisterCounter(const char *name)
+{
+    return RegisterMetric(name, MetricType_Counter);
+}
+
+Metric *RegisterGauge(const char *name)
+{
+    return RegisterMetric(name, MetricType_Gauge);
+}
+
+Metric *RegisterHistogram(const char *name)
+{
+    return RegisterMetric(name, MetricType_Histogram);
+}
+
+void MetricAdd(Metric *metric, s64 amount)
+{
+    Assert(metric->type != MetricType_Histogram);
+
+    __atomic_fetch_add(&metric->value, amount, __ATOMIC_RELAXED);
+}
+
+void MetricSet(Metric *metric, s64 value)
+{
+    Assert(metric->type == MetricType_Gauge);
+
+    __atomic_store_n(&metric->value, value, __ATOMIC_RELAXED);
+}
+
+static int GetHistogramBucket(s64 value)
+{
+    if (value <= 0)
+        return 0;
+
+    return 64 - __builtin_clzll((u64)value);
+}
+
+void MetricRecord(Metric *metric, s64 value)
+{
+    Assert(metric->type == MetricType_Histogram);
+
+    __atomic_fetch_add(&metric->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&metric->sum, value, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&metric->buckets[GetHistogramBucket(value)], 1, __ATOMIC_RELAXED);
+
+    s64 min = __atomic_load_n(&metric->min, __ATOMIC_RELAXED);
+    while (value < min && !__atomic_compare_exchange_n(&metric->min, &min, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+
+    s64 max = __atomic_load_n(&metric->max, __ATOMIC_RELAXED);
+    while (value > max && !__atomic_compare_exchange_n(&metric->max, &max, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
+
+s64 GetMetricValue(Metric *metric)
+{
+    return __atomic_load_n(&metric->value, __ATOMIC_RELAXED);
+}
+
+s64 GetMetricPercentile(Metric *metric, f64 percentile)
+{
+    Assert(metric->type == MetricType_Histogram);
+
+    s64 count = __atomic_load_n(&metric->count, __ATOMIC_RELAXED);
+    if (count <= 0)
+        return 0;
+
+    s64 min = __atomic_load_n(&metric->min, __ATOMIC_RELAXED);
+    s64 max = __atomic_load_n(&metric->max, __ATOMIC_RELAXED);
+
+    s64 target = (s64)ceil(percentile * count);
+    s64 cumulative = 0;
+    for (int i = 0; i < Metric_Histogram_Num_Buckets; i += 1)
+    {
+        cumulative += __atomic_load_n(&metric->buckets[i], __ATOMIC_RELAXED);
+        if (cumulative >= target)
+        {
+            s64 upper_bound = i == 0 ? 0 : (s64)((1ull << i) - 1);
+            return Clamp(upper_bound, min, max);
+        }
+    }
+
+    return max;
+}
+
+Slice<Metric> GetAllMetrics()
+{
+    int count = __atomic_load_n(&g_num_metrics, __ATOMIC_ACQUIRE);
+
+    return Slice<Metric>{.count=count, .data=g_metrics};
+}
+
+struct MemoryTagMetrics
+{
+    // Metrics keep a pointer to their name
+    char live_name[64] = {};
+    char peak_name[64] = {};
+    char allocations_name[64] = {};
+
+    Metric *live_bytes = null;
+    Metric *peak_bytes = null;
+    Metric *num_live_allocations = null;
+};
+
+static MemoryTagMetrics g_memory_tag_metrics[MemoryTag_Count];
+
+void PublishMemoryMetrics()
+{
+    for (int i = 0; i < MemoryTag_Count; i += 1)
+    {
+        MemoryTagMetrics *m = &g_memory_tag_metrics[i];
+        if (!m->live_bytes)
+        {
+            const char *name = GetMemoryTagName((MemoryTag)i);
+            snprintf(m->live_name, sizeof(m->live_name), "memory.tag.%s.live", name);
+            snprintf(m->peak_name, sizeof(m->peak_name), "memory.tag.%s.peak", name);
+            snprintf(m->allocations_name, sizeof(m->allocations_name), "memory.tag.%s.allocations", name);
+
+            m->live_bytes = RegisterGauge(m->live_name);
+            m->peak_bytes = RegisterGauge(m->peak_name);
+            m->num_live_allocations = RegisterGauge(m->allocations_name);
+        }
+
+        MemoryTagStats stats = GetMemoryTagStats((MemoryTag)i);
+        MetricSet(m->live_bytes, stats.live_bytes);
+        MetricSet(m->peak_bytes, stats.peak_bytes);
+        MetricSet(m->num_live_allocations, stats.num_live_allocations);
+    }
+}
+
+bool StartMetricsDump(String filename, int interval_in_frames)
+{
+    StopMetricsDump();
+
+    FILE *file = fopen(CloneToCString(filename, temp), "w");
+    if (!file)
+    {
+        LogError(Log_Metrics, "Could not open %.*s for writing", FSTR(filename));
+        return false;
+    }
+
+    String csv_extension = ".csv";
+    bool csv = filename.length >= csv_extension.length
+        && Equals(String{csv_extension.length, filename.data + filename.length - csv_extension.length}, csv_extension);
+
+    g_metrics_dump = {
+        .file=file,
+        .csv=csv,
+        .interval_in_frames=Max(interval_in_frames, 1),
+        .start_time_ns=GetTimeInNanoseconds(),
+    };
+
+    LogMessage(Log_Metrics, "Writing metrics to %.*s every %d frames", FSTR(filename), g_metrics_dump.interval_in_frames);
+
+    return true;
+}
+
+void StopMetricsDump()
+{
+    if (g_metrics_dump.file)
+        fclose(g_metrics_dump.file);
+
+    g_metrics_dump = {};
+}
+
+bool IsDumpingMetrics()
+{
+    return g_metrics_dump.file != null;
+}
+
+static void WriteCSVHeader(FILE *file, Slice<Metric> metrics)
+{
+    fprintf(file, "frame,time");
+    foreach (i, metrics)
+    {
+        if (metrics[i].type == MetricType_Histogram)
+            fprintf(file, ",%s.count,%s.p50,%s.p99,%s.max", metrics[i].name, metrics[i].name, metrics[i].name, metrics[i].name);
+        else
+            fprintf(file, ",%s", metrics[i].name);
+    }
+    fprintf(file, "\n");
+}
+
+void UpdateMetricsDump()
+{
+    MetricsDump *dump = &g_metrics_dump;
+    if (!dump->file || g_frame_index % dump->interval_in_frames != 0)
+        return;
+
+    Slice<Metric> metrics = GetAllMetrics();
+    f64 time = (GetTimeInNanoseconds() - dump->start_time_ns) * 1e-9;
+
+    if (dump->csv)
+    {
+        if (metrics.count != dump->num_metrics_in_header)
+        {
+            WriteCSVHeader(dump->file, metrics);
+            dump->num_metrics_in_header = (int)metrics.count;
+        }
+
+        fprintf(dump->file, "%llu,%.3f", g_frame_index, time);
+        foreach (i, metrics)
+        {
+            Metric *metric = &metrics[i];
+            if (metric->type == MetricType_Histogram)
+            {
+                s64 count = __atomic_load_n(&metric->count, __ATOMIC_RELAXED);
+                s64 max = count > 0 ? __atomic_load_n(&metric->max, __ATOMIC_RELAXED) : 0;
+                fprintf(dump->file, ",%lld,%lld,%lld,%lld", count, GetMetricPercentile(metric, 0.5), GetMetricPercentile(metric, 0.99), max);
+            }
+            else
+            {
+                fprintf(dump->file, ",%lld", GetMetricValue(metric));
+            }
+        }
+        fprintf(dump->file, "\n");
+    }
+    else
+    {
+        fprintf(dump->file, "{\"frame\":%llu,\"time\":%.3f", g_frame_index, time);
+        foreach (i, metrics)
+        {
+            Metric *metric = &metrics[i];
+            if (metric->type == MetricType_Histogram)
+            {
+                s64 count = __atomic_load_n(&metric->count, __ATOMIC_RELAXED);
+                s64 max = count > 0 ? __atomic_load_n(&metric->max, __ATOMIC_RELAXED) : 0;
+                fprintf(dump->file, ",\"%s\":{\"count\":%lld,\"p50\":%lld,\"p99\":%lld,\"max\":%lld}", metric->name, count, GetMetricPercentile(metric, 0.5), GetMetricPercentile(metric, 0.99), max);
+            }
+            else
+            {
+                fprintf(dump->file, ",\"%s\":%lld", metric->name, GetMetricValue(metric));
+            }
+        }
+        fprintf(dump->file, "}\n");
+    }
+
+    // Soak runs might not end cleanly, so we do not want to lose what was buffered
+    fflush(dump->file);
+}
@@ -0,0 +1,377 @@
+#include "OffsetAllocator.hpp"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define Small_Size_Limit Offset_Allocator_Num_Second_Level_Bins
+
+static inline u32 MostSignificantBit(u32 x)
+{
+    Assert(x != 0);
+
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse(&index, x);
+    return index;
+#else
+    return 31 - __builtin_clz(x);
+#endif
+}
+
+static inline u32 LeastSignificantBit(u32 x)
+{
+    Assert(x != 0);
+
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return index;
+#else
+    return __builtin_ctz(x);
+#endif
+}
+
+// Sizes smaller than Small_Size_Limit each get their own bin in the first level,
+// bigger sizes are split in power of two ranges (first level) further divided in
+// Offset_Allocator_Num_Second_Level_Bins linear ranges (second level)
+static void GetBinForSize(u64 size, u32 *first_level, u32 *second_level)
+{
+    if (size > 0xffffffff)
+    {
+        *first_level = Offset_Allocator_Num_First_Level_Bins;
+        *second_level = 0;
+    }
+    else if (size < Small_Size_Limit)
+    {
+        *first_level = 0;
+        *second_level = (u32)size;
+    }
+    else
+    {
+        u32 msb = MostSignificantBit((u32)size);
+        *first_level = msb - Offset_Allocator_Num_Second_Level_Bins_Log2 + 1;
+        *second_level = (u32)(size >> (msb - Offset_Allocator_Num_Second_Level_Bins_Log2)) ^ Offset_Allocator_Num_Second_Level_Bins;
+    }
+}
+
+static inline u32 GetBinIndex(u32 first_level, u32 second_level)
+{
+    return first_level * Offset_Allocator_Num_Second_Level_Bins + second_level;
+}
+
+static u32 NewNode(OffsetAllocator *allocator)
+{
+    if (allocator->unused_nodes.count > 0)
+    {
+        u32 index = allocator->unused_nodes[allocator->unused_nodes.count - 1];
+        ArrayPop(&allocator->unused_nodes);
+        allocator->nodes[index] = {};
+
+        return index;
+    }
+
+    ArrayPush(&allocator->nodes);
+
+    return (u32)(allocator->nodes.count - 1);
+}
+
+static void ReleaseNode(OffsetAllocator *allocator, u32 index)
+{
+    allocator->nodes[index] = {};
+    ArrayPush(&allocator->unused_nodes, index);
+}
+
+static void InsertFreeNode(OffsetAllocator *allocator, u32 index)
+{
+    OffsetAllocatorNode *node = &allocator->nodes[index];
+
+    u32 first_level, second_level;
+    GetBinForSize(node->size, &first_level, &second_level);
+    u32 bin = GetBinIndex(first_level, second_level);
+
+    node->used = false;
+    node->prev_free = Offset_Allocator_Invalid_Node;
+    node->next_free = allocator->bin_heads[bin];
+    if (node->next_free != Offset_Allocator_Invalid_Node)
+        allocator->nodes[node->next_free].prev_free = index;
+
+    allocator->bin_heads[bin] = index;
+    allocator->second_level_bitmaps[first_level] |= 1 << second_level;
+    allocator->first_level_bitmap |= 1 << first_level;
+    allocator->num_free_blocks += 1;
+}
+
+static void RemoveFreeNode(OffsetAllocator *allocator, u32 index)
+{
+    OffsetAllocatorNode *node = &allocator->nodes[index];
+    Assert(!node->used);
+
+    if (node->prev_free != Offset_Allocator_Invalid_Node)
+        allocator->nodes[node->prev_free].next_free = node->next_free;
+    if (node->next_free != Offset_Allocator_Invalid_Node)
+        allocator->nodes[node->next_free].prev_free = node->prev_free;
+
+    u32 first_level, second_level;
+    GetBinForSize(node->size, &first_level, &second_level);
+    u32 bin = GetBinIndex(first_level, second_level);
+
+    if (allocator->bin_heads[bin] == index)
+    {
+        allocator->bin_heads[bin] = node->next_free;
+        if (node->next_free == Offset_Allocator_Invalid_Node)
+        {
+            allocator->second_level_bitmaps[first_level] &= ~(1 << second_level);
+            if (allocator->second_level_bitmaps[first_level] == 0)
+                allocator->first_level_bitmap &= ~(1 << first_level);
+        }
+    }
+
+    node->prev_free = Offset_Allocator_Invalid_Node;
+    node->next_free = Offset_Allocator_Invalid_Node;
+    allocator->num_free_blocks -= 1;
+}
+
+// Returns the head of a bin whose blocks are all at least size large
+static u32 FindFreeNode(OffsetAllocator *allocator, u32 size)
+{
+    // Round up to the next bin so that any block in the bin we find is large enough
+    u64 rounded_size = size;
+    if (size >= Small_Size_Limit)
+        rounded_size += (1ull << (MostSignificantBit(size) - Offset_Allocator_Num_Second_Level_Bins_Log2)) - 1;
+
+    u32 first_level, second_level;
+    GetBinForSize(rounded_size, &first_level, &second_level);
+    if (first_level >= Offset_Allocator_Num_First_Level_Bins)
+        return Offset_Allocator_Invalid_Node;
+
+    u32 second_level_map = allocator->second_level_bitmaps[first_level] & (~0u << second_level);
+    if (!second_level_map)
+    {
+        if (first_level + 1 >= Offset_Allocator_Num_First_Level_Bins)
+            return Offset_Allocator_Invalid_Node;
+
+        u32 first_level_map = allocator->first_level_bitmap & (~0u << (first_level + 1));
+        if (!first_level_map)
+            return Offset_Allocator_Invalid_Node;
+
+        first_level = LeastSignificantBit(first_level_map);
+        second_level_map = allocator->second_level_bitmaps[first_level];
+    }
+
+    second_level = LeastSignificantBit(second_level_map);
+
+    return allocator->bin_heads[GetBinIndex(first_level, second_level)];
+}
+
+void InitOffsetAllocator(OffsetAllocator *allocator, u32 size, Allocator node_allocator)
+{
+    *allocator = {};
+    allocator->nodes.allocator = node_allocator;
+    allocator->unused_nodes.allocator = node_allocator;
+
+    for (int i = 0; i < Offset_Allocator_Num_Bins; i += 1)
+        allocator->bin_heads[i] = Offset_Allocator_Invalid_Node;
+
+    GrowOffsetAllocator(allocator, size);
+}
+
+void DestroyOffsetAllocator(OffsetAllocator *allocator)
+{
+    ArrayFree(&allocator->nodes);
+    ArrayFree(&allocator->unused_nodes);
+    *allocator = {};
+}
+
+OffsetAllocation AllocOffset(OffsetAllocator *allocator, u32 size, void *user_data)
+{
+    if (size == 0)
+        return {};
+
+    u32 index = FindFreeNode(allocator, size);
+    if (index == Offset_Allocator_Invalid_Node)
+        return {};
+
+    RemoveFreeNode(allocator, index);
+
+    // Give back what we do not need as a new free block
+    if (allocator->nodes[index].size > size)
+    {
+        u32 remainder = NewNode(allocator);
+
+        OffsetAllocatorNode *node = &allocator->nodes[index];
+        OffsetAllocatorNode *remainder_node = &allocator->nodes[remainder];
+
+        remainder_node->offset = node->offset + size;
+        remainder_node->size = node->size - size;
+        remainder_node->prev_physical = index;
+        remainder_node->next_physical = node->next_physical;
+
+        if (node->next_physical != Offset_Allocator_Invalid_Node)
+            allocator->nodes[node->next_physical].prev_physical = remainder;
+        else
+            allocator->last_physical = remainder;
+
+        node->next_physical = remainder;
+        node->size = size;
+
+        InsertFreeNode(allocator, remainder);
+    }
+
+    OffsetAllocatorNode *node = &allocator->nodes[index];
+    node->used = true;
+    node->user_data = user_data;
+
+    allocator->used_size += size;
+    allocator->num_allocations += 1;
+
+    return {.offset=node->offset, .size=node->size, .node=index};
+}
+
+void FreeOffset(OffsetAllocator *allocator, OffsetAllocation allocation)
+{
+    if (IsNull(allocation))
+        return;
+
+    u32 index = allocation.node;
+    Assert(index < allocator->nodes.count);
+    Assert(allocator->nodes[index].used, "Double free in offset allocator");
+    Assert(allocator->nodes[index].offset == allocation.offset && allocator->nodes[index].size == allocation.size);
+
+    allocator->used_size -= allocation.size;
+    allocator->num_allocations -= 1;
+
+    allocator->nodes[index].used = false;
+    allocator->nodes[index].user_data = null;
+
+    u32 prev = allocator->nodes[index].prev_physical;
+    if (prev != Offset_Allocator_Invalid_Node && !allocator->nodes[prev].used)
+    {
+        RemoveFreeNode(allocator, prev);
+
+        OffsetAllocatorNode *node = &allocator->nodes[index];
+        OffsetAllocatorNode *prev_node = &allocator->nodes[prev];
+        prev_node->size += node->size;
+        prev_node->next_physical = node->next_physical;
+
+        if (node->next_physical != Offset_Allocator_Invalid_Node)
+            allocator->nodes[node->next_physical].prev_physical = prev;
+        else
+            allocator->last_physical = prev;
+
+        ReleaseNode(allocator, index);
+        index = prev;
+    }
+
+    u32 next = allocator->nodes[index].next_physical;
+    if (next != Offset_Allocator_Invalid_Node && !allocator->nodes[next].used)
+    {
+        RemoveFreeNode(allocator, next);
+
+        OffsetAllocatorNode *node = &allocator->nodes[index];
+        OffsetAllocatorNode *next_node = &allocator->nodes[next];
+        node->size += next_node->size;
+        node->next_physical = next_node->next_physical;
+
+        if (next_node->next_physical != Offset_Allocator_Invalid_Node)
+            allocator->nodes[next_node->next_physical].prev_physical = index;
+        else
+            allocator->last_physical = index;
+
+        ReleaseNode(allocator, next);
+    }
+
+    InsertFreeNode(allocator, index);
+}
+
+void GrowOffsetAllocator(OffsetAllocator *allocator, u32 new_size)
+{
+    Assert(new_size >= allocator->size);
+
+    u32 extra = new_size - allocator->size;
+    if (extra == 0)
+        return;
+
+    u32 last = allocator->last_physical;
+    if (last != Offset_Allocator_Invalid_Node && !allocator->nodes[last].used)
+    {
+        RemoveFreeNode(allocator, last);
+        allocator->nodes[last].size += extra;
+        InsertFreeNode(allocator, last);
+    }
+    else
+    {
+        u32 index = NewNode(allocator);
+        allocator->nodes[index].offset = allocator->size;
+        allocator->nodes[index].size = extra;
+        allocator->nodes[index].prev_physical = last;
+
+        if (last != Offset_Allocator_Invalid_Node)
+            allocator->nodes[last].next_physical = index;
+
+        allocator->last_physical = index;
+
+        InsertFreeNode(allocator, index);
+    }
+
+    allocator->size = new_size;
+}
+
+OffsetAllocatorStats GetOffsetAllocatorStats(OffsetAllocator *allocator)
+{
+    OffsetAllocatorStats stats{};
+    stats.size = allocator->size;
+    stats.used_size = allocator->used_size;
+    stats.free_size = allocator->size - allocator->used_size;
+    stats.num_allocations = allocator->num_allocations;
+    stats.num_free_blocks = allocator->num_free_blocks;
+
+    // The largest free block is in the highest non empty bin
+    if (allocator->first_level_bitmap)
+    {
+        u32 first_level = MostSignificantBit(allocator->first_level_bitmap);
+        u32 second_level = MostSignificantBit(allocator->second_level_bitmaps[first_level]);
+
+        u32 index = allocator->bin_heads[GetBinIndex(first_level, second_level)];
+        while (index != Offset_Allocator_Invalid_Node)
+        {
+            if (allocator->nodes[index].size > stats.largest_free_block)
+                stats.largest_free_block = allocator->nodes[index].size;
+            index = allocator->nodes[index].next_free;
+        }
+    }
+
+    if (stats.free_size > 0)
+        stats.fragmentation = 1 - stats.largest_free_block / (float)stats.free_size;
+
+    return stats;
+}
+
+Array<OffsetAllocatorBlock> GetOffsetAllocatorBlocks(OffsetAllocator *allocator, Allocator allocator_for_result)
+{
+    Array<OffsetAllocatorBlock> result = {.allocator=allocator_for_result};
+    ArrayReserve(&result, allocator->num_allocations);
+
+    u32 index = allocator->last_physical;
+    if (index == Offset_Allocator_Invalid_Node)
+        return result;
+
+    while (allocator->nodes[index].prev_physical != Offset_Allocator_Invalid_Node)
+        index = allocator->nodes[index].prev_physical;
+
+    while (index != Offset_Allocator_Invalid_Node)
+    {
+        OffsetAllocatorNode *node = &allocator->nodes[index];
+        if (node->used)
+        {
+            ArrayPush(&result, {
+                .allocation={.offset=node->offset, .size=node->size, .node=index},
+                .user_data=node->user_data,
+            });
+        }
+
+        index = node->next_physical;
+    }
+
+    return result;
+}
@@ -0,0 +1,250 @@
+#include "Profiler.hpp"
+#include "Math.hpp"
+
+static ProfilerThread g_profiler_threads[Profiler_Max_Threads];
+static int g_profiler_num_threads = 0;
+static pthread_mutex_t g_profiler_threads_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static thread_local ProfilerThread *t_profiler_thread = null;
+
+static s64 g_profiler_start_ns = GetTimeInNanoseconds();
+static s64 g_profiler_frame_start_ns = 0;
+static ProfileFrameSummary g_profiler_last_frame = {};
+
+void ProfilerRegisterThread(const char *name)
+{
+    pthread_mutex_lock(&g_profiler_threads_mutex);
+    defer(pthread_mutex_unlock(&g_profiler_threads_mutex));
+
+    ProfilerThread *thread = null;
+    for (int i = 0; i < g_profiler_num_threads; i += 1)
+    {
+        if (!g_profiler_threads[i].active && strcmp(g_profiler_threads[i].name, name) == 0)
+        {
+            thread = &g_profiler_threads[i];
+            break;
+        }
+    }
+
+    if (!thread)
+    {
+        if (g_profiler_num_threads >= Profiler_Max_Threads)
+        {
+            LogWarning(Log_Profiler, "Too many threads, zones of thread '%s' will not be recorded", name);
+            return;
+        }
+
+        thread = &g_profiler_threads[g_profiler_num_threads];
+        snprintf(thread->name, sizeof(thread->name), "%s", name);
+        thread->events = Alloc<ProfileEvent>(Profiler_Events_Per_Thread, TaggedHeap(MemoryTag_Profiler), true);
+
+        // Readers do not take the mutex, so the thread is published after it is initialized
+        __atomic_store_n(&g_profiler_num_threads, g_profiler_num_threads + 1, __ATOMIC_RELEASE);
+    }
+
+    thread->active = true;
+    thread->depth = 0;
+
+    t_profiler_thread = thread;
+}
+
+void ProfilerUnregisterThread()
+{
+    if (!t_profiler_thread)
+        return;
+
+    pthread_mutex_lock(&g_profiler_threads_mutex);
+    t_profiler_thread->active = false;
+    pthread_mutex_unlock(&g_profiler_threads_mutex);
+
+    t_profiler_thread = null;
+}
+
+void ProfilerShutdown()
+{
+    pthread_mutex_lock(&g_profiler_threads_mutex);
+    defer(pthread_mutex_unlock(&g_profiler_threads_mutex));
+
+    for (int i = 0; i < g_profiler_num_threads; i += 1)
+    {
+        Free(g_profiler_threads[i].events, TaggedHeap(MemoryTag_Profiler));
+        g_profiler_threads[i] = {};
+    }
+
+    __atomic_store_n(&g_profiler_num_threads, 0, __ATOMIC_RELEASE);
+
+    t_profiler_thread = null;
+}
+
+void ProfilerBeginZone(const char *name)
+{
+    ProfilerThread *thread = t_profiler_thread;
+    if (!thread)
+        return;
+
+    Assert(thread->depth < Profiler_Max_Zone_Depth, "Profiler zones are nested too deep");
+
+    thread->open_zones[thread->depth] = {.name=name, .start_ns=GetTimeInNanoseconds()};
+    thread->depth += 1;
+}
+
+void ProfilerEndZone()
+{
+    s64 end_ns = GetTimeInNanoseconds();
+
+    ProfilerThread *thread = t_profiler_thread;
+    if (!thread)
+        return;
+
+    Assert(thread->depth > 0, "Unbalanced profiler zones");
+    thread->depth -= 1;
+
+    ProfileOpenZone zone = thread->open_zones[thread->depth];
+    thread->events[thread->head & (Profiler_Events_Per_Thread - 1)] = {
+        .name=zone.name,
+        .start_ns=zone.start_ns,
+        .end_ns=end_ns,
+        .depth=thread->depth,
+    };
+
+    // The event has to be visible to the readers before the new head
+    __atomic_store_n(&thread->head, thread->head + 1, __ATOMIC_RELEASE);
+}
+
+static ProfileZoneSummary *FindOrAddZoneSummary(ProfileFrameSummary *summary, const char *name)
+{
+    for (int i = 0; i < summary->num_zones; i += 1)
+    {
+        if (summary->zones[i].name == name || strcmp(summary->zones[i].name, name) == 0)
+            return &summary->zones[i];
+    }
+
+    if (summary->num_zones >= Profiler_Max_Zone_Summaries)
+        return null;
+
+    ProfileZoneSummary *result = &summary->zones[summary->num_zones];
+    *result = {.name=name};
+    summary->num_zones += 1;
+
+    return result;
+}
+
+static int CompareZoneSummaries(const void *a, const void *b)
+{
+    s64 x = ((ProfileZoneSummary *)a)->total_ns;
+    s64 y = ((ProfileZoneSummary *)b)->total_ns;
+
+    return (x < y) - (x > y);
+}
+
+// The ring holds Profiler_Events_Per_Thread slots, and the slot at head is the one
+// the owning thread writes next, which is also the oldest event of a full ring
+static inline u64 GetFirstCompleteEvent(u64 head)
+{
+    return head >= Profiler_Events_Per_Thread ? head - Profiler_Events_Per_Thread + 1 : 0;
+}
+
+void ProfilerNewFrame()
+{
+    s64 now = GetTimeInNanoseconds();
+
+    ProfileFrameSummary summary{};
+    summary.frame_ns = g_profiler_frame_start_ns > 0 ? now - g_profiler_frame_start_ns : 0;
+    g_profiler_frame_start_ns = now;
+
+    int num_threads = __atomic_load_n(&g_profiler_num_threads, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < num_threads; i += 1)
+    {
+        ProfilerThread *thread = &g_profiler_threads[i];
+
+        u64 head = __atomic_load_n(&thread->head, __ATOMIC_ACQUIRE);
+
+        // The thread might have written more events than the ring can hold since last time
+        u64 first = Max(thread->summary_cursor, GetFirstCompleteEvent(head));
+
+        for (u64 j = first; j < head; j += 1)
+        {
+            ProfileEvent event = thread->events[j & (Profiler_Events_Per_Thread - 1)];
+
+            // Skip the event if the thread wrapped around and started overwriting it while we were copying it
+            if (GetFirstCompleteEvent(__atomic_load_n(&thread->head, __ATOMIC_ACQUIRE)) > j)
+                continue;
+
+            ProfileZoneSummary *zone = FindOrAddZoneSummary(&summary, event.name);
+            if (!zone)
+                continue;
+
+            s64 duration = event.end_ns - event.start_ns;
+            zone->count += 1;
+            zone->total_ns += duration;
+            zone->max_ns = Max(zone->max_ns, duration);
+        }
+
+        thread->summary_cursor = head;
+    }
+
+    qsort(summary.zones, summary.num_zones, sizeof(ProfileZoneSummary), CompareZoneSummaries);
+
+    g_profiler_last_frame = summary;
+}
+
+ProfileFrameSummary *ProfilerGetLastFrameSummary()
+{
+    return &g_profiler_last_frame;
+}
+
+bool ProfilerWriteChromeTrace(String filename)
+{
+    FILE *file = fopen(CloneToCString(filename, temp), "w");
+    if (!file)
+    {
+        LogError(Log_Profiler, "Could not open %.*s for writing", FSTR(filename));
+        return false;
+    }
+
+    defer(fclose(file));
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Vox\"}}");
+
+    auto events = Alloc<ProfileEvent>(Profiler_Events_Per_Thread, TaggedHeap(MemoryTag_Profiler));
+    defer(Free(events, TaggedHeap(MemoryTag_Profiler)));
+
+    s64 num_written = 0;
+    int num_threads = __atomic_load_n(&g_profiler_num_threads, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < num_threads; i += 1)
+    {
+        ProfilerThread *thread = &g_profiler_threads[i];
+
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", i + 1, thread->name);
+        fprintf(file, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"sort_index\":%d}}", i + 1, i);
+
+        u64 head = __atomic_load_n(&thread->head, __ATOMIC_ACQUIRE);
+        u64 first = GetFirstCompleteEvent(head);
+        for (u64 j = first; j < head; j += 1)
+            events[j - first] = thread->events[j & (Profiler_Events_Per_Thread - 1)];
+
+        // Skip the events the thread overwrote while we were copying them
+        u64 new_head = __atomic_load_n(&thread->head, __ATOMIC_ACQUIRE);
+        u64 first_valid = GetFirstCompleteEvent(new_head);
+
+        for (u64 j = Max(first, first_valid); j < head; j += 1)
+        {
+            ProfileEvent event = events[j - first];
+
+            // Timestamps are in microseconds
+            fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                event.name, i + 1,
+                (event.start_ns - g_profiler_start_ns) / 1000.0,
+                (event.end_ns - event.start_ns) / 1000.0);
+
+            num_written += 1;
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+
+    LogMessage(Log_Profiler, "Wrote %lld events from %d threads to %.*s", num_written, num_threads, FSTR(filename));
+
+    return true;
+}
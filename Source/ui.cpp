@@ -10,6 +10,11 @@
 #define UI_Elem_Padding 6
 #define UI_Button_Padding 3
 
+#define UI_Max_Profiler_Zones 16
+#define UI_Profiler_Trace_Filename "vox-trace.json"
+#define UI_Metrics_Dump_Filename "vox-metrics.csv"
+#define UI_Chunk_Traces_Filename "vox-chunk-traces.json"
+
 static const char UI_Font_Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+-=()[]{}<>/*:#%!?.,'\"@&$";
 
 static bool g_ui_has_mouse;
@@ -22,10 +27,22 @@ Array<UIRectElement> g_ui_elements;
 GfxTexture g_ui_font;
 GfxTexture g_ui_white_texture;
 
+void DestroyUI()
+{
+    ArrayFree(&g_ui_elements);
+
+    if (!IsNull(&g_ui_font))
+        GfxDestroyTexture(&g_ui_font);
+    if (!IsNull(&g_ui_white_texture))
+        GfxDestroyTexture(&g_ui_white_texture);
+
+    DestroyUIPipeline();
+}
+
 void UIBeginFrame()
 {
     if (!g_ui_elements.allocator.func)
-        g_ui_elements.allocator = heap;
+        g_ui_elements.allocator = TaggedHeap(MemoryTag_UI);
 
     if (IsNull(&g_ui_font))
     {
@@ -43,6 +60,7 @@ void UIBeginFrame()
         Assert(!IsNull(&g_ui_font));
 
         GfxReplaceTextureRegion(&g_ui_font, {0,0,0}, {(u32)width,(u32)height,1}, 0, 0, pixels);
+        stbi_image_free(pixels);
     }
 
     if (IsNull(&g_ui_white_texture))
@@ -162,6 +180,31 @@ void UIImage(GfxTexture *texture, Vec2f size, Vec2f uv0, Vec2f uv1)
     ArrayPush(&g_ui_elements, elem);
 }
 
+// Bar graph, values are clamped to max_value
+void UIGraph(Slice<float> values, Vec2f size, float max_value)
+{
+    UIRectElement bg{};
+    bg.size = size;
+    bg.position = LayoutElem(size);
+    bg.color = {0, 0, 0, 1};
+    ArrayPush(&g_ui_elements, bg);
+
+    if (values.count <= 0 || max_value <= 0)
+        return;
+
+    float bar_width = size.x / values.count;
+    foreach (i, values)
+    {
+        float height = Clamp(values[i] / max_value, 0.0f, 1.0f) * size.y;
+
+        UIRectElement bar{};
+        bar.size = {bar_width, height};
+        bar.position = {bg.position.x + i * bar_width, bg.position.y + size.y - height};
+        bar.color = {0, 1, 0, 1};
+        ArrayPush(&g_ui_elements, bar);
+    }
+}
+
 void UIText(String text)
 {
     text = GetIdText(text);
@@ -558,7 +601,7 @@ static const char *Noise_Param_Names[] = {
 static GfxTexture GenerateTerrainTexture(World *world, int size_in_chunks)
 {
     int pixel_size = size_in_chunks * 2 * Chunk_Size;
-    u32 *pixels = Alloc<u32>(pixel_size * pixel_size, heap);
+    u32 *pixels = Alloc<u32>(pixel_size * pixel_size, TaggedHeap(MemoryTag_UI));
 
     for (int z = -size_in_chunks; z < size_in_chunks; z += 1)
     {
@@ -569,7 +612,7 @@ static GfxTexture GenerateTerrainTexture(World *world, int size_in_chunks)
             int px_min_y = (z + size_in_chunks) * Chunk_Size;
             int px_max_y = px_min_y + Chunk_Size;
 
-            Chunk *chunk = HashMapFind(&world->chunks_by_position, {(s16)x, (s16)z});
+            Chunk *chunk = FindChunk(&world->chunk_grid, (s16)x, (s16)z);
             if (!chunk)
             {
                 for (int px_y = px_min_y; px_y < px_max_y; px_y += 1)
@@ -642,7 +685,7 @@ static GfxTexture GenerateNoiseTexture(World *world, int param, u32 size)
     desc.usage = GfxTextureUsage_ShaderRead;
     auto texture = GfxCreateTexture(name, desc);
 
-    u32 *pixels = Alloc<u32>(size * size, heap);
+    u32 *pixels = Alloc<u32>(size * size, TaggedHeap(MemoryTag_UI));
     for (u32 y = 0; y < size; y += 1)
     {
         for (u32 x = 0; x < size; x += 1)
@@ -797,7 +840,7 @@ static void ShowTerrainEditorUI(World *world)
     // if (regenerate && !IsNull(&terrain_texture))
     //     GfxDestroyTexture(&terrain_texture);
 
-    // if (IsNull(&terrain_texture) && world->num_generated_chunks == world->all_chunks.count)
+    // if (IsNull(&terrain_texture) && world->num_generated_chunks == world->chunks.items.count)
     //     terrain_texture = GenerateTerrainTexture(world, g_settings.render_distance);
 }
 
@@ -810,6 +853,176 @@ static void ShowGraphicsEditorUI(World *world)
 
     UIText("== Debug ==");
     UICheckbox("show debug atlas", &g_show_debug_atlas);
+    UICheckbox("connectivity culling", &g_settings.connectivity_culling);
+    if (g_settings.connectivity_culling)
+        UIText(TPrintf("visible chunks: %d/%lld", world->num_visible_chunks, world->chunks.items.count));
+    UIText("");
+
+    UIText("== GPU Timings ==");
+    {
+        // Oldest on the left
+        int num_frames = GfxGetNumFrameTimings();
+        auto gpu_times = AllocSlice<float>(num_frames, temp);
+        float max_gpu_time = 0;
+        for (int i = 0; i < num_frames; i += 1)
+        {
+            gpu_times[i] = GfxGetFrameTimings(num_frames - 1 - i)->gpu_time;
+            max_gpu_time = Max(max_gpu_time, gpu_times[i]);
+        }
+
+        UIText(TPrintf("frame: %.2f ms, max %.2f ms over %d frames", GfxGetLastFrameGPUTime() * 1000, max_gpu_time * 1000, num_frames));
+        UIGraph(gpu_times, {2 * Gfx_Timing_History_Length, 60}, Max(max_gpu_time, 1 / 60.0f));
+
+        GfxFrameTimings *timings = GfxGetFrameTimings(0);
+        if (timings)
+        {
+            for (int i = 0; i < timings->num_scopes; i += 1)
+            {
+                GfxTimingScope *scope = &timings->scopes[i];
+                UIText(TPrintf("%*s%.*s: %.3f ms", scope->depth * 2, "", scope->name_length, scope->name, scope->time * 1000));
+            }
+        }
+    }
+    UIText("");
+
+    UIText("== CPU Profiler ==");
+    {
+        ProfileFrameSummary *summary = ProfilerGetLastFrameSummary();
+        UIText(TPrintf("frame: %.2f ms", summary->frame_ns / 1000000.0));
+
+        // Zones are sorted by total time, worker threads are summed together
+        for (int i = 0; i < Min(summary->num_zones, UI_Max_Profiler_Zones); i += 1)
+        {
+            ProfileZoneSummary *zone = &summary->zones[i];
+            UIText(TPrintf("%s: %.3f ms, %d calls, max %.3f ms", zone->name, zone->total_ns / 1000000.0, zone->count, zone->max_ns / 1000000.0));
+        }
+
+        if (UIButton("write trace"))
+            ProfilerWriteChromeTrace(UI_Profiler_Trace_Filename);
+    }
+    UIText("");
+
+    UIText("== Jobs ==");
+    {
+        JobSystem *jobs = &world->jobs;
+        UIText(TPrintf("%lld workers, %d queued, %d waiting for dependencies", jobs->workers.count, GetNumQueuedJobs(jobs), GetNumWaitingJobs(jobs)));
+
+        foreach (i, jobs->workers)
+        {
+            JobWorker *worker = &jobs->workers[i];
+            UIText(TPrintf("worker %lld: %.0f%%, %lld jobs", i, worker->utilization * 100, __atomic_load_n(&worker->num_jobs, __ATOMIC_RELAXED)));
+
+            s64 scratch_allocations = __atomic_load_n(&worker->num_scratch_allocations, __ATOMIC_RELAXED);
+            s64 scratch_peak_used = __atomic_load_n(&worker->scratch_peak_used, __ATOMIC_RELAXED);
+            s64 scratch_reserved = __atomic_load_n(&worker->scratch_reserved, __ATOMIC_RELAXED);
+            UIText(TPrintf("  scratch: %lld allocations, peak %.1f KB, reserved %.1f KB", scratch_allocations, scratch_peak_used / 1024.0, scratch_reserved / 1024.0));
+        }
+    }
+    UIText("");
+
+    UIText("== Memory ==");
+    for (int i = 0; i < MemoryTag_Count; i += 1)
+    {
+        MemoryTagStats stats = GetMemoryTagStats((MemoryTag)i);
+        UIText(TPrintf("%s: %.2f MiB, peak %.2f MiB, %lld allocations (%lld total)", GetMemoryTagName((MemoryTag)i), stats.live_bytes / (1024.0 * 1024.0), stats.peak_bytes / (1024.0 * 1024.0), stats.num_live_allocations, stats.num_allocations));
+    }
+    UIText("");
+
+    UIText("== Metrics ==");
+    {
+        Slice<Metric> metrics = GetAllMetrics();
+        foreach (i, metrics)
+        {
+            Metric *metric = &metrics[i];
+            if (metric->type == MetricType_Histogram)
+            {
+                s64 count = metric->count;
+                s64 max = count > 0 ? metric->max : 0;
+                UIText(TPrintf("%s: %lld values, p50 %lld, p99 %lld, max %lld", metric->name, count, GetMetricPercentile(metric, 0.5), GetMetricPercentile(metric, 0.99), max));
+            }
+            else
+            {
+                UIText(TPrintf("%s: %lld", metric->name, GetMetricValue(metric)));
+            }
+        }
+
+        if (!IsDumpingMetrics())
+        {
+            if (UIButton("start writing metrics"))
+                StartMetricsDump(UI_Metrics_Dump_Filename, Default_Metrics_Dump_Interval);
+        }
+        else
+        {
+            if (UIButton("stop writing metrics"))
+                StopMetricsDump();
+        }
+    }
+    UIText("");
+
+    UIText("== Chunk Latency ==");
+    {
+        const char *stage_names[ChunkLatencyStage_Count] = {
+            "generation queue", "generation", "generation handoff",
+            "neighbor wait", "mesh queue", "meshing", "mesh handoff",
+            "upload", "queue to visible",
+        };
+
+        for (int i = 0; i < ChunkLatencyStage_Count; i += 1)
+        {
+            Metric *metric = GetChunkLatencyMetric((ChunkLatencyStage)i);
+            UIText(TPrintf("%s: p50 %.2f ms, p99 %.2f ms", stage_names[i], GetMetricPercentile(metric, 0.5) / 1000000.0, GetMetricPercentile(metric, 0.99) / 1000000.0));
+        }
+
+        if (UIButton("write slowest chunk traces"))
+            WriteChunkTraceOutliers(UI_Chunk_Traces_Filename);
+    }
+    UIText("");
+
+    UIText("== GPU State ==");
+    {
+        GfxStateStats stats = GfxGetLastFrameStateStats();
+        UIText(TPrintf("state changes: %lld issued, %lld skipped", stats.num_issued, stats.num_skipped));
+    }
+    UIText("");
+
+    UIText("== Frame Data ==");
+    {
+        GfxAllocatorStats stats = GetGfxAllocatorStats(FrameDataGfxAllocator());
+        UIText(TPrintf("used: %.1f/%.1f MiB, peak %.1f MiB, %d frames in flight", stats.used / (1024.0 * 1024.0), stats.capacity / (1024.0 * 1024.0), stats.high_water / (1024.0 * 1024.0), stats.num_frames_in_flight));
+        UIText(TPrintf("last frame: %.1f KiB, max %.1f KiB, grown %d times", stats.last_frame_bytes / 1024.0, stats.max_frame_bytes / 1024.0, stats.num_grows));
+    }
+    UIText("");
+
+    UIText("== Chunk Uploads ==");
+    UIIntEdit("upload budget (MiB)", &g_settings.chunk_upload_budget_in_mb, 1, 64);
+    UIFloatEdit("upload budget (ms)", &g_settings.chunk_upload_budget_in_ms, 0.5, 16, 0.5);
+    UIText(TPrintf("pending: %lld chunks, %.1f MiB", g_chunk_upload_stats.num_pending, g_chunk_upload_stats.pending_bytes / (1024.0 * 1024.0)));
+    UIText(TPrintf("last frame: %d chunks, %.1f MiB in %.2f ms", g_chunk_upload_stats.num_uploaded, g_chunk_upload_stats.uploaded_bytes / (1024.0 * 1024.0), g_chunk_upload_stats.upload_time_ns / 1000000.0));
+    UIText(TPrintf("last drain: %lld chunks in %d frames, %.2f s", g_chunk_upload_stats.last_drain_num_chunks, g_chunk_upload_stats.last_drain_num_frames, g_chunk_upload_stats.last_drain_ns / 1000000000.0));
+    StagingRingStats staging_stats = GetStagingRingStats(&g_chunk_staging_ring);
+    UIText(TPrintf("staging ring: %.1f/%.1f MiB, peak %.1f MiB, %lld failed reservations", staging_stats.used / (1024.0 * 1024.0), staging_stats.capacity / (1024.0 * 1024.0), staging_stats.high_water / (1024.0 * 1024.0), staging_stats.num_failed_reservations));
+    UIText("");
+
+    UIText("== Chunk Mesh Pools ==");
+    ChunkMeshPool *pools[] = {&g_chunk_vertex_pool, &g_chunk_index_pool};
+    for (int i = 0; i < (int)StaticArraySize(pools); i += 1)
+    {
+        ChunkMeshPoolStats stats = GetChunkMeshPoolStats(pools[i]);
+        UIText(TPrintf("%.*s: %.1f/%.1f MiB, %u blocks", FSTR(pools[i]->name), stats.used / (1024.0 * 1024.0), stats.capacity / (1024.0 * 1024.0), stats.num_allocations));
+        UIText(TPrintf("  fragmentation: %.2f (%u free blocks, largest %.1f MiB)", stats.fragmentation, stats.num_free_blocks, stats.largest_free_block / (1024.0 * 1024.0)));
+        UIText(TPrintf("  grown %d times, defragmented %d times", stats.num_grows, stats.num_defragmentations));
+    }
+    if (UIButton("defragment"))
+        g_defragment_chunk_mesh_pools = true;
+    UIText("");
+
+    UIText("== Chunk Pool ==");
+    UIIntEdit("free budget (MiB)", &g_settings.chunk_pool_free_budget_in_mb, 0, 1024);
+    {
+        ChunkPoolStats stats = GetChunkPoolStats(&world->chunk_pool);
+        UIText(TPrintf("resident: %.1f/%.1f MiB in %d regions", stats.resident / (1024.0 * 1024.0), stats.reserved / (1024.0 * 1024.0), stats.num_regions));
+        UIText(TPrintf("slots: %lld used, %lld free, %lld released", stats.num_used_slots, stats.num_free_slots, stats.num_released_slots));
+    }
     UIText("");
 
     UIText("== Shadow Map ==");
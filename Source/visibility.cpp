@@ -0,0 +1,356 @@
+#include "Core.hpp"
+#include "World.hpp"
+
+// Connectivity culling: each 16x16x16 section of a chunk stores which pairs of its
+// six faces can see each other through non opaque blocks. Starting from the camera's
+// section, we walk from section to section only through faces that are connected,
+// which discards everything hidden behind terrain (caves, valleys, mountains...)
+
+#define Section_Num_Blocks (Chunk_Size * Chunk_Size * Chunk_Section_Height)
+
+static inline bool IsOpaque(Block block)
+{
+    return Block_Infos[block].mesh_type == ChunkMeshType_Solid;
+}
+
+static inline BlockFace GetOppositeFace(BlockFace face)
+{
+    return (BlockFace)((uint)face ^ 1);
+}
+
+static inline SectionConnectivity ConnectFaces(SectionConnectivity connectivity, BlockFaceFlags faces)
+{
+    for (int a = 0; a < 6; a += 1)
+    {
+        if (!(faces & (1 << a)))
+            continue;
+
+        for (int b = 0; b < 6; b += 1)
+        {
+            if (faces & (1 << b))
+                connectivity |= 1ull << (a * 6 + b);
+        }
+    }
+
+    return connectivity;
+}
+
+bool AreSectionFacesConnected(SectionConnectivity connectivity, BlockFace a, BlockFace b)
+{
+    return (connectivity & (1ull << ((uint)a * 6 + (uint)b))) != 0;
+}
+
+// Marks the opaque blocks of the section as visited so flood fills go around them
+static int MarkOpaqueBlocks(Block *blocks, u64 visited[Section_Num_Blocks / 64])
+{
+    int num_opaque = 0;
+    for (int i = 0; i < Section_Num_Blocks; i += 1)
+    {
+        if (IsOpaque(blocks[i]))
+        {
+            visited[i / 64] |= 1ull << (i % 64);
+            num_opaque += 1;
+        }
+    }
+
+    return num_opaque;
+}
+
+// Visits all the blocks connected to start that were not visited yet, and returns the faces of the section they touch
+static BlockFaceFlags FloodFillSection(int start, u64 visited[Section_Num_Blocks / 64], u16 stack[Section_Num_Blocks])
+{
+    visited[start / 64] |= 1ull << (start % 64);
+
+    int stack_count = 0;
+    stack[stack_count] = (u16)start;
+    stack_count += 1;
+
+    BlockFaceFlags reached_faces = 0;
+    while (stack_count > 0)
+    {
+        stack_count -= 1;
+        int index = stack[stack_count];
+
+        int x = index % Chunk_Size;
+        int z = (index / Chunk_Size) % Chunk_Size;
+        int y = index / (Chunk_Size * Chunk_Size);
+
+        if (x == 0)
+            reached_faces |= BlockFaceFlag_West;
+        if (x == Chunk_Size - 1)
+            reached_faces |= BlockFaceFlag_East;
+        if (y == 0)
+            reached_faces |= BlockFaceFlag_Bottom;
+        if (y == Chunk_Section_Height - 1)
+            reached_faces |= BlockFaceFlag_Top;
+        if (z == 0)
+            reached_faces |= BlockFaceFlag_South;
+        if (z == Chunk_Size - 1)
+            reached_faces |= BlockFaceFlag_North;
+
+        int neighbors[6];
+        int num_neighbors = 0;
+        if (x > 0)
+        {
+            neighbors[num_neighbors] = index - 1;
+            num_neighbors += 1;
+        }
+        if (x < Chunk_Size - 1)
+        {
+            neighbors[num_neighbors] = index + 1;
+            num_neighbors += 1;
+        }
+        if (z > 0)
+        {
+            neighbors[num_neighbors] = index - Chunk_Size;
+            num_neighbors += 1;
+        }
+        if (z < Chunk_Size - 1)
+        {
+            neighbors[num_neighbors] = index + Chunk_Size;
+            num_neighbors += 1;
+        }
+        if (y > 0)
+        {
+            neighbors[num_neighbors] = index - Chunk_Size * Chunk_Size;
+            num_neighbors += 1;
+        }
+        if (y < Chunk_Section_Height - 1)
+        {
+            neighbors[num_neighbors] = index + Chunk_Size * Chunk_Size;
+            num_neighbors += 1;
+        }
+
+        for (int i = 0; i < num_neighbors; i += 1)
+        {
+            int n = neighbors[i];
+            if (visited[n / 64] & (1ull << (n % 64)))
+                continue;
+
+            visited[n / 64] |= 1ull << (n % 64);
+            stack[stack_count] = (u16)n;
+            stack_count += 1;
+        }
+    }
+
+    return reached_faces;
+}
+
+SectionConnectivity ComputeSectionConnectivity(Chunk *chunk, int section_index)
+{
+    Assert(section_index >= 0 && section_index < Chunk_Num_Sections);
+
+    Block *blocks = chunk->blocks + section_index * Section_Num_Blocks;
+
+    u64 visited[Section_Num_Blocks / 64] = {};
+    int num_opaque = MarkOpaqueBlocks(blocks, visited);
+
+    if (num_opaque == 0)
+        return Section_Connectivity_All;
+
+    // A section needs at least a full layer of opaque blocks to separate two faces
+    if (num_opaque < Chunk_Size * Chunk_Size)
+        return Section_Connectivity_All;
+
+    SectionConnectivity result = 0;
+    u16 stack[Section_Num_Blocks];
+
+    for (int start = 0; start < Section_Num_Blocks; start += 1)
+    {
+        if (visited[start / 64] & (1ull << (start % 64)))
+            continue;
+
+        result = ConnectFaces(result, FloodFillSection(start, visited, stack));
+        if (result == Section_Connectivity_All)
+            break;
+    }
+
+    return result;
+}
+
+// Faces of the section the block at (x, y, z) can see through non opaque blocks. From inside
+// of an opaque block we do not know where the camera is looking from, so all faces are returned
+static BlockFaceFlags GetSectionFacesReachableFromBlock(Chunk *chunk, int section_index, int x, int y, int z)
+{
+    Block *blocks = chunk->blocks + section_index * Section_Num_Blocks;
+    int start = y * Chunk_Size * Chunk_Size + z * Chunk_Size + x;
+    if (IsOpaque(blocks[start]))
+        return 0x3f;
+
+    u64 visited[Section_Num_Blocks / 64] = {};
+    MarkOpaqueBlocks(blocks, visited);
+
+    u16 stack[Section_Num_Blocks];
+
+    return FloodFillSection(start, visited, stack);
+}
+
+void ComputeChunkConnectivity(Chunk *chunk, SectionConnectivity connectivity[Chunk_Num_Sections])
+{
+    for (int i = 0; i < Chunk_Num_Sections; i += 1)
+        connectivity[i] = ComputeSectionConnectivity(chunk, i);
+}
+
+struct SectionVisit
+{
+    Chunk *chunk = null;
+    int section = 0;
+    int entry_face = -1;
+    BlockFaceFlags directions = 0;
+};
+
+static Chunk *GetNeighborSection(World *world, Chunk *chunk, int section, BlockFace face, int *neighbor_section)
+{
+    *neighbor_section = section;
+    switch (face)
+    {
+    case BlockFace_East:  return GetChunk(world, chunk->east);
+    case BlockFace_West:  return GetChunk(world, chunk->west);
+    case BlockFace_North: return GetChunk(world, chunk->north);
+    case BlockFace_South: return GetChunk(world, chunk->south);
+    case BlockFace_Top:
+        *neighbor_section = section + 1;
+        return section + 1 < Chunk_Num_Sections ? chunk : null;
+    case BlockFace_Bottom:
+        *neighbor_section = section - 1;
+        return section - 1 >= 0 ? chunk : null;
+    }
+
+    return null;
+}
+
+// Returns true if the section was not visited yet this frame
+static bool MarkSectionVisited(Chunk *chunk, int section, u64 frame_index)
+{
+    if (chunk->visibility_frame != frame_index)
+    {
+        chunk->visibility_frame = frame_index;
+        chunk->visited_sections = 0;
+
+        if (chunk->render_index >= 0)
+            g_chunk_render_table.flags[chunk->render_index] |= ChunkRenderFlag_Visible;
+    }
+
+    u32 bit = 1 << section;
+    if (chunk->visited_sections & bit)
+        return false;
+
+    chunk->visited_sections |= bit;
+
+    return true;
+}
+
+void UpdateChunkVisibility(World *world, Vec3f camera_position, float max_distance)
+{
+    ProfileFunction();
+
+    ChunkKey camera_key = {
+        .x=(s16)floorf(camera_position.x / Chunk_Size),
+        .z=(s16)floorf(camera_position.z / Chunk_Size),
+    };
+
+    ChunkRenderTable *table = &g_chunk_render_table;
+
+    Chunk *start = FindChunk(&world->chunk_grid, camera_key.x, camera_key.z);
+    if (!start)
+    {
+        // We do not know anything about the surroundings of the camera, everything is visible
+        foreach (i, world->chunks.items)
+        {
+            world->chunks[i]->visibility_frame = g_frame_index;
+            world->chunks[i]->visited_sections = 0xffff;
+        }
+
+        for (s64 i = 0; i < table->count; i += 1)
+            table->flags[i] |= ChunkRenderFlag_Visible;
+
+        world->num_visible_chunks = (int)world->chunks.items.count;
+
+        return;
+    }
+
+    int start_section = (int)floorf(camera_position.y / Chunk_Section_Height);
+    start_section = Clamp(start_section, 0, Chunk_Num_Sections - 1);
+
+    // A chunk right next to the camera can still be hidden by the blocks of the camera's section.
+    // The blocks of a chunk are only written before it is generated, so they are safe to read
+    BlockFaceFlags start_faces = 0x3f;
+    int camera_y = (int)floorf(camera_position.y);
+    if (start->is_generated && camera_y >= 0 && camera_y < Chunk_Height)
+    {
+        int camera_x = Clamp((int)floorf(camera_position.x) - start->x * Chunk_Size, 0, Chunk_Size - 1);
+        int camera_z = Clamp((int)floorf(camera_position.z) - start->z * Chunk_Size, 0, Chunk_Size - 1);
+        start_faces = GetSectionFacesReachableFromBlock(start, start_section, camera_x, camera_y % Chunk_Section_Height, camera_z);
+    }
+
+    Vec2f camera_xz = {camera_position.x, camera_position.z};
+
+    ClearChunkRenderFlags(table, ChunkRenderFlag_Visible);
+
+    Array<SectionVisit> queue = {.allocator=temp};
+    ArrayReserve(&queue, world->chunks.items.count * 2);
+
+    MarkSectionVisited(start, start_section, g_frame_index);
+    ArrayPush(&queue, {.chunk=start, .section=start_section});
+
+    int num_visible_chunks = 1;
+
+    for (s64 queue_index = 0; queue_index < queue.count; queue_index += 1)
+    {
+        SectionVisit visit = queue[queue_index];
+        SectionConnectivity connectivity = visit.chunk->section_connectivity[visit.section];
+
+        for (int face = 0; face < 6; face += 1)
+        {
+            BlockFace exit_face = (BlockFace)face;
+            BlockFace entry_face = GetOppositeFace(exit_face);
+
+            // Never walk back towards the direction we came from
+            if (visit.directions & (1 << entry_face))
+                continue;
+
+            if (visit.entry_face < 0)
+            {
+                if (!(start_faces & (1 << exit_face)))
+                    continue;
+            }
+            else if (!AreSectionFacesConnected(connectivity, (BlockFace)visit.entry_face, exit_face))
+            {
+                continue;
+            }
+
+            int neighbor_section;
+            Chunk *neighbor = GetNeighborSection(world, visit.chunk, visit.section, exit_face, &neighbor_section);
+            if (!neighbor)
+                continue;
+
+            if (neighbor != visit.chunk)
+            {
+                Vec2f neighbor_center = {(neighbor->x + 0.5f) * Chunk_Size, (neighbor->z + 0.5f) * Chunk_Size};
+                if (Length(neighbor_center - camera_xz) > max_distance)
+                    continue;
+            }
+
+            bool chunk_was_visible = neighbor->visibility_frame == g_frame_index;
+            if (!MarkSectionVisited(neighbor, neighbor_section, g_frame_index))
+                continue;
+
+            if (!chunk_was_visible)
+                num_visible_chunks += 1;
+
+            ArrayPush(&queue, {
+                .chunk=neighbor,
+                .section=neighbor_section,
+                .entry_face=(int)entry_face,
+                .directions=visit.directions | (1 << exit_face),
+            });
+        }
+    }
+
+    world->num_visible_chunks = num_visible_chunks;
+}
+
+bool IsChunkVisible(Chunk *chunk)
+{
+    return chunk->visibility_frame == g_frame_index && chunk->visited_sections != 0;
+}
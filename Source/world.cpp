@@ -3,16 +3,6 @@
 #include "Input.hpp"
 #include "UI.hpp"
 
-static bool CompareChunkKeys(ChunkKey a, ChunkKey b)
-{
-    return a.x == b.x && a.z == b.z;
-}
-
-static u64 HashChunkKey(ChunkKey key)
-{
-    return Fnv1aHash(&key, sizeof(ChunkKey));
-}
-
 void UpdateCamera(Camera *camera)
 {
     bool moving = IsMouseButtonDown(MouseButton_Right);
@@ -70,23 +60,23 @@ Block GetBlock(Chunk *chunk, int x, int y, int z)
     return chunk->blocks[index];
 }
 
-Block GetBlockInNeighbors(Chunk *chunk, int x, int y, int z)
+Block GetBlockInNeighbors(ChunkNeighborhood *neighborhood, int x, int y, int z)
 {
     if (x < 0)
-        return chunk->west ? GetBlock(chunk->west, Chunk_Size + x, y, z) : Block_Air;
+        return neighborhood->west ? GetBlock(neighborhood->west, Chunk_Size + x, y, z) : Block_Air;
     if (x >= Chunk_Size)
-        return chunk->east ? GetBlock(chunk->east, x - Chunk_Size, y, z) : Block_Air;
+        return neighborhood->east ? GetBlock(neighborhood->east, x - Chunk_Size, y, z) : Block_Air;
     if (z < 0)
-        return chunk->south ? GetBlock(chunk->south, x, y, Chunk_Size + z) : Block_Air;
+        return neighborhood->south ? GetBlock(neighborhood->south, x, y, Chunk_Size + z) : Block_Air;
     if (z >= Chunk_Size)
-        return chunk->north ? GetBlock(chunk->north, x, y, z - Chunk_Size) : Block_Air;
+        return neighborhood->north ? GetBlock(neighborhood->north, x, y, z - Chunk_Size) : Block_Air;
 
-    return GetBlock(chunk, x, y, z);
+    return GetBlock(neighborhood->chunk, x, y, z);
 }
 
-float GetBlockHeight(Chunk *chunk, Block block, int x, int y, int z)
+float GetBlockHeight(ChunkNeighborhood *neighborhood, Block block, int x, int y, int z)
 {
-    Block above = GetBlockInNeighbors(chunk, x, y + 1, z);
+    Block above = GetBlockInNeighbors(neighborhood, x, y + 1, z);
     if (block == Block_Water && above != Block_Water)
         return 14 / 16.0;
 
@@ -138,121 +128,287 @@ void SetDefaultNoiseParams(World *world)
     AddPoint(&world->erosion_spline, 0.980, 0.350, -3.000);
 }
 
-static void GenerateChunkWorker(ThreadGroup *group, void *work);
+struct WorldMetrics
+{
+    Metric *chunks_generating = null;
+    Metric *chunks_meshing = null;
+    Metric *chunks_uploading = null;
+    Metric *chunks_ready = null;
+    Metric *dirty_chunks = null;
+    Metric *chunks_outside_grid = null;
+
+    Metric *generated_chunks = null;
+
+    Metric *queued_jobs = null;
+    Metric *waiting_jobs = null;
+    Metric *worker_utilization = null;
+    Metric *scratch_allocations = null;
+    Metric *scratch_peak_bytes = null;
+    Metric *scratch_reserved_bytes = null;
+    Metric *generation_completed_queue = null;
+    Metric *mesh_completed_queue = null;
+
+    Metric *chunk_size_bytes = null;
+    Metric *chunks_memory_bytes = null;
+    Metric *chunk_pool_reserved_bytes = null;
+    Metric *chunk_pool_resident_bytes = null;
+    Metric *chunk_pool_free_slots = null;
+    Metric *chunk_pool_released_slots = null;
+};
+
+static WorldMetrics g_world_metrics;
+
+static void InitWorldMetrics()
+{
+    WorldMetrics *m = &g_world_metrics;
+
+    m->chunks_generating = RegisterGauge("world.chunks.generating");
+    m->chunks_meshing = RegisterGauge("world.chunks.meshing");
+    m->chunks_uploading = RegisterGauge("world.chunks.uploading");
+    m->chunks_ready = RegisterGauge("world.chunks.ready");
+    m->dirty_chunks = RegisterGauge("world.chunks.dirty");
+    m->chunks_outside_grid = RegisterGauge("world.chunks.outside_grid");
+
+    m->generated_chunks = RegisterCounter("world.generated_chunks");
+
+    m->queued_jobs = RegisterGauge("jobs.queued");
+    m->waiting_jobs = RegisterGauge("jobs.waiting");
+    m->worker_utilization = RegisterGauge("jobs.utilization_percent");
+    m->scratch_allocations = RegisterGauge("jobs.scratch.allocations");
+    m->scratch_peak_bytes = RegisterGauge("jobs.scratch.peak_used");
+    m->scratch_reserved_bytes = RegisterGauge("jobs.scratch.reserved");
+    m->generation_completed_queue = RegisterGauge("world.generation_queue.completed");
+    m->mesh_completed_queue = RegisterGauge("world.mesh_queue.completed");
+
+    m->chunk_size_bytes = RegisterGauge("memory.chunk_size");
+    m->chunks_memory_bytes = RegisterGauge("memory.chunks");
+    m->chunk_pool_reserved_bytes = RegisterGauge("memory.chunk_pool.reserved");
+    m->chunk_pool_resident_bytes = RegisterGauge("memory.chunk_pool.resident");
+    m->chunk_pool_free_slots = RegisterGauge("memory.chunk_pool.free_slots");
+    m->chunk_pool_released_slots = RegisterGauge("memory.chunk_pool.released_slots");
+}
 
-void InitWorld(World *world, u32 seed)
+void PublishWorldMetrics(World *world)
+{
+    WorldMetrics *m = &g_world_metrics;
+
+    // The counters are kept up to date when the chunks change state, so we do not have to walk
+    // every chunk. A chunk can be remeshed while its previous mesh is uploading, so ready is approximate
+    s64 num_generating = world->num_generating_chunks;
+    s64 num_meshing = world->num_meshing_chunks; // Or waiting for its neighbors to be generated
+    s64 num_uploading = g_chunk_upload_stats.num_pending;
+    s64 num_ready = Max(world->chunks.items.count - num_generating - num_meshing - num_uploading, (s64)0);
+
+    MetricSet(m->chunks_generating, num_generating);
+    MetricSet(m->chunks_meshing, num_meshing);
+    MetricSet(m->chunks_uploading, num_uploading);
+    MetricSet(m->chunks_ready, num_ready);
+    MetricSet(m->dirty_chunks, world->dirty_chunks.count);
+    MetricSet(m->chunks_outside_grid, world->chunk_grid.outside.count);
+
+    UpdateJobSystemStats(&world->jobs);
+    MetricSet(m->queued_jobs, GetNumQueuedJobs(&world->jobs));
+    MetricSet(m->waiting_jobs, GetNumWaitingJobs(&world->jobs));
+    MetricSet(m->worker_utilization, (s64)(GetAverageJobWorkerUtilization(&world->jobs) * 100));
+
+    // Allocations are summed over the workers, the peak is the biggest one of a single job
+    s64 scratch_allocations = 0;
+    s64 scratch_peak_used = 0;
+    s64 scratch_reserved = 0;
+    foreach (i, world->jobs.workers)
+    {
+        JobWorker *worker = &world->jobs.workers[i];
+        scratch_allocations += __atomic_load_n(&worker->num_scratch_allocations, __ATOMIC_RELAXED);
+        scratch_peak_used = Max(scratch_peak_used, __atomic_load_n(&worker->scratch_peak_used, __ATOMIC_RELAXED));
+        scratch_reserved += __atomic_load_n(&worker->scratch_reserved, __ATOMIC_RELAXED);
+    }
+
+    MetricSet(m->scratch_allocations, scratch_allocations);
+    MetricSet(m->scratch_peak_bytes, scratch_peak_used);
+    MetricSet(m->scratch_reserved_bytes, scratch_reserved);
+    MetricSet(m->generation_completed_queue, GetNumCompletedJobs(&world->generated_chunks));
+    MetricSet(m->mesh_completed_queue, GetNumCompletedJobs(&world->generated_chunk_meshes));
+
+    // Destroyed chunks that are still pinned by a job are counted too
+    ChunkPoolStats pool_stats = GetChunkPoolStats(&world->chunk_pool);
+    MetricSet(m->chunk_size_bytes, sizeof(Chunk));
+    MetricSet(m->chunks_memory_bytes, pool_stats.num_used_slots * pool_stats.slot_size);
+    MetricSet(m->chunk_pool_reserved_bytes, pool_stats.reserved);
+    MetricSet(m->chunk_pool_resident_bytes, pool_stats.resident);
+    MetricSet(m->chunk_pool_free_slots, pool_stats.num_free_slots);
+    MetricSet(m->chunk_pool_released_slots, pool_stats.num_released_slots);
+}
+
+static void GenerateChunkWorker(void *data);
+
+struct ChunkGenerationWork
+{
+    World *world = null;
+    Chunk *chunk = null;     // Pinned until the job is handled
+    ChunkHandle handle = {}; // Stale once the chunk is destroyed, in which case the result is dropped
+
+    Job job = {};
+};
+
+void InitWorld(World *world, u32 seed, int num_threads)
 {
     RNG rng{};
     RandomSeed(&rng, seed);
 
     world->seed = seed;
 
+    InitWorldMetrics();
+    ClearChunkTraceOutliers();
+
     world->camera.position.y = Water_Level + 5;
 
-    world->chunks_by_position.allocator = heap;
-    world->chunks_by_position.Compare = CompareChunkKeys;
-    world->chunks_by_position.Hash = HashChunkKey;
+    InitChunkGrid(&world->chunk_grid, 0, 0);
+    InitChunkPool(&world->chunk_pool);
     world->num_generated_chunks = 0;
 
-    world->all_chunks.allocator = heap;
-    world->dirty_chunks.allocator = heap;
+    SlotMapSetAllocator(&world->chunks, TaggedHeap(MemoryTag_World));
+    world->dirty_chunks.allocator = TaggedHeap(MemoryTag_World);
 
-    InitThreadGroup(&world->chunk_generation_thread_group, "Chunk Generation", GenerateChunkWorker, 20);
-    Start(&world->chunk_generation_thread_group);
-
-    InitThreadGroup(&world->chunk_mesh_generation_thread_group, "Chunk Mesh Generation", GenerateChunkMeshWorker, 20);
-    Start(&world->chunk_mesh_generation_thread_group);
+    InitJobSystem(&world->jobs, "World Jobs", num_threads);
+    InitJobCompletionQueue(&world->generated_chunks);
+    InitJobCompletionQueue(&world->generated_chunk_meshes);
 
     world->density_params.max_amplitude = PerlinFractalMax(world->density_params.octaves, world->density_params.persistance);
 
-    world->density_offsets = AllocSlice<Vec3f>(world->density_params.octaves, heap);
+    world->density_offsets = AllocSlice<Vec3f>(world->density_params.octaves, TaggedHeap(MemoryTag_World));
     PerlinGenerateOffsets(&rng, &world->density_offsets);
 
     world->continentalness_params.max_amplitude = PerlinFractalMax(world->continentalness_params.octaves, world->continentalness_params.persistance);
 
-    world->continentalness_offsets = AllocSlice<Vec2f>(world->continentalness_params.octaves, heap);
+    world->continentalness_offsets = AllocSlice<Vec2f>(world->continentalness_params.octaves, TaggedHeap(MemoryTag_World));
     PerlinGenerateOffsets(&rng, &world->continentalness_offsets);
 
     world->erosion_params.max_amplitude = PerlinFractalMax(world->erosion_params.octaves, world->erosion_params.persistance);
 
-    world->erosion_offsets = AllocSlice<Vec2f>(world->erosion_params.octaves, heap);
+    world->erosion_offsets = AllocSlice<Vec2f>(world->erosion_params.octaves, TaggedHeap(MemoryTag_World));
     PerlinGenerateOffsets(&rng, &world->erosion_offsets);
 
     world->peaks_and_valleys_params.max_amplitude = PerlinFractalMax(world->peaks_and_valleys_params.octaves, world->peaks_and_valleys_params.persistance);
 
-    world->peaks_and_valleys_offsets = AllocSlice<Vec2f>(world->peaks_and_valleys_params.octaves, heap);
+    world->peaks_and_valleys_offsets = AllocSlice<Vec2f>(world->peaks_and_valleys_params.octaves, TaggedHeap(MemoryTag_World));
     PerlinGenerateOffsets(&rng, &world->peaks_and_valleys_offsets);
 }
 
 void DestroyWorld(World *world)
 {
-    Stop(&world->chunk_generation_thread_group);
-    Stop(&world->chunk_mesh_generation_thread_group);
+    // Jobs point to the chunks, so they have to be gone before the chunks.
+    // Jobs that did not run are handed back through the completion queues too
+    DestroyJobSystem(&world->jobs);
 
-    while (world->all_chunks.count > 0)
-        DestroyChunk(world, world->all_chunks[0]);
+    while (auto job = PopCompletedJob(&world->generated_chunks))
+    {
+        auto work = (ChunkGenerationWork *)job->data;
+        work->chunk->generation_job = null;
+        UnpinChunk(world, work->chunk);
+        Free(work, TaggedHeap(MemoryTag_World));
+    }
+    while (auto job = PopCompletedJob(&world->generated_chunk_meshes))
+    {
+        auto work = (ChunkMeshWork *)job->data;
+        work->neighborhood.chunk->mesh_state = ChunkMeshState_UpToDate;
+        DropChunkMeshWork(world, work);
+    }
+
+    DestroyJobCompletionQueue(&world->generated_chunks);
+    DestroyJobCompletionQueue(&world->generated_chunk_meshes);
 
-    HashMapFree(&world->chunks_by_position);
-    ArrayFree(&world->all_chunks);
+    while (world->chunks.items.count > 0)
+        DestroyChunk(world, world->chunks[0]);
+
+    DestroyChunkGrid(&world->chunk_grid);
+    DestroyChunkPool(&world->chunk_pool);
+    SlotMapFree(&world->chunks);
     ArrayFree(&world->dirty_chunks);
 
-    DestroyThreadGroup(&world->chunk_generation_thread_group);
-    DestroyThreadGroup(&world->chunk_mesh_generation_thread_group);
+    Free(world->density_offsets.data, TaggedHeap(MemoryTag_World));
+    Free(world->continentalness_offsets.data, TaggedHeap(MemoryTag_World));
+    Free(world->erosion_offsets.data, TaggedHeap(MemoryTag_World));
+    Free(world->peaks_and_valleys_offsets.data, TaggedHeap(MemoryTag_World));
 }
 
-void DestroyChunk(World *world, Chunk *chunk)
+void PinChunk(Chunk *chunk)
 {
-    CancelChunkMeshUpload(chunk);
+    chunk->num_pins += 1;
+}
 
-    if (chunk->east)
-    {
-        chunk->east->west = null;
-        MarkChunkDirty(world, chunk->east);
-    }
-    if (chunk->west)
-    {
-        chunk->west->east = null;
-        MarkChunkDirty(world, chunk->west);
-    }
-    if (chunk->north)
+void UnpinChunk(World *world, Chunk *chunk)
+{
+    Assert(chunk->num_pins > 0);
+
+    chunk->num_pins -= 1;
+    if (chunk->num_pins == 0 && IsNull(chunk->handle))
+        FreeChunk(&world->chunk_pool, chunk);
+}
+
+void PinChunkNeighborhood(ChunkNeighborhood *neighborhood)
+{
+    Chunk *chunks[] = {neighborhood->chunk, neighborhood->east, neighborhood->west, neighborhood->north, neighborhood->south};
+    for (int i = 0; i < (int)StaticArraySize(chunks); i += 1)
     {
-        chunk->north->south = null;
-        MarkChunkDirty(world, chunk->north);
+        if (chunks[i])
+            PinChunk(chunks[i]);
     }
-    if (chunk->south)
+}
+
+void UnpinChunkNeighborhood(World *world, ChunkNeighborhood *neighborhood)
+{
+    Chunk *chunks[] = {neighborhood->chunk, neighborhood->east, neighborhood->west, neighborhood->north, neighborhood->south};
+    for (int i = 0; i < (int)StaticArraySize(chunks); i += 1)
     {
-        chunk->south->north = null;
-        MarkChunkDirty(world, chunk->south);
+        if (chunks[i])
+            UnpinChunk(world, chunks[i]);
     }
+}
 
-    GfxDestroyBuffer(&chunk->mesh.vertex_buffer);
-    GfxDestroyBuffer(&chunk->mesh.index_buffer);
+ChunkNeighborhood GetChunkNeighborhood(World *world, Chunk *chunk)
+{
+    return ChunkNeighborhood{
+        .chunk=chunk,
+        .east=GetChunk(world, chunk->east),
+        .west=GetChunk(world, chunk->west),
+        .north=GetChunk(world, chunk->north),
+        .south=GetChunk(world, chunk->south),
+    };
+}
 
-    foreach (i, world->dirty_chunks)
-    {
-        if (world->dirty_chunks[i] == chunk)
-        {
-            ArrayOrderedRemoveAt(&world->dirty_chunks, i);
-            break;
-        }
-    }
+void DestroyChunk(World *world, Chunk *chunk)
+{
+    CancelChunkMeshUpload(chunk);
+    RemoveChunkRenderRecord(&g_chunk_render_table, chunk);
 
-    foreach (i, world->all_chunks)
+    // The links of the neighbors to this chunk go stale by themselves, they only have to be remeshed without it
+    ChunkNeighborhood neighborhood = GetChunkNeighborhood(world, chunk);
+    Chunk *neighbors[] = {neighborhood.east, neighborhood.west, neighborhood.north, neighborhood.south};
+    for (int i = 0; i < (int)StaticArraySize(neighbors); i += 1)
     {
-        if (world->all_chunks[i] == chunk)
-        {
-            ArrayOrderedRemoveAt(&world->all_chunks, i);
-            break;
-        }
+        if (neighbors[i])
+            MarkChunkDirty(world, neighbors[i]);
     }
 
-    HashMapRemove(&world->chunks_by_position, ChunkKey{chunk->x, chunk->z});
+    FreeChunkMesh(&chunk->mesh);
+
+    // If the chunk is in dirty_chunks, the handle is skipped when the mesh jobs are submitted
+    SlotMapRemove(&world->chunks, chunk->handle);
+    chunk->handle = {};
+    __atomic_store_n(&chunk->is_destroyed, true, __ATOMIC_RELAXED);
+
+    RemoveChunkFromGrid(&world->chunk_grid, chunk);
 
-    Free(chunk, heap);
+    if (chunk->num_pins == 0)
+        FreeChunk(&world->chunk_pool, chunk);
 }
 
 void GenerateChunksAroundPoint(World *world, Vec3f point, float radius)
 {
+    ProfileFunction();
+
+    RecenterChunkGrid(&world->chunk_grid, (s32)floorf(point.x / Chunk_Size), (s32)floorf(point.z / Chunk_Size));
+
     int chunk_min_x = (int)((point.x - radius) / Chunk_Size);
     int chunk_min_z = (int)((point.z - radius) / Chunk_Size);
     int chunk_max_x = (int)((point.x + radius) / Chunk_Size);
@@ -268,68 +424,87 @@ void GenerateChunksAroundPoint(World *world, Vec3f point, float radius)
 
 float squashing_factor = 1.0;
 
-struct ChunkGenerationWork
-{
-    World *world = null;
-    Chunk *chunk = null;
-};
-
 void QueueChunkGeneration(World *world, s16 x, s16 z)
 {
-    bool exists = false;
-    Chunk **chunk_ptr = HashMapFindOrAdd(&world->chunks_by_position, {.x=x, .z=z}, &exists);
-    if (exists)
+    if (FindChunk(&world->chunk_grid, x, z))
         return;
 
-    Chunk *chunk = Alloc<Chunk>(heap);
+    Chunk *chunk = AllocChunk(&world->chunk_pool);
     chunk->x = x;
     chunk->z = z;
+    chunk->trace.queued_ns = GetTimeInNanoseconds();
+
+    // Until the chunk is meshed we do not know what it looks like, so consider it see-through
+    for (int i = 0; i < Chunk_Num_Sections; i += 1)
+        chunk->section_connectivity[i] = Section_Connectivity_All;
 
-    ArrayPush(&world->all_chunks, chunk);
-    *chunk_ptr = chunk;
+    chunk->handle = SlotMapAdd(&world->chunks, chunk);
+    AddChunkToGrid(&world->chunk_grid, chunk);
 
-    chunk->east  = HashMapFind(&world->chunks_by_position, ChunkKey{.x=(s16)(chunk->x+1), .z=chunk->z});
-    if (chunk->east)
+    Chunk *east = FindChunk(&world->chunk_grid, (s16)(chunk->x+1), chunk->z);
+    if (east)
     {
-        chunk->east->west = chunk;
-        MarkChunkDirty(world, chunk->east);
+        chunk->east = east->handle;
+        east->west = chunk->handle;
+        MarkChunkDirty(world, east);
     }
 
-    chunk->west  = HashMapFind(&world->chunks_by_position, ChunkKey{.x=(s16)(chunk->x-1), .z=chunk->z});
-    if (chunk->west)
+    Chunk *west = FindChunk(&world->chunk_grid, (s16)(chunk->x-1), chunk->z);
+    if (west)
     {
-        chunk->west->east = chunk;
-        MarkChunkDirty(world, chunk->west);
+        chunk->west = west->handle;
+        west->east = chunk->handle;
+        MarkChunkDirty(world, west);
     }
 
-    chunk->north = HashMapFind(&world->chunks_by_position, ChunkKey{.x=chunk->x, .z=(s16)(chunk->z+1)});
-    if (chunk->north)
+    Chunk *north = FindChunk(&world->chunk_grid, chunk->x, (s16)(chunk->z+1));
+    if (north)
     {
-        chunk->north->south = chunk;
-        MarkChunkDirty(world, chunk->north);
+        chunk->north = north->handle;
+        north->south = chunk->handle;
+        MarkChunkDirty(world, north);
     }
 
-    chunk->south = HashMapFind(&world->chunks_by_position, ChunkKey{.x=chunk->x, .z=(s16)(chunk->z-1)});
-    if (chunk->south)
+    Chunk *south = FindChunk(&world->chunk_grid, chunk->x, (s16)(chunk->z-1));
+    if (south)
     {
-        chunk->south->north = chunk;
-        MarkChunkDirty(world, chunk->south);
+        chunk->south = south->handle;
+        south->north = chunk->handle;
+        MarkChunkDirty(world, south);
     }
 
-    auto work = Alloc<ChunkGenerationWork>(heap);
+    // The mesh job of the chunk is released once the chunk and its neighbors are generated
+    MarkChunkDirty(world, chunk);
+
+    auto work = Alloc<ChunkGenerationWork>(TaggedHeap(MemoryTag_World));
     work->world = world;
     work->chunk = chunk;
+    work->handle = chunk->handle;
+    PinChunk(chunk);
 
-    AddWork(&world->chunk_generation_thread_group, work);
+    world->num_generating_chunks += 1;
+    chunk->generation_job = &work->job;
+    InitJob(chunk->generation_job, GenerateChunkWorker, work, JobPriority_Normal, &world->generated_chunks);
+    SubmitJob(&world->jobs, chunk->generation_job);
 }
 
-void GenerateChunkWorker(ThreadGroup *worker, void *data)
+void GenerateChunkWorker(void *data)
 {
+    ProfileFunction();
+
     auto work = (ChunkGenerationWork *)data;
 
     World *world = work->world;
     Chunk *chunk = work->chunk;
 
+    // The result would be dropped anyway. Chunks come from the pool with whatever blocks they
+    // had before, and the mesh jobs of the neighbors still read them, so they have to be air
+    if (__atomic_load_n(&chunk->is_destroyed, __ATOMIC_RELAXED))
+    {
+        memset(chunk->blocks, Block_Air, sizeof(chunk->blocks));
+        return;
+    }
+
     // Fill surface level terrain params
     for (int iz = 0; iz < Chunk_Size; iz += 1)
     {
@@ -343,12 +518,6 @@ void GenerateChunkWorker(ThreadGroup *worker, void *data)
             float continentalness = PerlinFractalNoise(world->continentalness_params, world->continentalness_offsets, perlin_x, perlin_z);
             float erosion = PerlinFractalNoise(world->erosion_params, world->erosion_offsets, perlin_x, perlin_z);
             erosion = (erosion + 1) * 0.5;
-            float peaks_and_valleys = PerlinFractalNoise(world->peaks_and_valleys_params, world->peaks_and_valleys_offsets, perlin_x, perlin_z);
-            peaks_and_valleys = 1 - Abs(3 * Abs(peaks_and_valleys) - 2);
-
-            chunk->continentalness_values[surface_index] = continentalness;
-            chunk->erosion_values[surface_index] = erosion;
-            chunk->peaks_and_valleys_values[surface_index] = peaks_and_valleys;
 
             float erosion_spline = SampleSpline(&world->erosion_spline, erosion);
             float continentalness_spline = SampleSpline(&world->continentalness_spline, continentalness);
@@ -367,20 +536,8 @@ void GenerateChunkWorker(ThreadGroup *worker, void *data)
             {
                 int surface_index = iz * Chunk_Size + ix;
                 int index = iy * Chunk_Size * Chunk_Size + surface_index;
-
-                float perlin_x = (chunk->x * Chunk_Size + ix);
-                float perlin_y = iy;
-                float perlin_z = (chunk->z * Chunk_Size + iz);
-
-                float continentalness = chunk->continentalness_values[surface_index];
-                float erosion = chunk->erosion_values[surface_index];
-                float peaks_and_valleys = chunk->peaks_and_valleys_values[surface_index];
                 float base_height = chunk->terrain_height_values[surface_index];
 
-                float density = PerlinFractalNoise(world->density_params, world->density_offsets, perlin_x, perlin_y, perlin_z);
-                float density_bias = (base_height - iy) * squashing_factor * squashing_factor;
-                chunk->density_values[index] = density;
-
                 if (iy <= base_height)
                     chunk->blocks[index] = Block_Stone;
                 else if (iy <= Water_Level)
@@ -424,25 +581,49 @@ void GenerateChunkWorker(ThreadGroup *worker, void *data)
 
 void HandleNewlyGeneratedChunks(World *world)
 {
-    auto completed = GetCompletedWork(&world->chunk_generation_thread_group);
-    foreach (i, completed)
+    ProfileFunction();
+
+    while (auto job = PopCompletedJob(&world->generated_chunks))
     {
-        auto work = (ChunkGenerationWork *)completed[i];
+        auto work = (ChunkGenerationWork *)job->data;
+
+        world->num_generating_chunks -= 1;
+        work->chunk->generation_job = null;
+
+        Chunk *chunk = GetChunk(world, work->handle);
+        if (chunk)
+        {
+            chunk->is_generated = true;
+            world->num_generated_chunks += 1;
+            MetricAdd(g_world_metrics.generated_chunks);
 
-        work->chunk->is_generated = true;
-        world->num_generated_chunks += 1;
-        MarkChunkDirty(world, work->chunk);
-        Free(work, heap);
+            chunk->trace.generation_start_ns = job->start_ns;
+            chunk->trace.generation_end_ns = job->end_ns;
+            TraceChunkGenerated(chunk);
+        }
+
+        UnpinChunk(world, work->chunk);
+        Free(work, TaggedHeap(MemoryTag_World));
     }
 }
 
 void MarkChunkDirty(World *world, Chunk *chunk)
 {
-    foreach (i, world->dirty_chunks)
+    switch (chunk->mesh_state)
     {
-        if (world->dirty_chunks[i] == chunk)
-            return;
+    case ChunkMeshState_UpToDate:
+        chunk->mesh_state = ChunkMeshState_Dirty;
+        ArrayPush(&world->dirty_chunks, chunk->handle);
+        break;
+
+    case ChunkMeshState_Meshing:
+        chunk->mesh_state = ChunkMeshState_MeshingDirty;
+        break;
+
+    case ChunkMeshState_Dirty:
+    case ChunkMeshState_MeshingDirty:
+        return;
     }
 
-    ArrayPush(&world->dirty_chunks, chunk);
+    chunk->trace.dirty_ns = GetTimeInNanoseconds();
 }